@@ -1,23 +1,22 @@
+import { createHash } from 'crypto';
 import { NextResponse } from 'next/server';
-import ICAL from 'ical.js';
-
-interface CalendarConfig {
-  url: string;
-  name: string;
-  color: string;
-}
-
-interface CalendarEvent {
-  id: string;
-  title: string;
-  start: string;
-  end: string;
-  allDay: boolean;
-  calendar: string;
-  color: string;
-  location?: string;
-  description?: string;
-}
+import { CalendarConfig, CalendarEvent, FeedText, RequestTiming, SeriesOutput, feedEvents } from '@/lib/feeds';
+import { EVENT_FIELDS, deviceEvents, deviceSeries, parseFields, projectEvents } from '@/lib/fields';
+import {
+  LAYOUT_VIEWS,
+  LayoutView,
+  UtcOffsets,
+  buildLayout,
+  offsetAt,
+  pageDays,
+  pageStart,
+  parseUtcOffsets,
+} from '@/lib/layout';
+import { WATCHED_FRESH_MS, dataVersion, feedText, onFeedChange } from '@/lib/upstream';
+
+// Change streams (?watch=1) run until shortly before this, then the
+// display reconnects
+export const maxDuration = 300;
 
 const calendars: CalendarConfig[] = [
   {
@@ -42,179 +41,149 @@ const calendars: CalendarConfig[] = [
   },
 ].filter((cal) => cal.url);
 
-async function fetchICS(config: CalendarConfig, rangeStart: Date, rangeEnd: Date): Promise<CalendarEvent[]> {
+const DAY_MS = 24 * 60 * 60 * 1000;
+const WATCH_PING_MS = 15 * 1000; // WATCH_PING_SECS in esp32/src/watch.h
+const WATCH_MAX_MS = (maxDuration - 10) * 1000;
+
+async function fetchICS(
+  config: CalendarConfig,
+  feed: FeedText | null,
+  rangeStart: Date,
+  rangeEnd: Date,
+  timing: RequestTiming,
+  compact?: SeriesOutput
+): Promise<CalendarEvent[]> {
   try {
-    const response = await fetch(config.url, {
-      next: { revalidate: 300 }, // Cache for 5 minutes
-    } as any);
-
-    if (!response.ok) {
-      console.error(`Failed to fetch ${config.name}: ${response.status}`);
-      return [];
-    }
-
-    const icsData = await response.text();
-    const jcalData = ICAL.parse(icsData);
-    const comp = new ICAL.Component(jcalData);
-    const params: CalendarEvent[] = [];
-
-    // Group events by UID to handle overrides
-    const eventsByUid = new Map<string, ICAL.Component[]>();
-    const vevents = comp.getAllSubcomponents('vevent');
-
-    for (const vevent of vevents) {
-      const uid = vevent.getFirstPropertyValue('uid');
-      if (!uid || typeof uid !== 'string') continue; // Skip events without valid UID
+    if (!feed) return [];
 
-      if (!eventsByUid.has(uid)) {
-        eventsByUid.set(uid, []);
-      }
-      eventsByUid.get(uid)?.push(vevent);
-    }
-
-    for (const [uid, components] of eventsByUid) {
-      // Find master event (no recurrence-id)
-      const masterComp = components.find(c => !c.getFirstPropertyValue('recurrence-id'));
-      const exceptions = components.filter(c => c.getFirstPropertyValue('recurrence-id'));
-
-      // Helper to convert ICAL.Time to JS Date, respecting all-day events
-      const icalTimeToDate = (icalTime: any): Date => {
-        if (!icalTime) return new Date();
+    // Parsing and expansion are cached per feed (lib/feeds.ts)
+    return feedEvents(config, feed, rangeStart, rangeEnd, timing, compact);
+  } catch (error) {
+    console.error(`Error fetching ${config.name}:`, error);
+    return [];
+  }
+}
 
-        // For all-day events (DATE type, not DATE-TIME), create date without timezone conversion
-        if (icalTime.isDate) {
-          return new Date(icalTime.year, icalTime.month - 1, icalTime.day, 0, 0, 0, 0);
+// Server-Sent Events for displays (esp32/src/watch.h): the data version
+// now and after every feed change, pings in between. While the stream is
+// open feeds are revalidated every WATCHED_FRESH_MS, so a display learns
+// about upstream edits within about a minute instead of a polling interval.
+function watchResponse(request: Request): Response {
+  const encoder = new TextEncoder();
+  let stop = () => {};
+  const stream = new ReadableStream<Uint8Array>({
+    start(controller) {
+      let open = true;
+      let sent = '';
+      const send = (text: string) => {
+        if (!open) return;
+        try {
+          controller.enqueue(encoder.encode(text));
+        } catch {
+          stop();
         }
-
-        // For timed events, use toJSDate() which handles timezone properly
-        return icalTime.toJSDate();
       };
-
-      // Helper to get a normalized timestamp for comparing recurrence instances
-      const getNormalizedTimestamp = (icalTime: any): number => {
-        if (!icalTime) return 0;
-
-        // For all-day events, use year/month/day only to avoid timezone shifts
-        if (icalTime.isDate) {
-          return new Date(icalTime.year, icalTime.month - 1, icalTime.day).getTime();
+      const check = async () => {
+        const timing: RequestTiming = { upstream: 0, parse: 0, expand: 0 };
+        const feeds = await Promise.all(calendars.map((config) => feedText(config, timing, WATCHED_FRESH_MS)));
+        const version = dataVersion(calendars, feeds);
+        if (version !== sent) {
+          sent = version;
+          send(`event: version\ndata: ${version}\n\n`);
         }
-
-        // For timed events, convert to UTC timestamp
-        return icalTime.toUnixTime() * 1000;
-      };
-
-      // Helper to process a single event instance
-      const processEvent = (event: ICAL.Event, start: Date, end: Date) => {
-        // Skip cancelled
-        if (event.summary && event.summary.includes('Canceled:')) return;
-        const status = event.component.getFirstPropertyValue('status');
-        if (status === 'CANCELLED') return;
-
-        // Check if fully outside range
-        if (end < rangeStart || start > rangeEnd) return;
-
-        params.push({
-          id: `${config.name}-${event.uid}-${start.getTime()}`,
-          title: event.summary || 'Untitled',
-          start: start.toISOString(),
-          end: end.toISOString(),
-          allDay: event.startDate.isDate,
-          calendar: config.name,
-          color: config.color,
-          location: event.location || undefined,
-          description: event.description || undefined,
-        });
       };
 
-      // 1. Process Master Event (Expansion)
-      if (masterComp) {
-        const masterEvent = new ICAL.Event(masterComp);
-
-        // Skip master if cancelled
-        if (masterEvent.component.getFirstPropertyValue('status') === 'CANCELLED') {
-          // If master is cancelled, do we skip overrides? usually yes, but let's be safe.
-          // Actually if master is cancelled, the whole series is usually dead.
-        } else if (masterEvent.isRecurring()) {
-          const iterator = masterEvent.iterator();
-          let next;
-          let count = 0;
-          const maxOccurrences = 500;
-
-          // Track exception dates (recurrence-ids) to skip them in expansion
-          const exceptionDates = new Set<number>();
-          for (const ex of exceptions) {
-            const rid = ex.getFirstPropertyValue('recurrence-id');
-            if (rid) {
-              exceptionDates.add(getNormalizedTimestamp(rid));
-            }
-          }
-
-          while ((next = iterator.next()) && count < maxOccurrences) {
-            // Convert ICAL.Time to proper JS Date respecting all-day events
-            const start = icalTimeToDate(next);
-
-            // If this date is covered by an exception (override), skip it here
-            // (The exception will be processed separately or is a cancellation)
-            const normalizedTimestamp = getNormalizedTimestamp(next);
-            if (exceptionDates.has(normalizedTimestamp)) {
-              continue;
-            }
-
-            if (start > rangeEnd) break;
-
-            const duration = masterEvent.duration;
-            const end = new Date(start.getTime() + (duration ? duration.toSeconds() * 1000 : 0));
-
-            if (end < rangeStart) continue;
-
-            processEvent(masterEvent, start, end);
-            count++;
-          }
-        } else {
-          // Master is not recurring
-          const start = icalTimeToDate(masterEvent.startDate);
-          const duration = masterEvent.duration;
-          const end = masterEvent.endDate
-            ? icalTimeToDate(masterEvent.endDate)
-            : new Date(start.getTime() + (duration ? duration.toSeconds() * 1000 : 0));
-          processEvent(masterEvent, start, end);
+      const unsubscribe = onFeedChange(() => void check());
+      const ping = setInterval(() => {
+        send(': ping\n\n');
+        void check();
+      }, WATCH_PING_MS);
+      const end = setTimeout(() => stop(), WATCH_MAX_MS);
+      stop = () => {
+        if (!open) return;
+        open = false;
+        clearInterval(ping);
+        clearTimeout(end);
+        unsubscribe();
+        try {
+          controller.close();
+        } catch {
+          // Already closed by the client going away
         }
-      }
-
-      // 2. Process Exceptions (Overrides) independently
-      // These are specific instances (moves) or single separate events
-      for (const exComp of exceptions) {
-        const exEvent = new ICAL.Event(exComp);
-        // Recurrence-ID exists, meaning it replaces a specific instance.
-        // We already skipped the "original" time in the master loop above.
-        // Now just add this event as is (if not cancelled).
-
-        const start = icalTimeToDate(exEvent.startDate);
-        const duration = exEvent.duration;
-        const end = exEvent.endDate
-          ? icalTimeToDate(exEvent.endDate)
-          : new Date(start.getTime() + (duration ? duration.toSeconds() * 1000 : 0));
-
-        processEvent(exEvent, start, end);
-      }
-    }
+      };
+      request.signal.addEventListener('abort', () => stop());
+      void check();
+    },
+    cancel() {
+      stop();
+    },
+  });
 
-    return params;
-  } catch (error) {
-    console.error(`Error fetching ${config.name}:`, error);
-    return [];
-  }
+  return new Response(stream, {
+    headers: {
+      'Content-Type': 'text/event-stream',
+      'Cache-Control': 'no-cache, no-transform',
+      'X-Accel-Buffering': 'no',
+    },
+  });
 }
 
 export async function GET(request: Request) {
+  const requestStart = performance.now();
   const { searchParams } = new URL(request.url);
   const from = searchParams.get('from');
   const to = searchParams.get('to');
 
   // Define strict expansion window based on request
   // Default to [Now - 1 month, Now + 6 months] if not provided
-  const rangeStart = from ? new Date(from) : new Date(Date.now() - 30 * 24 * 60 * 60 * 1000);
-  const rangeEnd = to ? new Date(to) : new Date(Date.now() + 180 * 24 * 60 * 60 * 1000);
+  let rangeStart = from ? new Date(from) : new Date(Date.now() - 30 * 24 * 60 * 60 * 1000);
+  let rangeEnd = to ? new Date(to) : new Date(Date.now() + 180 * 24 * 60 * 60 * 1000);
+
+  // Render-ready page instead of raw events (lib/layout.ts):
+  // layout=day|week|month, w/h panel size, date=YYYY-MM-DD on the page
+  // (default today), tz=local UTC offset in minutes and its DST changes
+  // (parseUtcOffsets())
+  const layout = searchParams.get('layout');
+  let page: { view: LayoutView; anchor: number; offsets: UtcOffsets; w: number; h: number } | null = null;
+  if (layout) {
+    if (!LAYOUT_VIEWS.includes(layout as LayoutView)) {
+      return NextResponse.json({ error: `Unknown layout ${layout}` }, { status: 400 });
+    }
+    const offsets = parseUtcOffsets(searchParams.get('tz'));
+    const date = searchParams.get('date');
+    const today = Math.floor((Date.now() + offsetAt(offsets, Date.now())) / DAY_MS) * DAY_MS;
+    const anchor = date && /^\d{4}-\d{2}-\d{2}$/.test(date) ? Date.parse(`${date}T00:00:00Z`) : today;
+    page = {
+      view: layout as LayoutView,
+      anchor,
+      offsets,
+      w: parseInt(searchParams.get('w') || '', 10) || 1024,
+      h: parseInt(searchParams.get('h') || '', 10) || 600,
+    };
+    // The page's days on the local clock, plus a day of slack for the offset
+    const first = pageStart(page.view, anchor);
+    rangeStart = new Date(first - DAY_MS);
+    rangeEnd = new Date(first + (pageDays(page.view) + 1) * DAY_MS);
+  }
+
+  // Trimmed events (lib/fields.ts): profile=device, or fields=title,start,...
+  const profile = searchParams.get('profile');
+  if (profile && profile !== 'device') {
+    return NextResponse.json({ error: `Unknown profile ${profile}` }, { status: 400 });
+  }
+  // Recurring series as rules instead of instances, for the display
+  const series = searchParams.get('series') === '1';
+  if (series && profile !== 'device') {
+    return NextResponse.json({ error: 'series=1 needs profile=device' }, { status: 400 });
+  }
+  const fieldList = searchParams.get('fields');
+  const fields = fieldList ? parseFields(fieldList) : null;
+  if (fieldList && !fields) {
+    return NextResponse.json(
+      { error: `Unknown field in ${fieldList}, expected ${EVENT_FIELDS.join(',')}` },
+      { status: 400 }
+    );
+  }
 
   // Security check
   const apiSecret = process.env.API_SECRET;
@@ -227,10 +196,35 @@ export async function GET(request: Request) {
     );
   }
 
+  if (searchParams.get('watch')) return watchResponse(request);
+
   try {
-    // Fetch all calendars in parallel, passing the range constraints
+    // Last good copy of every feed, revalidated in the background (lib/upstream.ts)
+    const timing: RequestTiming = { upstream: 0, parse: 0, expand: 0 };
+    const feeds = await Promise.all(calendars.map((config) => feedText(config, timing)));
+
+    // "<data version>.<window or page>": a client holding it gets a 304
+    // and nothing is parsed, expanded or sent
+    const version = dataVersion(calendars, feeds);
+    const windowKey = page
+      ? `${page.view} ${page.anchor} ${JSON.stringify(page.offsets)} ${page.w}x${page.h}`
+      : `${rangeStart.getTime()} ${rangeEnd.getTime()} ${profile ?? ''} ${fields?.join(',') ?? ''} ${series ? 'series' : ''}`;
+    const etag = `"${version}.${createHash('sha1').update(windowKey).digest('hex').slice(0, 12)}"`;
+    const ifNoneMatch = request.headers.get('if-none-match');
+    if (ifNoneMatch && ifNoneMatch.split(',').some((tag) => tag.trim() === etag)) {
+      return new NextResponse(null, {
+        status: 304,
+        headers: {
+          ETag: etag,
+          'Server-Timing': `upstream;dur=${timing.upstream.toFixed(1)}, total;dur=${(performance.now() - requestStart).toFixed(1)}`,
+        },
+      });
+    }
+
+    // Parse and expand all calendars, passing the range constraints
+    const compact: SeriesOutput | undefined = series && !page ? { series: [], zones: new Map() } : undefined;
     const allEventsArrays = await Promise.all(
-      calendars.map(config => fetchICS(config, rangeStart, rangeEnd))
+      calendars.map((config, i) => fetchICS(config, feeds[i], rangeStart, rangeEnd, timing, compact))
     );
 
     let events = allEventsArrays.flat();
@@ -247,17 +241,48 @@ export async function GET(request: Request) {
       (a, b) => new Date(a.start).getTime() - new Date(b.start).getTime()
     );
 
+    const layoutStart = performance.now();
     // Return calendar metadata along with events
-    const response = {
-      calendars: calendars.map((cal) => ({
-        name: cal.name,
-        color: cal.color,
-      })),
-      events,
-      fetchedAt: new Date().toISOString(),
-    };
-
-    return NextResponse.json(response);
+    const calendarList = calendars.map((cal) => ({
+      name: cal.name,
+      color: cal.color,
+    }));
+    let response: object;
+    if (page) {
+      response = buildLayout(page.view, page.anchor, page.offsets, page.w, page.h, events, calendars);
+    } else if (compact) {
+      // The window is sent along so instances can be made for it without the request
+      response = {
+        profile,
+        calendars: calendarList,
+        events: deviceEvents(events, calendars),
+        ...deviceSeries(compact, calendars),
+        from: rangeStart.toISOString().slice(0, 19),
+        to: rangeEnd.toISOString().slice(0, 19),
+        version,
+      };
+    } else if (profile) {
+      response = { profile, calendars: calendarList, events: deviceEvents(events, calendars), version };
+    } else {
+      response = {
+        calendars: calendarList,
+        events: fields ? projectEvents(events, fields) : events,
+        fetchedAt: new Date().toISOString(),
+        version,
+      };
+    }
+    const layoutMs = performance.now() - layoutStart;
+
+    // Read back by the display's refresh log (esp32/src/refresh_log.h)
+    const serverTiming = [
+      `upstream;dur=${timing.upstream.toFixed(1)}`,
+      `parse;dur=${timing.parse.toFixed(1)}`,
+      `expand;dur=${timing.expand.toFixed(1)}`,
+      ...(page ? [`layout;dur=${layoutMs.toFixed(1)}`] : []),
+      `total;dur=${(performance.now() - requestStart).toFixed(1)}`,
+    ].join(', ');
+
+    return NextResponse.json(response, { headers: { ETag: etag, 'Server-Timing': serverTiming } });
   } catch (error) {
     console.error('Calendar API error:', error);
     return NextResponse.json(
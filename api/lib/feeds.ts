@@ -0,0 +1,594 @@
+import ICAL from 'ical.js';
+
+export interface CalendarConfig {
+  url: string;
+  name: string;
+  color: string;
+}
+
+export interface CalendarEvent {
+  id: string;
+  title: string;
+  start: string;
+  end: string;
+  allDay: boolean;
+  calendar: string;
+  color: string;
+  location?: string;
+  description?: string;
+}
+
+// A recurring master sent once instead of instance by instance (series=1,
+// lib/fields.ts), for displays that expand it themselves (esp32/src/series.h)
+export interface CalendarSeries {
+  title: string;
+  calendar: string;
+  allDay: boolean;
+  start: string; // DTSTART as wall time in `zone`, "YYYY-MM-DDTHH:MM:SS"
+  zone: string | null; // TZID, null for UTC, floating and all-day
+  duration: number; // Seconds, every instance
+  rrule: string;
+  exdates: string[]; // UTC starts of instances that don't happen (EXDATE, overridden)
+  location?: string;
+}
+
+// From a wall time "YYYY-MM-DDTHH:MM:SS" on, a zone is `offset` seconds
+// east of UTC; the first shift also applies before it
+export type ZoneShift = [string, number];
+
+// Filled by feedEvents() for series=1
+export interface SeriesOutput {
+  series: CalendarSeries[];
+  zones: Map<string, ZoneShift[]>; // By TZID, covering the window
+}
+
+// An ICS download and the hash the caches are keyed by
+export interface FeedText {
+  text: string;
+  hash: string;
+}
+
+// Milliseconds spent per step, reported to clients as Server-Timing.
+// Feeds are fetched in parallel, so upstream is the slowest feed; parsing
+// and expansion run on the one JS thread and are summed over all feeds.
+export interface RequestTiming {
+  upstream: number;
+  parse: number;
+  expand: number;
+}
+
+const MAX_OCCURRENCES = 500; // Per series and expansion pass
+const MAX_COVERAGE_MS = 400 * 24 * 60 * 60 * 1000; // Start over instead of growing past this
+const DAY_MS = 24 * 60 * 60 * 1000;
+
+// Switches for scripts/bench-expand.ts, which compares both ways
+export const expandOptions = {
+  skipAhead: true,
+};
+
+// All components of one UID: the master (if any) and its overrides
+interface Series {
+  master?: ICAL.Event;
+  exceptions: ICAL.Event[];
+  exceptionDates: Set<number>; // Normalized recurrence-ids, skipped when expanding the master
+}
+
+// Where a recurring master's expansion stopped: `next` is the first
+// occurrence that wasn't looked at yet
+interface SeriesCursor {
+  iterator: any;
+  next: any;
+}
+
+// Instances overlapping [start, end], kept so a sliding window only
+// expands the part it hasn't seen
+interface Expansion {
+  start: number;
+  end: number;
+  byId: Map<string, CalendarEvent>;
+  masters: Map<string, Series>; // Instance id -> series, for instances made from a recurring master
+  cursors: Map<Series, SeriesCursor>; // Resume points at `end`
+  sorted: CalendarEvent[] | null; // Rebuilt after the map changes
+}
+
+interface FeedEntry {
+  hash: string;
+  series: Series[];
+  expansion: Expansion | null;
+}
+
+// Per feed URL; lives as long as the server instance
+const cache = new Map<string, FeedEntry>();
+
+// Helper to convert ICAL.Time to JS Date, respecting all-day events
+const icalTimeToDate = (icalTime: any): Date => {
+  if (!icalTime) return new Date();
+
+  // For all-day events (DATE type, not DATE-TIME), create date without timezone conversion
+  if (icalTime.isDate) {
+    return new Date(icalTime.year, icalTime.month - 1, icalTime.day, 0, 0, 0, 0);
+  }
+
+  // For timed events, use toJSDate() which handles timezone properly
+  return icalTime.toJSDate();
+};
+
+// Helper to get a normalized timestamp for comparing recurrence instances
+const getNormalizedTimestamp = (icalTime: any): number => {
+  if (!icalTime) return 0;
+
+  // For all-day events, use year/month/day only to avoid timezone shifts
+  if (icalTime.isDate) {
+    return new Date(icalTime.year, icalTime.month - 1, icalTime.day).getTime();
+  }
+
+  // For timed events, convert to UTC timestamp
+  return icalTime.toUnixTime() * 1000;
+};
+
+const isCancelled = (event: ICAL.Event): boolean =>
+  Boolean(event.summary && event.summary.includes('Canceled:')) ||
+  event.component.getFirstPropertyValue('status') === 'CANCELLED';
+
+const eventEnd = (event: ICAL.Event, start: Date): Date => {
+  const duration = event.duration;
+  return new Date(start.getTime() + (duration ? duration.toSeconds() * 1000 : 0));
+};
+
+const BYDAY_PATTERN = /^([+-]?\d+)?(MO|TU|WE|TH|FR|SA|SU)$/;
+
+const gcd = (a: number, b: number): number => (b ? gcd(b, a % b) : a);
+
+// Where to start iterating `event` so the first occurrence ending at or
+// after `rangeStart` comes out within a period, instead of after every
+// occurrence since DTSTART.
+//
+// The start returned is itself an occurrence, a whole number of periods
+// after DTSTART, so iterating from it gives exactly the occurrences a walk
+// from DTSTART would. That only holds for rules that repeat exactly with
+// their period: one RRULE without COUNT (it counts from DTSTART), and
+//   DAILY    optionally BYDAY weekdays (the period becomes whole weeks)
+//   WEEKLY   optionally BYDAY weekdays
+//   MONTHLY  on DTSTART's day (up to the 28th), or one BYDAY like 2TU/-1FR
+//   YEARLY   on DTSTART's day and month (not Feb 29)
+// Anything else returns null and is walked from DTSTART as before.
+function skipAhead(event: ICAL.Event, rangeStart: Date): any {
+  const rrules = event.component.getAllProperties('rrule');
+  if (rrules.length !== 1) return null;
+  const rule: any = rrules[0].getFirstValue();
+  if (!rule || rule.count) return null;
+
+  const dtstart: any = event.startDate;
+  const first = icalTimeToDate(dtstart);
+  const from = rangeStart.getTime() - (eventEnd(event, first).getTime() - first.getTime());
+  if (from <= first.getTime()) return null;
+
+  const interval = rule.interval || 1;
+  const parts: Record<string, any[]> = rule.parts || {};
+  const byday = (parts.BYDAY || []).map((value: string) => BYDAY_PATTERN.exec(value));
+  const byOnly = (...allowed: string[]) =>
+    Object.keys(parts).every((part) => allowed.includes(part) || !parts[part].length);
+  const plainDays = byday.every((m: RegExpExecArray | null) => m && !m[1]);
+
+  // Whole periods to skip: one fewer than fit, so DST shifts and month
+  // lengths can't carry the start past `from`
+  let periods: number;
+  const start = dtstart.clone();
+
+  if (rule.freq === 'DAILY' || rule.freq === 'WEEKLY') {
+    if (!byOnly('BYDAY') || !plainDays) return null;
+    let stepDays = rule.freq === 'WEEKLY' ? 7 * interval : interval;
+    if (rule.freq === 'DAILY' && byday.length) stepDays = (stepDays * 7) / gcd(stepDays, 7);
+    periods = Math.floor((from - first.getTime()) / (stepDays * DAY_MS)) - 1;
+    if (periods < 1) return null;
+    start.adjust(periods * stepDays, 0, 0, 0);
+    return start;
+  }
+
+  const target = new Date(from);
+  const months = (target.getFullYear() - dtstart.year) * 12 + target.getMonth() + 1 - dtstart.month;
+
+  if (rule.freq === 'MONTHLY') {
+    let nth: RegExpExecArray | null = null;
+    if (byday.length) {
+      nth = byday.length === 1 ? byday[0] : null;
+      const pos = nth && nth[1] ? parseInt(nth[1], 10) : 0;
+      if (!nth || !byOnly('BYDAY') || pos < -1 || pos > 4 || pos === 0) return null;
+      if (!dtstart.isNthWeekDay(ICAL.Recur.icalDayToNumericDay(nth[2]), pos)) return null;
+    } else {
+      const bymonthday = parts.BYMONTHDAY || [];
+      if (!byOnly('BYMONTHDAY') || dtstart.day > 28) return null;
+      if (bymonthday.length && (bymonthday.length !== 1 || bymonthday[0] !== dtstart.day)) return null;
+    }
+    periods = Math.floor(months / interval) - 1;
+    if (periods < 1) return null;
+
+    const month = dtstart.year * 12 + dtstart.month - 1 + periods * interval;
+    start.day = 1;
+    start.year = Math.floor(month / 12);
+    start.month = (month % 12) + 1;
+    start.day = nth
+      ? start.nthWeekDay(ICAL.Recur.icalDayToNumericDay(nth[2]), parseInt(nth[1], 10))
+      : dtstart.day;
+    return start;
+  }
+
+  if (rule.freq === 'YEARLY') {
+    const bymonth = parts.BYMONTH || [];
+    const bymonthday = parts.BYMONTHDAY || [];
+    if (!byOnly('BYMONTH', 'BYMONTHDAY') || (dtstart.month === 2 && dtstart.day === 29)) return null;
+    if (bymonth.length && (bymonth.length !== 1 || bymonth[0] !== dtstart.month)) return null;
+    if (bymonthday.length && (bymonthday.length !== 1 || bymonthday[0] !== dtstart.day)) return null;
+    periods = Math.floor(months / 12 / interval) - 1;
+    if (periods < 1) return null;
+    start.year += periods * interval;
+    return start;
+  }
+
+  return null;
+}
+
+function parseFeed(icsData: string): Series[] {
+  const jcalData = ICAL.parse(icsData);
+  const comp = new ICAL.Component(jcalData);
+
+  // Group events by UID to handle overrides
+  const eventsByUid = new Map<string, ICAL.Component[]>();
+  const vevents = comp.getAllSubcomponents('vevent');
+
+  for (const vevent of vevents) {
+    const uid = vevent.getFirstPropertyValue('uid');
+    if (!uid || typeof uid !== 'string') continue; // Skip events without valid UID
+
+    if (!eventsByUid.has(uid)) {
+      eventsByUid.set(uid, []);
+    }
+    eventsByUid.get(uid)?.push(vevent);
+  }
+
+  const series: Series[] = [];
+  for (const components of eventsByUid.values()) {
+    // Find master event (no recurrence-id)
+    const masterComp = components.find(c => !c.getFirstPropertyValue('recurrence-id'));
+    const exceptions = components.filter(c => c.getFirstPropertyValue('recurrence-id'));
+
+    // Track exception dates (recurrence-ids) to skip them in expansion
+    const exceptionDates = new Set<number>();
+    for (const ex of exceptions) {
+      const rid = ex.getFirstPropertyValue('recurrence-id');
+      if (rid) {
+        exceptionDates.add(getNormalizedTimestamp(rid));
+      }
+    }
+
+    series.push({
+      master: masterComp ? new ICAL.Event(masterComp) : undefined,
+      exceptions: exceptions.map(c => new ICAL.Event(c)),
+      exceptionDates,
+    });
+  }
+  return series;
+}
+
+// Add the instances of `series` overlapping [rangeStart, rangeEnd] to `out`.
+// Returns where a recurring master stopped, so the next pass can resume there.
+function expandSeries(
+  config: CalendarConfig,
+  series: Series,
+  rangeStart: Date,
+  rangeEnd: Date,
+  out: Map<string, CalendarEvent>,
+  masters: Map<string, Series>,
+  resume?: SeriesCursor
+): SeriesCursor | undefined {
+  // Helper to process a single event instance, returns its id if added
+  const processEvent = (event: ICAL.Event, start: Date, end: Date): string | undefined => {
+    // Skip cancelled
+    if (isCancelled(event)) return;
+
+    // Check if fully outside range
+    if (end < rangeStart || start > rangeEnd) return;
+
+    const id = `${config.name}-${event.uid}-${start.getTime()}`;
+    out.set(id, {
+      id,
+      title: event.summary || 'Untitled',
+      start: start.toISOString(),
+      end: end.toISOString(),
+      allDay: event.startDate.isDate,
+      calendar: config.name,
+      color: config.color,
+      location: event.location || undefined,
+      description: event.description || undefined,
+    });
+    return id;
+  };
+
+  let cursor: SeriesCursor | undefined;
+
+  // 1. Process Master Event (Expansion)
+  const masterEvent = series.master;
+  if (masterEvent) {
+    // Skip master if cancelled
+    if (masterEvent.component.getFirstPropertyValue('status') === 'CANCELLED') {
+      // If master is cancelled, do we skip overrides? usually yes, but let's be safe.
+      // Actually if master is cancelled, the whole series is usually dead.
+    } else if (masterEvent.isRecurring()) {
+      const skipTo = !resume && expandOptions.skipAhead ? skipAhead(masterEvent, rangeStart) : null;
+      const iterator = resume ? resume.iterator : masterEvent.iterator(skipTo || undefined);
+      let next = resume ? resume.next : iterator.next();
+      let count = 0;
+
+      while (next && count < MAX_OCCURRENCES) {
+        // Convert ICAL.Time to proper JS Date respecting all-day events
+        const start = icalTimeToDate(next);
+
+        // If this date is covered by an exception (override), skip it here
+        // (The exception will be processed separately or is a cancellation)
+        if (!series.exceptionDates.has(getNormalizedTimestamp(next))) {
+          // Not consumed: the next pass starts with this occurrence
+          if (start > rangeEnd) break;
+
+          const end = eventEnd(masterEvent, start);
+          if (end >= rangeStart) {
+            const id = processEvent(masterEvent, start, end);
+            if (id) masters.set(id, series);
+            count++;
+          }
+        }
+        next = iterator.next();
+      }
+      cursor = { iterator, next };
+    } else {
+      // Master is not recurring
+      const start = icalTimeToDate(masterEvent.startDate);
+      const end = masterEvent.endDate ? icalTimeToDate(masterEvent.endDate) : eventEnd(masterEvent, start);
+      processEvent(masterEvent, start, end);
+    }
+  }
+
+  // 2. Process Exceptions (Overrides) independently
+  // These are specific instances (moves) or single separate events
+  for (const exEvent of series.exceptions) {
+    // Recurrence-ID exists, meaning it replaces a specific instance.
+    // We already skipped the "original" time in the master loop above.
+    // Now just add this event as is (if not cancelled).
+    const start = icalTimeToDate(exEvent.startDate);
+    const end = exEvent.endDate ? icalTimeToDate(exEvent.endDate) : eventEnd(exEvent, start);
+    processEvent(exEvent, start, end);
+  }
+
+  return cursor;
+}
+
+const WEEKDAYS = ['SU', 'MO', 'TU', 'WE', 'TH', 'FR', 'SA'];
+const QUARTER_HOUR_MS = 15 * 60 * 1000;
+
+const pad = (n: number, width = 2) => String(n).padStart(width, '0');
+
+// ICAL.Time as written, without converting it to UTC
+const wallTime = (time: any): string =>
+  `${pad(time.year, 4)}-${pad(time.month)}-${pad(time.day)}T${pad(time.hour)}:${pad(time.minute)}:${pad(time.second)}`;
+
+// Masters' rules as esp32/src/rrule.h reads them, null where it would
+// expand differently; a feed's series don't change while it is cached
+const compactRules = new WeakMap<Series, string | null>();
+
+// One RRULE without RDATE/EXRULE, DAILY to YEARLY, with at most
+// INTERVAL, COUNT, UNTIL, WKST, BYDAY (7), BYMONTHDAY (8) and BYMONTH
+function compactRule(series: Series): string | null {
+  let text = compactRules.get(series);
+  if (text !== undefined) return text;
+  text = null;
+  const master = series.master;
+  const component = master?.component;
+  const rrules = component ? component.getAllProperties('rrule') : [];
+  if (
+    master &&
+    !isCancelled(master) &&
+    rrules.length === 1 &&
+    !component!.getFirstProperty('rdate') &&
+    !component!.getFirstProperty('exrule')
+  ) {
+    const rule: any = rrules[0].getFirstValue();
+    const parts: Record<string, any[]> = rule?.parts || {};
+    const byday: any[] = parts.BYDAY || [];
+    const bymonthday: any[] = parts.BYMONTHDAY || [];
+    const bymonth: any[] = parts.BYMONTH || [];
+    const supported =
+      rule &&
+      ['DAILY', 'WEEKLY', 'MONTHLY', 'YEARLY'].includes(rule.freq) &&
+      (rule.interval || 1) <= 1000 &&
+      Object.keys(parts).every((part) => ['BYDAY', 'BYMONTHDAY', 'BYMONTH'].includes(part) || !parts[part].length) &&
+      byday.length <= 7 &&
+      byday.every((value) => {
+        const m = BYDAY_PATTERN.exec(value);
+        return m && Math.abs(parseInt(m[1] || '0', 10)) <= 53;
+      }) &&
+      bymonthday.length <= 8 &&
+      bymonthday.every((day) => day && Math.abs(day) <= 31);
+    if (supported) {
+      const out = [`FREQ=${rule.freq}`];
+      if (rule.interval > 1) out.push(`INTERVAL=${rule.interval}`);
+      if (rule.count) out.push(`COUNT=${rule.count}`);
+      if (rule.until) out.push(`UNTIL=${rule.until.toICALString()}`);
+      if (rule.wkst && rule.wkst !== ICAL.Time.MONDAY) out.push(`WKST=${WEEKDAYS[rule.wkst - 1]}`);
+      if (byday.length) out.push(`BYDAY=${byday.join(',')}`);
+      if (bymonthday.length) out.push(`BYMONTHDAY=${bymonthday.join(',')}`);
+      if (bymonth.length) out.push(`BYMONTH=${bymonth.join(',')}`);
+      text = out.join(';');
+    }
+  }
+  compactRules.set(series, text);
+  return text;
+}
+
+// When `zone`'s UTC offset changes between two days before `from` and two
+// after `to`, found to the quarter hour
+function zoneShifts(zone: any, from: number, to: number): ZoneShift[] {
+  const offsetAt = (wall: number): number => {
+    const d = new Date(wall);
+    const time = new ICAL.Time(
+      {
+        year: d.getUTCFullYear(),
+        month: d.getUTCMonth() + 1,
+        day: d.getUTCDate(),
+        hour: d.getUTCHours(),
+        minute: d.getUTCMinutes(),
+        second: 0,
+        isDate: false,
+      },
+      zone
+    );
+    return zone.utcOffset(time);
+  };
+  const start = Math.floor(from / DAY_MS) * DAY_MS - 2 * DAY_MS;
+  let offset = offsetAt(start);
+  const shifts: ZoneShift[] = [[new Date(start).toISOString().slice(0, 19), offset]];
+  for (let day = start + DAY_MS; day <= to + 2 * DAY_MS; day += DAY_MS) {
+    if (offsetAt(day) === offset) continue;
+    let wall = day - DAY_MS;
+    while (offsetAt(wall) === offset) wall += QUARTER_HOUR_MS;
+    offset = offsetAt(wall);
+    shifts.push([new Date(wall).toISOString().slice(0, 19), offset]);
+  }
+  return shifts;
+}
+
+// `series` as the display gets it for [rangeStart, rangeEnd]; adds its zone to `zones`
+function compactSeries(
+  config: CalendarConfig,
+  series: Series,
+  rangeStart: Date,
+  rangeEnd: Date,
+  zones: Map<string, ZoneShift[]>
+): CalendarSeries {
+  const master = series.master!;
+  const dtstart: any = master.startDate;
+  const first = icalTimeToDate(dtstart);
+  const duration = eventEnd(master, first).getTime() - first.getTime();
+
+  let zone: string | null = null;
+  const tz: any = dtstart.zone;
+  if (!dtstart.isDate && tz && tz.tzid !== 'UTC' && tz.tzid !== 'floating') {
+    zone = tz.tzid as string;
+    if (!zones.has(zone)) zones.set(zone, zoneShifts(tz, rangeStart.getTime(), rangeEnd.getTime()));
+  }
+
+  // Instances the rule makes that the master doesn't show: EXDATEs and
+  // the ones overrides replace (those come as events of their own)
+  const skipped = new Set<number>(series.exceptionDates);
+  for (const prop of master.component.getAllProperties('exdate')) {
+    for (const value of prop.getValues()) skipped.add(getNormalizedTimestamp(value));
+  }
+  const exdates = [...skipped]
+    .filter((time) => time + duration >= rangeStart.getTime() && time <= rangeEnd.getTime())
+    .sort((a, b) => a - b)
+    .map((time) => new Date(time).toISOString().slice(0, 19));
+
+  return {
+    title: master.summary || 'Untitled',
+    calendar: config.name,
+    allDay: dtstart.isDate,
+    start: wallTime(dtstart),
+    zone,
+    duration: Math.round(duration / 1000),
+    rrule: compactRule(series)!,
+    exdates,
+    location: master.location || undefined,
+  };
+}
+
+// Expand every series over [from, to]. With `resume`, recurring masters
+// continue from their cursors instead of from DTSTART (forward extension).
+function expandRange(
+  config: CalendarConfig,
+  entry: FeedEntry,
+  expansion: Expansion,
+  from: number,
+  to: number,
+  resume: boolean
+) {
+  const rangeStart = new Date(from);
+  const rangeEnd = new Date(to);
+  for (const series of entry.series) {
+    const cursor = expandSeries(config, series, rangeStart, rangeEnd, expansion.byId, expansion.masters,
+      resume ? expansion.cursors.get(series) : undefined);
+    if (cursor && (resume || !expansion.cursors.has(series))) expansion.cursors.set(series, cursor);
+  }
+  expansion.sorted = null;
+}
+
+// Instances of one feed overlapping [rangeStart, rangeEnd].
+//
+// The parsed feed is reused while the ICS text hashes the same (hashed once
+// per download, see lib/upstream.ts). Expanded instances are kept for the
+// window covered so far; a request inside it costs a filter, a request that
+// slides it expands only the new part.
+//
+// With `compact`, series the display can expand (compactRule()) go there
+// once each and their instances are left out of the result.
+export function feedEvents(
+  config: CalendarConfig,
+  feed: FeedText,
+  rangeStart: Date,
+  rangeEnd: Date,
+  timing: RequestTiming,
+  compact?: SeriesOutput
+): CalendarEvent[] {
+  let entry = cache.get(config.url);
+  if (!entry || entry.hash !== feed.hash) {
+    const parseStart = performance.now();
+    entry = { hash: feed.hash, series: parseFeed(feed.text), expansion: null };
+    cache.set(config.url, entry);
+    timing.parse += performance.now() - parseStart;
+  }
+
+  const expandStart = performance.now();
+  const from = rangeStart.getTime();
+  const to = rangeEnd.getTime();
+  let expansion = entry.expansion;
+  if (
+    !expansion ||
+    to < expansion.start ||
+    from > expansion.end ||
+    Math.max(to, expansion.end) - Math.min(from, expansion.start) > MAX_COVERAGE_MS
+  ) {
+    // Nothing reusable (first request, new feed content, or a far jump)
+    expansion = { start: from, end: to, byId: new Map(), masters: new Map(), cursors: new Map(), sorted: null };
+    entry.expansion = expansion;
+    expandRange(config, entry, expansion, from, to, false);
+  } else {
+    if (from < expansion.start) {
+      // Earlier instances: masters start over (skipping ahead where they can)
+      expandRange(config, entry, expansion, from, expansion.start, false);
+      expansion.start = from;
+    }
+    if (to > expansion.end) {
+      expandRange(config, entry, expansion, expansion.end, to, true);
+      expansion.end = to;
+    }
+  }
+
+  if (!expansion.sorted) {
+    expansion.sorted = [...expansion.byId.values()].sort(
+      (a, b) => new Date(a.start).getTime() - new Date(b.start).getTime()
+    );
+  }
+  let result = expansion.sorted.filter(
+    (event) => new Date(event.end) >= rangeStart && new Date(event.start) <= rangeEnd
+  );
+  if (compact) {
+    const masters = expansion.masters;
+    const used = new Set<Series>();
+    result = result.filter((event) => {
+      const series = masters.get(event.id);
+      if (!series || compactRule(series) === null) return true;
+      used.add(series);
+      return false;
+    });
+    for (const series of used) compact.series.push(compactSeries(config, series, rangeStart, rangeEnd, compact.zones));
+  }
+  timing.expand += performance.now() - expandStart;
+  return result;
+}
@@ -0,0 +1,121 @@
+import { CalendarConfig, CalendarEvent, SeriesOutput } from './feeds';
+
+// Event lists trimmed for clients that don't need every field.
+//
+// fields=title,start,end   only the listed keys of each event
+// profile=device           what the ESP32 reads, with short keys, no
+//                          defaults, a calendar index instead of a color
+//                          and times to the second:
+//                          {"t":"Team Meeting","s":"2026-01-15T09:00:00",
+//                           "e":"2026-01-15T10:00:00","c":0,"l":"Room A"}
+//                          `l` only when there is a location, `a: 1` only
+//                          for all-day events
+// &series=1                with profile=device: recurring series the
+//                          display can expand (esp32/src/series.h) come
+//                          once each instead of as instances,
+//                          {"t":"Maths","s":"2026-09-07T08:00:00","d":2700,
+//                           "z":0,"r":"FREQ=WEEKLY;BYDAY=MO,TH","c":1,
+//                           "x":["2026-10-26T07:00:00"]}
+//                          `s` is DTSTART's wall time in zone `z` (an index
+//                          into `zones`, each [{wall, offset}] shifts over
+//                          the window: {"id":"Europe/Berlin",
+//                          "o":[["2026-09-01T00:00:00",7200],...]}), `d`
+//                          the duration in seconds, `x` the UTC starts of
+//                          instances that don't happen; no `z` for UTC
+
+export const EVENT_FIELDS = [
+  'id',
+  'title',
+  'start',
+  'end',
+  'allDay',
+  'calendar',
+  'color',
+  'location',
+  'description',
+] as const;
+
+export type EventField = (typeof EVENT_FIELDS)[number];
+
+export interface DeviceEvent {
+  t: string;
+  s: string;
+  e: string;
+  c: number; // Index into `calendars`
+  l?: string;
+  a?: 1;
+}
+
+export interface DeviceSeries {
+  t: string;
+  s: string;
+  d: number;
+  r: string;
+  c: number;
+  z?: number; // Index into `zones`
+  x?: string[];
+  l?: string;
+  a?: 1;
+}
+
+export interface DeviceZone {
+  id: string;
+  o: [string, number][];
+}
+
+// "title,start,end" -> fields, null if any is unknown
+export function parseFields(list: string): EventField[] | null {
+  const fields = list.split(',').map((f) => f.trim()).filter(Boolean);
+  if (!fields.length || !fields.every((f) => (EVENT_FIELDS as readonly string[]).includes(f))) return null;
+  return fields as EventField[];
+}
+
+export function projectEvents(events: CalendarEvent[], fields: EventField[]): Partial<CalendarEvent>[] {
+  return events.map((event) => {
+    const out: Partial<CalendarEvent> = {};
+    for (const field of fields) {
+      if (event[field] !== undefined) (out as any)[field] = event[field];
+    }
+    return out;
+  });
+}
+
+export function deviceEvents(events: CalendarEvent[], calendars: CalendarConfig[]): DeviceEvent[] {
+  const index = new Map(calendars.map((cal, i) => [cal.name, i]));
+  return events.map((event) => {
+    // The firmware reads times to the second ("YYYY-MM-DDTHH:MM:SS")
+    const out: DeviceEvent = {
+      t: event.title,
+      s: event.start.slice(0, 19),
+      e: event.end.slice(0, 19),
+      c: index.get(event.calendar) ?? 0,
+    };
+    if (event.location) out.l = event.location;
+    if (event.allDay) out.a = 1;
+    return out;
+  });
+}
+
+export function deviceSeries(
+  compact: SeriesOutput,
+  calendars: CalendarConfig[]
+): { series: DeviceSeries[]; zones: DeviceZone[] } {
+  const index = new Map(calendars.map((cal, i) => [cal.name, i]));
+  const zones = [...compact.zones].map(([id, o]) => ({ id, o }));
+  const zoneIndex = new Map(zones.map((zone, i) => [zone.id, i]));
+  const series = compact.series.map((item) => {
+    const out: DeviceSeries = {
+      t: item.title,
+      s: item.start,
+      d: item.duration,
+      r: item.rrule,
+      c: index.get(item.calendar) ?? 0,
+    };
+    if (item.zone !== null) out.z = zoneIndex.get(item.zone);
+    if (item.exdates.length) out.x = item.exdates;
+    if (item.location) out.l = item.location;
+    if (item.allDay) out.a = 1;
+    return out;
+  });
+  return { series, zones };
+}
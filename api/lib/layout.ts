@@ -0,0 +1,251 @@
+import { CalendarConfig, CalendarEvent } from './feeds';
+
+export type LayoutView = 'day' | 'week' | 'month';
+
+export const LAYOUT_VIEWS: LayoutView[] = ['day', 'week', 'month'];
+
+// Geometry of the firmware's views (esp32/src/main.cpp), so boxes and
+// clipped titles come out as the device would compute them. Keep in sync
+// with the #defines there.
+const FIRST_HOUR = 7; // DAY_START_HOUR, WEEK_START_HOUR
+const LAST_HOUR = 18; // DAY_END_HOUR, WEEK_END_HOUR
+const HOUR_HEIGHT = 48; // HOUR_HEIGHT_DAY, HOUR_HEIGHT_WEEK
+const WEEK_HOUR_W = 50;
+const DAY_HOUR_W = 60;
+const MONTH_GRID_Y = 80;
+const MONTH_EVENT_Y = 28; // First event row in a month cell
+const MONTH_EVENT_H = 16;
+const MAX_MONTH_EVENTS = 5;
+const MAX_WEEK_EVENTS = 20;
+const MAX_DAY_EVENTS = 30;
+const MAX_DAY_COLUMNS = 10;
+
+const DAY_MS = 24 * 60 * 60 * 1000;
+const MINUTE_MS = 60 * 1000;
+
+// One event as placed on the page. Minutes count from the day's local
+// midnight and are clamped to the hours the view shows.
+export interface PlacedEvent {
+  t: string; // Title, clipped to its box; '' when the device wouldn't print one
+  c: number; // Index into `calendars`
+  s?: number; // Week, day: first and last minute of the box
+  e?: number;
+  col?: number; // Week, day: column among the overlapping events
+  cols?: number; // Week, day: columns sharing the width
+  l?: string; // Day: "HH:MM-HH:MM"
+}
+
+export interface PageLayout {
+  layout: LayoutView;
+  start: string; // YYYY-MM-DD of the first day on the page
+  w: number;
+  h: number;
+  calendars: { name: string; color: string }[];
+  days: PlacedEvent[][]; // 1 (day), 7 (week) or 42 (month)
+}
+
+// The device's UTC offset over the page: minutes east of UTC, and from
+// each shift's instant (UTC milliseconds) on, that shift's minutes
+export interface UtcOffsets {
+  base: number;
+  shifts: [number, number][];
+}
+
+// tz=<minutes>[,<UTC seconds>:<minutes>...] as tzParam() in net.cpp sends
+// it: the offset before the page, then every DST change on it. A bare
+// number is an offset that doesn't change.
+export function parseUtcOffsets(tz: string | null): UtcOffsets {
+  const [base, ...changes] = (tz ?? '').split(',');
+  const shifts: [number, number][] = [];
+  for (const change of changes) {
+    const [at, minutes] = change.split(':').map((n) => parseInt(n, 10));
+    if (Number.isFinite(at) && Number.isFinite(minutes)) shifts.push([at * 1000, minutes]);
+  }
+  shifts.sort((a, b) => a[0] - b[0]);
+  return { base: parseInt(base, 10) || 0, shifts };
+}
+
+// The offset at UTC milliseconds `t`, in milliseconds
+export function offsetAt(offsets: UtcOffsets, t: number): number {
+  let minutes = offsets.base;
+  for (const [at, m] of offsets.shifts) {
+    if (t < at) break;
+    minutes = m;
+  }
+  return minutes * MINUTE_MS;
+}
+
+// Event times on a local clock: milliseconds with the UTC offset at that
+// instant added, so Date's UTC getters read local fields and every day is
+// DAY_MS long, as wall clocks are. All-day events are dates and are left
+// as they are.
+interface LocalEvent {
+  title: string;
+  cal: number;
+  start: number;
+  end: number;
+}
+
+// printClipped() in main.cpp: longer than `limit` becomes `keep` chars and `suffix`
+function clip(text: string, limit: number, keep: number, suffix: string): string {
+  const chars = Array.from(text);
+  return chars.length <= limit ? text : chars.slice(0, keep).join('') + suffix;
+}
+
+const pad = (n: number) => String(n).padStart(2, '0');
+const clock = (local: number) => {
+  const d = new Date(local);
+  return `${pad(d.getUTCHours())}:${pad(d.getUTCMinutes())}`;
+};
+
+// Local midnight of the first day of the page showing `anchor` (local midnight)
+export function pageStart(view: LayoutView, anchor: number): number {
+  if (view === 'day') return anchor;
+  let first = anchor;
+  if (view === 'month') {
+    const d = new Date(anchor);
+    first = Date.UTC(d.getUTCFullYear(), d.getUTCMonth(), 1);
+  }
+  // Weeks start on Monday
+  const daysSinceMonday = (new Date(first).getUTCDay() + 6) % 7;
+  return first - daysSinceMonday * DAY_MS;
+}
+
+export function pageDays(view: LayoutView): number {
+  return view === 'day' ? 1 : view === 'week' ? 7 : 42;
+}
+
+// Events of one day in list order, at most `max` (eventsForDay() in layout.cpp)
+function eventsOfDay(events: LocalEvent[], dayStart: number, max: number): LocalEvent[] {
+  const dayEnd = dayStart + DAY_MS;
+  const out: LocalEvent[] = [];
+  for (const e of events) {
+    if (e.start < dayEnd && e.end > dayStart && out.length < max) out.push(e);
+  }
+  return out;
+}
+
+// Minutes from midnight, clamped to the day
+function dayMinutes(e: LocalEvent, dayStart: number): [number, number] {
+  const s = Math.max(e.start, dayStart) - dayStart;
+  const end = Math.min(e.end, dayStart + DAY_MS) - dayStart;
+  return [Math.round(s / MINUTE_MS), Math.round(end / MINUTE_MS)];
+}
+
+function monthDay(events: LocalEvent[], dayStart: number, h: number): PlacedEvent[] {
+  const cellH = Math.floor((h - MONTH_GRID_Y) / 6);
+  let rows = 0;
+  while (rows < MAX_MONTH_EVENTS && MONTH_EVENT_Y + rows * MONTH_EVENT_H < cellH - 10) rows++;
+  return eventsOfDay(events, dayStart, rows).map((e) => ({ t: clip(e.title, 12, 11, '..'), c: e.cal }));
+}
+
+// layoutWeekDay() in layout.cpp: side by side only when overlapping
+function weekDay(events: LocalEvent[], dayStart: number, w: number): PlacedEvent[] {
+  const dayEvents = eventsOfDay(events, dayStart, MAX_WEEK_EVENTS);
+  const minutes = dayEvents.map((e) => dayMinutes(e, dayStart));
+  const cellW = Math.floor((w - WEEK_HOUR_W) / 7);
+  const out: PlacedEvent[] = [];
+
+  dayEvents.forEach((event, i) => {
+    let overlaps = 0;
+    let col = 0;
+    minutes.forEach(([s, e], j) => {
+      if (i === j || Math.max(minutes[i][0], s) >= Math.min(minutes[i][1], e)) return;
+      overlaps++;
+      if (s < minutes[i][0] || (s === minutes[i][0] && j < i)) col++;
+    });
+
+    const s = Math.max(minutes[i][0], FIRST_HOUR * 60);
+    const e = Math.min(minutes[i][1], LAST_HOUR * 60);
+    if (e <= s) return;
+
+    const cols = overlaps + 1;
+    const width = cols === 1 ? cellW - 4 : Math.max(Math.floor((cellW - 4) / cols) - 2, 10);
+    const height = Math.floor(((e - s) * HOUR_HEIGHT) / 60);
+    const chars = Math.min(Math.floor(width / 7), 10);
+    const t = width > 20 && height > 12 ? clip(event.title, chars, chars, '') : '';
+    out.push({ t, c: event.cal, s, e, col, cols });
+  });
+  return out;
+}
+
+// layoutDay() in layout.cpp plus the column count drawDayEvent() works out
+function dayView(events: LocalEvent[], dayStart: number, w: number): PlacedEvent[] {
+  const dayEvents = eventsOfDay(events, dayStart, MAX_DAY_EVENTS).sort((a, b) => a.start - b.start);
+  const minutes = dayEvents.map((e) => dayMinutes(e, dayStart));
+  const colEnd: number[] = new Array(MAX_DAY_COLUMNS).fill(-1);
+  const cols = minutes.map(([s, e]) => {
+    const c = colEnd.findIndex((end) => s >= end);
+    if (c < 0) return 0;
+    colEnd[c] = e;
+    return c;
+  });
+
+  const out: PlacedEvent[] = [];
+  dayEvents.forEach((event, i) => {
+    let maxCol = cols[i];
+    minutes.forEach(([s, e], j) => {
+      if (i !== j && Math.max(minutes[i][0], s) < Math.min(minutes[i][1], e)) maxCol = Math.max(maxCol, cols[j]);
+    });
+
+    const s = Math.max(minutes[i][0], FIRST_HOUR * 60);
+    const e = Math.min(minutes[i][1], LAST_HOUR * 60);
+    if (e <= s) return;
+
+    const width = Math.floor((w - DAY_HOUR_W - 20) / (maxCol + 1));
+    const chars = Math.floor(width / 12);
+    out.push({
+      t: clip(event.title, chars, chars, '.'),
+      c: event.cal,
+      s,
+      e,
+      col: cols[i],
+      cols: maxCol + 1,
+      l: `${clock(event.start)}-${clock(event.end)}`,
+    });
+  });
+  return out;
+}
+
+// One page of `view` for a w x h panel, `anchor` and `offsets` describing
+// the device's local day and clock. `events` must be sorted by start, as
+// the raw API returns them.
+export function buildLayout(
+  view: LayoutView,
+  anchor: number,
+  offsets: UtcOffsets,
+  w: number,
+  h: number,
+  events: CalendarEvent[],
+  calendars: CalendarConfig[]
+): PageLayout {
+  const index = new Map(calendars.map((cal, i) => [cal.name, i]));
+  const toLocal = (iso: string, allDay: boolean) => {
+    const t = new Date(iso).getTime();
+    return allDay ? t : t + offsetAt(offsets, t);
+  };
+  const local: LocalEvent[] = events.map((e) => ({
+    title: e.title,
+    cal: index.get(e.calendar) ?? 0,
+    start: toLocal(e.start, e.allDay),
+    end: toLocal(e.end, e.allDay),
+  }));
+
+  const first = pageStart(view, anchor);
+  const days: PlacedEvent[][] = [];
+  for (let d = 0; d < pageDays(view); d++) {
+    const dayStart = first + d * DAY_MS;
+    if (view === 'month') days.push(monthDay(local, dayStart, h));
+    else if (view === 'week') days.push(weekDay(local, dayStart, w));
+    else days.push(dayView(local, dayStart, w));
+  }
+
+  return {
+    layout: view,
+    start: new Date(first).toISOString().slice(0, 10),
+    w,
+    h,
+    calendars: calendars.map((cal) => ({ name: cal.name, color: cal.color })),
+    days,
+  };
+}
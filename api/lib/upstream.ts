@@ -0,0 +1,104 @@
+import { createHash } from 'crypto';
+import { CalendarConfig, FeedText, RequestTiming } from './feeds';
+
+const FRESH_MS = 5 * 60 * 1000; // Don't ask upstream again within this
+// While a display holds a change stream open (route.ts, ?watch=1) feeds are
+// checked this often; a 304 from upstream costs next to nothing
+export const WATCHED_FRESH_MS = 60 * 1000;
+const COLD_WAIT_MS = 4000; // Longest a request waits for a feed it has never seen
+
+// Last good copy of one feed and the validators that came with it
+interface Source {
+  current: FeedText | null;
+  etag: string | null;
+  lastModified: string | null;
+  checkedAt: number; // Last attempt, successful or not
+  inflight: Promise<void> | null;
+}
+
+// Per feed URL; lives as long as the server instance
+const sources = new Map<string, Source>();
+
+// Called after any feed's text changed
+const changeListeners = new Set<() => void>();
+
+export function onFeedChange(listener: () => void): () => void {
+  changeListeners.add(listener);
+  return () => {
+    changeListeners.delete(listener);
+  };
+}
+
+async function revalidate(config: CalendarConfig, source: Source): Promise<void> {
+  const headers: Record<string, string> = {};
+  if (source.current) {
+    if (source.etag) headers['If-None-Match'] = source.etag;
+    if (source.lastModified) headers['If-Modified-Since'] = source.lastModified;
+  }
+  source.checkedAt = Date.now();
+
+  try {
+    // Our own cache replaces Next's data cache, which would hide the 304s
+    const response = await fetch(config.url, { headers, cache: 'no-store' });
+    if (response.status === 304 && source.current) return;
+
+    if (!response.ok) {
+      console.error(`Failed to fetch ${config.name}: ${response.status}`);
+      return;
+    }
+
+    const text = await response.text();
+    const hash = createHash('sha1').update(text).digest('hex');
+    source.etag = response.headers.get('etag');
+    source.lastModified = response.headers.get('last-modified');
+    // Feeds without validators still come back byte-identical most of the time
+    if (!source.current || source.current.hash !== hash) {
+      source.current = { text, hash };
+      changeListeners.forEach((listener) => listener());
+    }
+  } catch (error) {
+    console.error(`Error fetching ${config.name}:`, error);
+  }
+}
+
+// The ICS text to serve for `config` right now.
+//
+// A feed seen before is returned immediately, even when stale; if it is
+// older than FRESH_MS a conditional request (If-None-Match /
+// If-Modified-Since) runs in the background and a 304 keeps the parsed
+// copy. Only a feed without any copy is waited for, and at most
+// COLD_WAIT_MS: a slow calendar is left out of this response and shows up
+// in a later one. Returns null when there is nothing to serve.
+export async function feedText(
+  config: CalendarConfig,
+  timing: RequestTiming,
+  freshMs: number = FRESH_MS
+): Promise<FeedText | null> {
+  let source = sources.get(config.url);
+  if (!source) {
+    source = { current: null, etag: null, lastModified: null, checkedAt: 0, inflight: null };
+    sources.set(config.url, source);
+  }
+
+  const start = performance.now();
+  if (!source.inflight && (!source.current || Date.now() - source.checkedAt >= freshMs)) {
+    const s = source;
+    s.inflight = revalidate(config, s).finally(() => {
+      s.inflight = null;
+    });
+  }
+
+  if (!source.current && source.inflight) {
+    await Promise.race([source.inflight, new Promise((resolve) => setTimeout(resolve, COLD_WAIT_MS))]);
+  }
+  timing.upstream = Math.max(timing.upstream, performance.now() - start);
+  return source.current;
+}
+
+// Short id of what the feeds currently serve, calendar settings included.
+// Clients get it as the start of the ETag and in change streams.
+export function dataVersion(configs: CalendarConfig[], feeds: (FeedText | null)[]): string {
+  const hash = createHash('sha1');
+  configs.forEach((config, i) => hash.update(`${config.name}\n${config.color}\n${feeds[i]?.hash ?? '-'}\n`));
+  return hash.digest('hex').slice(0, 12);
+}
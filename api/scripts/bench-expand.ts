@@ -0,0 +1,146 @@
+// Recurrence expansion over synthetic feeds whose series started 8-12 years
+// ago, with and without skipping ahead to the requested window.
+//
+//   npm run bench:expand                    # 50, 200 and 1000 series
+//   npm run bench:expand -- 5000 --runs=5
+//
+// Each run parses a fresh copy of the feed and expands the window the
+// displays ask for (one month back, two ahead). Both ways must produce the
+// same instances; a mismatch is printed and fails the run.
+
+import { CalendarConfig, RequestTiming, expandOptions, feedEvents } from '../lib/feeds';
+
+const YEAR_MS = 365.25 * 24 * 60 * 60 * 1000;
+
+// Fixed-seed xorshift like the firmware's host/synth.cpp, so runs repeat
+let seed = 12345;
+const random = (): number => {
+  seed ^= seed << 13;
+  seed ^= seed >>> 17;
+  seed ^= seed << 5;
+  return (seed >>> 0) / 0x100000000;
+};
+
+const pad = (n: number) => String(n).padStart(2, '0');
+const icsTime = (d: Date) =>
+  `${d.getUTCFullYear()}${pad(d.getUTCMonth() + 1)}${pad(d.getUTCDate())}T${pad(d.getUTCHours())}${pad(d.getUTCMinutes())}00Z`;
+const icsDate = (d: Date) => `${d.getUTCFullYear()}${pad(d.getUTCMonth() + 1)}${pad(d.getUTCDate())}`;
+
+// The rule shapes calendars actually contain, the last two not skippable
+const RULES = [
+  'FREQ=WEEKLY;BYDAY=MO,WE',
+  'FREQ=WEEKLY;INTERVAL=2',
+  'FREQ=DAILY',
+  'FREQ=DAILY;BYDAY=MO,TU,WE,TH,FR',
+  'FREQ=MONTHLY',
+  'FREQ=MONTHLY;BYDAY=2TU',
+  'FREQ=MONTHLY;BYDAY=-1FR',
+  'FREQ=YEARLY',
+  'FREQ=WEEKLY;COUNT=2000',
+  'FREQ=MONTHLY;BYDAY=MO;BYSETPOS=1',
+];
+
+function synthFeed(seriesCount: number, now: number): string {
+  const lines = ['BEGIN:VCALENDAR', 'VERSION:2.0', 'PRODID:-//family-calendar//bench//EN'];
+  for (let i = 0; i < seriesCount; i++) {
+    const uid = `bench-${i}@family-calendar`;
+    const rule = RULES[i % RULES.length];
+    const start = new Date(now - (8 + random() * 4) * YEAR_MS);
+    start.setUTCHours(6 + Math.floor(random() * 12), random() < 0.5 ? 0 : 30, 0, 0);
+    // MONTHLY BYDAY series have to start on a matching day
+    if (rule.includes('BYDAY=2TU')) {
+      start.setUTCDate(1);
+      start.setUTCDate(1 + ((9 - start.getUTCDay()) % 7) + 7);
+    } else if (rule.includes('BYDAY=-1FR')) {
+      start.setUTCMonth(start.getUTCMonth() + 1, 0);
+      start.setUTCDate(start.getUTCDate() - ((start.getUTCDay() + 2) % 7));
+    } else if (start.getUTCDate() > 28) {
+      start.setUTCDate(28);
+    }
+    const end = new Date(start.getTime() + (1 + Math.floor(random() * 4)) * 30 * 60 * 1000);
+
+    lines.push('BEGIN:VEVENT', `UID:${uid}`, `DTSTAMP:${icsTime(start)}`);
+    lines.push(`DTSTART:${icsTime(start)}`, `DTEND:${icsTime(end)}`, `RRULE:${rule}`);
+    lines.push(`SUMMARY:Series ${i}`);
+    if (i % 10 === 3) {
+      // A cancelled occurrence long ago
+      lines.push(`EXDATE:${icsTime(new Date(start.getTime() + 7 * 24 * 60 * 60 * 1000))}`);
+    }
+    lines.push('END:VEVENT');
+  }
+  // Some one-off events in and around the window, and all-day birthdays
+  for (let i = 0; i < seriesCount / 2; i++) {
+    const start = new Date(now + (random() * 4 - 2) * 30 * 24 * 60 * 60 * 1000);
+    const allDay = i % 5 === 0;
+    lines.push('BEGIN:VEVENT', `UID:single-${i}@family-calendar`, `DTSTAMP:${icsTime(start)}`);
+    if (allDay) {
+      const birth = new Date(start.getTime() - 30 * YEAR_MS);
+      lines.push(`DTSTART;VALUE=DATE:${icsDate(birth)}`, 'RRULE:FREQ=YEARLY');
+    } else {
+      lines.push(`DTSTART:${icsTime(start)}`, `DTEND:${icsTime(new Date(start.getTime() + 60 * 60 * 1000))}`);
+    }
+    lines.push(`SUMMARY:Single ${i}`, 'END:VEVENT');
+  }
+  lines.push('END:VCALENDAR');
+  return lines.join('\r\n');
+}
+
+function median(values: number[]): number {
+  const sorted = [...values].sort((a, b) => a - b);
+  return sorted[Math.floor(sorted.length / 2)];
+}
+
+function expandOnce(config: CalendarConfig, text: string, run: number, rangeStart: Date, rangeEnd: Date) {
+  const timing: RequestTiming = { upstream: 0, parse: 0, expand: 0 };
+  // A new hash per run, so nothing is reused from the previous one
+  const events = feedEvents(config, { text, hash: `${run}` }, rangeStart, rangeEnd, timing);
+  return { ms: timing.expand, ids: events.map((e) => e.id) };
+}
+
+function main() {
+  const args = process.argv.slice(2);
+  const runsArg = args.find((a) => a.startsWith('--runs='));
+  const runs = runsArg ? parseInt(runsArg.slice(7), 10) : 9;
+  const sizes = args.filter((a) => !a.startsWith('--')).map((a) => parseInt(a, 10));
+
+  const now = Date.now();
+  const rangeStart = new Date(now - 30 * 24 * 60 * 60 * 1000);
+  const rangeEnd = new Date(now + 60 * 24 * 60 * 60 * 1000);
+  let failed = false;
+
+  console.log('series  ics_kB  instances  from_dtstart_ms  skip_ahead_ms  speedup');
+  for (const size of sizes.length ? sizes : [50, 200, 1000]) {
+    const text = synthFeed(size, now);
+    const config: CalendarConfig = { url: `bench:${size}`, name: 'Bench', color: '#4A90D9' };
+    const times: Record<string, number[]> = { off: [], on: [] };
+    let reference: string[] = [];
+
+    for (let run = 0; run < runs; run++) {
+      for (const mode of ['off', 'on']) {
+        expandOptions.skipAhead = mode === 'on';
+        const { ms, ids } = expandOnce(config, text, run * 2 + (mode === 'on' ? 1 : 0), rangeStart, rangeEnd);
+        times[mode].push(ms);
+        if (mode === 'off') {
+          reference = ids;
+        } else if (ids.join('\n') !== reference.join('\n')) {
+          const missing = reference.filter((id) => !ids.includes(id));
+          const extra = ids.filter((id) => !reference.includes(id));
+          console.error(`series=${size}: instances differ, missing ${missing.slice(0, 5)} extra ${extra.slice(0, 5)}`);
+          failed = true;
+        }
+      }
+    }
+    expandOptions.skipAhead = true;
+
+    const off = median(times.off);
+    const on = median(times.on);
+    console.log(
+      `${String(size).padStart(6)}  ${String(Math.round(text.length / 1024)).padStart(6)}  ` +
+        `${String(reference.length).padStart(9)}  ${off.toFixed(2).padStart(15)}  ` +
+        `${on.toFixed(2).padStart(13)}  ${(off / on).toFixed(1).padStart(6)}x`
+    );
+  }
+  if (failed) process.exit(1);
+}
+
+main();
@@ -0,0 +1,46 @@
+// Prints what route.ts makes of ICS feeds for a window, one instance per
+// line, in the form the firmware's host/icsexpand prints what the device
+// makes of them (esp32/src/ics.h, rrule.h), so the two can be diffed:
+//
+//   npm run expand:ics -- [--from=YYYY-MM-DD] [--to=YYYY-MM-DD] feed.ics...
+//
+// The window runs from midnight UTC of --from (default: today - 30 days)
+// to --to (default: 91 days later). Lines are "start end allDay title",
+// sorted. Run with TZ=UTC, like the deployed API. Takes the firmware tool's
+// options, so one command line works for both; --piece=N only matters
+// there and is ignored here.
+
+import { readFileSync } from 'fs';
+import { CalendarConfig, RequestTiming, feedEvents } from '../lib/feeds';
+
+const DAY_MS = 24 * 60 * 60 * 1000;
+
+function main() {
+  const args = process.argv.slice(2);
+  const option = (name: string) => args.find((a) => a.startsWith(`--${name}=`))?.slice(name.length + 3);
+  const paths = args.filter((a) => !a.startsWith('--'));
+  const unknown = args.filter((a) => a.startsWith('--') && !/^--(from|to|piece)=/.test(a));
+  if (!paths.length || unknown.length) {
+    console.error('usage: expand-ics [--from=YYYY-MM-DD] [--to=YYYY-MM-DD] [--piece=N] feed.ics...');
+    process.exit(2);
+  }
+
+  const fromArg = option('from');
+  const toArg = option('to');
+  const from = fromArg ? Date.parse(`${fromArg}T00:00:00Z`) : Math.floor(Date.now() / DAY_MS) * DAY_MS - 30 * DAY_MS;
+  const to = toArg ? Date.parse(`${toArg}T00:00:00Z`) : from + 91 * DAY_MS;
+
+  const lines: string[] = [];
+  for (const path of paths) {
+    const config: CalendarConfig = { url: path, name: path, color: '#4A90D9' };
+    const timing: RequestTiming = { upstream: 0, parse: 0, expand: 0 };
+    const text = readFileSync(path, 'utf8');
+    for (const event of feedEvents(config, { text, hash: path }, new Date(from), new Date(to), timing)) {
+      lines.push(`${event.start.slice(0, 19)} ${event.end.slice(0, 19)} ${event.allDay ? 1 : 0} ${event.title}`);
+    }
+  }
+  lines.sort();
+  for (const line of lines) console.log(line);
+}
+
+main();
@@ -0,0 +1,233 @@
+#include "alloc_track.h"
+
+#ifndef NO_INSTRUMENTATION
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+#include <soc/soc.h>
+#else
+#include <malloc.h>
+#endif
+
+static AllocWindow current[ALLOC_PHASE_COUNT];
+static AllocWindow last[ALLOC_PHASE_COUNT];
+static AllocWindow totals[ALLOC_PHASE_COUNT];
+static uint32_t budgets[ALLOC_PHASE_COUNT] = {ALLOC_NO_BUDGET, ALLOC_NO_BUDGET, ALLOC_NO_BUDGET, ALLOC_NO_BUDGET};
+static uint32_t violations[ALLOC_PHASE_COUNT];
+
+static HeapSample history[HEAP_HISTORY];
+static int historyHead = 0;
+static int historyCount = 0;
+
+static const char* phaseNames[ALLOC_PHASE_COUNT] = {"other", "ingest", "layout", "render"};
+static const char* regionNames[ALLOC_REGION_COUNT] = {"internal", "psram"};
+
+#ifdef ARDUINO
+// The UI loop and the network task are pinned to different cores, so one
+// owner slot per core is enough to know who is allocating.
+struct PhaseOwner {
+  void* task;
+  AllocPhase phase;
+};
+static PhaseOwner owners[portNUM_PROCESSORS];
+
+static AllocPhase currentPhase() {
+  const PhaseOwner& o = owners[xPortGetCoreID()];
+  return (o.task && o.task == xTaskGetCurrentTaskHandle()) ? o.phase : ALLOC_OTHER;
+}
+
+AllocPhase allocEnter(AllocPhase phase) {
+  AllocPhase previous = currentPhase();
+  PhaseOwner& o = owners[xPortGetCoreID()];
+  o.task = xTaskGetCurrentTaskHandle();
+  o.phase = phase;
+  return previous;
+}
+
+void allocLeave(AllocPhase previous) {
+  PhaseOwner& o = owners[xPortGetCoreID()];
+  o.phase = previous;
+  if (previous == ALLOC_OTHER) o.task = NULL;
+}
+#else
+static thread_local AllocPhase threadPhase = ALLOC_OTHER;
+
+static AllocPhase currentPhase() {
+  return threadPhase;
+}
+
+AllocPhase allocEnter(AllocPhase phase) {
+  AllocPhase previous = threadPhase;
+  threadPhase = phase;
+  return previous;
+}
+
+void allocLeave(AllocPhase previous) {
+  threadPhase = previous;
+}
+#endif
+
+static void count(AllocCounters& c, size_t bytes, int sign) {
+  if (sign > 0) {
+    c.allocs++;
+    c.bytesAllocated += bytes;
+    c.live += bytes;
+    if (c.live > c.peak) c.peak = c.live;
+  } else {
+    c.frees++;
+    c.bytesFreed += bytes;
+    c.live -= bytes;
+  }
+}
+
+void allocNote(AllocRegion region, size_t bytes, int sign) {
+  AllocPhase phase = currentPhase();
+  count(current[phase].region[region], bytes, sign);
+  count(totals[phase].region[region], bytes, sign);
+}
+
+void allocWindowStart(AllocPhase phase) {
+  memset(&current[phase], 0, sizeof(AllocWindow));
+}
+
+bool allocWindowEnd(AllocPhase phase) {
+  last[phase] = current[phase];
+  uint32_t allocs = 0;
+  for (int r = 0; r < ALLOC_REGION_COUNT; r++) allocs += last[phase].region[r].allocs;
+  if (budgets[phase] != ALLOC_NO_BUDGET && allocs > budgets[phase]) {
+    violations[phase]++;
+    return false;
+  }
+  return true;
+}
+
+void allocSetBudget(AllocPhase phase, uint32_t maxAllocs) {
+  budgets[phase] = maxAllocs;
+}
+
+const AllocWindow* allocLastWindow(AllocPhase phase) {
+  return &last[phase];
+}
+
+const AllocWindow* allocTotals(AllocPhase phase) {
+  return &totals[phase];
+}
+
+uint32_t allocBudgetViolations(AllocPhase phase) {
+  return violations[phase];
+}
+
+const char* allocPhaseName(AllocPhase phase) {
+  return phaseNames[phase];
+}
+
+void heapSample(uint32_t uptimeSec) {
+  HeapSample& s = history[historyHead];
+  s.uptimeSec = uptimeSec;
+#ifdef ARDUINO
+  s.freeBytes[ALLOC_INTERNAL] = heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  s.largestBlock[ALLOC_INTERNAL] = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  s.freeBytes[ALLOC_PSRAM] = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+  s.largestBlock[ALLOC_PSRAM] = heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM);
+#else
+  struct mallinfo2 mi = mallinfo2();
+  s.freeBytes[ALLOC_INTERNAL] = mi.fordblks;
+  s.largestBlock[ALLOC_INTERNAL] = mi.fordblks;
+  s.freeBytes[ALLOC_PSRAM] = 0;
+  s.largestBlock[ALLOC_PSRAM] = 0;
+#endif
+  historyHead = (historyHead + 1) % HEAP_HISTORY;
+  if (historyCount < HEAP_HISTORY) historyCount++;
+}
+
+int heapHistory(const HeapSample** out) {
+  // Copy into oldest-first order
+  static HeapSample ordered[HEAP_HISTORY];
+  int start = (historyHead - historyCount + HEAP_HISTORY) % HEAP_HISTORY;
+  for (int i = 0; i < historyCount; i++) ordered[i] = history[(start + i) % HEAP_HISTORY];
+  *out = ordered;
+  return historyCount;
+}
+
+void allocReport(void (*emit)(const char* line)) {
+  char line[128];
+  emit("phase    region    last:allocs     bytes      peak   total:allocs   over-budget\n");
+  for (int p = 0; p < ALLOC_PHASE_COUNT; p++) {
+    for (int r = 0; r < ALLOC_REGION_COUNT; r++) {
+      const AllocCounters& l = last[p].region[r];
+      const AllocCounters& t = totals[p].region[r];
+      snprintf(line, sizeof(line), "%-8s %-9s %11lu %9llu %9ld %14lu %13lu\n",
+               phaseNames[p], regionNames[r], (unsigned long)l.allocs, (unsigned long long)l.bytesAllocated,
+               (long)l.peak, (unsigned long)t.allocs, (unsigned long)violations[p]);
+      emit(line);
+    }
+  }
+
+  const HeapSample* samples;
+  int n = heapHistory(&samples);
+  if (!n) return;
+  emit("uptime_s   internal free/largest   frag    psram free/largest   frag\n");
+  for (int i = 0; i < n; i++) {
+    const HeapSample& s = samples[i];
+    float fragI = s.freeBytes[0] ? 1.0f - (float)s.largestBlock[0] / s.freeBytes[0] : 0;
+    float fragP = s.freeBytes[1] ? 1.0f - (float)s.largestBlock[1] / s.freeBytes[1] : 0;
+    snprintf(line, sizeof(line), "%8lu %10lu/%-10lu %5.2f %10lu/%-10lu %5.2f\n",
+             (unsigned long)s.uptimeSec, (unsigned long)s.freeBytes[0], (unsigned long)s.largestBlock[0], fragI,
+             (unsigned long)s.freeBytes[1], (unsigned long)s.largestBlock[1], fragP);
+    emit(line);
+  }
+}
+
+#ifdef ARDUINO
+// Linked with -Wl,--wrap=malloc,... (see platformio.ini)
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* p, size_t size);
+void __real_free(void* p);
+
+static inline AllocRegion regionOf(void* p) {
+  uintptr_t a = (uintptr_t)p;
+  return (a >= SOC_EXTRAM_DATA_LOW && a < SOC_EXTRAM_DATA_HIGH) ? ALLOC_PSRAM : ALLOC_INTERNAL;
+}
+
+static inline void noteAlloc(void* p) {
+  if (p) allocNote(regionOf(p), heap_caps_get_allocated_size(p), +1);
+}
+
+static inline void noteFree(void* p) {
+  if (p) allocNote(regionOf(p), heap_caps_get_allocated_size(p), -1);
+}
+
+void* __wrap_malloc(size_t size) {
+  void* p = __real_malloc(size);
+  noteAlloc(p);
+  return p;
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+  void* p = __real_calloc(n, size);
+  noteAlloc(p);
+  return p;
+}
+
+void* __wrap_realloc(void* p, size_t size) {
+  noteFree(p);
+  void* q = __real_realloc(p, size);
+  if (q) noteAlloc(q);
+  else if (p && size) noteAlloc(p);   // Failed: the old block is still ours
+  return q;
+}
+
+void __wrap_free(void* p) {
+  noteFree(p);
+  __real_free(p);
+}
+}
+#endif
+
+#endif
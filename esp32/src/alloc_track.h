@@ -0,0 +1,97 @@
+#pragma once
+
+// Heap accounting per phase and per memory region.
+//
+// Every malloc/calloc/realloc/free is routed through allocNote() (on the
+// ESP32 via -Wl,--wrap, on host via operator new/delete). Allocations are
+// attributed to the phase the calling task entered with AllocScope, or to
+// ALLOC_OTHER. Each phase has a "window" (one refresh for ingest, one frame
+// for layout/render) with its own counters, peak and allocation budget.
+//
+// Phase counters are only written by the task that owns the phase;
+// ALLOC_OTHER is shared by every task and is approximate.
+
+#include <stdint.h>
+#include <stddef.h>
+#include "profiler.h"
+
+enum AllocPhase {
+  ALLOC_OTHER,
+  ALLOC_INGEST,   // One refresh: HTTP body, JSON document, event list
+  ALLOC_LAYOUT,   // Day queries and overlap layout within a frame
+  ALLOC_RENDER,   // Drawing steps within a frame
+  ALLOC_PHASE_COUNT
+};
+
+enum AllocRegion { ALLOC_INTERNAL, ALLOC_PSRAM, ALLOC_REGION_COUNT };
+
+struct AllocCounters {
+  uint32_t allocs;
+  uint32_t frees;
+  uint64_t bytesAllocated;
+  uint64_t bytesFreed;
+  int32_t live;        // Net bytes since the window started
+  int32_t peak;        // Highest `live` seen in the window
+};
+
+struct AllocWindow {
+  AllocCounters region[ALLOC_REGION_COUNT];
+};
+
+// Heap shape at one point in time
+struct HeapSample {
+  uint32_t uptimeSec;
+  uint32_t freeBytes[ALLOC_REGION_COUNT];
+  uint32_t largestBlock[ALLOC_REGION_COUNT];
+};
+
+#define ALLOC_NO_BUDGET 0xFFFFFFFF
+#define HEAP_HISTORY 60
+
+#ifndef NO_INSTRUMENTATION
+
+// Called by the platform hooks. sign is +1 for an allocation, -1 for a free.
+void allocNote(AllocRegion region, size_t bytes, int sign);
+
+// Attribute this task's allocations to `phase` while in scope (nests)
+AllocPhase allocEnter(AllocPhase phase);
+void allocLeave(AllocPhase previous);
+
+struct AllocScope {
+  AllocPhase previous;
+  explicit AllocScope(AllocPhase p) : previous(allocEnter(p)) {}
+  ~AllocScope() { allocLeave(previous); }
+};
+
+// Windows: start clears the running counters, end publishes them as the
+// phase's last window and checks the budget. Returns false if over budget.
+void allocWindowStart(AllocPhase phase);
+bool allocWindowEnd(AllocPhase phase);
+
+// Max allocations per window (ALLOC_NO_BUDGET to disable)
+void allocSetBudget(AllocPhase phase, uint32_t maxAllocs);
+
+const AllocWindow* allocLastWindow(AllocPhase phase);
+const AllocWindow* allocTotals(AllocPhase phase);
+uint32_t allocBudgetViolations(AllocPhase phase);
+const char* allocPhaseName(AllocPhase phase);
+
+// Fragmentation history (largest free block vs. total free)
+void heapSample(uint32_t uptimeSec);
+int heapHistory(const HeapSample** out);   // Oldest first, returns count
+
+void allocReport(void (*emit)(const char* line));
+
+#define ALLOC_SCOPE(phase) AllocScope PROF_CONCAT(_allocScope, __LINE__)(phase)
+
+#else
+
+inline void allocWindowStart(AllocPhase) {}
+inline bool allocWindowEnd(AllocPhase) { return true; }
+inline void allocSetBudget(AllocPhase, uint32_t) {}
+inline void heapSample(uint32_t) {}
+inline void allocReport(void (*)(const char*)) {}
+
+#define ALLOC_SCOPE(phase) do {} while (0)
+
+#endif
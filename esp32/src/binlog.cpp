@@ -0,0 +1,247 @@
+#include "binlog.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <esp_timer.h>
+#else
+#include <time.h>
+#endif
+
+#define LOG_MSG_LEVEL(id, level, fmt) level,
+#define LOG_MSG_FORMAT(id, level, fmt) fmt,
+static const uint8_t levels[LOG_MSG_COUNT] = { LOG_MESSAGES(LOG_MSG_LEVEL) };
+static const char* formats[LOG_MSG_COUNT] = { LOG_MESSAGES(LOG_MSG_FORMAT) };
+#undef LOG_MSG_LEVEL
+#undef LOG_MSG_FORMAT
+
+static const char levelChars[] = "DIWE";
+
+static LogSlot* ring = NULL;
+static uint32_t claimed = 0;     // Total slots ever claimed
+static uint32_t tailNext = 0;    // logTail() cursor
+
+void logInit() {
+  if (ring) return;
+#ifdef ARDUINO
+  ring = (LogSlot*)ps_calloc(LOG_CAPACITY, sizeof(LogSlot));
+#else
+  ring = (LogSlot*)calloc(LOG_CAPACITY, sizeof(LogSlot));
+#endif
+}
+
+static uint64_t nowUs() {
+#ifdef ARDUINO
+  return esp_timer_get_time();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+#endif
+}
+
+// Writers: seq = 0 marks the slot as being written, seq = claim + 1
+// publishes it. Readers copy a slot and check seq on both sides.
+LogSlot* logBegin(LogMsg msg, uint32_t& claim) {
+  if (!ring) return NULL;
+  claim = __atomic_fetch_add(&claimed, 1, __ATOMIC_RELAXED);
+  LogSlot* slot = &ring[claim % LOG_CAPACITY];
+  __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  slot->msg = msg;
+#ifdef ARDUINO
+  slot->core = xPortGetCoreID();
+#else
+  slot->core = 0;
+#endif
+  slot->ts = nowUs();
+  return slot;
+}
+
+void logCommit(LogSlot* slot, uint32_t claim, const uint8_t* end) {
+  slot->size = end - slot->payload;
+  __atomic_store_n(&slot->seq, claim + 1, __ATOMIC_RELEASE);
+}
+
+// 1 = copied, 0 = still being written, -1 = overwritten by a newer record
+static int readSlot(uint32_t n, LogSlot& out) {
+  const LogSlot& slot = ring[n % LOG_CAPACITY];
+  uint32_t seq = __atomic_load_n(&slot.seq, __ATOMIC_ACQUIRE);
+  if (seq == 0) return 0;
+  if (seq != n + 1) return -1;
+  memcpy(&out, &slot, sizeof(out));
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&slot.seq, __ATOMIC_RELAXED) == n + 1 ? 1 : -1;
+}
+
+LogLevel logLevel(LogMsg msg) {
+  return msg < LOG_MSG_COUNT ? (LogLevel)levels[msg] : LOG_ERROR;
+}
+
+uint32_t logTableHash() {
+  uint32_t h = 2166136261u;
+  for (int m = 0; m < LOG_MSG_COUNT; m++) {
+    h = (h ^ levels[m]) * 16777619u;
+    for (const char* c = formats[m]; ; c++) {
+      h = (h ^ (uint8_t)*c) * 16777619u;
+      if (!*c) break;
+    }
+  }
+  return h;
+}
+
+static size_t append(size_t size, size_t n, int written) {
+  if (written < 0) return n;
+  n += written;
+  return n < size ? n : size - 1;
+}
+
+// Print the next recorded argument with the format's flags, width and
+// conversion, using the width the argument was recorded with
+static size_t formatArg(char* out, size_t size, size_t n, const char* flags, char conv,
+                        const uint8_t*& p, const uint8_t* end) {
+  char spec[24];
+  bool isFloat = strchr("feEgGaA", conv) != NULL;
+  bool isString = conv == 's';
+  if (p >= end) return append(size, n, snprintf(out + n, size - n, "<?>"));
+
+  char tag = *p++;
+  switch (tag) {
+    case 'i':
+    case 'u': {
+      if (p + 4 > end) break;
+      uint32_t v;
+      memcpy(&v, p, 4);
+      p += 4;
+      if (isFloat) {
+        snprintf(spec, sizeof(spec), "%%%s%c", flags, conv);
+        return append(size, n, snprintf(out + n, size - n, spec, tag == 'i' ? (double)(int32_t)v : (double)v));
+      }
+      snprintf(spec, sizeof(spec), "%%%s%c", flags, isString ? (tag == 'i' ? 'd' : 'u') : conv);
+      return append(size, n, snprintf(out + n, size - n, spec, v));
+    }
+    case 'l':
+    case 'L': {
+      if (p + 8 > end) break;
+      uint64_t v;
+      memcpy(&v, p, 8);
+      p += 8;
+      if (isFloat) {
+        snprintf(spec, sizeof(spec), "%%%s%c", flags, conv);
+        return append(size, n, snprintf(out + n, size - n, spec, tag == 'l' ? (double)(int64_t)v : (double)v));
+      }
+      snprintf(spec, sizeof(spec), "%%%sll%c", flags, isString ? (tag == 'l' ? 'd' : 'u') : conv);
+      return append(size, n, snprintf(out + n, size - n, spec, (unsigned long long)v));
+    }
+    case 'd': {
+      if (p + 8 > end) break;
+      double v;
+      memcpy(&v, p, 8);
+      p += 8;
+      snprintf(spec, sizeof(spec), "%%%s%c", flags, isFloat ? conv : 'g');
+      return append(size, n, snprintf(out + n, size - n, spec, v));
+    }
+    case 's': {
+      if (p >= end || p + 1 + *p > end) break;
+      char text[LOG_PAYLOAD];
+      uint8_t len = *p++;
+      memcpy(text, p, len);
+      text[len] = 0;
+      p += len;
+      snprintf(spec, sizeof(spec), "%%%ss", flags);
+      return append(size, n, snprintf(out + n, size - n, spec, text));
+    }
+  }
+  p = end;   // Unknown or cut-off argument: nothing after it can be trusted
+  return append(size, n, snprintf(out + n, size - n, "<?>"));
+}
+
+void logFormat(const LogSlot& slot, char* out, size_t size) {
+  LogLevel level = logLevel((LogMsg)slot.msg);
+  size_t n = append(size, 0, snprintf(out, size, "%8lu.%03lu %c%u ", (unsigned long)(slot.ts / 1000),
+                                           (unsigned long)(slot.ts % 1000), levelChars[level], slot.core));
+  const char* fmt = slot.msg < LOG_MSG_COUNT ? formats[slot.msg] : "<unknown message>";
+  const uint8_t* p = slot.payload;
+  const uint8_t* end = p + (slot.size < LOG_PAYLOAD ? slot.size : LOG_PAYLOAD);
+
+  for (const char* f = fmt; *f && n < size - 2; f++) {
+    if (*f != '%') {
+      out[n++] = *f;
+      continue;
+    }
+    if (f[1] == '%') {
+      out[n++] = '%';
+      f++;
+      continue;
+    }
+    char flags[12];
+    size_t k = 0;
+    for (f++; *f && strchr("-+ #0123456789.", *f); f++) {
+      if (k < sizeof(flags) - 1) flags[k++] = *f;
+    }
+    flags[k] = 0;
+    while (*f && strchr("hlLqjzt", *f)) f++;
+    if (!*f) break;
+    n = formatArg(out, size, n, flags, *f, p, end);
+  }
+  out[n++] = '\n';
+  out[n] = 0;
+}
+
+void logDump(void (*emit)(const char* text), LogLevel minLevel) {
+  if (!ring) return;
+  char line[LOG_LINE_MAX];
+  LogSlot slot;
+  uint32_t end = __atomic_load_n(&claimed, __ATOMIC_RELAXED);
+  uint32_t count = end < LOG_CAPACITY ? end : LOG_CAPACITY;
+  for (uint32_t n = end - count; n != end; n++) {
+    if (readSlot(n, slot) != 1 || logLevel((LogMsg)slot.msg) < minLevel) continue;
+    logFormat(slot, line, sizeof(line));
+    emit(line);
+  }
+}
+
+void logTail(void (*emit)(const char* text), LogLevel minLevel, uint32_t maxRecords) {
+  if (!ring) return;
+  char line[LOG_LINE_MAX];
+  LogSlot slot;
+  uint32_t end = __atomic_load_n(&claimed, __ATOMIC_RELAXED);
+  if (end - tailNext > LOG_CAPACITY) {
+    snprintf(line, sizeof(line), "... %lu log records lost\n", (unsigned long)(end - LOG_CAPACITY - tailNext));
+    emit(line);
+    tailNext = end - LOG_CAPACITY;
+  }
+  for (uint32_t done = 0; tailNext != end && done < maxRecords; done++) {
+    int state = readSlot(tailNext, slot);
+    if (state == 0) break;   // Writer still busy, pick it up next time
+    tailNext++;
+    if (state < 0 || logLevel((LogMsg)slot.msg) < minLevel) continue;
+    logFormat(slot, line, sizeof(line));
+    emit(line);
+  }
+}
+
+void logExportHex(void (*emit)(const char* text)) {
+  char line[2 * sizeof(LogSlot) + 2];
+  snprintf(line, sizeof(line), "# calendar log v1 slot=%u table=%08lx\n", (unsigned)sizeof(LogSlot),
+           (unsigned long)logTableHash());
+  emit(line);
+  if (!ring) return;
+
+  static const char hex[] = "0123456789abcdef";
+  LogSlot slot;
+  uint32_t end = __atomic_load_n(&claimed, __ATOMIC_RELAXED);
+  uint32_t count = end < LOG_CAPACITY ? end : LOG_CAPACITY;
+  for (uint32_t n = end - count; n != end; n++) {
+    if (readSlot(n, slot) != 1) continue;
+    const uint8_t* b = (const uint8_t*)&slot;
+    for (size_t i = 0; i < sizeof(slot); i++) {
+      line[2 * i] = hex[b[i] >> 4];
+      line[2 * i + 1] = hex[b[i] & 15];
+    }
+    line[2 * sizeof(slot)] = '\n';
+    line[2 * sizeof(slot) + 1] = 0;
+    emit(line);
+  }
+}
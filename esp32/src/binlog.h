@@ -0,0 +1,126 @@
+#pragma once
+
+// Deferred-formatting log. A log call stores a message id (log_messages.h),
+// a timestamp and the raw arguments in a fixed 64-byte slot of a ring in
+// PSRAM: one atomic add and a few stores, no formatting, no locks, safe
+// from both cores. Text is produced only when the ring is read: live on
+// serial from the idle UI loop, on demand over serial and HTTP, or on a PC
+// from a hex dump (host/logdecode/).
+//
+// Arguments: integers, enums, bool, float/double and C strings. Strings
+// are copied and cut to what fits in the slot (48 bytes for all arguments
+// together); arguments that don't fit at all print as "<?>".
+//
+//   logWrite(LOG_NET_GET_FAILED, code);
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "log_messages.h"
+
+#define LOG_CAPACITY 4096   // Slots, 256 KB
+#define LOG_PAYLOAD  48
+#define LOG_LINE_MAX 160    // Longest formatted line
+
+enum LogLevel { LOG_DEBUG, LOG_INFO, LOG_WARN, LOG_ERROR };
+
+struct LogSlot {
+  uint32_t seq;       // Claim number + 1 once complete, 0 while being written
+  uint16_t msg;
+  uint8_t core;       // Device: CPU core (0 = net, 1 = ui); host: 0
+  uint8_t size;       // Payload bytes used
+  uint64_t ts;        // us since boot
+  uint8_t payload[LOG_PAYLOAD];   // Per argument: type tag + value
+};
+
+// Allocate the ring. Writes before this are dropped.
+void logInit();
+
+// Claim and publish a slot; logWrite() below is the normal entry point
+LogSlot* logBegin(LogMsg msg, uint32_t& claim);
+void logCommit(LogSlot* slot, uint32_t claim, const uint8_t* end);
+
+// Argument encoding, inline so a log call compiles to stores
+namespace binlog {
+
+inline void put(uint8_t*& p, uint8_t* end, char tag, const void* value, size_t n) {
+  if (p + 1 + n > end) {
+    p = end;   // Later arguments don't fit either
+    return;
+  }
+  *p++ = tag;
+  memcpy(p, value, n);
+  p += n;
+}
+
+inline void put32(uint8_t*& p, uint8_t* end, bool isSigned, uint32_t v) { put(p, end, isSigned ? 'i' : 'u', &v, 4); }
+inline void put64(uint8_t*& p, uint8_t* end, bool isSigned, uint64_t v) { put(p, end, isSigned ? 'l' : 'L', &v, 8); }
+
+inline void arg(uint8_t*& p, uint8_t* end, int v) { put32(p, end, true, v); }
+inline void arg(uint8_t*& p, uint8_t* end, unsigned v) { put32(p, end, false, v); }
+inline void arg(uint8_t*& p, uint8_t* end, long v) {
+  if (sizeof(long) > 4) put64(p, end, true, v);
+  else put32(p, end, true, v);
+}
+inline void arg(uint8_t*& p, uint8_t* end, unsigned long v) {
+  if (sizeof(long) > 4) put64(p, end, false, v);
+  else put32(p, end, false, v);
+}
+inline void arg(uint8_t*& p, uint8_t* end, long long v) { put64(p, end, true, v); }
+inline void arg(uint8_t*& p, uint8_t* end, unsigned long long v) { put64(p, end, false, v); }
+inline void arg(uint8_t*& p, uint8_t* end, double v) { put(p, end, 'd', &v, 8); }
+
+inline void arg(uint8_t*& p, uint8_t* end, const char* s) {
+  if (!s) s = "(null)";
+  if (p + 2 > end) {
+    p = end;
+    return;
+  }
+  size_t n = strlen(s);
+  if (n > (size_t)(end - p - 2)) n = end - p - 2;
+  *p++ = 's';
+  *p++ = (uint8_t)n;
+  memcpy(p, s, n);
+  p += n;
+}
+inline void arg(uint8_t*& p, uint8_t* end, char* s) { arg(p, end, (const char*)s); }
+
+inline void args(uint8_t*&, uint8_t*) {}
+
+template <typename T, typename... Rest>
+inline void args(uint8_t*& p, uint8_t* end, T first, Rest... rest) {
+  arg(p, end, first);
+  args(p, end, rest...);
+}
+
+}
+
+template <typename... Args>
+inline void logWrite(LogMsg msg, Args... values) {
+  uint32_t claim;
+  LogSlot* slot = logBegin(msg, claim);
+  if (!slot) return;
+  uint8_t* p = slot->payload;
+  binlog::args(p, slot->payload + LOG_PAYLOAD, values...);
+  logCommit(slot, claim, p);
+}
+
+LogLevel logLevel(LogMsg msg);
+
+// One record as "<ms>.<us> <level><core> <text>\n"
+void logFormat(const LogSlot& slot, char* out, size_t size);
+
+// Formatted ring, oldest first
+void logDump(void (*emit)(const char* text), LogLevel minLevel);
+
+// Records written since the previous call (single reader: the UI loop),
+// at most maxRecords per call. Reports records lost to overwrites.
+void logTail(void (*emit)(const char* text), LogLevel minLevel, uint32_t maxRecords);
+
+// Hex dump for host/logdecode/: a header line with the slot size and the
+// message table hash, then one line per slot
+void logExportHex(void (*emit)(const char* text));
+
+// FNV-1a over every format in log_messages.h; a dump only decodes with
+// the same table
+uint32_t logTableHash();
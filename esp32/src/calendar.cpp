@@ -0,0 +1,28 @@
+#include "calendar.h"
+#include "profiler.h"
+#include <stdlib.h>
+
+uint16_t hexToRGB(const char* hex) {
+  if (*hex == '#') hex++;
+  long number = strtol(hex, NULL, 16);
+  uint8_t r = (number >> 16) & 0xFF;
+  uint8_t g = (number >> 8) & 0xFF;
+  uint8_t b = number & 0xFF;
+  // Same packing as LGFX::color565, without needing the display object
+  return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+}
+
+time_t parseISO(const char* iso) {
+  PROF_SCOPE(PROF_PARSE_ISO);
+  struct tm t = {0};
+  strptime(iso, "%Y-%m-%dT%H:%M:%S", &t);
+  return mktime(&t); // Assumes local time or needs adjustment if UTC
+}
+
+time_t deviceTime(int64_t utcSecs) {
+  time_t t = (time_t)utcSecs;
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  tm.tm_isdst = 0;
+  return mktime(&tm);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+// Calendar data model shared between the UI loop and the network task
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include "host/wstring.h"
+#endif
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+
+struct CalEvent {
+  String title;
+  time_t start;
+  time_t end;
+  uint16_t color;
+  String location;
+  bool allDay;
+};
+
+struct CalInfo {
+  String name;
+  uint16_t color;
+  String id;
+};
+
+// "#RRGGBB" -> RGB565
+uint16_t hexToRGB(const char* hex);
+
+// "YYYY-MM-DDTHH:MM:SS" -> time_t
+time_t parseISO(const char* iso);
+
+// Seconds since 1970 UTC -> time_t the way parseISO() makes it from that
+// time's ISO string, for times computed on the device (ics.h, series.h)
+time_t deviceTime(int64_t utcSecs);
@@ -0,0 +1,40 @@
+#include "diag.h"
+#include "trace.h"
+#include "recorder.h"
+#include "refresh_log.h"
+#include "binlog.h"
+#include <string.h>
+
+static bool route(const char* path, const char* name) {
+  size_t n = strlen(name);
+  return strncmp(path, name, n) == 0 && (path[n] == 0 || path[n] == '?');
+}
+
+void diagRespond(const char* path, void (*sample)(SystemGauges& sys), void (*emit)(const char* text)) {
+  if (route(path, "/metrics")) {
+    SystemGauges sys;
+    sample(sys);
+    emit("HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\n\r\n");
+    metricsReport(sys, emit);
+  } else if (route(path, "/trace")) {
+    emit("HTTP/1.0 200 OK\r\nContent-Type: application/json\r\n"
+         "Content-Disposition: attachment; filename=\"calendar-trace.json\"\r\nConnection: close\r\n\r\n");
+    traceExport(emit);
+  } else if (route(path, "/recording")) {
+    emit("HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\n"
+         "Content-Disposition: attachment; filename=\"calendar-recording.txt\"\r\nConnection: close\r\n\r\n");
+    recExport(emit);
+  } else if (route(path, "/refreshes")) {
+    emit("HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\nConnection: close\r\n\r\n");
+    refreshLogReport(emit);
+  } else if (route(path, "/log")) {
+    emit("HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\nConnection: close\r\n\r\n");
+    logDump(emit, LOG_DEBUG);
+  } else if (route(path, "/log.hex")) {
+    emit("HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\n"
+         "Content-Disposition: attachment; filename=\"calendar-log.txt\"\r\nConnection: close\r\n\r\n");
+    logExportHex(emit);
+  } else {
+    emit("HTTP/1.0 404 Not Found\r\nConnection: close\r\n\r\n");
+  }
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+// Routes of the LAN diagnostics endpoint, shared by the device (network
+// task) and the native build:
+//   /metrics    Prometheus text (metrics.h)
+//   /trace      Chrome trace-event JSON (trace.h)
+//   /recording  field recording for the replay runner (recorder.h)
+//   /refreshes  per-step timing of the last refreshes (refresh_log.h)
+//   /log        log ring as text, /log.hex for host/logdecode/ (binlog.h)
+
+#include "metrics.h"
+
+// Write a complete HTTP/1.0 response (status line, headers, body) for path
+void diagRespond(const char* path, void (*sample)(SystemGauges& sys), void (*emit)(const char* text));
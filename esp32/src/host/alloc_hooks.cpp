@@ -0,0 +1,41 @@
+// Host stand-in for the firmware's malloc wrappers: route C++ allocations
+// through the same accounting. Everything counts as internal RAM.
+
+#include "../alloc_track.h"
+
+#ifndef NO_INSTRUMENTATION
+
+#include <malloc.h>
+#include <stdlib.h>
+#include <new>
+
+void* operator new(size_t size) {
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  allocNote(ALLOC_INTERNAL, malloc_usable_size(p), +1);
+  return p;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+  if (!p) return;
+  allocNote(ALLOC_INTERNAL, malloc_usable_size(p), -1);
+  free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  operator delete(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  operator delete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+  operator delete(p);
+}
+
+#endif
@@ -0,0 +1,325 @@
+/*
+ * Host micro-benchmarks for the firmware's hot paths.
+ *
+ *   pio run -e native_bench
+ *   .pio/build/native_bench/program [options]
+ *
+ * Options (Google Benchmark spelling where one exists):
+ *   --benchmark_filter=SUBSTR      only names containing SUBSTR
+ *   --benchmark_min_time=SECONDS   per measurement (default 0.5)
+ *   --benchmark_repetitions=N      repeat and add mean/median/stddev rows
+ *   --benchmark_format=console|json
+ *   --benchmark_out=FILE           also write JSON to FILE
+ *   --events=LIST                  calendar sizes (default 100,1000,10000,100000)
+ *   --overlap=LIST                 mean concurrent events (default 1,4)
+ *   --recur=LIST                   % of events in weekly series (default 30)
+ *   --description=BYTES            description on every event in the full
+ *                                  response (default none)
+ */
+
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+struct Registered {
+  const char* name;
+  BenchFn fn;
+  bool perCalendar;
+};
+
+struct Result {
+  std::string name;
+  std::string runName;
+  bool aggregate;
+  const char* aggregateName;
+  int repetitions;
+  int repetitionIndex;
+  int64_t iterations;
+  double realNs;     // Per iteration
+  double cpuNs;
+  double itemsPerSec;
+  double bytesPerSec;
+};
+
+static std::vector<Registered>& registry() {
+  static std::vector<Registered> r;
+  return r;
+}
+
+BenchRegistration::BenchRegistration(const char* name, BenchFn fn, bool perCalendar) {
+  registry().push_back({name, fn, perCalendar});
+}
+
+static uint64_t clockNs(clockid_t id) {
+  struct timespec ts;
+  clock_gettime(id, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static SynthCalendar* currentCalendar = NULL;
+static SynthParams currentParams;
+
+BenchState::BenchState(const SynthParams* params, int64_t iterations)
+  : params_(params), iterations_(iterations), remaining_(iterations), running_(false),
+    realStart_(0), cpuStart_(0), realNs_(0), cpuNs_(0), items_(0), bytes_(0) {}
+
+void BenchState::start() {
+  running_ = true;
+  realStart_ = clockNs(CLOCK_MONOTONIC);
+  cpuStart_ = clockNs(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+void BenchState::pauseTiming() {
+  if (!running_) return;
+  realNs_ += clockNs(CLOCK_MONOTONIC) - realStart_;
+  cpuNs_ += clockNs(CLOCK_PROCESS_CPUTIME_ID) - cpuStart_;
+  running_ = false;
+}
+
+void BenchState::resumeTiming() {
+  if (!running_) start();
+}
+
+SynthCalendar& BenchState::calendar() {
+  if (!currentCalendar) {
+    currentCalendar = new SynthCalendar;
+    synthGenerate(*params_, *currentCalendar);
+  }
+  return *currentCalendar;
+}
+
+// Options
+static const char* filter = "";
+static double minTime = 0.5;
+static int repetitions = 1;
+static bool json = false;
+static const char* outPath = NULL;
+static std::vector<int> eventCounts = {100, 1000, 10000, 100000};
+static std::vector<int> overlaps = {1, 4};
+static std::vector<int> recurs = {30};
+static int descriptionBytes = 0;
+
+static std::vector<int> parseList(const char* s) {
+  std::vector<int> v;
+  while (*s) {
+    v.push_back(atoi(s));
+    const char* comma = strchr(s, ',');
+    if (!comma) break;
+    s = comma + 1;
+  }
+  return v;
+}
+
+static bool option(const char* arg, const char* name, const char** value) {
+  size_t n = strlen(name);
+  if (strncmp(arg, name, n) || arg[n] != '=') return false;
+  *value = arg + n + 1;
+  return true;
+}
+
+// Grow the iteration count until one run lasts minTime (as Google Benchmark does)
+static BenchState measure(const Registered& b, const SynthParams* params) {
+  int64_t iterations = 1;
+  for (;;) {
+    BenchState state(params, iterations);
+    b.fn(state);
+    double seconds = state.realNs() / 1e9;
+    if (seconds >= minTime || iterations >= 1000000000) return state;
+    double multiplier = seconds > 1e-9 ? minTime * 1.4 / seconds : 10;
+    if (multiplier > 10) multiplier = 10;
+    int64_t next = (int64_t)(iterations * multiplier);
+    iterations = next > iterations ? next : iterations + 1;
+  }
+}
+
+static Result toResult(const std::string& name, const BenchState& s, int index) {
+  Result r;
+  r.name = name;
+  r.runName = name;
+  r.aggregate = false;
+  r.aggregateName = "";
+  r.repetitions = repetitions;
+  r.repetitionIndex = index;
+  r.iterations = s.iterations();
+  r.realNs = s.realNs() / s.iterations();
+  r.cpuNs = s.cpuNs() / s.iterations();
+  double seconds = s.realNs() / 1e9;
+  r.itemsPerSec = s.items() && seconds > 0 ? s.items() / seconds : 0;
+  r.bytesPerSec = s.bytes() && seconds > 0 ? s.bytes() / seconds : 0;
+  return r;
+}
+
+static void addAggregates(std::vector<Result>& results, size_t first) {
+  size_t n = results.size() - first;
+  if (n < 2) return;
+  const char* names[] = {"mean", "median", "stddev"};
+  for (int a = 0; a < 3; a++) {
+    std::vector<double> real, cpu, items, bytes;
+    for (size_t i = first; i < first + n; i++) {
+      real.push_back(results[i].realNs);
+      cpu.push_back(results[i].cpuNs);
+      items.push_back(results[i].itemsPerSec);
+      bytes.push_back(results[i].bytesPerSec);
+    }
+    auto stat = [&](std::vector<double>& v) {
+      double mean = 0;
+      for (double x : v) mean += x;
+      mean /= v.size();
+      if (a == 0) return mean;
+      if (a == 1) {
+        std::sort(v.begin(), v.end());
+        return v.size() % 2 ? v[v.size() / 2] : (v[v.size() / 2 - 1] + v[v.size() / 2]) / 2;
+      }
+      double var = 0;
+      for (double x : v) var += (x - mean) * (x - mean);
+      return sqrt(var / (v.size() - 1));
+    };
+    Result r = results[first];
+    r.name = results[first].runName + "_" + names[a];
+    r.aggregate = true;
+    r.aggregateName = names[a];
+    r.iterations = n;
+    r.realNs = stat(real);
+    r.cpuNs = stat(cpu);
+    r.itemsPerSec = stat(items);
+    r.bytesPerSec = stat(bytes);
+    results.push_back(r);
+  }
+}
+
+static void formatRate(char* buf, size_t len, const char* label, double perSec) {
+  const char* unit = "";
+  if (perSec >= 1e9) { perSec /= 1e9; unit = "G"; }
+  else if (perSec >= 1e6) { perSec /= 1e6; unit = "M"; }
+  else if (perSec >= 1e3) { perSec /= 1e3; unit = "k"; }
+  snprintf(buf, len, "%s=%.4g%s/s", label, perSec, unit);
+}
+
+static void printConsole(const Result& r) {
+  char rate[48] = "";
+  if (r.bytesPerSec) formatRate(rate, sizeof(rate), "bytes_per_second", r.bytesPerSec);
+  else if (r.itemsPerSec) formatRate(rate, sizeof(rate), "items_per_second", r.itemsPerSec);
+  printf("%-56s %12.0f ns %12.0f ns %10lld %s\n", r.name.c_str(), r.realNs, r.cpuNs, (long long)r.iterations, rate);
+  fflush(stdout);
+}
+
+static void writeJson(FILE* f, const std::vector<Result>& results, const char* executable) {
+  char date[32], host[64] = "";
+  time_t now = time(NULL);
+  struct tm tm;
+  localtime_r(&now, &tm);
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", &tm);
+  gethostname(host, sizeof(host) - 1);
+
+  fprintf(f, "{\n  \"context\": {\n    \"date\": \"%s\",\n    \"host_name\": \"%s\",\n    \"executable\": \"%s\",\n"
+             "    \"num_cpus\": %ld,\n    \"mhz_per_cpu\": 0,\n    \"cpu_scaling_enabled\": false,\n    \"caches\": [],\n"
+             "    \"library_build_type\": \"%s\"\n  },\n  \"benchmarks\": [",
+          date, host, executable, sysconf(_SC_NPROCESSORS_ONLN),
+#ifdef __OPTIMIZE__
+          "release"
+#else
+          "debug"
+#endif
+  );
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result& r = results[i];
+    fprintf(f, "%s\n    {\n      \"name\": \"%s\",\n      \"run_name\": \"%s\",\n      \"run_type\": \"%s\",\n",
+            i ? "," : "", r.name.c_str(), r.runName.c_str(), r.aggregate ? "aggregate" : "iteration");
+    fprintf(f, "      \"repetitions\": %d,\n      \"repetition_index\": %d,\n      \"threads\": 1,\n",
+            r.repetitions, r.aggregate ? 0 : r.repetitionIndex);
+    if (r.aggregate) fprintf(f, "      \"aggregate_name\": \"%s\",\n", r.aggregateName);
+    fprintf(f, "      \"iterations\": %lld,\n      \"real_time\": %.6e,\n      \"cpu_time\": %.6e,\n      \"time_unit\": \"ns\"",
+            (long long)r.iterations, r.realNs, r.cpuNs);
+    if (r.bytesPerSec) fprintf(f, ",\n      \"bytes_per_second\": %.6e", r.bytesPerSec);
+    if (r.itemsPerSec) fprintf(f, ",\n      \"items_per_second\": %.6e", r.itemsPerSec);
+    fprintf(f, "\n    }");
+  }
+  fprintf(f, "\n  ]\n}\n");
+}
+
+static void run(const Registered& b, const SynthParams* params, std::vector<Result>& results) {
+  char name[128];
+  if (params) {
+    int len = snprintf(name, sizeof(name), "%s/events:%d/overlap:%d/recur:%d", b.name, params->events,
+                       params->overlap, params->recurPct);
+    if (params->descriptionBytes) {
+      snprintf(name + len, sizeof(name) - len, "/description:%d", params->descriptionBytes);
+    }
+  } else {
+    snprintf(name, sizeof(name), "%s", b.name);
+  }
+  if (!strstr(name, filter)) return;
+
+  size_t first = results.size();
+  for (int rep = 0; rep < repetitions; rep++) {
+    results.push_back(toResult(name, measure(b, params), rep));
+    if (!json) printConsole(results.back());
+  }
+  addAggregates(results, first);
+  if (!json) {
+    for (size_t i = first + repetitions; i < results.size(); i++) printConsole(results[i]);
+  }
+}
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    const char* v;
+    if (option(argv[i], "--benchmark_filter", &v)) filter = v;
+    else if (option(argv[i], "--benchmark_min_time", &v)) minTime = atof(v);
+    else if (option(argv[i], "--benchmark_repetitions", &v)) repetitions = atoi(v) > 0 ? atoi(v) : 1;
+    else if (option(argv[i], "--benchmark_format", &v)) json = !strcmp(v, "json");
+    else if (option(argv[i], "--benchmark_out", &v)) outPath = v;
+    else if (option(argv[i], "--events", &v)) eventCounts = parseList(v);
+    else if (option(argv[i], "--overlap", &v)) overlaps = parseList(v);
+    else if (option(argv[i], "--recur", &v)) recurs = parseList(v);
+    else if (option(argv[i], "--description", &v)) descriptionBytes = atoi(v);
+    else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  // Calendar times are interpreted in local time, as on the device; pin it
+  setenv("TZ", "UTC", 1);
+  tzset();
+
+  std::vector<Result> results;
+  if (!json) printf("%-56s %15s %15s %10s\n", "Benchmark", "Time", "CPU", "Iterations");
+
+  for (const Registered& b : registry()) {
+    if (!b.perCalendar) run(b, NULL, results);
+  }
+
+  // One calendar at a time; the 100k ones are large
+  for (int events : eventCounts) {
+    for (int overlap : overlaps) {
+      for (int recur : recurs) {
+        currentParams = {events, overlap, recur, 0, 0, descriptionBytes};
+        for (const Registered& b : registry()) {
+          if (b.perCalendar) run(b, &currentParams, results);
+        }
+        delete currentCalendar;
+        currentCalendar = NULL;
+      }
+    }
+  }
+
+  if (json) writeJson(stdout, results, argv[0]);
+  if (outPath) {
+    FILE* f = fopen(outPath, "w");
+    if (!f) {
+      perror(outPath);
+      return 1;
+    }
+    writeJson(f, results, argv[0]);
+    fclose(f);
+  }
+  return 0;
+}
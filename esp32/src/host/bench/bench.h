@@ -0,0 +1,74 @@
+#pragma once
+
+// Small benchmark runner for the host build. Results are written in Google
+// Benchmark's JSON schema, so its tools/compare.py can diff two runs.
+//
+// A benchmark is a function that loops on state.keepRunning(); anything
+// before the first call or after the last one is not timed:
+//
+//   static void day_query(BenchState& state) {
+//     SynthCalendar& cal = state.calendar();
+//     while (state.keepRunning()) { ... }
+//     state.setItemsProcessed(state.iterations());
+//   }
+//   BENCHMARK(day_query);
+
+#include <stdint.h>
+#include "../synth.h"
+
+class BenchState {
+public:
+  BenchState(const SynthParams* params, int64_t iterations);
+
+  bool keepRunning() {
+    if (remaining_ > 0) {
+      if (remaining_-- == iterations_) start();
+      return true;
+    }
+    pauseTiming();
+    return false;
+  }
+
+  void pauseTiming();
+  void resumeTiming();
+
+  // Items/bytes handled in total, reported per second
+  void setItemsProcessed(int64_t n) { items_ = n; }
+  void setBytesProcessed(int64_t n) { bytes_ = n; }
+
+  // The synthetic calendar for this run's parameters (cached, untimed)
+  SynthCalendar& calendar();
+  const SynthParams& params() const { return *params_; }
+  int64_t iterations() const { return iterations_; }
+
+  double realNs() const { return realNs_; }
+  double cpuNs() const { return cpuNs_; }
+  int64_t items() const { return items_; }
+  int64_t bytes() const { return bytes_; }
+
+private:
+  void start();
+
+  const SynthParams* params_;
+  int64_t iterations_;
+  int64_t remaining_;
+  bool running_;
+  uint64_t realStart_, cpuStart_;
+  double realNs_, cpuNs_;
+  int64_t items_, bytes_;
+};
+
+typedef void (*BenchFn)(BenchState& state);
+
+struct BenchRegistration {
+  // perCalendar: run once per --events/--overlap/--recur combination
+  BenchRegistration(const char* name, BenchFn fn, bool perCalendar);
+};
+
+#define BENCHMARK(fn) static BenchRegistration _bench_##fn(#fn, fn, true)
+#define BENCHMARK_SCALAR(fn) static BenchRegistration _bench_##fn(#fn, fn, false)
+
+// Keep the compiler from discarding a result
+template <class T> inline void benchKeep(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
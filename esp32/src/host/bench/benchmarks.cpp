@@ -0,0 +1,309 @@
+// The firmware functions measured by bench.cpp. Sizes and limits mirror
+// the views in main.cpp (30 events per day, 20 per week column, 5 per
+// month cell).
+
+#include "bench.h"
+#include "../../ingest.h"
+#include "../../ics.h"
+#include "../../layout.h"
+#include "../../series.h"
+#include "../../binlog.h"
+#include <string.h>
+#include <algorithm>
+
+#define DAY_LIMIT 30
+#define WEEK_LIMIT 20
+#define MONTH_CELL_LIMIT 5
+
+static void parse_iso(BenchState& state) {
+  static const char* samples[] = {
+    "2025-01-06T08:00:00.000Z", "2025-02-14T17:45:00.000Z", "2025-03-30T00:00:00.000Z", "2025-12-31T23:59:59.000Z"
+  };
+  int i = 0;
+  while (state.keepRunning()) {
+    benchKeep(parseISO(samples[i++ & 3]));
+  }
+  state.setItemsProcessed(state.iterations());
+}
+BENCHMARK_SCALAR(parse_iso);
+
+static void hex_to_rgb(BenchState& state) {
+  static const char* samples[] = {"#3B82F6", "#22C55E", "#EC4899", "#F97316"};
+  int i = 0;
+  while (state.keepRunning()) {
+    benchKeep(hexToRGB(samples[i++ & 3]));
+  }
+  state.setItemsProcessed(state.iterations());
+}
+BENCHMARK_SCALAR(hex_to_rgb);
+
+// Cost of a hot-path log call (what a frame pays), and of formatting it
+// later (what the idle loop pays)
+static void log_write(BenchState& state) {
+  logInit();
+  uint32_t i = 0;
+  while (state.keepRunning()) {
+    logWrite(LOG_UI_FRAME, VIEW_WEEK, (int)(i & 63), i, i * 2);
+    i++;
+  }
+  state.setItemsProcessed(state.iterations());
+}
+BENCHMARK_SCALAR(log_write);
+
+static void log_format(BenchState& state) {
+  logInit();
+  uint32_t claim;
+  LogSlot* slot = logBegin(LOG_NET_REFRESH, claim);
+  uint8_t* p = slot->payload;
+  binlog::args(p, slot->payload + LOG_PAYLOAD, "ok", 200, 123456u, 391793u, 2000u);
+  logCommit(slot, claim, p);
+  LogSlot copy = *slot;
+  char line[LOG_LINE_MAX];
+  while (state.keepRunning()) {
+    logFormat(copy, line, sizeof(line));
+    benchKeep(line[0]);
+  }
+  state.setItemsProcessed(state.iterations());
+}
+BENCHMARK_SCALAR(log_format);
+
+// Whole response body -> event vectors, as on every refresh
+static void ingest_json(BenchState& state) {
+  SynthCalendar& cal = state.calendar();
+  while (state.keepRunning()) {
+    std::vector<CalEvent> events;
+    std::vector<CalInfo> calendars;
+    const char* error;
+    benchKeep(ingestCalendarJson(cal.json.data(), cal.json.size(), events, calendars, &error));
+  }
+  state.setItemsProcessed(state.iterations() * (int64_t)cal.events.size());
+  state.setBytesProcessed(state.iterations() * (int64_t)cal.json.size());
+}
+BENCHMARK(ingest_json);
+
+// The same calendar as ?profile=device sends it
+static void ingest_device_json(BenchState& state) {
+  SynthCalendar& cal = state.calendar();
+  while (state.keepRunning()) {
+    std::vector<CalEvent> events;
+    std::vector<CalInfo> calendars;
+    const char* error;
+    benchKeep(ingestCalendarJson(cal.deviceJson.data(), cal.deviceJson.size(), events, calendars, &error));
+  }
+  state.setItemsProcessed(state.iterations() * (int64_t)cal.events.size());
+  state.setBytesProcessed(state.iterations() * (int64_t)cal.deviceJson.size());
+}
+BENCHMARK(ingest_device_json);
+
+// ... with &series=1, series kept for seriesForDay()
+static void ingest_series_json(BenchState& state) {
+  SynthCalendar& cal = state.calendar();
+  while (state.keepRunning()) {
+    std::vector<CalEvent> events;
+    std::vector<CalInfo> calendars;
+    SeriesSet series;
+    const char* error;
+    benchKeep(ingestCalendarJson(cal.seriesJson.data(), cal.seriesJson.size(), events, calendars, &error, &series));
+  }
+  state.setItemsProcessed(state.iterations() * (int64_t)cal.events.size());
+  state.setBytesProcessed(state.iterations() * (int64_t)cal.seriesJson.size());
+}
+BENCHMARK(ingest_series_json);
+
+// The same calendar as an ICS feed parsed on the device (ICS_FEEDS), in
+// pieces the size of HTTPClient's TCP buffer
+#define ICS_CHUNK 1436
+
+static void collectIcs(const std::string& ics, time_t from, time_t to, std::vector<CalEvent>* events,
+                       IcsIndex* index) {
+  static IcsParser parser;
+  IcsCollector collector;
+  icsBegin(parser, from, to);
+  if (index) icsCollectBegin(collector, parser, 0, *index);
+  else icsCollectBegin(collector, parser, 0, *events);
+  for (size_t i = 0; i < ics.size(); i += ICS_CHUNK) {
+    icsFeed(parser, ics.data() + i, std::min((size_t)ICS_CHUNK, ics.size() - i), icsCollect, &collector);
+  }
+  icsEnd(parser, icsCollect, &collector);
+  icsCollectEnd(collector);
+}
+
+static void ingestIcs(BenchState& state, const std::string& ics) {
+  SynthCalendar& cal = state.calendar();
+  time_t to = cal.windowStart + (time_t)cal.days * 86400;
+  while (state.keepRunning()) {
+    std::vector<CalEvent> events;
+    collectIcs(ics, cal.windowStart, to, &events, NULL);
+    benchKeep(events.size());
+  }
+  state.setItemsProcessed(state.iterations() * (int64_t)cal.events.size());
+  state.setBytesProcessed(state.iterations() * (int64_t)ics.size());
+}
+
+// A download of the same feed where one event changed, against the index
+// of the last one (IcsIndex): only that VEVENT is collected again, the
+// rest move over from the index. The two versions alternate, so every
+// download has one change.
+static void reingestIcs(BenchState& state, const std::string& ics) {
+  SynthCalendar& cal = state.calendar();
+  time_t to = cal.windowStart + (time_t)cal.days * 86400;
+  std::string versions[2] = {ics, ics};
+  size_t summary = versions[1].find("SUMMARY:");
+  if (summary != std::string::npos) versions[1].insert(summary + 8, "x");
+  IcsIndex index = IcsIndex();
+  collectIcs(versions[0], cal.windowStart, to, NULL, &index);
+  int n = 1;
+  while (state.keepRunning()) {
+    collectIcs(versions[n++ & 1], cal.windowStart, to, NULL, &index);
+    benchKeep(index.events.size());
+  }
+  state.setItemsProcessed(state.iterations() * (int64_t)cal.events.size());
+  state.setBytesProcessed(state.iterations() * (int64_t)ics.size());
+}
+
+static void ingest_ics(BenchState& state) {
+  ingestIcs(state, state.calendar().ics);
+}
+BENCHMARK(ingest_ics);
+
+static void reingest_ics(BenchState& state) {
+  reingestIcs(state, state.calendar().ics);
+}
+BENCHMARK(reingest_ics);
+
+// The weekly series as RRULEs: expanding them is what an unchanged
+// VEVENT saves
+static void ingest_ics_series(BenchState& state) {
+  ingestIcs(state, state.calendar().icsSeries);
+}
+BENCHMARK(ingest_ics_series);
+
+static void reingest_ics_series(BenchState& state) {
+  reingestIcs(state, state.calendar().icsSeries);
+}
+BENCHMARK(reingest_ics_series);
+
+static time_t dayStart(const SynthCalendar& cal, int day) {
+  return cal.windowStart + (time_t)day * 86400;
+}
+
+static void day_query(BenchState& state) {
+  SynthCalendar& cal = state.calendar();
+  CalEvent* out[DAY_LIMIT];
+  int day = 0;
+  while (state.keepRunning()) {
+    benchKeep(eventsForDay(cal.events, dayStart(cal, day), out, DAY_LIMIT));
+    day = (day + 1) % SYNTH_DAYS;
+  }
+  state.setItemsProcessed(state.iterations());
+}
+BENCHMARK(day_query);
+
+// The same days with series expanded on demand. The window has more days
+// than the bucket cache, so every query makes its bucket afresh.
+static void day_query_series(BenchState& state) {
+  SynthCalendar& cal = state.calendar();
+  std::vector<CalEvent> events;
+  std::vector<CalInfo> calendars;
+  static SeriesSet series;
+  static SeriesDays cache;
+  const char* error;
+  series = SeriesSet();
+  seriesDaysClear(cache);
+  ingestCalendarJson(cal.seriesJson.data(), cal.seriesJson.size(), events, calendars, &error, &series);
+  seriesDaysReserve(series, cache);
+  CalEvent* out[DAY_LIMIT];
+  int day = 0;
+  while (state.keepRunning()) {
+    int n = eventsForDay(events, dayStart(cal, day), out, DAY_LIMIT);
+    benchKeep(seriesForDay(series, cache, dayStart(cal, day), out, n, DAY_LIMIT));
+    day = (day + 1) % SYNTH_DAYS;
+  }
+  state.setItemsProcessed(state.iterations());
+}
+BENCHMARK(day_query_series);
+
+// Day lists arrive in API order, i.e. already sorted; shuffle them so the
+// insertion sort sees the merged-feed worst case
+static void sort_day(BenchState& state) {
+  SynthCalendar& cal = state.calendar();
+  std::vector<CalEvent*> lists(SYNTH_DAYS * DAY_LIMIT);
+  std::vector<int> counts(SYNTH_DAYS);
+  uint32_t seed = 1;
+  for (int d = 0; d < SYNTH_DAYS; d++) {
+    CalEvent** list = &lists[d * DAY_LIMIT];
+    counts[d] = eventsForDay(cal.events, dayStart(cal, d), list, DAY_LIMIT);
+    for (int i = counts[d] - 1; i > 0; i--) {
+      seed = seed * 1103515245 + 12345;
+      std::swap(list[i], list[(seed >> 16) % (i + 1)]);
+    }
+  }
+
+  CalEvent* scratch[DAY_LIMIT];
+  int day = 0;
+  while (state.keepRunning()) {
+    memcpy(scratch, &lists[day * DAY_LIMIT], counts[day] * sizeof(CalEvent*));
+    sortEvents(scratch, counts[day]);
+    benchKeep(scratch[0]);
+    day = (day + 1) % SYNTH_DAYS;
+  }
+  state.setItemsProcessed(state.iterations());
+}
+BENCHMARK(sort_day);
+
+// Day view: query, sort and column packing for one day
+static void day_layout(BenchState& state) {
+  SynthCalendar& cal = state.calendar();
+  CalEvent* events[DAY_LIMIT];
+  LayoutInfo layouts[DAY_LIMIT];
+  int day = 0;
+  while (state.keepRunning()) {
+    int n = eventsForDay(cal.events, dayStart(cal, day), events, DAY_LIMIT);
+    layoutDay(events, n, layouts);
+    benchKeep(layouts[0]);
+    day = (day + 1) % SYNTH_DAYS;
+  }
+  state.setItemsProcessed(state.iterations());
+}
+BENCHMARK(day_layout);
+
+// Week view: seven day columns with overlap splitting
+static void week_layout(BenchState& state) {
+  SynthCalendar& cal = state.calendar();
+  CalEvent* events[WEEK_LIMIT];
+  WeekSlot slots[WEEK_LIMIT];
+  int week = 0;
+  while (state.keepRunning()) {
+    for (int d = 0; d < 7; d++) {
+      int n = eventsForDay(cal.events, dayStart(cal, week * 7 + d), events, WEEK_LIMIT);
+      layoutWeekDay(events, n, slots);
+      benchKeep(slots[0]);
+    }
+    week = (week + 1) % (SYNTH_DAYS / 7);
+  }
+  state.setItemsProcessed(state.iterations());
+}
+BENCHMARK(week_layout);
+
+// Month view: grid start plus the 42 cell queries drawMonthCell makes
+static void month_layout(BenchState& state) {
+  SynthCalendar& cal = state.calendar();
+  CalEvent* events[MONTH_CELL_LIMIT];
+  struct tm first;
+  localtime_r(&cal.windowStart, &first);
+  int month = 0;
+  while (state.keepRunning()) {
+    struct tm viewDate = first;
+    viewDate.tm_mon += month;
+    viewDate.tm_mday = 15;
+    struct tm grid = monthGridStart(viewDate);
+    for (int i = 0; i < 42; i++) {
+      struct tm cell = grid;
+      cell.tm_mday += i;
+      benchKeep(eventsForDay(cal.events, mktime(&cell), events, MONTH_CELL_LIMIT));
+    }
+    month = (month + 1) % 3;
+  }
+  state.setItemsProcessed(state.iterations());
+}
+BENCHMARK(month_layout);
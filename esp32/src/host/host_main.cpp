@@ -0,0 +1,198 @@
+/*
+ * Native (Linux) build of the firmware's portable modules.
+ *
+ *   pio run -e native
+ *   .pio/build/native/program [--metrics-port 9100] [--once]
+ *       [--api URL [--key SECRET] [--refresh SECS] [--soak N]]
+ *
+ * Serves the same /metrics and /trace endpoints as the device. --once
+ * prints the metrics to stdout and exits.
+ *
+ * With --api it refreshes from that URL (normally the local stand-in,
+ * mockapi/) the way the network task does: GET, ingest, metrics. --soak
+ * stops after N refreshes and prints a summary.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <time.h>
+#include <vector>
+#include "../diag.h"
+#include "../trace.h"
+#include "../ingest.h"
+#include "../alloc_track.h"
+#include "../refresh_log.h"
+#include "../binlog.h"
+#include "http_server.h"
+#include "http_client.h"
+
+#define HTTP_TIMEOUT_MS 5000   // HTTPClient default
+
+static time_t startTime;
+
+static void sampleSystem(SystemGauges& sys) {
+  struct mallinfo2 mi = mallinfo2();
+  sys.uptimeSec = time(NULL) - startTime;
+  sys.heapFree = mi.fordblks;
+  sys.heapLargestBlock = 0;   // Not meaningful on glibc
+  sys.psramFree = 0;
+  sys.wifiRssi = 0;
+}
+
+static void emitStdout(const char* text) {
+  fputs(text, stdout);
+}
+
+static void handleHttp(const HttpRequest& request, void (*emit)(const char*)) {
+  diagRespond(request.path.c_str(), sampleSystem, emit);
+}
+
+// Refresh outcomes for the soak summary
+struct SoakStats {
+  uint32_t ok;
+  uint32_t httpErrors;     // Non-200 status
+  uint32_t netErrors;      // Refused, lost, timed out or truncated
+  uint32_t jsonErrors;
+  uint32_t maxMs;
+  uint64_t totalMs;
+  size_t maxBytes;
+};
+
+static SoakStats soak;
+
+// Mirrors fetchEvents() in net.cpp: -1 .. +2 months
+static uint32_t nowUs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static bool refresh(const char* api, const char* key, RefreshRecord& rec) {
+  TRACE_SCOPE(TRACE_REFRESH);
+  char url[512];
+  time_t now = time(NULL);
+  struct tm startTm; localtime_r(&now, &startTm);
+  startTm.tm_hour = startTm.tm_min = startTm.tm_sec = 0;
+  struct tm endTm = startTm;
+  startTm.tm_mon -= 1; mktime(&startTm);
+  endTm.tm_mon += 2; mktime(&endTm);
+  char startIso[30], endIso[30];
+  strftime(startIso, sizeof(startIso), "%Y-%m-%dT%H:%M:%SZ", &startTm);
+  strftime(endIso, sizeof(endIso), "%Y-%m-%dT%H:%M:%SZ", &endTm);
+  snprintf(url, sizeof(url), "%s?from=%s&to=%s&profile=device", api, startIso, endIso);
+
+  std::string payload;
+  HttpTiming timing;
+  int code;
+  {
+    PROF_SCOPE(PROF_NET_GET);
+    code = httpGet(url, key, payload, HTTP_TIMEOUT_MS, &timing);
+  }
+  rec.status = code;
+  rec.stepUs[REFRESH_DNS] = timing.dnsUs;
+  rec.stepUs[REFRESH_CONNECT] = timing.connectUs;
+  rec.stepUs[REFRESH_TTFB] = timing.ttfbUs;
+  rec.stepUs[REFRESH_TRANSFER] = timing.transferUs;
+  refreshParseServerTiming(timing.serverTiming.c_str(), rec);
+  rec.bodyBytes = payload.size();
+  if (code != 200) {
+    printf("[net] GET failed: %d\n", code);
+    if (code < 0) soak.netErrors++;
+    else soak.httpErrors++;
+    return false;
+  }
+
+  std::vector<CalEvent> events;
+  std::vector<CalInfo> calendars;
+  const char* error;
+  uint32_t t = nowUs();
+  bool parsed = ingestCalendarJson(payload.c_str(), payload.size(), events, calendars, &error);
+  rec.stepUs[REFRESH_DECODE] = nowUs() - t;
+  if (!parsed) {
+    printf("[net] JSON error: %s\n", error);
+    soak.jsonErrors++;
+    return false;
+  }
+  rec.events = events.size();
+  t = nowUs();
+  metricsSetEventCount(events.size());
+  rec.stepUs[REFRESH_APPLY] = nowUs() - t;
+  if (payload.size() > soak.maxBytes) soak.maxBytes = payload.size();
+  soak.ok++;
+  return true;
+}
+
+static void refreshLoop(const char* api, const char* key, int intervalSec, int count) {
+  traceSetThread(0);   // The network task's row
+  for (int n = 0; !count || n < count; n++) {
+    uint32_t start = nowUs();
+    RefreshRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    bool ok;
+    allocWindowStart(ALLOC_INGEST);
+    {
+      ALLOC_SCOPE(ALLOC_INGEST);
+      ok = refresh(api, key, rec);
+    }
+    allocWindowEnd(ALLOC_INGEST);
+    rec.ok = ok;
+    rec.totalUs = nowUs() - start;
+    rec.uptimeSec = time(NULL) - startTime;
+    refreshLogAdd(rec);
+    logWrite(LOG_NET_REFRESH, ok ? "ok" : "failed", rec.status, rec.totalUs, rec.bodyBytes, rec.events);
+    uint32_t ms = rec.totalUs / 1000;
+    metricsRefreshDone(ok, ms, rec.bodyBytes, rec.uptimeSec);
+    soak.totalMs += ms;
+    if (ms > soak.maxMs) soak.maxMs = ms;
+    if (!count || n + 1 < count) sleep(intervalSec);
+  }
+
+  uint32_t total = soak.ok + soak.httpErrors + soak.netErrors + soak.jsonErrors;
+  printf("soak: %lu refreshes, %lu ok, %lu http errors, %lu network errors, %lu json errors\n",
+         (unsigned long)total, (unsigned long)soak.ok, (unsigned long)soak.httpErrors,
+         (unsigned long)soak.netErrors, (unsigned long)soak.jsonErrors);
+  printf("soak: avg %lu ms, max %lu ms, largest body %zu bytes\n",
+         (unsigned long)(total ? soak.totalMs / total : 0), (unsigned long)soak.maxMs, soak.maxBytes);
+  refreshLogReport(emitStdout);
+  profReport(emitStdout);
+  allocReport(emitStdout);
+}
+
+int main(int argc, char** argv) {
+  int port = METRICS_PORT;
+  bool once = false;
+  const char* api = NULL;
+  const char* key = getenv("API_SECRET");
+  int refreshSec = 300;
+  int soakCount = 0;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--metrics-port") && i + 1 < argc) port = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--once")) once = true;
+    else if (!strcmp(argv[i], "--api") && i + 1 < argc) api = argv[++i];
+    else if (!strcmp(argv[i], "--key") && i + 1 < argc) key = argv[++i];
+    else if (!strcmp(argv[i], "--refresh") && i + 1 < argc) refreshSec = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--soak") && i + 1 < argc) soakCount = atoi(argv[++i]);
+  }
+
+  startTime = time(NULL);
+  traceInit();
+  logInit();
+
+  if (once) {
+    SystemGauges sys;
+    sampleSystem(sys);
+    metricsReport(sys, emitStdout);
+    return 0;
+  }
+
+  if (!httpServeBackground(port, handleHttp)) return 1;
+  printf("metrics on http://localhost:%d/metrics\n", port);
+  if (api) {
+    refreshLoop(api, key, refreshSec, soakCount);
+    return 0;
+  }
+  for (;;) sleep(1);
+}
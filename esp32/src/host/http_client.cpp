@@ -0,0 +1,131 @@
+#include "http_client.h"
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// "http://host[:port]/path"
+static bool splitUrl(const char* url, std::string& host, std::string& port, std::string& path) {
+  if (strncmp(url, "http://", 7)) return false;
+  const char* h = url + 7;
+  const char* slash = strchr(h, '/');
+  std::string hostPort = slash ? std::string(h, slash - h) : std::string(h);
+  path = slash ? slash : "/";
+  size_t colon = hostPort.find(':');
+  host = hostPort.substr(0, colon);
+  port = colon == std::string::npos ? "80" : hostPort.substr(colon + 1);
+  return !host.empty();
+}
+
+static uint32_t nowUs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static int connectTo(const std::string& host, const std::string& port, int timeoutMs, HttpTiming& timing) {
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* res;
+  uint32_t t = nowUs();
+  int failed = getaddrinfo(host.c_str(), port.c_str(), &hints, &res);
+  timing.dnsUs = nowUs() - t;
+  if (failed) return -1;
+
+  t = nowUs();
+  int fd = -1;
+  for (addrinfo* a = res; a; a = a->ai_next) {
+    fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if (fd < 0) continue;
+    timeval tv = {timeoutMs / 1000, (timeoutMs % 1000) * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    if (connect(fd, a->ai_addr, a->ai_addrlen) == 0) break;
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+  timing.connectUs = nowUs() - t;
+  return fd;
+}
+
+int httpGet(const char* url, const char* apiKey, std::string& body, int timeoutMs, HttpTiming* timing,
+            const char* ifNoneMatch) {
+  HttpTiming scratch;
+  HttpTiming& t = timing ? *timing : scratch;
+  t = HttpTiming();
+  std::string host, port, path;
+  body.clear();
+  if (!splitUrl(url, host, port, path)) return HTTP_ERROR_CONNECTION_REFUSED;
+
+  int fd = connectTo(host, port, timeoutMs, t);
+  if (fd < 0) return HTTP_ERROR_CONNECTION_REFUSED;
+
+  std::string request = "GET " + path + " HTTP/1.0\r\nHost: " + host + "\r\n";
+  if (apiKey && *apiKey) request += std::string("x-api-key: ") + apiKey + "\r\n";
+  if (ifNoneMatch) request += std::string("If-None-Match: \"") + ifNoneMatch + "\"\r\n";
+  request += "Connection: close\r\n\r\n";
+  if (send(fd, request.data(), request.size(), MSG_NOSIGNAL) != (ssize_t)request.size()) {
+    close(fd);
+    return HTTP_ERROR_CONNECTION_LOST;
+  }
+
+  std::string response;
+  char buf[4096];
+  int error = 0;
+  uint32_t sent = nowUs();
+  uint32_t firstByte = 0;
+  for (;;) {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n > 0) {
+      if (response.empty()) {
+        firstByte = nowUs();
+        t.ttfbUs = firstByte - sent;
+      }
+      response.append(buf, n);
+      continue;
+    }
+    if (n < 0) error = (errno == EAGAIN || errno == EWOULDBLOCK) ? HTTP_ERROR_READ_TIMEOUT : HTTP_ERROR_CONNECTION_LOST;
+    break;
+  }
+  close(fd);
+  if (firstByte) t.transferUs = nowUs() - firstByte;
+  if (error) return error;
+
+  size_t headEnd = response.find("\r\n\r\n");
+  int status = 0;
+  if (headEnd == std::string::npos || sscanf(response.c_str(), "HTTP/%*s %d", &status) != 1) {
+    return HTTP_ERROR_CONNECTION_LOST;
+  }
+  body = response.substr(headEnd + 4);
+
+  // Content-Length is optional; when present a short body is an error
+  std::string head = response.substr(0, headEnd);
+  for (size_t i = 0; i < head.size(); i++) head[i] = tolower(head[i]);
+  size_t st = head.find("\r\nserver-timing:");
+  if (st != std::string::npos) {
+    size_t from = st + 16;
+    size_t to = head.find("\r\n", from);
+    t.serverTiming = response.substr(from, (to == std::string::npos ? headEnd : to) - from);
+  }
+  size_t et = head.find("\r\netag:");
+  if (et != std::string::npos) {
+    size_t from = response.find_first_not_of(" \"", et + 7);
+    size_t to = head.find("\r\n", et + 7);
+    if (to == std::string::npos) to = headEnd;
+    while (to > from && (response[to - 1] == '"' || response[to - 1] == ' ')) to--;
+    if (from < to) t.etag = response.substr(from, to - from);
+  }
+  size_t cl = head.find("\r\ncontent-length:");
+  if (cl != std::string::npos && strtoul(head.c_str() + cl + 17, NULL, 10) != body.size()) {
+    return HTTP_ERROR_CONNECTION_LOST;
+  }
+  return status;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// Blocking HTTP/1.0 GET for native builds (plain http only). Stands in for
+// HTTPClient on the device; error codes use the same values.
+
+#include <string>
+
+#define HTTP_ERROR_CONNECTION_REFUSED -1
+#define HTTP_ERROR_CONNECTION_LOST    -5   // Includes bodies shorter than Content-Length
+#define HTTP_ERROR_READ_TIMEOUT       -11
+
+// Step times of one request, in the same steps as refresh_log.h
+struct HttpTiming {
+  uint32_t dnsUs;
+  uint32_t connectUs;
+  uint32_t ttfbUs;          // Request sent until the first response byte
+  uint32_t transferUs;      // First byte until the connection closed
+  std::string serverTiming; // Server-Timing header, empty if absent
+  std::string etag;         // ETag header without quotes, empty if absent
+};
+
+// Returns the status code (body filled in), or a negative error.
+// timeoutMs applies to each read, like HTTPClient::setTimeout.
+// ifNoneMatch is sent quoted as If-None-Match when given.
+int httpGet(const char* url, const char* apiKey, std::string& body, int timeoutMs, HttpTiming* timing = NULL,
+            const char* ifNoneMatch = NULL);
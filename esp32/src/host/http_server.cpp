@@ -0,0 +1,130 @@
+#include "http_server.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <thread>
+
+static thread_local int clientFd = -1;
+static thread_local bool clientGone = false;
+
+void httpSend(const void* data, size_t len) {
+  const char* p = (const char*)data;
+  while (len > 0 && !clientGone) {
+    ssize_t n = send(clientFd, p, len, MSG_NOSIGNAL);
+    if (n <= 0) {
+      clientGone = true;
+      return;
+    }
+    p += n;
+    len -= n;
+  }
+}
+
+static void emitToClient(const char* text) {
+  httpSend(text, strlen(text));
+}
+
+bool httpClientGone() {
+  return clientGone;
+}
+
+// Reads up to the end of the headers; bodies are ignored (GET only)
+static bool readRequest(int fd, std::string& head) {
+  char buf[1024];
+  while (head.find("\r\n\r\n") == std::string::npos) {
+    if (head.size() > 8192) return false;
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0) return !head.empty();
+    head.append(buf, n);
+  }
+  return true;
+}
+
+static void serveClient(int fd, HttpHandler handler) {
+  std::string head;
+  if (!readRequest(fd, head)) return;
+
+  // "GET /path?query HTTP/1.1"
+  HttpRequest request;
+  request.path = "/";
+  size_t sp1 = head.find(' ');
+  size_t lineEnd = head.find("\r\n");
+  if (sp1 != std::string::npos) {
+    size_t sp2 = head.find(' ', sp1 + 1);
+    if (sp2 != std::string::npos && sp2 < lineEnd) request.path = head.substr(sp1 + 1, sp2 - sp1 - 1);
+  }
+  size_t q = request.path.find('?');
+  if (q != std::string::npos) {
+    request.query = request.path.substr(q + 1);
+    request.path.resize(q);
+  }
+
+  // Header names are case-insensitive
+  size_t pos = lineEnd;
+  while (pos != std::string::npos && pos + 2 < head.size()) {
+    size_t next = head.find("\r\n", pos + 2);
+    std::string line = head.substr(pos + 2, next == std::string::npos ? std::string::npos : next - pos - 2);
+    if (!strncasecmp(line.c_str(), "x-api-key:", 10)) {
+      size_t v = line.find_first_not_of(' ', 10);
+      if (v != std::string::npos) request.apiKey = line.substr(v);
+    } else if (!strncasecmp(line.c_str(), "if-none-match:", 14)) {
+      size_t v = line.find_first_not_of(" \"", 14);
+      size_t end = line.find_last_not_of(" \"");
+      if (v != std::string::npos && end >= v) request.ifNoneMatch = line.substr(v, end - v + 1);
+    }
+    pos = next;
+  }
+
+  clientFd = fd;
+  clientGone = false;
+  handler(request, emitToClient);
+  clientFd = -1;
+}
+
+std::string httpQueryParam(const std::string& query, const char* name) {
+  size_t n = strlen(name);
+  size_t pos = 0;
+  while (pos <= query.size()) {
+    size_t end = query.find('&', pos);
+    if (end == std::string::npos) end = query.size();
+    if (end - pos > n && !query.compare(pos, n, name) && query[pos + n] == '=') {
+      return query.substr(pos + n + 1, end - pos - n - 1);
+    }
+    pos = end + 1;
+  }
+  return "";
+}
+
+bool httpServeBackground(int port, HttpHandler handler) {
+  int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+  if (listenFd < 0) return false;
+  int one = 1;
+  setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(listenFd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, 16) < 0) {
+    perror("http server");
+    close(listenFd);
+    return false;
+  }
+
+  std::thread([listenFd, handler]() {
+    for (;;) {
+      int fd = accept(listenFd, NULL, NULL);
+      if (fd < 0) continue;
+      std::thread([fd, handler]() {
+        serveClient(fd, handler);
+        close(fd);
+      }).detach();
+    }
+  }).detach();
+  return true;
+}
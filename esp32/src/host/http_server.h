@@ -0,0 +1,30 @@
+#pragma once
+
+// Minimal blocking HTTP/1.0 server for native builds. Stands in for the
+// firmware's diagnostics endpoint on the network task, and serves the
+// local calendar API (mockapi/).
+
+#include <string>
+
+struct HttpRequest {
+  std::string path;      // Without the query string
+  std::string query;     // Raw, after '?'
+  std::string apiKey;    // x-api-key header, empty if absent
+  std::string ifNoneMatch;  // If-None-Match header without quotes, empty if absent
+};
+
+// Handler writes the full response (status line, headers, body) via emit
+typedef void (*HttpHandler)(const HttpRequest& request, void (*emit)(const char* text));
+
+// Serve forever on a background thread, one thread per connection so slow
+// responses don't hold up others. Returns false if the port can't be bound.
+bool httpServeBackground(int port, HttpHandler handler);
+
+// Binary-safe counterpart of emit, to the current handler's client
+void httpSend(const void* data, size_t len);
+
+// True once a send to the current handler's client has failed
+bool httpClientGone();
+
+// Value of `name` in a query string ("" if absent); no %-decoding
+std::string httpQueryParam(const std::string& query, const char* name);
@@ -0,0 +1,42 @@
+#!/bin/bash
+# Diffs what the device makes of the feeds in testdata/ against
+# testdata/*.expected. Run from esp32/ after `pio run -e native_icsexpand`:
+#
+#   src/host/icsexpand/check.sh            # exits 1 if any feed differs
+#   src/host/icsexpand/check.sh --update   # rewrite *.expected with
+#                                          # api/scripts/expand-ics.ts (ical.js)
+#
+# The committed *.expected are NOT ical.js output yet: they were written
+# where npm couldn't install ical.js, by a separate Python expander
+# (icalendar + dateutil) following route.ts's rules. Until `--update` has
+# been run and committed, a pass means the device agrees with that
+# expander, not with the API.
+#
+# The window is fixed so the expected output doesn't move with the date.
+
+set -e
+
+WINDOW="--from=2026-09-16 --to=2026-12-16"
+DIR="$(cd "$(dirname "$0")" && pwd)"
+PROGRAM="${PROGRAM:-.pio/build/native_icsexpand/program}"
+
+if [ "$1" = "--update" ]; then
+    for feed in "$DIR"/testdata/*.ics; do
+        (cd "$DIR/../../../../api" && npm run --silent expand:ics -- $WINDOW "$feed") > "${feed%.ics}.expected"
+        echo "wrote ${feed%.ics}.expected"
+    done
+    exit 0
+fi
+
+status=0
+for feed in "$DIR"/testdata/*.ics; do
+    for piece in 1436 7; do
+        if "$PROGRAM" $WINDOW --piece=$piece "$feed" 2> /dev/null | diff -u "${feed%.ics}.expected" - ; then
+            echo "ok      $(basename "$feed") (pieces of $piece bytes)"
+        else
+            echo "FAILED  $(basename "$feed") (pieces of $piece bytes)"
+            status=1
+        fi
+    done
+done
+exit $status
@@ -0,0 +1,110 @@
+/*
+ * Prints the events the display makes of ICS feeds (ics.h, rrule.h) for a
+ * window, one per line, in the form api/scripts/expand-ics.ts prints what
+ * route.ts makes of them, so the two can be diffed feed by feed:
+ *
+ *   pio run -e native_icsexpand
+ *   .pio/build/native_icsexpand/program [options] feed.ics...
+ *   cd ../api && npm run expand:ics -- [options] feed.ics...
+ *
+ *   --from=YYYY-MM-DD   window start, midnight UTC (default: today - 30 days)
+ *   --to=YYYY-MM-DD     window end, midnight UTC (default: from + 91 days)
+ *   --piece=N           feed the parser N bytes at a time (default 1436)
+ *
+ * Lines are "start end allDay title" with UTC times as the API sends them,
+ * sorted, so a diff shows exactly which instances differ. Runs with TZ=UTC:
+ * the device's times then are the API's. Both tools take the same options
+ * (expand-ics.ts ignores --piece); check.sh diffs this one against the
+ * API's output for the feeds in testdata/.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "../../ics.h"
+
+static bool parseDay(const char* s, time_t& out) {
+  struct tm t = {0};
+  if (sscanf(s, "%d-%d-%d", &t.tm_year, &t.tm_mon, &t.tm_mday) != 3) return false;
+  t.tm_year -= 1900;
+  t.tm_mon -= 1;
+  out = mktime(&t);
+  return true;
+}
+
+static std::string isoTime(time_t t) {
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  char buf[24];
+  strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+  return buf;
+}
+
+int main(int argc, char** argv) {
+  setenv("TZ", "UTC", 1);
+  tzset();
+  time_t from = time(NULL) / 86400 * 86400 - 30 * 86400;
+  time_t to = 0;
+  size_t piece = 1436;
+  std::vector<const char*> paths;
+  for (int i = 1; i < argc; i++) {
+    const char* value = strchr(argv[i], '=');
+    if (!strncmp(argv[i], "--from=", 7)) {
+      if (!parseDay(value + 1, from)) {
+        fprintf(stderr, "bad date %s\n", value + 1);
+        return 2;
+      }
+    } else if (!strncmp(argv[i], "--to=", 5)) {
+      if (!parseDay(value + 1, to)) {
+        fprintf(stderr, "bad date %s\n", value + 1);
+        return 2;
+      }
+    } else if (!strncmp(argv[i], "--piece=", 8)) {
+      piece = strtoul(value + 1, NULL, 10);
+      if (!piece) piece = 1;
+    } else if (argv[i][0] == '-') {
+      fprintf(stderr, "usage: %s [--from=YYYY-MM-DD] [--to=YYYY-MM-DD] [--piece=N] feed.ics...\n", argv[0]);
+      return 2;
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+  if (!to) to = from + 91 * 86400;
+  if (paths.empty()) {
+    fprintf(stderr, "no feed given\n");
+    return 2;
+  }
+
+  static IcsParser parser;
+  std::vector<CalEvent> events;
+  std::vector<char> buf(piece);
+  for (const char* path : paths) {
+    FILE* in = fopen(path, "rb");
+    if (!in) {
+      perror(path);
+      return 1;
+    }
+    IcsCollector collector;
+    icsBegin(parser, from, to);
+    icsCollectBegin(collector, parser, 0, events);
+    size_t n;
+    while ((n = fread(buf.data(), 1, piece, in)) > 0) icsFeed(parser, buf.data(), n, icsCollect, &collector);
+    icsEnd(parser, icsCollect, &collector);
+    icsCollectEnd(collector);
+    fclose(in);
+    fprintf(stderr, "%s: %lu bytes, %lu VEVENTs, %lu series, %lu shown once\n", path, (unsigned long)parser.bytes,
+            (unsigned long)parser.vevents, (unsigned long)collector.series, (unsigned long)collector.unsupported);
+  }
+
+  std::vector<std::string> lines;
+  for (const CalEvent& e : events) {
+    lines.push_back(isoTime(e.start) + " " + isoTime(e.end) + " " + (e.allDay ? "1" : "0") + " " + e.title.c_str());
+  }
+  std::sort(lines.begin(), lines.end());
+  for (const std::string& line : lines) puts(line.c_str());
+  return 0;
+}
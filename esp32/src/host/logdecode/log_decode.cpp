@@ -0,0 +1,105 @@
+/*
+ * Turns a binlog hex dump (serial 'x' or http://<display-ip>:9100/log.hex)
+ * back into text, using the message table this build was compiled with.
+ *
+ *   pio run -e native_logdecode
+ *   .pio/build/native_logdecode/program dump.txt [--level debug|info|warn|error] [--force]
+ *
+ * Reads stdin when no file is given. Lines that aren't part of the dump
+ * (other serial output) are skipped. A dump from firmware with a different
+ * log_messages.h is refused unless --force is given, since message ids
+ * would map to the wrong formats.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../../binlog.h"
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+static bool parseSlot(const char* line, LogSlot& slot) {
+  uint8_t* b = (uint8_t*)&slot;
+  for (size_t i = 0; i < sizeof(slot); i++) {
+    int hi = hexValue(line[2 * i]);
+    int lo = hi < 0 ? -1 : hexValue(line[2 * i + 1]);
+    if (lo < 0) return false;
+    b[i] = hi << 4 | lo;
+  }
+  char after = line[2 * sizeof(slot)];
+  return after == 0 || after == '\n' || after == '\r';
+}
+
+int main(int argc, char** argv) {
+  const char* path = NULL;
+  LogLevel minLevel = LOG_DEBUG;
+  bool force = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--level") && i + 1 < argc) {
+      const char* l = argv[++i];
+      if (!strcmp(l, "debug")) minLevel = LOG_DEBUG;
+      else if (!strcmp(l, "info")) minLevel = LOG_INFO;
+      else if (!strcmp(l, "warn")) minLevel = LOG_WARN;
+      else if (!strcmp(l, "error")) minLevel = LOG_ERROR;
+      else {
+        fprintf(stderr, "unknown level %s\n", l);
+        return 2;
+      }
+    } else if (!strcmp(argv[i], "--force")) {
+      force = true;
+    } else if (!path) {
+      path = argv[i];
+    } else {
+      fprintf(stderr, "usage: %s [dump.txt] [--level debug|info|warn|error] [--force]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  FILE* in = path ? fopen(path, "r") : stdin;
+  if (!in) {
+    perror(path);
+    return 1;
+  }
+
+  char line[512];
+  char text[LOG_LINE_MAX];
+  bool header = false;
+  unsigned long records = 0;
+  while (fgets(line, sizeof(line), in)) {
+    unsigned slotSize;
+    unsigned long table;
+    if (sscanf(line, "# calendar log v1 slot=%u table=%lx", &slotSize, &table) == 2) {
+      if (slotSize != sizeof(LogSlot)) {
+        fprintf(stderr, "dump has %u-byte slots, this decoder %zu\n", slotSize, sizeof(LogSlot));
+        return 1;
+      }
+      if (table != logTableHash()) {
+        fprintf(stderr, "dump was written with a different log_messages.h (table %08lx, ours %08lx)\n",
+                table, (unsigned long)logTableHash());
+        if (!force) return 1;
+      }
+      header = true;
+      continue;
+    }
+
+    LogSlot slot;
+    if (!header || !parseSlot(line, slot)) continue;
+    records++;
+    if (logLevel((LogMsg)slot.msg) < minLevel) continue;
+    logFormat(slot, text, sizeof(text));
+    fputs(text, stdout);
+  }
+  if (path) fclose(in);
+
+  if (!header) {
+    fprintf(stderr, "no log dump found\n");
+    return 1;
+  }
+  fprintf(stderr, "%lu records\n", records);
+  return 0;
+}
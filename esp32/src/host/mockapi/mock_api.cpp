@@ -0,0 +1,368 @@
+/*
+ * Local stand-in for the Vercel /api/calendar route, for load and fault
+ * testing without real calendars. Speaks the same contract as route.ts:
+ * GET /api/calendar?from=ISO&to=ISO with x-api-key, answering
+ * {calendars, events, fetchedAt, version} with synthetic events in the
+ * window (the trimmed form for profile=device, weekly series once each with
+ * series=1), an ETag "<version>.<window>" and 304 to a matching
+ * If-None-Match; GET /api/calendar?watch=1 streams version events
+ * (esp32/src/watch.h). GET /mock/change changes the data (one event title)
+ * and answers with the new version, for host/watchsim. GET /mock/feed.ics
+ * serves the default window as one ICS feed, for ICS_FEEDS (esp32/src/ics.h);
+ * it needs no key and gets the same faults.
+ *
+ *   pio run -e native_mockapi
+ *   .pio/build/native_mockapi/program [options]
+ *
+ *   --port N            listen port (default 3001)
+ *   --key SECRET        required x-api-key (default $API_SECRET, none if unset)
+ *   --events N          events per window (default 300)
+ *   --overlap N         mean concurrent events (default 2)
+ *   --recur PCT         share of weekly series events (default 30)
+ *   --latency MS        delay before the response
+ *   --jitter MS         extra random delay, 0..MS
+ *   --trickle BPS       send the body at BPS bytes per second
+ *   --truncate PCT      close PCT% of responses part-way through the body
+ *   --burst N/M         fail M of every N requests with 5xx (500, 502, 503 in turn)
+ *   --oversize BYTES    pad bodies to at least BYTES with event descriptions
+ *   --watch-max SECS    end change streams after SECS like a serverless time
+ *                       limit (default 300); 0 answers watch=1 with events
+ *                       like an API without change streams
+ *
+ * Responses carry a Server-Timing header like route.ts: the injected delay
+ * as "upstream", generating the window as "expand", and "total".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include "../http_server.h"
+#include "../synth.h"
+
+#define DEFAULT_PORT 3001
+#define MAX_DAYS 400
+#define TRICKLE_TICK_MS 100
+#define WATCH_PING_SECS 15
+
+static const char* apiKey = NULL;
+static SynthParams base = {300, 2, 30, 0, 0, 0};
+static int latencyMs = 0;
+static int jitterMs = 0;
+static int trickleBps = 0;
+static int truncatePct = 0;
+static int burstEvery = 0;
+static int burstFail = 0;
+static int oversizeBytes = 0;
+static int watchMaxSecs = 300;
+
+static std::atomic<uint32_t> requestCount(0);
+
+// Data version, bumped by /mock/change; change streams wait on `changed`
+static std::mutex versionMutex;
+static std::condition_variable changed;
+static uint32_t version = 1;
+
+// Last generated window; firmware asks for the same one until the day changes
+static std::mutex cacheMutex;
+static time_t cachedStart = 0;
+static int cachedDays = 0;
+static uint32_t cachedVersion = 0;
+static std::string cachedBody;
+static std::string cachedDeviceBody;
+static std::string cachedSeriesBody;
+static size_t cachedEvents = 0;
+
+static double elapsedMs(const struct timespec& since) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - since.tv_sec) * 1e3 + (now.tv_nsec - since.tv_nsec) / 1e6;
+}
+
+static void sleepMs(int ms) {
+  if (ms > 0) usleep(ms * 1000);
+}
+
+static std::string percentDecode(const std::string& s) {
+  std::string out;
+  for (size_t i = 0; i < s.size(); i++) {
+    if (s[i] == '%' && i + 2 < s.size()) {
+      out += (char)strtol(s.substr(i + 1, 2).c_str(), NULL, 16);
+      i += 2;
+    } else {
+      out += s[i];
+    }
+  }
+  return out;
+}
+
+// "YYYY-MM-DDTHH:MM:SS[.sss][Z]" as UTC, like new Date() in route.ts
+static bool parseUtc(const std::string& s, time_t& out) {
+  struct tm t = {0};
+  if (!strptime(s.c_str(), "%Y-%m-%dT%H:%M:%S", &t)) return false;
+  out = timegm(&t);
+  return true;
+}
+
+static uint32_t currentVersion() {
+  std::lock_guard<std::mutex> lock(versionMutex);
+  return version;
+}
+
+static int windowDays(time_t from, time_t to) {
+  int days = (int)((to - from + 86399) / 86400);
+  if (days < 1) days = 1;
+  if (days > MAX_DAYS) days = MAX_DAYS;
+  return days;
+}
+
+// Every change renames the first event; the version rides along
+static void markVersion(std::string& json, const char* titleKey, uint32_t v) {
+  char mark[32];
+  size_t title = json.find(titleKey);
+  if (v > 1 && title != std::string::npos) {
+    snprintf(mark, sizeof(mark), "[v%u] ", v);
+    json.insert(title + strlen(titleKey), mark);
+  }
+  snprintf(mark, sizeof(mark), "\"version\":\"v%u\",", v);
+  json.insert(1, mark);
+}
+
+static void body(time_t from, time_t to, uint32_t v, bool device, bool series, std::string& out, size_t& events) {
+  int days = windowDays(from, to);
+
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  if (cachedStart != from || cachedDays != days || cachedVersion != v) {
+    SynthParams p = base;
+    p.windowStart = from;
+    p.days = days;
+    SynthCalendar cal;
+    synthGenerate(p, cal);
+    if (oversizeBytes > (int)cal.json.size() && !cal.events.empty()) {
+      p.descriptionBytes = (oversizeBytes - cal.json.size()) / cal.events.size() + 1;
+      synthGenerate(p, cal);
+    }
+    markVersion(cal.json, "\"title\":\"", v);
+    markVersion(cal.deviceJson, "\"t\":\"", v);
+    markVersion(cal.seriesJson, "\"t\":\"", v);
+    cachedStart = from;
+    cachedDays = days;
+    cachedVersion = v;
+    cachedBody.swap(cal.json);
+    cachedDeviceBody.swap(cal.deviceJson);
+    cachedSeriesBody.swap(cal.seriesJson);
+    cachedEvents = cal.events.size();
+  }
+  out = series ? cachedSeriesBody : device ? cachedDeviceBody : cachedBody;
+  events = cachedEvents;
+}
+
+static void sendBody(const std::string& data, size_t len, void (*emit)(const char*)) {
+  size_t chunk = trickleBps ? (trickleBps * TRICKLE_TICK_MS / 1000 > 0 ? trickleBps * TRICKLE_TICK_MS / 1000 : 1) : 16384;
+  std::string piece;
+  for (size_t pos = 0; pos < len && !httpClientGone(); pos += chunk) {
+    piece.assign(data, pos, chunk < len - pos ? chunk : len - pos);
+    emit(piece.c_str());
+    if (trickleBps) sleepMs(TRICKLE_TICK_MS);
+  }
+}
+
+// Server-Sent Events: the version now and after every change, pings in
+// between, until the client goes or watchMaxSecs is up
+static void serveWatch(uint32_t n, void (*emit)(const char*)) {
+  emit("HTTP/1.0 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\nConnection: close\r\n\r\n");
+  printf("[mockapi] #%u watch\n", n);
+  fflush(stdout);
+
+  time_t until = time(NULL) + watchMaxSecs;
+  uint32_t sent = 0;
+  char line[64];
+  while (!httpClientGone() && time(NULL) < until) {
+    uint32_t v;
+    {
+      std::unique_lock<std::mutex> lock(versionMutex);
+      changed.wait_for(lock, std::chrono::seconds(WATCH_PING_SECS), [&] { return version != sent; });
+      v = version;
+    }
+    if (v != sent) {
+      snprintf(line, sizeof(line), "event: version\ndata: v%u\n\n", v);
+      sent = v;
+    } else {
+      snprintf(line, sizeof(line), ": ping\n\n");
+    }
+    emit(line);
+  }
+  printf("[mockapi] #%u watch ended%s\n", n, httpClientGone() ? " (client gone)" : "");
+  fflush(stdout);
+}
+
+static void handleHttp(const HttpRequest& req, void (*emit)(const char*)) {
+  static thread_local std::mt19937 rng(std::random_device{}());
+  uint32_t n = requestCount++;
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  bool feed = req.path == "/mock/feed.ics";
+  if (req.path != "/api/calendar" && req.path != "/mock/change" && !feed) {
+    emit("HTTP/1.0 404 Not Found\r\nConnection: close\r\n\r\n");
+    return;
+  }
+  if (apiKey && req.apiKey != apiKey && !feed) {
+    printf("[mockapi] #%u 401\n", n);
+    emit("HTTP/1.0 401 Unauthorized\r\nContent-Type: application/json\r\nConnection: close\r\n\r\n{\"error\":\"Unauthorized\"}");
+    return;
+  }
+
+  if (req.path == "/mock/change") {
+    uint32_t v;
+    {
+      std::lock_guard<std::mutex> lock(versionMutex);
+      v = ++version;
+    }
+    changed.notify_all();
+    char text[96];
+    snprintf(text, sizeof(text), "HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\nConnection: close\r\n\r\nv%u\n", v);
+    emit(text);
+    printf("[mockapi] #%u change to v%u\n", n, v);
+    fflush(stdout);
+    return;
+  }
+
+  sleepMs(latencyMs + (jitterMs ? (int)(rng() % (jitterMs + 1)) : 0));
+  double upstreamMs = elapsedMs(start);
+
+  if (burstEvery && (int)(n % burstEvery) < burstFail) {
+    static const char* statuses[] = {"500 Internal Server Error", "502 Bad Gateway", "503 Service Unavailable"};
+    const char* status = statuses[n % 3];
+    char head[160];
+    snprintf(head, sizeof(head), "HTTP/1.0 %s\r\nContent-Type: application/json\r\nConnection: close\r\n\r\n", status);
+    emit(head);
+    emit("{\"error\":\"Failed to fetch calendars\"}");
+    printf("[mockapi] #%u %.3s (burst)\n", n, status);
+    return;
+  }
+
+  if (watchMaxSecs > 0 && !httpQueryParam(req.query, "watch").empty()) {
+    serveWatch(n, emit);
+    return;
+  }
+
+  // Same defaults as route.ts: now - 30 days .. now + 180 days
+  time_t now = time(NULL);
+  time_t from = now - 30 * 86400, to = now + 180 * 86400;
+  std::string fromArg = percentDecode(httpQueryParam(req.query, "from"));
+  std::string toArg = percentDecode(httpQueryParam(req.query, "to"));
+  if (!fromArg.empty()) parseUtc(fromArg, from);
+  if (!toArg.empty()) parseUtc(toArg, to);
+
+  if (feed) {
+    SynthParams p = base;
+    p.windowStart = from;
+    p.days = windowDays(from, to);
+    p.descriptionBytes = oversizeBytes / (p.events > 0 ? p.events : 1);
+    SynthCalendar cal;
+    synthGenerate(p, cal);
+    size_t len = cal.ics.size();
+    bool truncated = truncatePct && (int)(rng() % 100) < truncatePct;
+    if (truncated) len = rng() % cal.ics.size();
+    char head[160];
+    snprintf(head, sizeof(head), "HTTP/1.0 200 OK\r\nContent-Type: text/calendar; charset=UTF-8\r\n"
+             "Content-Length: %zu\r\nConnection: close\r\n\r\n", cal.ics.size());
+    emit(head);
+    sendBody(cal.ics, len, emit);
+    printf("[mockapi] #%u 200 feed.ics events=%zu bytes=%zu%s%s\n", n, cal.events.size(), cal.ics.size(),
+           truncated ? " truncated" : "", httpClientGone() ? " client-gone" : "");
+    fflush(stdout);
+    return;
+  }
+
+  std::string profile = httpQueryParam(req.query, "profile");
+  if (!profile.empty() && profile != "device") {
+    emit("HTTP/1.0 400 Bad Request\r\nContent-Type: application/json\r\nConnection: close\r\n\r\n{\"error\":\"Unknown profile\"}");
+    return;
+  }
+  bool device = !profile.empty();
+  bool series = httpQueryParam(req.query, "series") == "1";
+  if (series && !device) {
+    emit("HTTP/1.0 400 Bad Request\r\nContent-Type: application/json\r\nConnection: close\r\n\r\n"
+         "{\"error\":\"series=1 needs profile=device\"}");
+    return;
+  }
+
+  // Same window, form and version, same body: no need to generate it
+  uint32_t v = currentVersion();
+  char etag[64];
+  snprintf(etag, sizeof(etag), "v%u.%lx-%d%s", v, (unsigned long)from, windowDays(from, to),
+           series ? "-s" : device ? "-d" : "");
+  if (req.ifNoneMatch == etag) {
+    char head[256];
+    snprintf(head, sizeof(head),
+             "HTTP/1.0 304 Not Modified\r\nETag: \"%s\"\r\n"
+             "Server-Timing: upstream;dur=%.1f, total;dur=%.1f\r\nConnection: close\r\n\r\n",
+             etag, upstreamMs, elapsedMs(start));
+    emit(head);
+    printf("[mockapi] #%u 304 %s\n", n, etag);
+    fflush(stdout);
+    return;
+  }
+
+  std::string json;
+  size_t events;
+  struct timespec expandStart;
+  clock_gettime(CLOCK_MONOTONIC, &expandStart);
+  body(from, to, v, device, series, json, events);
+  double expandMs = elapsedMs(expandStart);
+
+  size_t len = json.size();
+  bool truncated = truncatePct && (int)(rng() % 100) < truncatePct;
+  if (truncated) len = rng() % json.size();
+
+  char head[320];
+  snprintf(head, sizeof(head),
+           "HTTP/1.0 200 OK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\nETag: \"%s\"\r\n"
+           "Server-Timing: upstream;dur=%.1f, expand;dur=%.1f, total;dur=%.1f\r\nConnection: close\r\n\r\n",
+           json.size(), etag, upstreamMs, expandMs, elapsedMs(start));
+  emit(head);
+  sendBody(json, len, emit);
+
+  printf("[mockapi] #%u 200 events=%zu bytes=%zu%s%s\n", n, events, json.size(),
+         truncated ? " truncated" : "", httpClientGone() ? " client-gone" : "");
+  fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+  int port = DEFAULT_PORT;
+  apiKey = getenv("API_SECRET");
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const char* opt = argv[i];
+    const char* v = argv[i + 1];
+    if (!strcmp(opt, "--port")) port = atoi(v);
+    else if (!strcmp(opt, "--key")) apiKey = v;
+    else if (!strcmp(opt, "--events")) base.events = atoi(v);
+    else if (!strcmp(opt, "--overlap")) base.overlap = atoi(v);
+    else if (!strcmp(opt, "--recur")) base.recurPct = atoi(v);
+    else if (!strcmp(opt, "--latency")) latencyMs = atoi(v);
+    else if (!strcmp(opt, "--jitter")) jitterMs = atoi(v);
+    else if (!strcmp(opt, "--trickle")) trickleBps = atoi(v);
+    else if (!strcmp(opt, "--truncate")) truncatePct = atoi(v);
+    else if (!strcmp(opt, "--burst")) sscanf(v, "%d/%d", &burstEvery, &burstFail);
+    else if (!strcmp(opt, "--oversize")) oversizeBytes = atoi(v);
+    else if (!strcmp(opt, "--watch-max")) watchMaxSecs = atoi(v);
+    else {
+      fprintf(stderr, "unknown option %s\n", opt);
+      return 2;
+    }
+  }
+  if (apiKey && !*apiKey) apiKey = NULL;
+
+  if (!httpServeBackground(port, handleHttp)) return 1;
+  printf("calendar API on http://localhost:%d/api/calendar (%d events%s)\n", port, base.events,
+         apiKey ? ", x-api-key required" : "");
+  fflush(stdout);
+  for (;;) sleep(1);
+}
@@ -0,0 +1,57 @@
+// Arduino and libc time stand-ins for the replay build, on the virtual clock
+
+#include <Arduino.h>
+#include <stdarg.h>
+#include "replay.h"
+
+HardwareSerial Serial;
+
+static uint32_t nowMs = 0;
+static uint32_t clockMs = 0;     // Virtual ms at which epoch was known
+static int64_t clockEpoch = 0;
+
+uint32_t replayNowMs() {
+  return nowMs;
+}
+
+void replaySetClock(uint32_t ms, int64_t epochAtMs) {
+  nowMs = ms;
+  clockMs = ms;
+  clockEpoch = epochAtMs;
+}
+
+unsigned long millis() {
+  return nowMs;
+}
+
+unsigned long micros() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+void delay(unsigned long ms) {
+  nowMs += ms;
+}
+
+// Deterministic, unlike the ESP32's hardware RNG
+long random(long lo, long hi) {
+  static uint32_t state = 1;
+  state = state * 1103515245 + 12345;
+  return hi > lo ? lo + (long)((state >> 8) % (uint32_t)(hi - lo)) : lo;
+}
+
+int HardwareSerial::printf(const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vprintf(fmt, ap);
+  va_end(ap);
+  return n;
+}
+
+// Linked with -Wl,--wrap=time: wall clock follows the virtual clock
+extern "C" time_t __wrap_time(time_t* out) {
+  time_t t = (time_t)(clockEpoch + ((int64_t)nowMs - clockMs) / 1000);
+  if (out) *out = t;
+  return t;
+}
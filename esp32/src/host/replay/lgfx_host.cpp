@@ -0,0 +1,147 @@
+#include "../../lgfx_config.h"
+#include "replay.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int LGFX::width() const { return REPLAY_WIDTH; }
+int LGFX::height() const { return REPLAY_HEIGHT; }
+
+bool LGFX::getTouch(uint16_t* x, uint16_t* y) {
+  return replayTouch(x, y);
+}
+
+int LGFX::getTouch(lgfx::touch_point_t* tp, int count) {
+  uint16_t x, y;
+  if (count < 1 || !replayTouch(&x, &y)) return 0;
+  tp[0].x = x;
+  tp[0].y = y;
+  tp[0].size = 1;
+  tp[0].id = 0;
+  return 1;
+}
+
+void LGFX::pixel(int x, int y, uint16_t color) {
+  if (x < 0 || y < 0 || x >= REPLAY_WIDTH || y >= REPLAY_HEIGHT) return;
+  replayFramebuffer()[y * REPLAY_WIDTH + x] = color;
+}
+
+void LGFX::hline(int x0, int x1, int y, uint16_t color) {
+  if (y < 0 || y >= REPLAY_HEIGHT) return;
+  if (x0 > x1) { int t = x0; x0 = x1; x1 = t; }
+  if (x0 < 0) x0 = 0;
+  if (x1 >= REPLAY_WIDTH) x1 = REPLAY_WIDTH - 1;
+  uint16_t* row = replayFramebuffer() + y * REPLAY_WIDTH;
+  for (int x = x0; x <= x1; x++) row[x] = color;
+}
+
+void LGFX::fillScreen(uint16_t color) {
+  fillRect(0, 0, REPLAY_WIDTH, REPLAY_HEIGHT, color);
+}
+
+void LGFX::fillRect(int x, int y, int w, int h, uint16_t color) {
+  if (w <= 0 || h <= 0) return;
+  for (int row = y; row < y + h; row++) hline(x, x + w - 1, row, color);
+}
+
+void LGFX::drawRect(int x, int y, int w, int h, uint16_t color) {
+  if (w <= 0 || h <= 0) return;
+  hline(x, x + w - 1, y, color);
+  hline(x, x + w - 1, y + h - 1, color);
+  for (int row = y; row < y + h; row++) {
+    pixel(x, row, color);
+    pixel(x + w - 1, row, color);
+  }
+}
+
+void LGFX::fillRoundRect(int x, int y, int w, int h, int r, uint16_t color) {
+  if (w <= 0 || h <= 0) return;
+  if (r > w / 2) r = w / 2;
+  if (r > h / 2) r = h / 2;
+  for (int row = 0; row < h; row++) {
+    // Inset of the rounded corner on this row
+    int dy = row < r ? r - row : (row >= h - r ? row - (h - r - 1) : 0);
+    int inset = 0;
+    while (inset < r && (r - inset) * (r - inset) + dy * dy > r * r) inset++;
+    if (!dy) inset = 0;
+    hline(x + inset, x + w - 1 - inset, y + row, color);
+  }
+}
+
+void LGFX::drawRoundRect(int x, int y, int w, int h, int, uint16_t color) {
+  drawRect(x, y, w, h, color);
+}
+
+void LGFX::drawLine(int x0, int y0, int x1, int y1, uint16_t color) {
+  int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+  int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+  int err = dx + dy;
+  for (;;) {
+    pixel(x0, y0, color);
+    if (x0 == x1 && y0 == y1) break;
+    int e2 = 2 * err;
+    if (e2 >= dy) { err += dy; x0 += sx; }
+    if (e2 <= dx) { err += dx; y0 += sy; }
+  }
+}
+
+void LGFX::fillCircle(int cx, int cy, int r, uint16_t color) {
+  for (int dy = -r; dy <= r; dy++) {
+    int dx = 0;
+    while ((dx + 1) * (dx + 1) + dy * dy <= r * r) dx++;
+    hline(cx - dx, cx + dx, cy + dy, color);
+  }
+}
+
+void LGFX::fillTriangle(int x0, int y0, int x1, int y1, int x2, int y2, uint16_t color) {
+  int minY = y0 < y1 ? (y0 < y2 ? y0 : y2) : (y1 < y2 ? y1 : y2);
+  int maxY = y0 > y1 ? (y0 > y2 ? y0 : y2) : (y1 > y2 ? y1 : y2);
+  int xs[3][4] = {{x0, y0, x1, y1}, {x1, y1, x2, y2}, {x2, y2, x0, y0}};
+  for (int y = minY; y <= maxY; y++) {
+    int lo = REPLAY_WIDTH, hi = -1;
+    for (auto& e : xs) {
+      int ya = e[1], yb = e[3];
+      if ((y < ya && y < yb) || (y > ya && y > yb)) continue;
+      int x = ya == yb ? e[0] : e[0] + (e[2] - e[0]) * (y - ya) / (yb - ya);
+      if (ya == yb) { if (e[2] < lo) lo = e[2]; if (e[2] > hi) hi = e[2]; }
+      if (x < lo) lo = x;
+      if (x > hi) hi = x;
+    }
+    if (hi >= lo) hline(lo, hi, y, color);
+  }
+}
+
+void LGFX::pushImage(int x, int y, int w, int h, const uint16_t* data) {
+  for (int row = 0; row < h; row++) {
+    for (int col = 0; col < w; col++) pixel(x + col, y + row, data[row * w + col]);
+  }
+}
+
+void LGFX::print(const char* text) {
+  int cw = 6 * textSize, ch = 8 * textSize;
+  for (; *text; text++) {
+    if (*text == '\n') {
+      cursorX = 0;
+      cursorY += ch;
+      continue;
+    }
+    if (*text != ' ') fillRect(cursorX, cursorY, cw - textSize, ch - textSize, textColor);
+    cursorX += cw;
+  }
+}
+
+void LGFX::print(int value) {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%d", value);
+  print(buf);
+}
+
+int LGFX::printf(const char* fmt, ...) {
+  char buf[128];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  print(buf);
+  return n;
+}
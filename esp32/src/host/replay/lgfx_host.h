@@ -0,0 +1,57 @@
+#pragma once
+
+// The subset of LovyanGFX that main.cpp uses, drawing into the replay
+// framebuffer. Shapes are exact; text is drawn as one block per glyph
+// cell (6x8 at size 1), enough to see the layout in frame dumps.
+
+#include <stdint.h>
+#include "../wstring.h"
+
+namespace lgfx {
+struct touch_point_t {
+  int16_t x;
+  int16_t y;
+  uint16_t size;
+  uint16_t id;
+};
+}
+
+class LGFX {
+public:
+  void init() {}
+  void setRotation(int) {}
+  int width() const;
+  int height() const;
+
+  bool getTouch(uint16_t* x, uint16_t* y);
+  int getTouch(lgfx::touch_point_t* tp, int count);   // Recordings hold one point
+
+  void fillScreen(uint16_t color);
+  void fillRect(int x, int y, int w, int h, uint16_t color);
+  void drawRect(int x, int y, int w, int h, uint16_t color);
+  void fillRoundRect(int x, int y, int w, int h, int r, uint16_t color);
+  void drawRoundRect(int x, int y, int w, int h, int r, uint16_t color);
+  void drawLine(int x0, int y0, int x1, int y1, uint16_t color);
+  void fillCircle(int x, int y, int r, uint16_t color);
+  void fillTriangle(int x0, int y0, int x1, int y1, int x2, int y2, uint16_t color);
+  void pushImage(int x, int y, int w, int h, const uint16_t* data);
+
+  void setTextColor(uint16_t fg) { textColor = fg; }
+  void setTextColor(uint16_t fg, uint16_t) { textColor = fg; }
+  void setTextSize(int size) { textSize = size; }
+  void setCursor(int x, int y) { cursorX = x; cursorY = y; }
+
+  void print(const char* text);
+  void print(const String& text) { print(text.c_str()); }
+  void print(int value);
+  int printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+private:
+  void hline(int x0, int x1, int y, uint16_t color);
+  void pixel(int x, int y, uint16_t color);
+
+  uint16_t textColor = 0xFFFF;
+  int textSize = 1;
+  int cursorX = 0;
+  int cursorY = 0;
+};
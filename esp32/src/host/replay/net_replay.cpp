@@ -0,0 +1,184 @@
+// net.h for the replay build: payloads and touches come from the
+// recording as the virtual clock passes their timestamps.
+
+#include "../../net.h"
+#include "../../ingest.h"
+#include "replay.h"
+#include "../http_client.h"
+#include <Arduino.h>
+
+#define TILE_PAGES 3
+#define TILE_TIMEOUT_MS 3000
+
+static const std::vector<RecEntry>* recording = NULL;
+static size_t nextPayload = 0;
+static size_t nextPage = 0;
+static size_t nextTouch = 0;
+static bool touchDown = false;
+static uint16_t touchX = 0, touchY = 0;
+static std::vector<ReplayIngest> ingests;
+static uint16_t framebuffer[REPLAY_WIDTH * REPLAY_HEIGHT];
+
+static const char* tileServer = NULL;
+static bool tilesRequested = false;
+static ViewMode tilesView = VIEW_WEEK;
+static struct tm tilesDate;
+static int tilesWidth = 0, tilesHeight = 0;
+static std::shared_ptr<const TilePage> tileCache[TILE_PAGES];
+static std::vector<std::shared_ptr<const TilePage>> pendingTiles;
+static TileSyncStats tileStats;
+static uint32_t tileSyncs = 0;
+
+void replaySetRecording(const std::vector<RecEntry>* entries) {
+  recording = entries;
+  nextPayload = nextPage = nextTouch = 0;
+}
+
+const std::vector<ReplayIngest>& replayIngests() {
+  return ingests;
+}
+
+uint16_t* replayFramebuffer() {
+  return framebuffer;
+}
+
+// One sample per poll at most, so a quick tap isn't collapsed into
+// "not touching" when several samples fall into the same loop() step
+bool replayTouch(uint16_t* x, uint16_t* y) {
+  while (nextTouch < recording->size() && (*recording)[nextTouch].type != 'T') nextTouch++;
+  if (nextTouch < recording->size() && (*recording)[nextTouch].ms <= replayNowMs()) {
+    const RecEntry& e = (*recording)[nextTouch++];
+    touchDown = e.a != 0;
+    touchX = e.b;
+    touchY = e.c;
+  }
+  *x = touchX;
+  *y = touchY;
+  return touchDown;
+}
+
+void netBegin() {}
+
+NetPhase netPhase() {
+  return NET_IDLE;
+}
+
+const char* netPhaseName() {
+  return "replay";
+}
+
+// Refreshes happen when the recording says they did
+void netRequestRefresh() {}
+
+bool netTimeValid() {
+  return true;
+}
+
+bool netTakeEvents(std::vector<CalEvent>& outEvents, std::vector<CalInfo>& outCals, SeriesSet& outSeries) {
+  const RecEntry* latest = NULL;
+  for (; nextPayload < recording->size() && (*recording)[nextPayload].ms <= replayNowMs(); nextPayload++) {
+    if ((*recording)[nextPayload].type == 'P') latest = &(*recording)[nextPayload];
+  }
+  if (!latest) return false;
+
+  std::vector<CalEvent> events;
+  std::vector<CalInfo> cals;
+  SeriesSet series;
+  const char* error = "";
+  unsigned long start = micros();
+  bool ok = ingestCalendarJson(latest->text.data(), latest->text.size(), events, cals, &error, &series);
+  ReplayIngest r = {latest->ms, false, latest->text.size(), events.size(), (uint32_t)(micros() - start), ok};
+  ingests.push_back(r);
+  if (!ok) {
+    printf("[net] JSON error: %s\n", error);
+    return false;
+  }
+  outEvents.swap(events);
+  outCals.swap(cals);
+  std::swap(outSeries, series);
+  return true;
+}
+
+// Pages arrive when the recording says they did, whichever was asked for
+void netRequestPage(ViewMode, const struct tm&, int, int) {}
+
+bool netTakePage(PageLayout& out) {
+  const RecEntry* latest = NULL;
+  for (; nextPage < recording->size() && (*recording)[nextPage].ms <= replayNowMs(); nextPage++) {
+    if ((*recording)[nextPage].type == 'L') latest = &(*recording)[nextPage];
+  }
+  if (!latest) return false;
+
+  PageLayout page;
+  const char* error = "";
+  unsigned long start = micros();
+  bool ok = ingestLayoutJson(latest->text.data(), latest->text.size(), page, &error);
+  ReplayIngest r = {latest->ms, true, latest->text.size(), page.events.size(), (uint32_t)(micros() - start), ok};
+  ingests.push_back(r);
+  if (!ok) {
+    printf("[net] JSON error: %s\n", error);
+    return false;
+  }
+  std::swap(out, page);
+  return true;
+}
+
+void replaySetTileServer(const char* url) {
+  tileServer = url;
+}
+
+const TileSyncStats& replayTileStats() {
+  return tileStats;
+}
+
+uint32_t replayTileSyncs() {
+  return tileSyncs;
+}
+
+static int tileGet(void*, const char* url, const char* ifNoneMatch, TileData& body) {
+  std::string data;
+  int status = httpGet(url, getenv("API_SECRET"), data, TILE_TIMEOUT_MS, NULL, ifNoneMatch);
+  body.assign(data.begin(), data.end());
+  return status;
+}
+
+void netRequestTiles(ViewMode view, const struct tm& date, int width, int height) {
+  tilesView = view;
+  tilesDate = date;
+  tilesWidth = width;
+  tilesHeight = height;
+  tilesRequested = tileServer != NULL;
+}
+
+// Synced in place of the network task (blocking, off the virtual clock):
+// the page asked for, then the ones either side, as net.cpp does
+bool netTakeTiles(std::shared_ptr<const TilePage>& out) {
+  if (tilesRequested) {
+    tilesRequested = false;
+    std::shared_ptr<const TilePage> known[2 * TILE_PAGES];
+    for (int i = 0; i < TILE_PAGES; i++) known[i] = tileCache[i];
+    static const int order[TILE_PAGES] = {0, 1, -1};
+    for (int i = 0; i < TILE_PAGES; i++) {
+      struct tm date = pageShift(tilesView, tilesDate, order[i]);
+      known[TILE_PAGES + i] = tileSync(tileGet, NULL, tileServer, tilesView, date, tilesWidth, tilesHeight, known,
+                                       2 * TILE_PAGES, tileStats);
+      if (!known[TILE_PAGES + i]) {
+        printf("[net] tiles failed: %d\n", tileStats.status);
+        break;
+      }
+      pendingTiles.push_back(known[TILE_PAGES + i]);
+    }
+    for (int i = 0; i < TILE_PAGES; i++) {
+      if (known[TILE_PAGES + i]) tileCache[i] = known[TILE_PAGES + i];
+    }
+    tileSyncs++;
+  }
+  if (pendingTiles.empty()) return false;
+  out = pendingTiles.front();
+  pendingTiles.erase(pendingTiles.begin());
+  return true;
+}
+
+void bootMark(const char* label) {
+  printf("[boot] +%lu ms %s\n", millis(), label);
+}
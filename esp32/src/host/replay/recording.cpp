@@ -0,0 +1,62 @@
+#include "replay.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+bool replayLoad(const char* path, std::vector<RecEntry>& out) {
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return false;
+  }
+  std::string data;
+  char buf[65536];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.append(buf, n);
+  fclose(f);
+
+  size_t pos = 0;
+  int lineNo = 0;
+  while (pos < data.size()) {
+    size_t eol = data.find('\n', pos);
+    if (eol == std::string::npos) eol = data.size();
+    std::string line = data.substr(pos, eol - pos);
+    pos = eol + 1;
+    lineNo++;
+    if (line.empty() || line[0] == '#') continue;
+
+    RecEntry e;
+    e.type = line[0];
+    e.a = e.b = e.c = e.d = 0;
+    unsigned long ms = 0;
+    long long a = 0, b = 0, c = 0, d = 0;
+    int used = 0;
+    bool ok = false;
+    switch (e.type) {
+      case 'C': {
+        char tz[64] = "";
+        ok = sscanf(line.c_str(), "C %lu %lld %63s", &ms, &a, tz) >= 2;
+        e.text = tz;
+        break;
+      }
+      case 'V': ok = sscanf(line.c_str(), "V %lu %lld %lld %lld %lld", &ms, &a, &b, &c, &d) == 5; break;
+      case 'T': ok = sscanf(line.c_str(), "T %lu %lld %lld %lld", &ms, &a, &b, &c) == 4; break;
+      case 'P':
+      case 'L':
+        ok = sscanf(line.c_str() + 1, " %lu %lld%n", &ms, &a, &used) >= 2 && pos + a <= data.size();
+        if (ok) {
+          e.text = data.substr(pos, a);
+          pos += a + 1;
+        }
+        break;
+    }
+    if (!ok) {
+      fprintf(stderr, "%s:%d: bad record\n", path, lineNo);
+      return false;
+    }
+    e.ms = ms;
+    e.a = a; e.b = b; e.c = c; e.d = d;
+    out.push_back(e);
+  }
+  return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+// State shared by the replay build's stand-ins: the virtual clock, the
+// loaded recording and the framebuffer the host LGFX draws into.
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "../../tiles.h"
+
+struct RecEntry {
+  uint32_t ms;
+  char type;          // 'C', 'V', 'T', 'P' or 'L' (see recorder.h)
+  int64_t a, b, c, d; // Numeric fields in file order
+  std::string text;   // 'C': TZ, 'P' and 'L': body
+};
+
+// Parse a recording. Returns false (with a message on stderr) on errors.
+bool replayLoad(const char* path, std::vector<RecEntry>& out);
+
+// Virtual clock: millis() and time() follow this
+uint32_t replayNowMs();
+void replaySetClock(uint32_t ms, int64_t epochAtMs);
+
+// Recording being replayed (set before setup())
+void replaySetRecording(const std::vector<RecEntry>* entries);
+
+// Touch state at the current virtual time
+bool replayTouch(uint16_t* x, uint16_t* y);
+
+// Payloads ingested so far and time spent in ingest (host clock)
+struct ReplayIngest {
+  uint32_t ms;
+  bool page;          // 'L' record (server-side layout)
+  size_t bytes;
+  size_t events;
+  uint32_t ingestUs;
+  bool ok;
+};
+const std::vector<ReplayIngest>& replayIngests();
+
+// Thin-client frames (--tiles): tiles come from the tile server at `url`
+// instead of the recording, synced when main.cpp asks like the network
+// task does. Totals over all syncs so far.
+void replaySetTileServer(const char* url);
+const TileSyncStats& replayTileStats();
+uint32_t replayTileSyncs();
+
+#define REPLAY_WIDTH 1024
+#define REPLAY_HEIGHT 600
+uint16_t* replayFramebuffer();
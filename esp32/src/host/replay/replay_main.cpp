@@ -0,0 +1,214 @@
+/*
+ * Replays a field recording (recorder.h) through the firmware's own
+ * main.cpp: ingest, layout, render and touch handling, on a virtual clock.
+ *
+ *   pio run -e native_replay
+ *   .pio/build/native_replay/program recording.txt [--csv frames.csv]
+ *       [--frames DIR] [--tail-ms 5000] [--server-layout] [--tiles URL]
+ *
+ * millis(), delay() and time() follow the recording, so timers, gestures
+ * and redraws happen at the same points on every run. Frames still finish
+ * inside one loop() call (the virtual clock doesn't move while drawing).
+ * Reported timings are this machine's: per frame, per payload ingest, and
+ * the profiler's phase table. --server-layout draws from the recording's
+ * ?layout= pages (L records) like the 'm' serial key does on the device,
+ * so the two layout paths can be compared on the same data. --tiles draws
+ * as a thin client from a running tile server (host/tiles/), syncing
+ * tiles over HTTP whenever main.cpp asks for a page; the recording's
+ * touches still navigate, and prefetched neighbours are blitted from cache.
+ *
+ * Exits with 1 when any frame allocated on the heap in its layout or
+ * render phase (the zero budgets setup() sets, alloc_track.h), so a
+ * recording doubles as a regression test: testdata/ has some.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include <Arduino.h>
+#include "replay.h"
+#include "../../layout.h"
+#include "../../metrics.h"
+#include "../../profiler.h"
+#include "../../alloc_track.h"
+
+// main.cpp
+void setup();
+void loop();
+void draw();
+extern ViewMode currentView;
+extern struct tm viewDate;
+extern bool serverLayout;
+extern bool thinClient;
+
+#define STALL_LOOPS 1000   // loop() calls without a delay() before nudging the clock
+
+static const char* viewNames[] = {"day", "week", "month"};
+static const char* layoutNames[] = {"device", "server", "tiles"};
+
+struct FrameRow {
+  uint32_t ms;
+  int view;
+  int source;
+  uint32_t renderUs;
+};
+
+static void emitStdout(const char* text) {
+  fputs(text, stdout);
+}
+
+static void dumpFrame(const char* dir, int index) {
+  char path[512];
+  snprintf(path, sizeof(path), "%s/frame_%05d.ppm", dir, index);
+  FILE* f = fopen(path, "wb");
+  if (!f) {
+    perror(path);
+    return;
+  }
+  fprintf(f, "P6\n%d %d\n255\n", REPLAY_WIDTH, REPLAY_HEIGHT);
+  const uint16_t* fb = replayFramebuffer();
+  for (int i = 0; i < REPLAY_WIDTH * REPLAY_HEIGHT; i++) {
+    uint16_t c = fb[i];
+    uint8_t rgb[3] = {(uint8_t)((c >> 8) & 0xF8), (uint8_t)((c >> 3) & 0xFC), (uint8_t)((c << 3) & 0xF8)};
+    fwrite(rgb, 1, 3, f);
+  }
+  fclose(f);
+}
+
+static uint32_t percentile(std::vector<uint32_t> v, int pct) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  size_t i = (v.size() * pct + 99) / 100;
+  return v[i ? i - 1 : 0];
+}
+
+int main(int argc, char** argv) {
+  const char* path = NULL;
+  const char* csvPath = NULL;
+  const char* framesDir = NULL;
+  uint32_t tailMs = 5000;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--csv") && i + 1 < argc) csvPath = argv[++i];
+    else if (!strcmp(argv[i], "--frames") && i + 1 < argc) framesDir = argv[++i];
+    else if (!strcmp(argv[i], "--tail-ms") && i + 1 < argc) tailMs = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--server-layout")) serverLayout = true;
+    else if (!strcmp(argv[i], "--tiles") && i + 1 < argc) {
+      replaySetTileServer(argv[++i]);
+      thinClient = true;
+    }
+    else if (!path) path = argv[i];
+    else {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 2;
+    }
+  }
+  if (!path) {
+    fprintf(stderr, "usage: %s recording.txt [--csv FILE] [--frames DIR] [--tail-ms N] [--server-layout] [--tiles URL]\n", argv[0]);
+    return 2;
+  }
+
+  std::vector<RecEntry> rec;
+  if (!replayLoad(path, rec)) return 1;
+  const RecEntry* clock = NULL;
+  const RecEntry* view = NULL;
+  for (const RecEntry& e : rec) {
+    if (e.type == 'C' && !clock) clock = &e;
+    if (e.type == 'V' && !view) view = &e;
+  }
+  if (!clock || rec.empty()) {
+    fprintf(stderr, "%s: no clock record\n", path);
+    return 1;
+  }
+
+  setenv("TZ", clock->text.empty() ? "UTC0" : clock->text.c_str(), 1);
+  tzset();
+  replaySetClock(clock->ms, clock->a);
+  replaySetRecording(&rec);
+  uint32_t endMs = rec.back().ms + tailMs;
+
+  setup();
+
+  std::vector<FrameRow> frames;
+  uint32_t lastSeq = metricsLastFrame().seq;
+  bool viewApplied = false;
+  int stalled = 0;
+  while (replayNowMs() <= endMs) {
+    uint32_t before = replayNowMs();
+    loop();
+
+    // Once main.cpp has picked "today", go to the view the recording started on
+    if (!viewApplied && view && replayNowMs() >= view->ms) {
+      viewApplied = true;
+      currentView = (ViewMode)view->a;
+      viewDate.tm_year = view->b - 1900;
+      viewDate.tm_mon = view->c - 1;
+      viewDate.tm_mday = view->d;
+      mktime(&viewDate);
+      draw();
+    }
+
+    FrameSample f = metricsLastFrame();
+    if (f.seq != lastSeq) {
+      lastSeq = f.seq;
+      frames.push_back({replayNowMs(), f.view, f.source, f.renderUs});
+      if (framesDir) dumpFrame(framesDir, frames.size());
+    }
+
+    stalled = replayNowMs() == before ? stalled + 1 : 0;
+    if (stalled >= STALL_LOOPS) {
+      delay(1);
+      stalled = 0;
+    }
+  }
+
+  if (csvPath) {
+    FILE* f = fopen(csvPath, "w");
+    if (!f) {
+      perror(csvPath);
+      return 1;
+    }
+    fprintf(f, "ms,view,layout,render_us\n");
+    for (const FrameRow& r : frames) {
+      fprintf(f, "%lu,%s,%s,%lu\n", (unsigned long)r.ms, viewNames[r.view], layoutNames[r.source],
+              (unsigned long)r.renderUs);
+    }
+    fclose(f);
+  }
+
+  printf("\nreplay: %s, %.1f s virtual\n", path, (endMs - clock->ms) / 1000.0);
+  for (const ReplayIngest& r : replayIngests()) {
+    printf("%-8s +%7.1f s %8zu bytes %6zu events  ingest %6lu us%s\n", r.page ? "page" : "payload",
+           (r.ms - clock->ms) / 1000.0, r.bytes, r.events, (unsigned long)r.ingestUs, r.ok ? "" : "  FAILED");
+  }
+  printf("view     layout frames   p50_us   p90_us   p99_us   max_us\n");
+  for (int l = 0; l < FRAME_SOURCES; l++) {
+    for (int v = 0; v < 3; v++) {
+      std::vector<uint32_t> us;
+      for (const FrameRow& r : frames) if (r.view == v && r.source == l) us.push_back(r.renderUs);
+      if (us.empty()) continue;
+      printf("%-8s %-6s %6zu %8lu %8lu %8lu %8lu\n", viewNames[v], layoutNames[l], us.size(),
+             (unsigned long)percentile(us, 50), (unsigned long)percentile(us, 90),
+             (unsigned long)percentile(us, 99), (unsigned long)percentile(us, 100));
+    }
+  }
+  if (replayTileSyncs()) {
+    const TileSyncStats& t = replayTileStats();
+    printf("tiles: %lu syncs, %u fetched, %u not modified, %u reused, %lu bytes\n", (unsigned long)replayTileSyncs(),
+           t.fetched, t.notModified, t.reused, (unsigned long)t.bytes);
+  }
+  printf("\n");
+  profReport(emitStdout);
+  allocReport(emitStdout);
+#ifndef NO_INSTRUMENTATION
+  uint32_t overLayout = allocBudgetViolations(ALLOC_LAYOUT);
+  uint32_t overRender = allocBudgetViolations(ALLOC_RENDER);
+  if (overLayout || overRender) {
+    printf("\nFAILED: %lu frames allocated in layout, %lu in render (budget 0)\n", (unsigned long)overLayout,
+           (unsigned long)overRender);
+    return 1;
+  }
+#endif
+  return 0;
+}
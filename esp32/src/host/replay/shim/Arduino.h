@@ -0,0 +1,35 @@
+#pragma once
+
+// Arduino API for the replay build (host/replay/). millis() and delay()
+// run on the replay's virtual clock so timers, gestures and render slicing
+// behave the same on every run; micros() is the host's real clock so
+// render timings measure actual work.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include "../../wstring.h"
+
+using std::min;
+using std::max;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+long random(long lo, long hi);
+
+class HardwareSerial {
+public:
+  void begin(unsigned long) {}
+  int available() { return 0; }
+  int read() { return -1; }
+  void print(const char* s) { fputs(s, stdout); }
+  void print(const String& s) { fputs(s.c_str(), stdout); }
+  void println(const char* s) { puts(s); }
+  int printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+extern HardwareSerial Serial;
@@ -0,0 +1,299 @@
+#include "synth.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#define DAY_FIRST_MIN (7 * 60)    // Timed events fall between 07:00 and 18:00
+#define DAY_LAST_MIN (18 * 60)
+#define MIN_DURATION 15
+#define ALL_DAY_PCT 3
+
+static const char* calNames[] = {"Papa", "Mama", "Kinder", "Familie"};
+static const char* calColors[] = {"#3B82F6", "#22C55E", "#EC4899", "#F97316"};
+static const char* titles[] = {
+  "Training", "Zahnarzt", "Elternabend", "Musikschule", "Meeting", "Einkaufen",
+  "Geburtstag", "Schwimmen", "Fussball", "Kita", "Arbeit", "Abendessen mit Freunden"
+};
+static const char* locations[] = {"", "", "Turnhalle", "Praxis Dr. Meier", "Buero", "Zuhause"};
+
+#define COUNT(a) (int)(sizeof(a) / sizeof(a[0]))
+
+// xorshift32, so runs are reproducible across machines
+static uint32_t rngState;
+static uint32_t rnd(uint32_t n) {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return rngState % n;
+}
+
+struct Proto {
+  int day;
+  int startMin;
+  int durationMin;
+  bool allDay;
+  int cal;
+  int title;
+  int location;
+  int series;      // -1 for single events
+};
+
+static Proto makeProto(int day, int meanDuration, int series) {
+  Proto p;
+  p.day = day;
+  p.allDay = series < 0 && (int)rnd(100) < ALL_DAY_PCT;
+  p.durationMin = meanDuration / 2 + rnd(meanDuration + 1);
+  if (p.durationMin < MIN_DURATION) p.durationMin = MIN_DURATION;
+  if (p.durationMin > DAY_LAST_MIN - DAY_FIRST_MIN) p.durationMin = DAY_LAST_MIN - DAY_FIRST_MIN;
+  int latest = DAY_LAST_MIN - p.durationMin;
+  p.startMin = DAY_FIRST_MIN + rnd((latest - DAY_FIRST_MIN) / 15 + 1) * 15;
+  p.cal = rnd(COUNT(calNames));
+  p.title = rnd(COUNT(titles));
+  p.location = rnd(COUNT(locations));
+  p.series = series;
+  return p;
+}
+
+static time_t dayTime(time_t windowStart, int day, int minute) {
+  struct tm t;
+  localtime_r(&windowStart, &t);
+  t.tm_mday += day;
+  t.tm_hour = 0;
+  t.tm_min = minute;
+  t.tm_sec = 0;
+  t.tm_isdst = -1;
+  return mktime(&t);
+}
+
+// Content line folded at 75 octets (RFC 5545 3.1)
+static void icsLine(std::string& out, const char* line) {
+  size_t len = strlen(line);
+  for (size_t i = 0; i < len; i += i ? 74 : 75) {
+    if (i) out += "\r\n ";
+    out.append(line + i, std::min(len - i, i ? (size_t)74 : (size_t)75));
+  }
+  out += "\r\n";
+}
+
+static void icsStamp(time_t t, bool date, char* buf, size_t len) {
+  struct tm tm;
+  if (date) {
+    localtime_r(&t, &tm);
+    strftime(buf, len, ";VALUE=DATE:%Y%m%d", &tm);
+  } else {
+    gmtime_r(&t, &tm);
+    strftime(buf, len, ":%Y%m%dT%H%M%SZ", &tm);
+  }
+}
+
+static const char* icsHeader =
+    "BEGIN:VCALENDAR\r\nPRODID:-//Google Inc//Google Calendar 70.9054//EN\r\nVERSION:2.0\r\n"
+    "CALSCALE:GREGORIAN\r\nMETHOD:PUBLISH\r\nX-WR-CALNAME:Familie\r\nX-WR-TIMEZONE:Europe/Berlin\r\n"
+    "BEGIN:VTIMEZONE\r\nTZID:Europe/Berlin\r\nX-LIC-LOCATION:Europe/Berlin\r\n"
+    "BEGIN:DAYLIGHT\r\nTZOFFSETFROM:+0100\r\nTZOFFSETTO:+0200\r\nTZNAME:CEST\r\n"
+    "DTSTART:19700329T020000\r\nRRULE:FREQ=YEARLY;BYMONTH=3;BYDAY=-1SU\r\nEND:DAYLIGHT\r\n"
+    "BEGIN:STANDARD\r\nTZOFFSETFROM:+0200\r\nTZOFFSETTO:+0100\r\nTZNAME:CET\r\n"
+    "DTSTART:19701025T030000\r\nRRULE:FREQ=YEARLY;BYMONTH=10;BYDAY=-1SU\r\nEND:STANDARD\r\n"
+    "END:VTIMEZONE\r\n";
+
+// One VEVENT as Google writes them; `rrule` may be empty
+static void icsEvent(std::string& out, uint32_t uid, const CalEvent& e, const char* rrule, int descriptionBytes) {
+  char dtstart[40], dtend[40], buf[512];
+  icsStamp(e.start, e.allDay, dtstart, sizeof(dtstart));
+  icsStamp(e.end, e.allDay, dtend, sizeof(dtend));
+  snprintf(buf, sizeof(buf),
+           "BEGIN:VEVENT\r\nDTSTART%s\r\nDTEND%s\r\n%s%s%sDTSTAMP:20250101T000000Z\r\n"
+           "UID:%08x%08x%010u@google.com\r\nCREATED:20241201T120000Z\r\n",
+           dtstart, dtend, *rrule ? "RRULE:" : "", rrule, *rrule ? "\r\n" : "",
+           uid * 2654435761u, uid ^ 0x5bd1e995u, uid);
+  out += buf;
+  if (descriptionBytes > 0) {
+    std::string line = "DESCRIPTION:";
+    for (int i = 0; i < descriptionBytes; i++) line += "Lorem ipsum dolor sit amet "[i % 27];
+    icsLine(out, line.c_str());
+  }
+  snprintf(buf, sizeof(buf), "LAST-MODIFIED:20241201T120000Z\r\nLOCATION:%s\r\nSEQUENCE:0\r\n"
+           "STATUS:CONFIRMED\r\nSUMMARY:%s\r\nTRANSP:OPAQUE\r\nEND:VEVENT\r\n",
+           e.location.c_str(), e.title.c_str());
+  out += buf;
+}
+
+static void iso(time_t t, char* buf, size_t len) {
+  struct tm tm;
+  gmtime_r(&t, &tm);
+  strftime(buf, len, "%Y-%m-%dT%H:%M:%S.000Z", &tm);
+}
+
+void synthGenerate(const SynthParams& params, SynthCalendar& out) {
+  rngState = 0x9E3779B9u ^ (uint32_t)params.events ^ ((uint32_t)params.overlap << 20) ^ ((uint32_t)params.recurPct << 26);
+
+  struct tm first = {0};
+  if (params.windowStart) {
+    localtime_r(&params.windowStart, &first);
+    first.tm_hour = 0; first.tm_min = 0; first.tm_sec = 0;
+  } else {
+    first.tm_year = 2025 - 1900;
+    first.tm_mon = 0;
+    first.tm_mday = 6;   // Monday
+  }
+  first.tm_isdst = -1;
+  out.windowStart = mktime(&first);
+  int days = out.days = params.days > 0 ? params.days : SYNTH_DAYS;
+
+  // Concurrency = events per day * duration / day span
+  int n = params.events;
+  int perDay = n / days > 0 ? n / days : 1;
+  int meanDuration = params.overlap * (DAY_LAST_MIN - DAY_FIRST_MIN) / perDay;
+
+  std::vector<Proto> protos;
+  protos.reserve(n);
+  int recurring = (int)((int64_t)n * params.recurPct / 100);
+  int series = 0;
+  while ((int)protos.size() < recurring) {
+    Proto p = makeProto(rnd(7), meanDuration, series++);
+    for (int day = p.day; day < days && (int)protos.size() < recurring; day += 7) {
+      p.day = day;
+      protos.push_back(p);
+    }
+  }
+  while ((int)protos.size() < n) protos.push_back(makeProto(rnd(days), meanDuration, -1));
+
+  out.events.clear();
+  out.events.reserve(n);
+  out.calendars.clear();
+  for (int c = 0; c < COUNT(calNames); c++) {
+    CalInfo ci;
+    ci.name = calNames[c];
+    ci.color = hexToRGB(calColors[c]);
+    out.calendars.push_back(ci);
+  }
+
+  std::vector<std::pair<time_t, int> > order;
+  order.reserve(n);
+  for (int i = 0; i < n; i++) {
+    const Proto& p = protos[i];
+    time_t start = p.allDay ? dayTime(out.windowStart, p.day, 0) : dayTime(out.windowStart, p.day, p.startMin);
+    order.push_back(std::make_pair(start, i));
+  }
+  std::stable_sort(order.begin(), order.end());
+
+  std::string calendarsJson;
+  for (int c = 0; c < COUNT(calNames); c++) {
+    char buf[96];
+    snprintf(buf, sizeof(buf), "%s{\"name\":\"%s\",\"color\":\"%s\"}", c ? "," : "", calNames[c], calColors[c]);
+    calendarsJson += buf;
+  }
+  out.json.clear();
+  out.json.reserve((size_t)n * 260 + 512);
+  out.json += "{\"calendars\":[" + calendarsJson + "],\"events\":[";
+  out.deviceJson.clear();
+  out.deviceJson.reserve((size_t)n * 100 + 512);
+  out.deviceJson += "{\"profile\":\"device\",\"calendars\":[" + calendarsJson + "],\"events\":[";
+  out.ics.clear();
+  out.ics.reserve((size_t)n * (420 + params.descriptionBytes * 77 / 74) + 1024);
+  out.ics += icsHeader;
+
+  for (int k = 0; k < n; k++) {
+    const Proto& p = protos[order[k].second];
+    CalEvent e;
+    e.title = titles[p.title];
+    e.start = order[k].first;
+    e.end = p.allDay ? dayTime(out.windowStart, p.day + 1, 0) : e.start + p.durationMin * 60;
+    e.color = hexToRGB(calColors[p.cal]);
+    e.location = locations[p.location];
+    e.allDay = p.allDay;
+    out.events.push_back(e);
+
+    // route.ts ids are "<calendar>-<UID>-<start ms>", UIDs like Google's
+    char start[32], end[32], buf[512];
+    iso(e.start, start, sizeof(start));
+    iso(e.end, end, sizeof(end));
+    uint32_t uid = p.series >= 0 ? p.series : n + order[k].second;
+    int len = snprintf(buf, sizeof(buf),
+                       "%s{\"id\":\"%s-%08x%08x%010u@google.com-%ld000\",\"title\":\"%s\",\"start\":\"%s\","
+                       "\"end\":\"%s\",\"allDay\":%s,\"calendar\":\"%s\",\"color\":\"%s\"",
+                       k ? "," : "", calNames[p.cal], uid * 2654435761u, uid ^ 0x5bd1e995u, uid, (long)e.start,
+                       titles[p.title], start, end, p.allDay ? "true" : "false", calNames[p.cal], calColors[p.cal]);
+    if (*locations[p.location]) {
+      len += snprintf(buf + len, sizeof(buf) - len, ",\"location\":\"%s\"", locations[p.location]);
+    }
+    out.json += buf;
+    if (params.descriptionBytes > 0) {
+      out.json += ",\"description\":\"";
+      for (int i = 0; i < params.descriptionBytes; i++) out.json += "Lorem ipsum dolor sit amet "[i % 27];
+      out.json += "\"";
+    }
+    out.json += "}";
+
+    // lib/fields.ts: times to the second, defaults left out
+    len = snprintf(buf, sizeof(buf), "%s{\"t\":\"%s\",\"s\":\"%.19s\",\"e\":\"%.19s\",\"c\":%d", k ? "," : "",
+                   titles[p.title], start, end, p.cal);
+    if (*locations[p.location]) len += snprintf(buf + len, sizeof(buf) - len, ",\"l\":\"%s\"", locations[p.location]);
+    if (p.allDay) len += snprintf(buf + len, sizeof(buf) - len, ",\"a\":1");
+    out.deviceJson += buf;
+    out.deviceJson += "}";
+
+    // Series occurrences go out as single events, so every one needs its own UID
+    icsEvent(out.ics, n + order[k].second, e, "", params.descriptionBytes);
+  }
+  out.ics += "END:VCALENDAR\r\n";
+
+  // &series=1: the single events as above, each series as its first
+  // occurrence and a COUNT (protos of one series are consecutive)
+  out.seriesJson.clear();
+  out.seriesJson.reserve((size_t)(n - recurring) * 100 + (size_t)series * 120 + 512);
+  out.seriesJson += "{\"profile\":\"device\",\"calendars\":[" + calendarsJson + "],\"events\":[";
+  out.icsSeries.clear();
+  out.icsSeries.reserve((size_t)(n - recurring + series) * (420 + params.descriptionBytes * 77 / 74) + 1024);
+  out.icsSeries += icsHeader;
+  bool firstEvent = true;
+  for (int k = 0; k < n; k++) {
+    const Proto& p = protos[order[k].second];
+    if (p.series >= 0) continue;
+    const CalEvent& e = out.events[k];
+    icsEvent(out.icsSeries, n + order[k].second, e, "", params.descriptionBytes);
+    char start[32], end[32], buf[256];
+    iso(e.start, start, sizeof(start));
+    iso(e.end, end, sizeof(end));
+    int len = snprintf(buf, sizeof(buf), "%s{\"t\":\"%s\",\"s\":\"%.19s\",\"e\":\"%.19s\",\"c\":%d",
+                       firstEvent ? "" : ",", titles[p.title], start, end, p.cal);
+    if (*locations[p.location]) len += snprintf(buf + len, sizeof(buf) - len, ",\"l\":\"%s\"", locations[p.location]);
+    if (p.allDay) len += snprintf(buf + len, sizeof(buf) - len, ",\"a\":1");
+    out.seriesJson += buf;
+    out.seriesJson += "}";
+    firstEvent = false;
+  }
+  out.seriesJson += "],\"zones\":[],\"series\":[";
+  for (int i = 0; i < recurring;) {
+    const Proto& p = protos[i];
+    bool firstSeries = !i;
+    int count = 0;
+    while (i < recurring && protos[i].series == p.series) {
+      i++;
+      count++;
+    }
+    char start[32], buf[256];
+    iso(dayTime(out.windowStart, p.day, p.startMin), start, sizeof(start));
+    int len = snprintf(buf, sizeof(buf), "%s{\"t\":\"%s\",\"s\":\"%.19s\",\"d\":%d,\"r\":\"FREQ=WEEKLY;COUNT=%d\",\"c\":%d",
+                       firstSeries ? "" : ",", titles[p.title], start, p.durationMin * 60, count, p.cal);
+    if (*locations[p.location]) len += snprintf(buf + len, sizeof(buf) - len, ",\"l\":\"%s\"", locations[p.location]);
+    out.seriesJson += buf;
+    out.seriesJson += "}";
+
+    CalEvent e;
+    e.title = titles[p.title];
+    e.start = p.allDay ? dayTime(out.windowStart, p.day, 0) : dayTime(out.windowStart, p.day, p.startMin);
+    e.end = p.allDay ? dayTime(out.windowStart, p.day + 1, 0) : e.start + p.durationMin * 60;
+    e.location = locations[p.location];
+    e.allDay = p.allDay;
+    snprintf(buf, sizeof(buf), "FREQ=WEEKLY;COUNT=%d", count);
+    icsEvent(out.icsSeries, p.series, e, buf, params.descriptionBytes);
+  }
+  out.icsSeries += "END:VCALENDAR\r\n";
+  char window[32], windowEnd[32];
+  iso(out.windowStart, window, sizeof(window));
+  iso(dayTime(out.windowStart, days, 0), windowEnd, sizeof(windowEnd));
+  out.seriesJson += "],\"from\":\"" + std::string(window, 19) + "\",\"to\":\"" + std::string(windowEnd, 19) + "\"}";
+  out.json += "],\"fetchedAt\":\"2025-01-06T00:00:00.000Z\"}";
+  out.deviceJson += "]}";
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+// Deterministic synthetic calendars for the benchmarks and the local API
+// server, in the ingested form, as /api/calendar response bodies and as an
+// ICS feed.
+
+#include <string>
+#include <vector>
+#include "../calendar.h"
+
+#define SYNTH_DAYS 91   // Same span the firmware fetches (-1 .. +2 months)
+
+struct SynthParams {
+  int events;           // Total events in the window
+  int overlap;          // Mean number of events running at once during the day
+                        // (approximate: durations are kept within 15 min .. 11 h)
+  int recurPct;         // Share of events that are weekly series occurrences
+  time_t windowStart;   // 0 = Monday 2025-01-06; rounded down to local midnight
+  int days;             // 0 = SYNTH_DAYS
+  int descriptionBytes; // Adds a "description" of this length to every event
+};
+
+struct SynthCalendar {
+  std::vector<CalEvent> events;    // Sorted by start, like the API returns them
+  std::vector<CalInfo> calendars;
+  std::string json;
+  std::string deviceJson;          // The same as ?profile=device
+  std::string seriesJson;          // ... with &series=1: weekly series once each, in UTC
+  std::string ics;                 // The same events as one ICS feed, laid out like Google's
+  std::string icsSeries;           // ... with weekly series as one recurring VEVENT each, in UTC
+  time_t windowStart;              // Local midnight of the first day
+  int days;
+};
+
+void synthGenerate(const SynthParams& p, SynthCalendar& out);
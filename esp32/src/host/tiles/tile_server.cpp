@@ -0,0 +1,393 @@
+/*
+ * Tile server for thin-client displays (tiles.h). Renders pages with the
+ * firmware's own main.cpp into a framebuffer, cuts them into RLE tiles and
+ * serves them with per-tile ETags, so a display only fetches and blits
+ * what changed.
+ *
+ *   pio run -e native_tiles
+ *   .pio/build/native_tiles/program [options]
+ *
+ *   --port N        listen port (default 3002)
+ *   --api URL       calendar API to render from (default the local API,
+ *                   http://localhost:3001/api/calendar)
+ *   --key SECRET    x-api-key for the API, and required from displays
+ *                   (default $API_SECRET, none if unset)
+ *   --refresh SECS  how often events are fetched again (default 300)
+ *   --tz TZ         POSIX TZ the pages are drawn in; must match the
+ *                   displays' (default $TZ, else UTC0)
+ *
+ * Events are fetched like the firmware does (one month back, two ahead).
+ * Rendered pages are kept until new events arrive or RENDER_TTL_SECS pass,
+ * so a manifest and the tile requests that follow it see the same render.
+ * Text is drawn by the host LGFX (host/replay/lgfx_host.h), one block per
+ * glyph.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Arduino.h>
+#include "../replay/replay.h"
+#include "../http_client.h"
+#include "../http_server.h"
+#include "../../net.h"
+#include "../../ingest.h"
+#include "../../metrics.h"
+#include "../../binlog.h"
+#include "../../tiles.h"
+
+// main.cpp
+void setup();
+void loop();
+void draw();
+extern ViewMode currentView;
+extern struct tm viewDate;
+extern LogLevel logTailLevel;
+
+extern "C" time_t __real_time(time_t* out);
+
+#define DEFAULT_PORT 3002
+#define RENDER_TTL_SECS 60
+#define RENDER_CACHE 16
+#define MAX_RENDER_LOOPS 100
+#define FETCH_TIMEOUT_MS 15000
+
+static const char* viewNames[] = {"day", "week", "month"};
+
+static const char* apiUrl = "http://localhost:3001/api/calendar";
+static const char* apiKey = NULL;
+static int refreshSecs = 300;
+
+// Newest events from the API, taken by main.cpp through netTakeEvents()
+static std::mutex dataMutex;
+static std::vector<CalEvent> pendingEvents;
+static std::vector<CalInfo> pendingCals;
+static bool pendingReady = false;
+static uint32_t generation = 0;   // Bumped per successful fetch
+
+static uint16_t framebuffer[REPLAY_WIDTH * REPLAY_HEIGHT];
+
+struct Rendered {
+  ViewMode view;
+  time_t start;
+  uint32_t generation;
+  time_t renderedAt;
+  double renderMs;
+  std::vector<std::string> tiles;
+  std::vector<uint32_t> hashes;
+};
+
+// main.cpp's globals and the framebuffer belong to whoever holds this
+static std::mutex renderMutex;
+static std::vector<Rendered> renders;
+static uint32_t requestCount = 0;
+
+// ---- Stand-ins for the firmware's network task and touch panel ----
+
+uint16_t* replayFramebuffer() {
+  return framebuffer;
+}
+
+bool replayTouch(uint16_t*, uint16_t*) {
+  return false;
+}
+
+void netBegin() {}
+
+NetPhase netPhase() {
+  return NET_IDLE;
+}
+
+const char* netPhaseName() {
+  return "tiles";
+}
+
+// Fetched on the server's own schedule (--refresh)
+void netRequestRefresh() {}
+
+bool netTimeValid() {
+  return true;
+}
+
+bool netTakeEvents(std::vector<CalEvent>& outEvents, std::vector<CalInfo>& outCals, SeriesSet& outSeries) {
+  std::lock_guard<std::mutex> lock(dataMutex);
+  if (!pendingReady) return false;
+  outEvents.swap(pendingEvents);
+  outCals.swap(pendingCals);
+  outSeries = SeriesSet();   // Fetched without &series=1, so all expanded
+  pendingEvents.clear();
+  pendingCals.clear();
+  pendingReady = false;
+  return true;
+}
+
+void netRequestPage(ViewMode, const struct tm&, int, int) {}
+
+bool netTakePage(PageLayout&) {
+  return false;
+}
+
+void netRequestTiles(ViewMode, const struct tm&, int, int) {}
+
+bool netTakeTiles(std::shared_ptr<const TilePage>&) {
+  return false;
+}
+
+void bootMark(const char* label) {
+  printf("[boot] %s\n", label);
+}
+
+// ---- Events ----
+
+static double elapsedMs(const struct timespec& since) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - since.tv_sec) * 1e3 + (now.tv_nsec - since.tv_nsec) / 1e6;
+}
+
+// Same window as fetchEvents() in net.cpp
+static bool fetchEvents() {
+  time_t now = __real_time(NULL);
+  struct tm startTm, endTm;
+  localtime_r(&now, &startTm);
+  startTm.tm_hour = startTm.tm_min = startTm.tm_sec = 0;
+  endTm = startTm;
+  startTm.tm_mon -= 1;
+  mktime(&startTm);
+  endTm.tm_mon += 2;
+  mktime(&endTm);
+  char startIso[30], endIso[30], url[512];
+  strftime(startIso, sizeof(startIso), "%Y-%m-%dT%H:%M:%SZ", &startTm);
+  strftime(endIso, sizeof(endIso), "%Y-%m-%dT%H:%M:%SZ", &endTm);
+  snprintf(url, sizeof(url), "%s?from=%s&to=%s&profile=device", apiUrl, startIso, endIso);
+
+  std::string body;
+  int status = httpGet(url, apiKey, body, FETCH_TIMEOUT_MS);
+  if (status != 200) {
+    printf("[tiles] API fetch failed: %d\n", status);
+    return false;
+  }
+  std::vector<CalEvent> events;
+  std::vector<CalInfo> cals;
+  const char* error = "";
+  if (!ingestCalendarJson(body.data(), body.size(), events, cals, &error)) {
+    printf("[tiles] API JSON error: %s\n", error);
+    return false;
+  }
+  printf("[tiles] %zu events from %zu calendars\n", events.size(), cals.size());
+
+  std::lock_guard<std::mutex> lock(dataMutex);
+  pendingEvents.swap(events);
+  pendingCals.swap(cals);
+  pendingReady = true;
+  generation++;
+  return true;
+}
+
+static void fetchLoop() {
+  for (;;) {
+    sleep(refreshSecs);
+    fetchEvents();
+  }
+}
+
+// ---- Rendering ----
+
+static uint32_t currentGeneration() {
+  std::lock_guard<std::mutex> lock(dataMutex);
+  return generation;
+}
+
+// Draw the page through main.cpp and cut it into tiles. `date` must be
+// normalized (mktime). Caller holds renderMutex.
+static const Rendered& renderPage(ViewMode view, const struct tm& date) {
+  time_t start = pageStart(view, date);
+  time_t now = __real_time(NULL);
+  uint32_t gen = currentGeneration();
+  for (const Rendered& r : renders) {
+    if (r.view == view && r.start == start && r.generation == gen && now - r.renderedAt < RENDER_TTL_SECS) return r;
+  }
+
+  struct timespec t0;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  // Wall clock for "today", reminders and the timers main.cpp keeps
+  replaySetClock(replayNowMs(), now);
+  for (int attempt = 0; attempt < 3; attempt++) {
+    currentView = view;
+    viewDate = date;
+    uint32_t seq = metricsLastFrame().seq;
+    draw();
+    for (int i = 0; i < MAX_RENDER_LOOPS && metricsLastFrame().seq == seq; i++) loop();
+    // A timer (day rollover) may have moved the view while drawing
+    if (currentView == view && pageStart(view, viewDate) == start) break;
+  }
+
+  Rendered r;
+  r.view = view;
+  r.start = start;
+  r.generation = gen;
+  r.renderedAt = now;
+  std::vector<uint8_t> buf(TILE_MAX_BYTES);
+  int cols = tileCols(REPLAY_WIDTH), rows = tileRows(REPLAY_HEIGHT);
+  for (int t = 0; t < cols * rows; t++) {
+    int x = (t % cols) * TILE_W, y = (t / cols) * TILE_H;
+    int w = REPLAY_WIDTH - x < TILE_W ? REPLAY_WIDTH - x : TILE_W;
+    int h = REPLAY_HEIGHT - y < TILE_H ? REPLAY_HEIGHT - y : TILE_H;
+    size_t len = tileEncode(framebuffer, REPLAY_WIDTH, x, y, w, h, buf.data());
+    r.tiles.push_back(std::string((const char*)buf.data(), len));
+    r.hashes.push_back(tileHash(buf.data(), len));
+  }
+  r.renderMs = elapsedMs(t0);
+
+  for (size_t i = 0; i < renders.size(); i++) {
+    if (renders[i].view == view && renders[i].start == start) renders.erase(renders.begin() + i);
+  }
+  if (renders.size() >= RENDER_CACHE) renders.erase(renders.begin());
+  renders.push_back(r);
+  return renders.back();
+}
+
+// ---- HTTP ----
+
+static void badRequest(void (*emit)(const char*), const char* why) {
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+           "HTTP/1.0 400 Bad Request\r\nContent-Type: application/json\r\nConnection: close\r\n\r\n{\"error\":\"%s\"}",
+           why);
+  emit(buf);
+}
+
+static void handleHttp(const HttpRequest& req, void (*emit)(const char*)) {
+  uint32_t n;
+  {
+    std::lock_guard<std::mutex> lock(renderMutex);
+    n = requestCount++;
+  }
+  if (req.path != "/api/tiles") {
+    emit("HTTP/1.0 404 Not Found\r\nConnection: close\r\n\r\n");
+    return;
+  }
+  if (apiKey && req.apiKey != apiKey) {
+    emit("HTTP/1.0 401 Unauthorized\r\nContent-Type: application/json\r\nConnection: close\r\n\r\n{\"error\":\"Unauthorized\"}");
+    return;
+  }
+
+  std::string viewArg = httpQueryParam(req.query, "view");
+  int v = 0;
+  while (v < 3 && viewArg != viewNames[v]) v++;
+  if (v == 3) return badRequest(emit, "view must be day, week or month");
+  struct tm date = {0};
+  if (sscanf(httpQueryParam(req.query, "date").c_str(), "%d-%d-%d", &date.tm_year, &date.tm_mon, &date.tm_mday) != 3) {
+    return badRequest(emit, "date must be YYYY-MM-DD");
+  }
+  date.tm_year -= 1900;
+  date.tm_mon -= 1;
+  date.tm_hour = 12;   // Weekday filled in; noon stays on the day across DST
+  date.tm_isdst = -1;
+  mktime(&date);
+  if (atoi(httpQueryParam(req.query, "w").c_str()) != REPLAY_WIDTH ||
+      atoi(httpQueryParam(req.query, "h").c_str()) != REPLAY_HEIGHT) {
+    return badRequest(emit, "only 1024x600 panels are rendered");
+  }
+  std::string tileArg = httpQueryParam(req.query, "tile");
+  int tile = tileArg.empty() ? -1 : atoi(tileArg.c_str());
+
+  // Copy out what the response needs; the render may be replaced after unlocking
+  std::string body;
+  uint32_t hash = 0;
+  double renderMs;
+  char head[320];
+  {
+    std::lock_guard<std::mutex> lock(renderMutex);
+    const Rendered& r = renderPage((ViewMode)v, date);
+    renderMs = r.renderMs;
+    if (!tileArg.empty() && (tile < 0 || tile >= (int)r.tiles.size())) return badRequest(emit, "no such tile");
+    if (tile >= 0) {
+      body = r.tiles[tile];
+      hash = r.hashes[tile];
+    } else {
+      struct tm start;
+      localtime_r(&r.start, &start);
+      snprintf(head, sizeof(head), "tiles 1 %s %04d-%02d-%02d %d %d %d %d\n", viewNames[v], start.tm_year + 1900,
+               start.tm_mon + 1, start.tm_mday, REPLAY_WIDTH, REPLAY_HEIGHT, TILE_W, TILE_H);
+      body = head;
+      for (uint32_t h : r.hashes) {
+        snprintf(head, sizeof(head), "%08lx\n", (unsigned long)h);
+        body += head;
+      }
+    }
+  }
+
+  if (tile < 0) {
+    snprintf(head, sizeof(head),
+             "HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\nCache-Control: no-cache\r\n"
+             "Server-Timing: render;dur=%.1f\r\nConnection: close\r\n\r\n",
+             body.size(), renderMs);
+    emit(head);
+    httpSend(body.data(), body.size());
+    printf("[tiles] #%u %s %s manifest\n", n, viewNames[v], httpQueryParam(req.query, "date").c_str());
+    fflush(stdout);
+    return;
+  }
+
+  char etag[12];
+  snprintf(etag, sizeof(etag), "%08lx", (unsigned long)hash);
+  if (req.ifNoneMatch == etag) {
+    snprintf(head, sizeof(head), "HTTP/1.0 304 Not Modified\r\nETag: \"%s\"\r\nConnection: close\r\n\r\n", etag);
+    emit(head);
+    printf("[tiles] #%u tile %d 304\n", n, tile);
+    fflush(stdout);
+    return;
+  }
+  snprintf(head, sizeof(head),
+           "HTTP/1.0 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: %zu\r\nETag: \"%s\"\r\n"
+           "Cache-Control: no-cache\r\nConnection: close\r\n\r\n",
+           body.size(), etag);
+  emit(head);
+  httpSend(body.data(), body.size());
+  printf("[tiles] #%u tile %d 200 %zu bytes\n", n, tile, body.size());
+  fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+  int port = DEFAULT_PORT;
+  apiKey = getenv("API_SECRET");
+  const char* tz = getenv("TZ");
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const char* opt = argv[i];
+    const char* v = argv[i + 1];
+    if (!strcmp(opt, "--port")) port = atoi(v);
+    else if (!strcmp(opt, "--api")) apiUrl = v;
+    else if (!strcmp(opt, "--key")) apiKey = v;
+    else if (!strcmp(opt, "--refresh")) refreshSecs = atoi(v) > 0 ? atoi(v) : 300;
+    else if (!strcmp(opt, "--tz")) tz = v;
+    else {
+      fprintf(stderr, "unknown option %s\n", opt);
+      return 2;
+    }
+  }
+  if (apiKey && !*apiKey) apiKey = NULL;
+  setenv("TZ", tz && *tz ? tz : "UTC0", 1);
+  tzset();
+
+  // First page only once events are in, or without them if the API is down
+  fetchEvents();
+  {
+    std::lock_guard<std::mutex> lock(renderMutex);
+    replaySetClock(0, __real_time(NULL));
+    logTailLevel = LOG_WARN;
+    setup();
+    loop();
+  }
+  std::thread(fetchLoop).detach();
+
+  if (!httpServeBackground(port, handleHttp)) return 1;
+  printf("tiles on http://localhost:%d/api/tiles (from %s%s)\n", port, apiUrl, apiKey ? ", x-api-key required" : "");
+  fflush(stdout);
+  for (;;) sleep(1);
+}
@@ -0,0 +1,322 @@
+/*
+ * Polling against change notifications, side by side in real time against
+ * the local API (mockapi/):
+ *
+ *   poll   GET the events every --poll seconds, as the firmware did before
+ *          change streams
+ *   watch  what the network task does now: keep GET ?watch=1 open
+ *          (watch.h), fetch conditionally when a new version is announced,
+ *          and keep the same polls, conditional, as a fallback
+ *
+ * The simulator changes the data itself (GET /mock/change) at random
+ * moments and reports per client how long it took until it held the new
+ * version (staleness) and how many full 200 responses it downloaded.
+ *
+ *   pio run -e native_mockapi && .pio/build/native_mockapi/program &
+ *   pio run -e native_watchsim
+ *   .pio/build/native_watchsim/program [options]
+ *
+ *   --api URL        calendar API (default http://localhost:3001/api/calendar)
+ *   --key SECRET     x-api-key (default $API_SECRET)
+ *   --duration SECS  length of the run (default 900)
+ *   --poll SECS      polling interval (default 300, REFRESH_INTERVAL)
+ *   --changes N      data changes spread over the run (default 10)
+ *   --seed N         change times (default: random)
+ *
+ * Changes a client never caught up with count as stale until the end.
+ */
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../http_client.h"
+#include "../../watch.h"
+
+#define DEFAULT_API "http://localhost:3001/api/calendar"
+#define HTTP_TIMEOUT_MS 10000
+#define WATCH_READ_MS 1000
+#define WATCH_RETRY_SECS 5      // WATCH_RETRY_MIN in net.cpp
+
+struct Change {
+  double at;                    // Seconds since the start
+  std::string version;
+};
+
+struct Client {
+  const char* name;
+  bool watch;
+  std::mutex mutex;             // One fetch at a time, like the network task
+  std::string etag;
+  std::vector<double> caughtUp; // Per change, < 0 while still stale
+  int full = 0;
+  int notModified = 0;
+  int failed = 0;
+  size_t bytes = 0;
+  int streams = 0;              // Change streams opened
+  int notifications = 0;
+};
+
+static std::string apiUrl = DEFAULT_API;
+static std::string eventsUrl;
+static const char* apiKey = NULL;
+static double duration = 900;
+static double pollSecs = 300;
+
+static struct timespec started;
+static std::mutex changesMutex;
+static std::vector<Change> changes;
+static std::atomic<bool> running(true);
+
+static double seconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - started.tv_sec) + (now.tv_nsec - started.tv_nsec) / 1e9;
+}
+
+static void sleepUntil(double at) {
+  while (running && seconds() < at) usleep(50000);
+}
+
+// "v3.<window>" -> "v3"
+static std::string versionOf(const std::string& etag) {
+  return etag.substr(0, etag.find('.'));
+}
+
+// Everything up to the change that produced `version` has reached the client
+static void caughtUp(Client& c, const std::string& version) {
+  std::lock_guard<std::mutex> lock(changesMutex);
+  for (size_t i = 0; i < changes.size(); i++) {
+    if (changes[i].version != version) continue;
+    double now = seconds();
+    for (size_t k = 0; k <= i; k++) {
+      if (c.caughtUp[k] < 0) c.caughtUp[k] = now;
+    }
+  }
+}
+
+static void fetch(Client& c) {
+  std::lock_guard<std::mutex> lock(c.mutex);
+  std::string body;
+  HttpTiming timing;
+  // Only the watching client sends the ETag back
+  const char* ifNoneMatch = c.watch && !c.etag.empty() ? c.etag.c_str() : NULL;
+  int status = httpGet(eventsUrl.c_str(), apiKey, body, HTTP_TIMEOUT_MS, &timing, ifNoneMatch);
+  if (status == 304) {
+    c.notModified++;
+  } else if (status == 200) {
+    c.full++;
+    c.bytes += body.size();
+    c.etag = timing.etag;
+    caughtUp(c, versionOf(c.etag));
+  } else {
+    c.failed++;
+  }
+}
+
+static void pollLoop(Client* c) {
+  for (double at = 0; running && at < duration; at += pollSecs) {
+    sleepUntil(at);
+    if (running) fetch(*c);
+  }
+}
+
+static void onVersion(void* ctx, const char* event, const char* data) {
+  Client& c = *(Client*)ctx;
+  if (strcmp(event, "version")) return;
+  {
+    std::lock_guard<std::mutex> lock(c.mutex);
+    if (versionOf(c.etag) == data) return;
+  }
+  c.notifications++;
+  fetch(c);
+}
+
+// "http://host[:port]/path"
+static bool splitUrl(const std::string& url, std::string& host, std::string& port, std::string& path) {
+  if (url.compare(0, 7, "http://")) return false;
+  size_t slash = url.find('/', 7);
+  std::string hostPort = url.substr(7, slash == std::string::npos ? std::string::npos : slash - 7);
+  path = slash == std::string::npos ? "/" : url.substr(slash);
+  size_t colon = hostPort.find(':');
+  host = hostPort.substr(0, colon);
+  port = colon == std::string::npos ? "80" : hostPort.substr(colon + 1);
+  return !host.empty();
+}
+
+static int openStream(const std::string& host, const std::string& port, const std::string& path) {
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* res;
+  if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res)) return -1;
+  int fd = -1;
+  for (addrinfo* a = res; a; a = a->ai_next) {
+    fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if (fd < 0) continue;
+    if (connect(fd, a->ai_addr, a->ai_addrlen) == 0) break;
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+  if (fd < 0) return -1;
+
+  timeval tv = {WATCH_READ_MS / 1000, (WATCH_READ_MS % 1000) * 1000};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  std::string request = "GET " + path + "?watch=1 HTTP/1.1\r\nHost: " + host + "\r\n";
+  if (apiKey && *apiKey) request += std::string("x-api-key: ") + apiKey + "\r\n";
+  request += "Accept: text/event-stream\r\n\r\n";
+  if (send(fd, request.data(), request.size(), MSG_NOSIGNAL) != (ssize_t)request.size()) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void watchLoop(Client* c) {
+  std::string host, port, path;
+  if (!splitUrl(apiUrl, host, port, path)) return;
+  while (running && seconds() < duration) {
+    int fd = openStream(host, port, path);
+    if (fd >= 0) {
+      c->streams++;
+      WatchParser parser;
+      watchReset(parser);
+      char buf[512];
+      double lastByte = seconds();
+      while (running && seconds() < duration) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n == 0 || (n < 0 && seconds() - lastByte > 3 * WATCH_PING_SECS)) break;
+        if (n < 0) continue;   // Read timeout, check the clock
+        lastByte = seconds();
+        if (!watchFeed(parser, buf, n, onVersion, c)) {
+          fprintf(stderr, "watch: status %d, not an event stream\n", parser.http.status);
+          break;
+        }
+      }
+      close(fd);
+    }
+    sleepUntil(seconds() + WATCH_RETRY_SECS);
+  }
+}
+
+static void report(Client& c) {
+  double sum = 0, worst = 0;
+  int seen = 0;
+  for (size_t i = 0; i < changes.size(); i++) {
+    bool caught = c.caughtUp[i] >= 0;
+    double stale = (caught ? c.caughtUp[i] : duration) - changes[i].at;
+    sum += stale;
+    worst = std::max(worst, stale);
+    seen += caught;
+  }
+  double mean = changes.empty() ? 0 : sum / changes.size();
+  printf("%-6s %4d/%-4zu %12.1f %11.1f %6d %6d %6d %9zu %8d %8d\n", c.name, seen, changes.size(), mean, worst, c.full,
+         c.notModified, c.failed, c.bytes, c.streams, c.notifications);
+}
+
+int main(int argc, char** argv) {
+  int changeCount = 10;
+  unsigned seed = std::random_device{}();
+  apiKey = getenv("API_SECRET");
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const char* opt = argv[i];
+    const char* v = argv[i + 1];
+    if (!strcmp(opt, "--api")) apiUrl = v;
+    else if (!strcmp(opt, "--key")) apiKey = v;
+    else if (!strcmp(opt, "--duration")) duration = atof(v);
+    else if (!strcmp(opt, "--poll")) pollSecs = atof(v);
+    else if (!strcmp(opt, "--changes")) changeCount = atoi(v);
+    else if (!strcmp(opt, "--seed")) seed = strtoul(v, NULL, 10);
+    else {
+      fprintf(stderr, "unknown option %s\n", opt);
+      return 2;
+    }
+  }
+  if (pollSecs <= 0 || duration <= 0) {
+    fprintf(stderr, "--poll and --duration must be positive\n");
+    return 2;
+  }
+
+  // The firmware's window: -1 .. +2 months of whole days, fixed for the run
+  time_t now = time(NULL);
+  struct tm startTm;
+  localtime_r(&now, &startTm);
+  startTm.tm_hour = startTm.tm_min = startTm.tm_sec = 0;
+  struct tm endTm = startTm;
+  startTm.tm_mon -= 1;
+  mktime(&startTm);
+  endTm.tm_mon += 2;
+  mktime(&endTm);
+  char startIso[30], endIso[30];
+  strftime(startIso, sizeof(startIso), "%Y-%m-%dT%H:%M:%SZ", &startTm);
+  strftime(endIso, sizeof(endIso), "%Y-%m-%dT%H:%M:%SZ", &endTm);
+  eventsUrl = apiUrl + "?from=" + startIso + "&to=" + endIso;
+
+  size_t origin = apiUrl.find('/', 7);
+  std::string changeUrl = apiUrl.substr(0, origin) + "/mock/change";
+
+  // Changes between 5% and 95% of the run
+  std::mt19937 rng(seed);
+  std::vector<double> at;
+  for (int i = 0; i < changeCount; i++) {
+    at.push_back(duration * (0.05 + 0.9 * std::uniform_real_distribution<double>(0, 1)(rng)));
+  }
+  std::sort(at.begin(), at.end());
+
+  Client poll, watch;
+  poll.name = "poll";
+  poll.watch = false;
+  watch.name = "watch";
+  watch.watch = true;
+  poll.caughtUp.assign(at.size(), -1);
+  watch.caughtUp.assign(at.size(), -1);
+
+  printf("%s, %.0f s, polling every %.0f s, %d changes (seed %u)\n", eventsUrl.c_str(), duration, pollSecs,
+         changeCount, seed);
+  fflush(stdout);
+  clock_gettime(CLOCK_MONOTONIC, &started);
+  std::thread pollThread(pollLoop, &poll);
+  std::thread watchPollThread(pollLoop, &watch);
+  std::thread watchThread(watchLoop, &watch);
+
+  for (size_t i = 0; i < at.size(); i++) {
+    sleepUntil(at[i]);
+    // Clients that see the new version before it is recorded wait for it
+    std::lock_guard<std::mutex> lock(changesMutex);
+    std::string body;
+    int status = httpGet(changeUrl.c_str(), apiKey, body, HTTP_TIMEOUT_MS);
+    if (status != 200) {
+      fprintf(stderr, "%s: status %d\n", changeUrl.c_str(), status);
+      running = false;
+      break;
+    }
+    body.erase(body.find_last_not_of("\r\n") + 1);
+    changes.push_back({seconds(), body});
+    printf("%7.1f s  changed to %s\n", changes.back().at, body.c_str());
+    fflush(stdout);
+  }
+  sleepUntil(duration);
+  running = false;
+  pollThread.join();
+  watchPollThread.join();
+  watchThread.join();
+
+  printf("\n%-6s %9s %12s %11s %6s %6s %6s %9s %8s %8s\n", "client", "caught", "mean stale s", "max stale s",
+         "full", "304", "failed", "bytes", "streams", "notified");
+  report(poll);
+  report(watch);
+  return 0;
+}
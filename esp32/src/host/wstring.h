@@ -0,0 +1,25 @@
+#pragma once
+
+// Just enough of Arduino's String for the calendar model on host builds
+
+#include <string>
+#include <string.h>
+
+class String {
+public:
+  String() {}
+  String(const char* s) : s_(s ? s : "") {}
+  String(const std::string& s) : s_(s) {}
+
+  String& operator=(const char* s) { s_ = s ? s : ""; return *this; }
+  bool operator==(const String& o) const { return s_ == o.s_; }
+  bool operator==(const char* o) const { return s_ == (o ? o : ""); }
+
+  unsigned char reserve(unsigned int size) { s_.reserve(size); return 1; }
+  const char* c_str() const { return s_.c_str(); }
+  unsigned int length() const { return s_.length(); }
+  bool startsWith(const char* prefix) const { return s_.compare(0, strlen(prefix), prefix) == 0; }
+
+private:
+  std::string s_;
+};
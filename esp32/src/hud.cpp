@@ -0,0 +1,119 @@
+#include "hud.h"
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <stdarg.h>
+#include "lgfx_config.h"
+#include "refresh_log.h"
+#include "binlog.h"
+
+#define HUD_BG     0x0000
+#define HUD_BORDER 0x07E0
+#define HUD_TEXT   0x07E0
+#define HUD_WARN   0xFFE0
+
+static LGFX_Sprite* sprite = NULL;
+static bool visible = false;
+static bool dirty = false;
+static uint32_t lastPaint = 0;
+static uint32_t hudUs = 0;   // Time the previous repaint took
+
+static uint32_t lastRenderUs = 0;
+static uint32_t lastPresentUs = 0;
+static uint32_t lastTouchUs = 0;
+
+// fps over whole seconds
+static uint32_t windowStart = 0;
+static uint32_t windowFrames = 0;
+static uint32_t fps = 0;
+
+void hudToggle() {
+  visible = !visible;
+  dirty = visible;
+}
+
+bool hudVisible() {
+  return visible;
+}
+
+void hudFrameDone(uint32_t renderUs, uint32_t presentUs, uint32_t touchUs) {
+  lastRenderUs = renderUs;
+  lastPresentUs = presentUs;
+  if (touchUs) lastTouchUs = touchUs;
+  windowFrames++;
+  dirty = true;
+}
+
+static void line(const char* label, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void line(const char* label, const char* fmt, ...) {
+  char value[32];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(value, sizeof(value), fmt, args);
+  va_end(args);
+  sprite->printf("%-8s%s\n", label, value);
+}
+
+static void paint(uint32_t eventCount) {
+  sprite->fillSprite(HUD_BG);
+  sprite->drawRect(0, 0, HUD_WIDTH, HUD_HEIGHT, HUD_BORDER);
+  sprite->setTextColor(HUD_TEXT);
+  sprite->setTextSize(1);
+  sprite->setCursor(6, 6);
+
+  line("fps", "%lu", (unsigned long)fps);
+  line("render", "%.1f ms", lastRenderUs / 1000.0);
+  line("present", "%.1f ms", lastPresentUs / 1000.0);
+  line("touch", "%.1f ms", lastTouchUs / 1000.0);
+  line("heap", "%lu KB (%lu)", (unsigned long)(ESP.getFreeHeap() / 1024),
+       (unsigned long)(heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT) / 1024));
+  line("psram", "%lu KB", (unsigned long)(ESP.getFreePsram() / 1024));
+
+  RefreshRecord r;
+  if (refreshLogLast(r)) {
+    if (!r.ok) sprite->setTextColor(HUD_WARN);
+    line("refresh", "%lu ms, %lus ago", (unsigned long)(r.totalUs / 1000),
+         (unsigned long)(esp_timer_get_time() / 1000000 - r.uptimeSec));
+    sprite->setTextColor(HUD_TEXT);
+  } else {
+    line("refresh", "-");
+  }
+  line("events", "%lu", (unsigned long)eventCount);
+  line("hud", "%.1f ms", hudUs / 1000.0);
+}
+
+bool hudUpdate(LGFX& tft, uint32_t eventCount) {
+  uint32_t now = millis();
+  if (now - windowStart >= 1000) {
+    fps = windowFrames * 1000 / (now - windowStart);
+    windowFrames = 0;
+    windowStart = now;
+  }
+  if (!visible || (!dirty && now - lastPaint < HUD_UPDATE_MS)) return false;
+
+  uint32_t start = micros();
+  if (!sprite) {
+    // Internal RAM, allocated on first use and kept
+    sprite = new LGFX_Sprite(&tft);
+    sprite->setColorDepth(16);
+    sprite->setPsram(false);
+    if (!sprite->createSprite(HUD_WIDTH, HUD_HEIGHT)) {
+      delete sprite;
+      sprite = NULL;
+      visible = false;
+      logWrite(LOG_HUD_NO_MEMORY);
+      return false;
+    }
+  }
+  paint(eventCount);
+  sprite->pushSprite(tft.width() - HUD_WIDTH - 8, tft.height() - HUD_HEIGHT - 40);
+  hudUs = micros() - start;
+  lastPaint = now;
+  dirty = false;
+  return true;
+}
+
+#endif
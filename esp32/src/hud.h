@@ -0,0 +1,42 @@
+#pragma once
+
+// Performance overlay for tuning on the panel: fps, last frame's render
+// and present time, touch-to-frame latency, free heap and PSRAM, last
+// refresh and event count.
+//
+// The HUD is drawn into its own small sprite and pushed onto the screen
+// only between frames, so its cost never lands in the render times it
+// shows (its own draw time is listed separately).
+
+#include <stdint.h>
+
+#define HUD_WIDTH        200
+#define HUD_HEIGHT       124
+#define HUD_UPDATE_MS    1000   // Repaint interval while idle
+#define HUD_TOUCH_POINTS 3      // Fingers for the toggle tap
+
+class LGFX;
+
+#ifdef ARDUINO
+
+void hudToggle();
+bool hudVisible();
+
+// UI loop, once per completed frame. present is draw() until the last
+// step finished (including yields); touch is the release that caused the
+// frame until then, 0 if the frame wasn't caused by a touch.
+void hudFrameDone(uint32_t renderUs, uint32_t presentUs, uint32_t touchUs);
+
+// Repaint after a frame or every HUD_UPDATE_MS; call only while no frame
+// is in progress. Returns true if it pushed the overlay.
+bool hudUpdate(LGFX& tft, uint32_t eventCount);
+
+#else
+
+// Replay and host builds have no overlay
+inline void hudToggle() {}
+inline bool hudVisible() { return false; }
+inline void hudFrameDone(uint32_t, uint32_t, uint32_t) {}
+inline bool hudUpdate(LGFX&, uint32_t) { return false; }
+
+#endif
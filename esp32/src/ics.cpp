@@ -0,0 +1,743 @@
+#include "ics.h"
+#include "rrule.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
+
+#define NO_DAY INT32_MIN
+#define HASH_BASIS 14695981039346656037ull
+#define HASH_PRIME 1099511628211ull
+
+// 64-bit FNV-1a of a content line, and a line break after it so lines
+// can't run into each other
+static uint64_t hashLine(uint64_t h, const char* s) {
+  for (; *s; s++) h = (h ^ (uint8_t)*s) * HASH_PRIME;
+  return (h ^ '\n') * HASH_PRIME;
+}
+
+static int32_t floorDiv(int64_t a, int64_t b) {
+  return (int32_t)(a >= 0 ? a / b : -((-a + b - 1) / b));
+}
+
+// The day of a yearly observance rule in `year`
+static int32_t ruleDay(const IcsObservance& o, int year) {
+  if (o.weekday == 7) return daysFromCivil(year, o.month, o.monthDay);
+  if (o.week == 0) {
+    int32_t first = daysFromCivil(year, o.month, o.monthDay);
+    return first + (o.weekday - weekdayOf(first) + 7) % 7;
+  }
+  if (o.week > 0) {
+    int32_t first = daysFromCivil(year, o.month, 1);
+    return first + (o.weekday - weekdayOf(first) + 7) % 7 + (o.week - 1) * 7;
+  }
+  int32_t last = daysFromCivil(year + (o.month == 12), o.month % 12 + 1, 1) - 1;
+  return last - (weekdayOf(last) - o.weekday + 7) % 7 + (o.week + 1) * 7;
+}
+
+// Seconds east of UTC in `zone` at a local time: the observance whose
+// latest transition is at or before it
+static int32_t zoneOffset(const IcsZone& zone, int32_t day, int32_t secs) {
+  int64_t t = (int64_t)day * 86400 + secs;
+  int y, m, d;
+  civilFromDays(day, y, m, d);
+  int64_t best = INT64_MIN;
+  int32_t offset = 0;
+  int32_t earliest = INT32_MAX;
+  for (int i = 0; i < zone.count; i++) {
+    const IcsObservance& o = zone.obs[i];
+    int64_t since = (int64_t)o.sinceDay * 86400 + o.secs;
+    if (o.sinceDay < earliest) {
+      earliest = o.sinceDay;
+      if (best == INT64_MIN) offset = o.offset;   // Before every transition
+    }
+    for (int year = y - 1; year <= y; year++) {
+      int64_t at = since;
+      if (o.month) {
+        int32_t ruleAt = ruleDay(o, year);
+        if (ruleAt > o.untilDay) continue;
+        at = (int64_t)ruleAt * 86400 + o.secs;
+        if (at < since) continue;
+      }
+      if (at <= t && at > best) {
+        best = at;
+        offset = o.offset;
+      }
+    }
+  }
+  return offset;
+}
+
+// "YYYYMMDD[THHMMSS[Z]]"; false if it isn't one
+static bool parseStamp(const char* s, IcsStamp& out) {
+  int y, m, d, hh = 0, mm = 0, ss = 0;
+  if (strlen(s) < 8 || sscanf(s, "%4d%2d%2d", &y, &m, &d) != 3) return false;
+  out.date = s[8] != 'T';
+  if (!out.date && sscanf(s + 9, "%2d%2d%2d", &hh, &mm, &ss) != 3) return false;
+  out.day = daysFromCivil(y, m, d);
+  out.secs = hh * 3600 + mm * 60 + ss;
+  out.zone = -1;
+  return true;
+}
+
+static time_t resolve(const IcsParser& p, const IcsStamp& s) {
+  if (s.date) return deviceTime((int64_t)s.day * 86400);
+  int64_t utc = (int64_t)s.day * 86400 + s.secs;
+  if (s.zone >= 0) utc -= zoneOffset(p.zones[s.zone], s.day, s.secs);
+  return deviceTime(utc);
+}
+
+// "+0100", "-0530", "+013045"
+static int32_t parseOffset(const char* s) {
+  int sign = *s == '-' ? -1 : 1;
+  if (*s == '+' || *s == '-') s++;
+  int hh = 0, mm = 0, ss = 0;
+  sscanf(s, "%2d%2d%2d", &hh, &mm, &ss);
+  return sign * (hh * 3600 + mm * 60 + ss);
+}
+
+// "P1D", "PT1H30M", "-PT15M", "P2W"
+static int32_t parseDuration(const char* s) {
+  int sign = 1;
+  if (*s == '+' || *s == '-') sign = *s++ == '-' ? -1 : 1;
+  if (*s++ != 'P') return -1;
+  int32_t total = 0;
+  while (*s) {
+    if (*s == 'T') {
+      s++;
+      continue;
+    }
+    char* end;
+    long n = strtol(s, &end, 10);
+    if (end == s) return -1;
+    switch (*end) {
+      case 'W': total += n * 7 * 86400; break;
+      case 'D': total += n * 86400; break;
+      case 'H': total += n * 3600; break;
+      case 'M': total += n * 60; break;
+      case 'S': total += n; break;
+      default: return -1;
+    }
+    s = end + 1;
+  }
+  return sign * total;
+}
+
+// Value of parameter `name` in ";NAME=value;..." (quotes removed)
+static bool param(const char* params, const char* name, char* out, size_t size) {
+  size_t len = strlen(name);
+  for (const char* s = params; (s = strchr(s, ';')); ) {
+    s++;
+    if (strncasecmp(s, name, len) || s[len] != '=') continue;
+    s += len + 1;
+    bool quoted = *s == '"';
+    if (quoted) s++;
+    size_t n = quoted ? strcspn(s, "\"") : strcspn(s, ";");
+    if (n >= size) n = size - 1;
+    memcpy(out, s, n);
+    out[n] = 0;
+    return true;
+  }
+  return false;
+}
+
+// RFC 5545 TEXT escapes, in place
+static void unescape(char* s) {
+  char* out = s;
+  for (; *s; s++) {
+    if (*s == '\\' && s[1]) {
+      s++;
+      *out++ = *s == 'n' || *s == 'N' ? '\n' : *s;
+    } else {
+      *out++ = *s;
+    }
+  }
+  *out = 0;
+}
+
+// RRULE part "NAME=" of an observance rule, NULL if absent
+static const char* rulePart(const char* rule, const char* name) {
+  size_t len = strlen(name);
+  for (const char* s = rule; s; s = strchr(s, ';')) {
+    if (*s == ';') s++;
+    if (!strncmp(s, name, len)) return s + len;
+  }
+  return NULL;
+}
+
+static int weekdayCode(const char* s) {
+  static const char* codes[] = {"SU", "MO", "TU", "WE", "TH", "FR", "SA"};
+  for (int i = 0; i < 7; i++) {
+    if (!strncmp(s, codes[i], 2)) return i;
+  }
+  return 7;
+}
+
+// Observance RRULE, e.g. "FREQ=YEARLY;BYMONTH=3;BYDAY=-1SU"
+static void observanceRule(IcsObservance& o, const char* rule) {
+  const char* month = rulePart(rule, "BYMONTH=");
+  if (!month) return;
+  o.month = atoi(month);
+  const char* byday = rulePart(rule, "BYDAY=");
+  if (byday) {
+    char* end;
+    o.week = strtol(byday, &end, 10);
+    o.weekday = weekdayCode(end);
+  }
+  const char* bymonthday = rulePart(rule, "BYMONTHDAY=");
+  if (bymonthday) o.monthDay = atoi(bymonthday);   // Lists like 8,9,...,14 are ascending
+  const char* until = rulePart(rule, "UNTIL=");
+  IcsStamp stamp;
+  if (until && parseStamp(until, stamp)) o.untilDay = stamp.day;
+  if (o.month < 1 || o.month > 12 || (o.weekday != 7 && (o.week < -1 || o.week > 5))) o.month = 0;
+}
+
+// Keeps the ICS_OBSERVANCES latest observances of the zone being read
+static void addObservance(IcsZone& zone, const IcsObservance& o) {
+  if (zone.count < ICS_OBSERVANCES) {
+    zone.obs[zone.count++] = o;
+    return;
+  }
+  IcsObservance* oldest = &zone.obs[0];
+  for (int i = 1; i < zone.count; i++) {
+    if (zone.obs[i].sinceDay < oldest->sinceDay) oldest = &zone.obs[i];
+  }
+  if (o.sinceDay > oldest->sinceDay) *oldest = o;
+}
+
+static int8_t findZone(const IcsParser& p, const char* tzid) {
+  for (int i = 0; i < p.zoneCount; i++) {
+    if (!strcmp(p.zones[i].tzid, tzid)) return i;
+  }
+  return -1;
+}
+
+// DTSTART/DTEND/RECURRENCE-ID/EXDATE value with its TZID
+static bool eventStamp(const IcsParser& p, const char* params, const char* value, IcsStamp& out) {
+  if (!parseStamp(value, out)) return false;
+  char tzid[ICS_TZID_MAX];
+  if (!out.date && value[15] != 'Z' && param(params, "TZID", tzid, sizeof(tzid))) out.zone = findZone(p, tzid);
+  return true;
+}
+
+static void resetEvent(IcsParser& p) {
+  IcsEvent& e = p.event;
+  e.uid = "";
+  e.title = "";
+  e.location = "";
+  e.rrule = "";
+  e.cancelled = false;
+  e.exdates.clear();
+  e.hash = HASH_BASIS;
+  p.start.day = p.end.day = p.recurrenceId.day = NO_DAY;
+  p.duration = -1;
+}
+
+static void endEvent(IcsParser& p, IcsEventFn onEvent, void* ctx) {
+  p.vevents++;
+  IcsEvent& e = p.event;
+  // Like the API: no UID, no event
+  if (p.start.day == NO_DAY || !e.uid.length()) return;
+
+  e.allDay = p.start.date;
+  e.dtstart = p.start;
+  e.start = resolve(p, p.start);
+  if (p.end.day != NO_DAY) e.end = resolve(p, p.end);
+  else if (p.duration >= 0) e.end = e.start + p.duration;
+  else e.end = p.start.date ? deviceTime(((int64_t)p.start.day + 1) * 86400) : e.start;
+  e.recurrenceId = p.recurrenceId.day != NO_DAY ? resolve(p, p.recurrenceId) : 0;
+  // The zones its times were resolved in
+  for (int i = 0; i < 8; i++) e.hash = (e.hash ^ (uint8_t)(p.zoneHash >> (i * 8))) * HASH_PRIME;
+  if (!e.title.length()) e.title = "Untitled";
+  else if (strstr(e.title.c_str(), "Canceled:")) e.cancelled = true;
+
+  bool inWindow;
+  if (e.rrule.length()) {
+    inWindow = e.start <= p.to;
+  } else {
+    inWindow = e.end >= p.from && e.start <= p.to;
+    // An override also matters where the instance it replaces was
+    if (e.recurrenceId && e.recurrenceId + (e.end - e.start) >= p.from && e.recurrenceId <= p.to) inWindow = true;
+  }
+  if (!inWindow) return;
+  p.emitted++;
+  onEvent(ctx, e);
+}
+
+static void beginSkip(IcsParser& p) {
+  p.skipReturn = p.scope;
+  p.skipDepth = 1;
+  p.scope = ICS_SKIP;
+}
+
+// One unfolded content line in p.line
+static void contentLine(IcsParser& p, IcsEventFn onEvent, void* ctx) {
+  if (p.lineCut) {
+    // Don't leave half a UTF-8 sequence at the cut
+    while (p.lineLen && ((uint8_t)p.line[p.lineLen - 1] & 0xC0) == 0x80) p.lineLen--;
+    if (p.lineLen && ((uint8_t)p.line[p.lineLen - 1] & 0x80)) p.lineLen--;
+  }
+  p.line[p.lineLen] = 0;
+  p.lineLen = 0;
+  p.lineCut = false;
+  char* line = p.line;
+  if (!*line) return;
+
+  // NAME;PARAM=...;PARAM="...":value
+  char name[24];
+  size_t nameLen = strcspn(line, ";:");
+  snprintf(name, sizeof(name), "%.*s", (int)nameLen, line);
+  char* params = line + nameLen;   // Keeps its leading ';' for param()
+  // Hashed as written, before the value is cut off and unescaped
+  if (p.scope == ICS_ZONE || p.scope == ICS_ZONE_OBSERVANCE) {
+    p.zoneHash = hashLine(p.zoneHash, line);
+  } else if (p.scope == ICS_EVENT && strcmp(name, "BEGIN") && strcmp(name, "END") && strcmp(name, "DTSTAMP")) {
+    p.event.hash = hashLine(p.event.hash, line);
+  }
+  char* value = params;
+  for (bool quoted = false; *value && (quoted || *value != ':'); value++) {
+    if (*value == '"') quoted = !quoted;
+  }
+  if (!*value) return;
+  *value++ = 0;
+
+  bool begin = !strcmp(name, "BEGIN");
+  bool end = !strcmp(name, "END");
+
+  switch (p.scope) {
+    case ICS_OUTSIDE:
+      if (begin && !strcmp(value, "VEVENT")) {
+        resetEvent(p);
+        p.scope = ICS_EVENT;
+      } else if (begin && !strcmp(value, "VTIMEZONE")) {
+        if (p.zoneCount < ICS_ZONES) {
+          IcsZone& zone = p.zones[p.zoneCount];
+          zone.tzid[0] = 0;
+          zone.count = 0;
+          p.scope = ICS_ZONE;
+        } else {
+          beginSkip(p);
+        }
+      } else if (begin && strcmp(value, "VCALENDAR")) {
+        beginSkip(p);
+      }
+      break;
+
+    case ICS_EVENT: {
+      IcsEvent& e = p.event;
+      if (begin) {
+        beginSkip(p);
+      } else if (end) {
+        p.scope = ICS_OUTSIDE;
+        endEvent(p, onEvent, ctx);
+      } else if (!strcmp(name, "UID")) {
+        e.uid = value;
+      } else if (!strcmp(name, "SUMMARY")) {
+        if (!e.title.length()) {
+          unescape(value);
+          e.title = value;
+        }
+      } else if (!strcmp(name, "LOCATION")) {
+        unescape(value);
+        e.location = value;
+      } else if (!strcmp(name, "DTSTART")) {
+        if (!eventStamp(p, params, value, p.start)) p.start.day = NO_DAY;
+      } else if (!strcmp(name, "DTEND")) {
+        if (!eventStamp(p, params, value, p.end)) p.end.day = NO_DAY;
+      } else if (!strcmp(name, "DURATION")) {
+        p.duration = parseDuration(value);
+      } else if (!strcmp(name, "STATUS")) {
+        if (!strcmp(value, "CANCELLED")) e.cancelled = true;
+      } else if (!strcmp(name, "RRULE")) {
+        e.rrule = value;
+      } else if (!strcmp(name, "RECURRENCE-ID")) {
+        if (!eventStamp(p, params, value, p.recurrenceId)) p.recurrenceId.day = NO_DAY;
+      } else if (!strcmp(name, "EXDATE")) {
+        // Comma-separated, same TZID for all
+        char* save;
+        for (char* s = strtok_r(value, ",", &save); s; s = strtok_r(NULL, ",", &save)) {
+          IcsStamp stamp;
+          if (eventStamp(p, params, s, stamp)) e.exdates.push_back(resolve(p, stamp));
+        }
+      }
+      break;
+    }
+
+    case ICS_ZONE: {
+      IcsZone& zone = p.zones[p.zoneCount];
+      if (begin && (!strcmp(value, "STANDARD") || !strcmp(value, "DAYLIGHT"))) {
+        memset(&p.observance, 0, sizeof(p.observance));
+        p.observance.weekday = 7;
+        p.observance.untilDay = INT32_MAX;
+        p.scope = ICS_ZONE_OBSERVANCE;
+      } else if (begin) {
+        beginSkip(p);
+      } else if (end) {
+        if (zone.tzid[0] && zone.count) p.zoneCount++;
+        p.scope = ICS_OUTSIDE;
+      } else if (!strcmp(name, "TZID")) {
+        snprintf(zone.tzid, sizeof(zone.tzid), "%s", value);
+      }
+      break;
+    }
+
+    case ICS_ZONE_OBSERVANCE: {
+      IcsObservance& o = p.observance;
+      if (end) {
+        addObservance(p.zones[p.zoneCount], o);
+        p.scope = ICS_ZONE;
+      } else if (!strcmp(name, "DTSTART")) {
+        IcsStamp stamp;
+        if (parseStamp(value, stamp)) {
+          o.sinceDay = stamp.day;
+          o.secs = stamp.secs;
+          int y, m, d;
+          civilFromDays(stamp.day, y, m, d);
+          if (!o.monthDay) o.monthDay = d;
+        }
+      } else if (!strcmp(name, "TZOFFSETTO")) {
+        o.offset = parseOffset(value);
+      } else if (!strcmp(name, "RRULE")) {
+        uint8_t day = o.monthDay;
+        o.monthDay = 0;
+        observanceRule(o, value);
+        if (!o.monthDay) o.monthDay = day;
+      }
+      break;
+    }
+
+    case ICS_SKIP:
+      if (begin) p.skipDepth++;
+      else if (end && !--p.skipDepth) p.scope = p.skipReturn;
+      break;
+  }
+}
+
+void icsBegin(IcsParser& p, time_t from, time_t to) {
+  p.from = from;
+  p.to = to;
+  p.lineLen = 0;
+  p.lineCut = false;
+  p.lineBreak = false;
+  p.scope = ICS_OUTSIDE;
+  p.skipReturn = ICS_OUTSIDE;
+  p.skipDepth = 0;
+  p.zoneCount = 0;
+  p.zoneHash = HASH_BASIS;
+  p.bytes = 0;
+  p.vevents = 0;
+  p.emitted = 0;
+  resetEvent(p);
+}
+
+void icsFeed(IcsParser& p, const char* bytes, size_t len, IcsEventFn onEvent, void* ctx) {
+  p.bytes += len;
+  const char* s = bytes;
+  const char* end = bytes + len;
+  while (s < end) {
+    if (p.lineBreak) {
+      p.lineBreak = false;
+      if (*s == ' ' || *s == '\t') {
+        // Folded: the line goes on after this one whitespace
+        s++;
+        continue;
+      }
+      contentLine(p, onEvent, ctx);
+    }
+    const char* nl = (const char*)memchr(s, '\n', end - s);
+    const char* stop = nl ? nl : end;
+    size_t n = stop - s;
+    size_t room = ICS_LINE_MAX - 1 - p.lineLen;
+    if (n > room) {
+      n = room;
+      p.lineCut = true;
+    }
+    memcpy(p.line + p.lineLen, s, n);
+    p.lineLen += n;
+    if (!nl) break;
+    if (p.lineLen && p.line[p.lineLen - 1] == '\r') p.lineLen--;
+    p.lineBreak = true;
+    s = nl + 1;
+  }
+}
+
+void icsEnd(IcsParser& p, IcsEventFn onEvent, void* ctx) {
+  if (p.lineBreak || p.lineLen) {
+    if (p.lineLen && p.line[p.lineLen - 1] == '\r') p.lineLen--;
+    p.lineBreak = false;
+    contentLine(p, onEvent, ctx);
+  }
+}
+
+// FNV-1a, to match overrides to their series without keeping UIDs around
+static uint32_t uidHash(const String& uid) {
+  uint32_t h = 2166136261u;
+  for (const char* s = uid.c_str(); *s; s++) h = (h ^ (uint8_t)*s) * 16777619u;
+  return h;
+}
+
+static void collectOne(IcsCollector& c, const IcsEvent& event, time_t start, time_t end) {
+  CalEvent e;
+  e.title = event.title.c_str();
+  e.start = start;
+  e.end = end;
+  e.color = c.color;
+  e.location = event.location.c_str();
+  e.allDay = event.allDay;
+  c.out->push_back(e);
+}
+
+// A master's instances in the window, like feeds.ts expandSeries(): from
+// DTSTART on, minus EXDATEs, each as long as the master
+static void expandSeries(IcsCollector& c, const IcsEvent& event, uint32_t uid, bool& unsupported) {
+  const IcsParser& p = *c.parser;
+  time_t duration = event.end - event.start;
+  RRule rule;
+  unsupported = !rruleParse(event.rrule.c_str(), rule);
+  if (unsupported) {
+    rule.freq = RRULE_DAILY;
+    rule.count = 1;
+    rule.hasUntil = false;
+  }
+  // UNTIL compares as UTC, a date as its midnight, like ical.js does
+  time_t until = 0;
+  if (rule.hasUntil) until = deviceTime((int64_t)rule.untilDay * 86400 + (rule.untilDate ? 0 : rule.untilSecs));
+
+  // Local days run up to 14 hours off device days; start a little early
+  int32_t fromDay = floorDiv((int64_t)p.from - duration, 86400) - 2;
+  RRuleIter it;
+  rruleBegin(it, rule, event.dtstart.day, fromDay, floorDiv(p.to, 86400) + 2);
+  uint16_t kept = 0;
+  int32_t day;
+  while (kept < ICS_MAX_OCCURRENCES && rruleNext(it, day)) {
+    IcsStamp stamp = event.dtstart;
+    stamp.day = day;
+    time_t start = resolve(p, stamp);
+    if (start > p.to || (rule.hasUntil && start > until)) break;
+    if (start + duration < p.from) continue;
+    if (std::find(event.exdates.begin(), event.exdates.end(), start) != event.exdates.end()) continue;
+    c.instances.push_back(std::make_pair(uid, c.out->size()));
+    collectOne(c, event, start, start + duration);
+    kept++;
+  }
+}
+
+static bool sameVevent(const IcsEntry& a, const IcsEntry& b) {
+  return a.uid == b.uid && a.recurrenceId == b.recurrenceId;
+}
+
+static size_t slotOf(const IcsEntry& e, size_t mask) {
+  return (e.uid ^ (uint32_t)e.recurrenceId * 2654435761u) & mask;
+}
+
+// IcsIndex::slots for `entries`, at most half full
+static void buildSlots(const std::vector<IcsEntry>& entries, std::vector<uint32_t>& slots) {
+  size_t size = 16;
+  while (size < entries.size() * 2) size *= 2;
+  slots.assign(size, 0);
+  for (size_t i = 0; i < entries.size(); i++) {
+    size_t s = slotOf(entries[i], size - 1);
+    while (slots[s]) s = (s + 1) & (size - 1);
+    slots[s] = i + 1;
+  }
+}
+
+// The first of `entries` with key's UID and RECURRENCE-ID that `fn`
+// accepts, -1 if none
+template <typename Fn>
+static int32_t findEntry(const std::vector<IcsEntry>& entries, const std::vector<uint32_t>& slots,
+                         const IcsEntry& key, Fn fn) {
+  if (slots.empty()) return -1;
+  size_t mask = slots.size() - 1;
+  for (size_t s = slotOf(key, mask); slots[s]; s = (s + 1) & mask) {
+    uint32_t i = slots[s] - 1;
+    if (sameVevent(entries[i], key) && fn(i)) return i;
+  }
+  return -1;
+}
+
+// The index entry `entry` can take its events from, NULL if it changed.
+// Feeds tend to list their VEVENTs in the same order every download, so
+// the one after the last reused is tried before looking it up.
+static const IcsEntry* findUnchanged(IcsCollector& c, const IcsEntry& entry) {
+  const std::vector<IcsEntry>& old = c.index->entries;
+  int32_t i = c.next;
+  if (i >= (int32_t)old.size() || c.taken[i] || !sameVevent(old[i], entry) || old[i].hash != entry.hash) {
+    i = findEntry(old, c.index->slots, entry,
+                  [&](uint32_t k) { return !c.taken[k] && old[k].hash == entry.hash; });
+    if (i < 0) return NULL;
+  }
+  c.taken[i] = true;
+  c.next = i + 1;
+  return &old[i];
+}
+
+// VEVENTs that differ between the index and c.entries: those with an
+// entry on either side that found no equal one on the other. Duplicate
+// UID/RECURRENCE-ID pairs count as one VEVENT. After a rebuild nothing
+// was matched, so every VEVENT in both lists counts as changed.
+static void diffEntries(IcsCollector& c, const std::vector<uint32_t>& slots) {
+  const IcsIndex& index = *c.index;
+  std::vector<std::pair<uint32_t, time_t>> keys;
+  for (uint32_t i : c.missed) keys.push_back(std::make_pair(c.entries[i].uid, c.entries[i].recurrenceId));
+  for (size_t i = 0; i < index.entries.size(); i++) {
+    if (i < c.taken.size() && c.taken[i]) continue;
+    keys.push_back(std::make_pair(index.entries[i].uid, index.entries[i].recurrenceId));
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  auto any = [](uint32_t) { return true; };
+  for (const auto& key : keys) {
+    IcsEntry e;
+    e.uid = key.first;
+    e.recurrenceId = key.second;
+    bool before = findEntry(index.entries, index.slots, e, any) >= 0;
+    bool now = findEntry(c.entries, slots, e, any) >= 0;
+    c.changes.push_back({key.first, key.second, !before ? ICS_ADDED : !now ? ICS_REMOVED : ICS_CHANGED});
+  }
+}
+
+// A VEVENT's events, made from scratch; sets the entry's flags
+static void collectEvent(IcsCollector& c, const IcsEvent& event, uint32_t uid, IcsEntry& entry) {
+  const IcsParser& p = *c.parser;
+  entry.series = entry.unsupported = false;
+  if (event.cancelled) return;
+  if (event.rrule.length() && !event.recurrenceId) {
+    entry.series = true;
+    expandSeries(c, event, uid, entry.unsupported);
+    return;
+  }
+  if (event.end < p.from || event.start > p.to) return;
+  collectOne(c, event, event.start, event.end);
+}
+
+static void collectBegin(IcsCollector& c, const IcsParser& p, uint16_t color, std::vector<CalEvent>& out,
+                         IcsIndex* index) {
+  c.parser = &p;
+  c.color = color;
+  c.out = &out;
+  c.replaced.clear();
+  c.instances.clear();
+  c.series = 0;
+  c.unsupported = 0;
+  c.index = index;
+  c.rebuilt = !index || index->from != p.from || index->to != p.to || index->color != color;
+  c.entries.clear();
+  c.taken.assign(index && !c.rebuilt ? index->entries.size() : 0, false);
+  c.next = 0;
+  c.missed.clear();
+  c.changes.clear();
+  c.reused = 0;
+}
+
+void icsCollectBegin(IcsCollector& c, const IcsParser& p, uint16_t color, std::vector<CalEvent>& out) {
+  collectBegin(c, p, color, out, NULL);
+}
+
+void icsCollectBegin(IcsCollector& c, const IcsParser& p, uint16_t color, IcsIndex& index) {
+  c.events.clear();
+  c.events.reserve(index.events.size());
+  collectBegin(c, p, color, c.events, &index);
+  // The events are the collector's until icsCollectEnd(): reused ones
+  // move out, so an index left behind by a failed download can't be
+  // reused, only diffed against
+  c.previous.clear();
+  if (!c.rebuilt) c.previous.swap(index.events);
+  std::vector<CalEvent>().swap(index.events);
+  index.dropped.clear();
+  index.from = index.to = 0;
+}
+
+void icsCollect(void* ctx, const IcsEvent& event) {
+  IcsCollector& c = *(IcsCollector*)ctx;
+  uint32_t uid = uidHash(event.uid);
+  // Cancelled overrides still take their instance out of the series
+  if (event.recurrenceId) c.replaced.push_back(std::make_pair(uid, event.recurrenceId));
+
+  IcsEntry entry;
+  entry.uid = uid;
+  entry.recurrenceId = event.recurrenceId;
+  entry.hash = event.hash;
+  entry.first = c.out->size();
+  const IcsEntry* old = c.index && !c.rebuilt ? findUnchanged(c, entry) : NULL;
+  if (old) {
+    for (uint32_t i = old->first; i < old->first + old->count; i++) {
+      if (old->series) c.instances.push_back(std::make_pair(uid, c.out->size()));
+      c.out->push_back(std::move(c.previous[i]));
+    }
+    entry.series = old->series;
+    entry.unsupported = old->unsupported;
+    c.reused++;
+  } else {
+    collectEvent(c, event, uid, entry);
+  }
+  c.series += entry.series;
+  c.unsupported += entry.unsupported;
+  if (!c.index) return;
+  entry.count = c.out->size() - entry.first;
+  if (!old) c.missed.push_back(c.entries.size());
+  c.entries.push_back(entry);
+}
+
+// Instances the overrides replaced, false if none
+static bool overridden(IcsCollector& c, std::vector<bool>& drop) {
+  const std::vector<CalEvent>& out = *c.out;
+  if (c.replaced.empty() || c.instances.empty()) return false;
+  std::sort(c.replaced.begin(), c.replaced.end());
+  drop.assign(out.size(), false);
+  bool any = false;
+  for (const auto& instance : c.instances) {
+    auto key = std::make_pair(instance.first, out[instance.second].start);
+    if (std::binary_search(c.replaced.begin(), c.replaced.end(), key)) {
+      drop[instance.second] = true;
+      any = true;
+    }
+  }
+  return any;
+}
+
+void icsCollectEnd(IcsCollector& c) {
+  std::vector<CalEvent>& out = *c.out;
+  std::vector<bool> drop;
+  bool any = overridden(c, drop);
+  if (c.index) {
+    IcsIndex& index = *c.index;
+    std::vector<uint32_t> slots;
+    buildSlots(c.entries, slots);
+    diffEntries(c, slots);
+    index.from = c.parser->from;
+    index.to = c.parser->to;
+    index.color = c.color;
+    index.entries.swap(c.entries);
+    index.slots.swap(slots);
+    index.events.swap(c.events);
+    if (any) index.dropped.swap(drop);
+    std::vector<IcsEntry>().swap(c.entries);
+    std::vector<bool>().swap(c.taken);
+    std::vector<uint32_t>().swap(c.missed);
+    std::vector<CalEvent>().swap(c.events);
+    std::vector<CalEvent>().swap(c.previous);
+    return;
+  }
+
+  if (!any) return;
+  size_t n = 0;
+  for (size_t i = 0; i < out.size(); i++) {
+    if (drop[i]) continue;
+    if (n != i) out[n] = std::move(out[i]);
+    n++;
+  }
+  out.resize(n);
+}
+
+void icsIndexEvents(const IcsIndex& index, std::vector<CalEvent>& out) {
+  if (index.dropped.empty()) {
+    out.insert(out.end(), index.events.begin(), index.events.end());
+    return;
+  }
+  for (size_t i = 0; i < index.events.size(); i++) {
+    if (!index.dropped[i]) out.push_back(index.events[i]);
+  }
+}
@@ -0,0 +1,203 @@
+#pragma once
+
+// Calendar feeds read straight from their ICS, for displays that run
+// without the API (ICS_FEEDS in secrets.h). The parser is fed the response
+// body in whatever pieces the socket delivers, unfolds lines (RFC 5545
+// 3.1) as they complete and keeps nothing but the current line, the
+// feed's time zones and the VEVENT being read, so a feed of several
+// megabytes costs about a kilobyte of state. Each VEVENT is handed over
+// when its END:VEVENT arrives, and only if it can touch the window.
+//
+// Times come out the way ingestCalendarJson() makes them from the API's
+// UTC strings (parseISO() of "YYYY-MM-DDTHH:MM:SS"), all-day dates as that
+// day's midnight, so either path yields the same events:
+//   DTSTART:20260115T080000Z                  UTC
+//   DTSTART;TZID=Europe/Berlin:20260115T090000  via the feed's VTIMEZONE
+//   DTSTART:20260115T090000                   floating, taken as UTC like
+//                                             the API does on its servers
+//   DTSTART;VALUE=DATE:20260115               all day
+// A TZID the feed has no VTIMEZONE for is taken as UTC as well.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <utility>
+#include <vector>
+#include "calendar.h"
+
+#define ICS_LINE_MAX 320        // Longer unfolded lines are cut (descriptions, attendee lists)
+#define ICS_ZONES 4             // VTIMEZONEs kept per feed
+#define ICS_OBSERVANCES 4       // STANDARD/DAYLIGHT blocks kept per zone (the latest ones)
+#define ICS_TZID_MAX 48
+#define ICS_MAX_OCCURRENCES 500  // Per series and window, like feeds.ts MAX_OCCURRENCES
+
+// One STANDARD or DAYLIGHT block: the offset that applies from its
+// transition on, every year if it has a rule
+struct IcsObservance {
+  int32_t offset;         // TZOFFSETTO, seconds east of UTC
+  int32_t sinceDay;       // DTSTART as days since 1970-01-01
+  int32_t secs;           // Local time of day of the transition
+  uint8_t month;          // Yearly rule: BYMONTH, 0 = no rule
+  int8_t week;            // BYDAY position, 1..5 or -1 (last), 0 = on `monthDay`
+  uint8_t weekday;        // BYDAY day, 0 = Sunday, 7 = none
+  uint8_t monthDay;       // First day a BYMONTHDAY list allows, or DTSTART's day
+  int32_t untilDay;       // Rule's UNTIL, INT32_MAX if none
+};
+
+struct IcsZone {
+  char tzid[ICS_TZID_MAX];
+  IcsObservance obs[ICS_OBSERVANCES];
+  uint8_t count;
+};
+
+// Stamps are resolved at END:VEVENT, once DTEND/DURATION are known
+struct IcsStamp {
+  int32_t day;            // Days since 1970-01-01, INT32_MIN if absent
+  int32_t secs;
+  bool date;
+  int8_t zone;            // Index into zones, -1 for UTC/floating
+};
+
+// A VEVENT as the parser hands it over
+struct IcsEvent {
+  String uid;
+  String title;           // "Untitled" if it has no SUMMARY, like the API
+  String location;
+  IcsStamp dtstart;       // As written, for expanding RRULE
+  time_t start;
+  time_t end;             // DTEND, else DTSTART + DURATION, else a day for dates
+  bool allDay;
+  bool cancelled;         // STATUS:CANCELLED or a "Canceled:" title
+  String rrule;           // RRULE value, empty for single events
+  time_t recurrenceId;    // The instance this one replaces, 0 if none
+  std::vector<time_t> exdates;
+  uint64_t hash;          // Content, see IcsIndex
+};
+
+typedef void (*IcsEventFn)(void* ctx, const IcsEvent& event);
+
+// Where in the feed the parser is
+enum IcsScope {
+  ICS_OUTSIDE,            // VCALENDAR level
+  ICS_EVENT,
+  ICS_ZONE,
+  ICS_ZONE_OBSERVANCE,
+  ICS_SKIP                // VALARM, VTODO, ...: until the matching END
+};
+
+struct IcsParser {
+  time_t from, to;        // Window, in the same terms as CalEvent times
+  char line[ICS_LINE_MAX];
+  uint16_t lineLen;
+  bool lineCut;           // Bytes past ICS_LINE_MAX were dropped
+  bool lineBreak;         // Line ended; the next byte says if it continues
+  IcsScope scope;
+  IcsScope skipReturn;    // Scope after ICS_SKIP
+  uint8_t skipDepth;      // Components open since ICS_SKIP began
+  IcsEvent event;
+  IcsStamp start, end, recurrenceId;
+  int32_t duration;       // Seconds, -1 if none
+  IcsZone zones[ICS_ZONES];
+  uint8_t zoneCount;
+  IcsObservance observance;   // Being read
+  uint64_t zoneHash;      // VTIMEZONE lines so far, part of every event's hash
+  uint32_t bytes;
+  uint32_t vevents;       // Seen
+  uint32_t emitted;       // Handed to the callback
+};
+
+// Start a feed. `from`/`to` as in CalEvent; VEVENTs entirely outside are
+// dropped, except overrides whose replaced instance is inside.
+void icsBegin(IcsParser& p, time_t from, time_t to);
+
+// Feed body bytes; `onEvent` is called for each VEVENT in the window
+void icsFeed(IcsParser& p, const char* bytes, size_t len, IcsEventFn onEvent, void* ctx);
+
+// Finish the last line, for feeds that don't end with a line break
+void icsEnd(IcsParser& p, IcsEventFn onEvent, void* ctx);
+
+// One VEVENT of a feed's last download and the events it made
+struct IcsEntry {
+  uint32_t uid;           // UID hash
+  time_t recurrenceId;    // 0 for masters and single events
+  uint64_t hash;          // IcsEvent::hash
+  uint32_t first;         // Its events in IcsIndex::events
+  uint16_t count;
+  bool series;            // A master; its events are instances
+  bool unsupported;       // ... of a rule rrule.h can't expand
+};
+
+// What a VEVENT did between the index's download and this one
+enum IcsChangeKind : uint8_t { ICS_ADDED, ICS_CHANGED, ICS_REMOVED };
+
+struct IcsChange {
+  uint32_t uid;
+  time_t recurrenceId;
+  IcsChangeKind kind;
+};
+
+// Kept per feed from one download to the next. Each VEVENT is hashed as
+// it is read: its unfolded lines except DTSTAMP (which Google rewrites on
+// every download) and nested VALARMs, plus the feed's VTIMEZONEs read so
+// far. A VEVENT with the same UID, RECURRENCE-ID and hash as last time
+// takes its events from here instead of being expanded again, so a feed
+// where one event changed costs its parsing and one expansion. Lines past
+// ICS_LINE_MAX aren't hashed, but nothing reads them either.
+//
+// The events depend on the window and color too; when either differs
+// (the window moves at midnight) everything is expanded again.
+//
+// The index owns the feed's events, so reusing them is a move, not a
+// copy: icsIndexEvents() copies out the ones overrides left, once, into
+// whatever gets published.
+struct IcsIndex {
+  time_t from, to;
+  uint16_t color;
+  std::vector<IcsEntry> entries;   // In download order
+  std::vector<uint32_t> slots;     // Entries by UID and RECURRENCE-ID: open
+                                   // addressing, index + 1, 0 when free
+  std::vector<CalEvent> events;    // Before overrides take instances out
+  std::vector<bool> dropped;       // Taken out by overrides; empty if none
+};
+
+// Appends the index's events that no override took out
+void icsIndexEvents(const IcsIndex& index, std::vector<CalEvent>& out);
+
+// Turns VEVENTs into the events the API would have sent for the parser's
+// window: cancelled ones dropped, series expanded (rrule.h) with their
+// EXDATEs and overrides applied. Pass icsCollect as the IcsEventFn and the
+// collector as its context; overrides may come before or after their
+// series, so instances they replace leave `out` in icsCollectEnd().
+//
+// Collecting into an `index` instead of `out`, unchanged VEVENTs move
+// their events over from it, and icsCollectEnd() lists in `changes` what
+// differs from the index's download before replacing it with this one;
+// the events stay in the index (icsIndexEvents()). `rebuilt` means the
+// index didn't apply (other window or color): every VEVENT is listed, as
+// changed if it was in both downloads, else as added or removed. A
+// download that never reaches icsCollectEnd() leaves the index to be
+// rebuilt, since its events may have moved out already.
+struct IcsCollector {
+  const IcsParser* parser;
+  uint16_t color;
+  std::vector<CalEvent>* out;
+  std::vector<std::pair<uint32_t, time_t>> replaced;   // UID hash, RECURRENCE-ID
+  std::vector<std::pair<uint32_t, size_t>> instances;  // UID hash, index in *out
+  uint32_t series;        // Recurring masters seen
+  uint32_t unsupported;   // ... with a rule rrule.h can't expand (DTSTART only)
+  IcsIndex* index;        // NULL: expand everything
+  bool rebuilt;
+  std::vector<CalEvent> events;      // With an index, this download's
+  std::vector<CalEvent> previous;    // ... and the index's, moved from when reused
+  std::vector<IcsEntry> entries;     // This download's
+  std::vector<bool> taken;           // Index entries reused so far
+  uint32_t next;                     // The index's entry after the last one reused
+  std::vector<uint32_t> missed;      // Entries that reused nothing
+  std::vector<IcsChange> changes;    // Filled by icsCollectEnd()
+  uint32_t reused;        // VEVENTs whose events came from the index
+};
+
+void icsCollectBegin(IcsCollector& c, const IcsParser& p, uint16_t color, std::vector<CalEvent>& out);
+void icsCollectBegin(IcsCollector& c, const IcsParser& p, uint16_t color, IcsIndex& index);
+void icsCollect(void* collector, const IcsEvent& event);
+void icsCollectEnd(IcsCollector& c);
@@ -0,0 +1,190 @@
+#include "ingest.h"
+#include "profiler.h"
+#include <ArduinoJson.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+// "YYYY-MM-DDTHH:MM:SS" as wall time, without a time zone
+static bool parseWall(const char* iso, int32_t& day, int32_t& secs) {
+  int y, m, d, hh, mm, ss;
+  if (sscanf(iso, "%d-%d-%dT%d:%d:%d", &y, &m, &d, &hh, &mm, &ss) != 6) return false;
+  day = daysFromCivil(y, m, d);
+  secs = hh * 3600 + mm * 60 + ss;
+  return true;
+}
+
+// &series=1: {"zones": [{"id", "o": [[wall, offset], ...]}],
+//             "series": [{"t", "c", "l", "a", "s", "d", "z", "r", "x": [...]}]}
+static void ingestSeries(JsonDocument& doc, size_t firstCal, const std::vector<CalInfo>& calendars, SeriesSet& out) {
+  int zoneBase = out.zones.size();
+  size_t firstSeries = out.series.size();
+  JsonArray zones = doc["zones"];
+  for (JsonVariant z : zones) {
+    SeriesZone zone;
+    JsonArray shifts = z["o"];
+    for (JsonVariant o : shifts) {
+      int32_t day, secs;
+      if (!parseWall(o[0] | "", day, secs)) continue;
+      SeriesShift shift = {(int64_t)day * 86400 + secs, o[1] | 0};
+      zone.shifts.push_back(shift);
+    }
+    out.zones.push_back(zone);
+  }
+
+  JsonArray series = doc["series"];
+  out.series.reserve(out.series.size() + series.size());
+  for (JsonVariant v : series) {
+    CalSeries s;
+    if (!parseWall(v["s"] | "", s.startDay, s.startSecs)) continue;
+    if (!rruleParse(v["r"] | "", s.rule)) {
+      // Not a rule this firmware knows (the API only sends ones it does):
+      // show the first instance
+      s.rule.freq = RRULE_DAILY;
+      s.rule.count = 1;
+      s.rule.hasUntil = false;
+    }
+    s.title = v["t"] | "";
+    size_t cal = firstCal + (v["c"] | 0);
+    s.color = cal < calendars.size() ? calendars[cal].color : 0;
+    s.location = v["l"] | "";
+    s.allDay = v["a"] | 0;
+    s.duration = v["d"] | 0;
+    int zone = v["z"] | -1;
+    s.zone = zone >= 0 ? zoneBase + zone : -1;
+    JsonArray skip = v["x"];
+    for (JsonVariant x : skip) s.skip.push_back(parseISO(x | ""));
+    out.series.push_back(s);
+  }
+  seriesPrepare(out, firstSeries);
+  seriesMeasure(out, parseISO(doc["from"] | ""), parseISO(doc["to"] | ""));
+}
+
+bool ingestCalendarJson(const char* payload, size_t length,
+                        std::vector<CalEvent>& events, std::vector<CalInfo>& calendars,
+                        const char** error, SeriesSet* series) {
+  DynamicJsonDocument doc(32768); // ~32KB buffer
+  DeserializationError err;
+  {
+    PROF_SCOPE(PROF_JSON_PARSE);
+    err = deserializeJson(doc, payload, length);
+  }
+  if (err) {
+    *error = err.c_str();
+    return false;
+  }
+
+  PROF_SCOPE(PROF_INGEST);
+  size_t firstCal = calendars.size();
+  JsonArray cals = doc["calendars"];
+  for (JsonVariant c : cals) {
+    CalInfo ci;
+    ci.name = c["name"] | "";
+    ci.color = hexToRGB(c["color"] | "");
+    calendars.push_back(ci);
+  }
+
+  JsonArray evts = doc["events"];
+  events.reserve(events.size() + evts.size());
+  if (!strcmp(doc["profile"] | "", "device")) {
+    // ?profile=device: short keys, defaults left out, calendar index
+    for (JsonVariant v : evts) {
+      CalEvent e;
+      e.title = v["t"] | "";
+      e.start = parseISO(v["s"] | "");
+      e.end = parseISO(v["e"] | "");
+      size_t cal = firstCal + (v["c"] | 0);
+      e.color = cal < calendars.size() ? calendars[cal].color : 0;   // Like a missing "color"
+      e.location = v["l"] | "";
+      e.allDay = v["a"] | 0;
+      events.push_back(e);
+    }
+    if (!doc["series"].isNull()) {
+      if (series) {
+        ingestSeries(doc, firstCal, calendars, *series);
+      } else {
+        // A caller without a series store gets the instances, merged in
+        // start order like the API sends them
+        SeriesSet set;
+        ingestSeries(doc, firstCal, calendars, set);
+        seriesExpand(set, parseISO(doc["from"] | ""), parseISO(doc["to"] | ""), events);
+        std::stable_sort(events.begin(), events.end(),
+                         [](const CalEvent& a, const CalEvent& b) { return a.start < b.start; });
+      }
+    }
+    return true;
+  }
+
+  for (JsonVariant v : evts) {
+    CalEvent e;
+    e.title = v["title"] | "";
+    e.start = parseISO(v["start"] | "");
+    e.end = parseISO(v["end"] | "");
+    e.color = hexToRGB(v["color"] | "");
+    e.location = v["location"] | "";
+    e.allDay = v["allDay"];
+    events.push_back(e);
+  }
+  return true;
+}
+
+bool ingestLayoutJson(const char* payload, size_t length, PageLayout& page, const char** error) {
+  DynamicJsonDocument doc(32768);
+  DeserializationError err;
+  {
+    PROF_SCOPE(PROF_JSON_PARSE);
+    err = deserializeJson(doc, payload, length);
+  }
+  if (err) {
+    *error = err.c_str();
+    return false;
+  }
+
+  PROF_SCOPE(PROF_INGEST);
+  const char* layout = doc["layout"] | "";
+  ViewMode view;
+  if (!strcmp(layout, "day")) view = VIEW_DAY;
+  else if (!strcmp(layout, "week")) view = VIEW_WEEK;
+  else if (!strcmp(layout, "month")) view = VIEW_MONTH;
+  else {
+    *error = "unknown layout";
+    return false;
+  }
+  struct tm start = {0};
+  if (!strptime(doc["start"] | "", "%Y-%m-%d", &start)) {
+    *error = "bad start date";
+    return false;
+  }
+  start.tm_isdst = -1;
+  page.view = view;
+  page.start = mktime(&start);
+
+  page.dayFirst.clear();
+  page.events.clear();
+  page.calendars.clear();
+  JsonArray days = doc["days"];
+  for (JsonArray day : days) {
+    page.dayFirst.push_back(page.events.size());
+    for (JsonVariant v : day) {
+      PlacedEvent e;
+      e.title = v["t"] | "";
+      e.label = v["l"] | "";
+      e.startMin = v["s"] | 0;
+      e.endMin = v["e"] | 0;
+      e.col = v["col"] | 0;
+      e.cols = v["cols"] | 1;
+      e.cal = v["c"] | 0;
+      page.events.push_back(e);
+    }
+  }
+  page.dayFirst.push_back(page.events.size());
+
+  JsonArray cals = doc["calendars"];
+  for (JsonVariant c : cals) {
+    CalInfo ci;
+    ci.name = c["name"] | "";
+    ci.color = hexToRGB(c["color"] | "");
+    page.calendars.push_back(ci);
+  }
+  return true;
+}
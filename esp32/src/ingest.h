@@ -0,0 +1,21 @@
+#pragma once
+
+// /api/calendar response body -> event model. Used by the network task and
+// by the host benchmarks.
+
+#include <stddef.h>
+#include "calendar.h"
+#include "layout.h"
+#include "series.h"
+
+// Appends to events/calendars. Reads the full response and the trimmed
+// ?profile=device one. Compact series (&series=1) go to `series` when
+// given, ready for seriesForDay(); without it they are expanded into
+// `events` for the response's window. On a JSON error returns false and
+// points *error at a static description.
+bool ingestCalendarJson(const char* payload, size_t length,
+                        std::vector<CalEvent>& events, std::vector<CalInfo>& calendars,
+                        const char** error, SeriesSet* series = NULL);
+
+// ?layout= response body -> page. Replaces `page` only on success.
+bool ingestLayoutJson(const char* payload, size_t length, PageLayout& page, const char** error);
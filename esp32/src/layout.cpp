@@ -0,0 +1,132 @@
+#include "layout.h"
+#include "profiler.h"
+#include "alloc_track.h"
+
+int eventsForDay(std::vector<CalEvent>& events, time_t dayStart, CalEvent** out, int maxEvents) {
+  PROF_SCOPE(PROF_DAY_QUERY);
+  ALLOC_SCOPE(ALLOC_LAYOUT);
+  struct tm dayTm;
+  localtime_r(&dayStart, &dayTm);
+  dayTm.tm_hour = 0; dayTm.tm_min = 0; dayTm.tm_sec = 0;
+  time_t dayMin = mktime(&dayTm);
+  dayTm.tm_hour = 23; dayTm.tm_min = 59; dayTm.tm_sec = 59;
+  time_t dayMax = mktime(&dayTm);
+
+  int count = 0;
+  for (auto& e : events) {
+    if (e.start < dayMax && e.end > dayMin) {
+      if (count < maxEvents) {
+        out[count++] = &e;
+      }
+    }
+  }
+  return count;
+}
+
+void sortEvents(CalEvent** events, int count) {
+  for (int i = 1; i < count; i++) {
+    CalEvent* key = events[i];
+    int j = i - 1;
+    while (j >= 0 && events[j]->start > key->start) {
+      events[j + 1] = events[j];
+      j--;
+    }
+    events[j + 1] = key;
+  }
+}
+
+static float hourOf(time_t t) {
+  struct tm tm;
+  localtime_r(&t, &tm);
+  return tm.tm_hour + tm.tm_min / 60.0;
+}
+
+void layoutDay(CalEvent** events, int count, LayoutInfo* out) {
+  PROF_SCOPE(PROF_LAYOUT);
+  ALLOC_SCOPE(ALLOC_LAYOUT);
+  sortEvents(events, count);
+
+  float colEndTimes[MAX_DAY_COLUMNS];
+  for (int k = 0; k < MAX_DAY_COLUMNS; k++) colEndTimes[k] = -1.0;
+
+  for (int i = 0; i < count; i++) {
+    float startH = hourOf(events[i]->start);
+    float endH = hourOf(events[i]->end);
+    out[i].startH = startH;
+    out[i].endH = endH;
+
+    int placedCol = 0;
+    for (int c = 0; c < MAX_DAY_COLUMNS; c++) {
+      if (startH >= colEndTimes[c]) {
+        placedCol = c;
+        colEndTimes[c] = endH;
+        break;
+      }
+    }
+    out[i].col = placedCol;
+  }
+}
+
+void layoutWeekDay(CalEvent* const* events, int count, WeekSlot* out) {
+  PROF_SCOPE(PROF_LAYOUT);
+  ALLOC_SCOPE(ALLOC_LAYOUT);
+  for (int i = 0; i < count; i++) {
+    out[i].startH = hourOf(events[i]->start);
+    out[i].endH = hourOf(events[i]->end);
+  }
+
+  for (int i = 0; i < count; i++) {
+    int overlapCount = 0;
+    int myColumn = 0;
+    for (int j = 0; j < count; j++) {
+      if (i == j) continue;
+      float lo = out[i].startH > out[j].startH ? out[i].startH : out[j].startH;
+      float hi = out[i].endH < out[j].endH ? out[i].endH : out[j].endH;
+      if (lo < hi) {
+        overlapCount++;
+        // Column order by start time, then by index
+        if (out[j].startH < out[i].startH || (out[j].startH == out[i].startH && j < i)) {
+          myColumn++;
+        }
+      }
+    }
+    out[i].col = myColumn;
+    out[i].cols = overlapCount + 1;
+  }
+}
+
+struct tm monthGridStart(const struct tm& viewDate) {
+  struct tm firstOfMonth = viewDate;
+  firstOfMonth.tm_mday = 1;
+  mktime(&firstOfMonth);
+
+  // Mon=0, Sun=6 adjustment
+  int startDayOfWeek = firstOfMonth.tm_wday - 1;
+  if (startDayOfWeek < 0) startDayOfWeek = 6;
+
+  struct tm gridStart = firstOfMonth;
+  gridStart.tm_mday -= startDayOfWeek;
+  mktime(&gridStart);
+  return gridStart;
+}
+
+time_t pageStart(ViewMode view, const struct tm& viewDate) {
+  struct tm first = view == VIEW_MONTH ? monthGridStart(viewDate) : viewDate;
+  if (view == VIEW_WEEK) {
+    int daysSinceMon = first.tm_wday - 1;
+    if (daysSinceMon < 0) daysSinceMon = 6;
+    first.tm_mday -= daysSinceMon;
+  }
+  first.tm_hour = 0; first.tm_min = 0; first.tm_sec = 0;
+  first.tm_isdst = -1;
+  return mktime(&first);
+}
+
+struct tm pageShift(ViewMode view, const struct tm& viewDate, int pages) {
+  struct tm out = viewDate;
+  if (view == VIEW_MONTH) out.tm_mon += pages;
+  else out.tm_mday += pages * (view == VIEW_WEEK ? 7 : 1);
+  out.tm_isdst = -1;
+  mktime(&out);
+  return out;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+// Event selection and placement for the views, independent of the display
+// so it can be measured on a host (see host/bench/).
+
+#include "calendar.h"
+
+#define MAX_DAY_COLUMNS 10
+
+enum ViewMode { VIEW_DAY, VIEW_WEEK, VIEW_MONTH };
+
+// Day view: greedy column packing
+struct LayoutInfo {
+  int col;
+  float startH;
+  float endH;
+};
+
+// Week view: side-by-side only when overlapping
+struct WeekSlot {
+  float startH;
+  float endH;
+  int col;      // Position among the events this one overlaps
+  int cols;     // 1 + number of events it overlaps
+};
+
+// Events intersecting the local day that contains dayStart, in list order
+int eventsForDay(std::vector<CalEvent>& events, time_t dayStart, CalEvent** out, int maxEvents);
+
+// Stable sort by start time (insertion sort; day lists are short)
+void sortEvents(CalEvent** events, int count);
+
+// Sorts `events` and assigns columns
+void layoutDay(CalEvent** events, int count, LayoutInfo* out);
+void layoutWeekDay(CalEvent* const* events, int count, WeekSlot* out);
+
+// First cell of the 6x7 month grid (the Monday on or before the 1st)
+struct tm monthGridStart(const struct tm& viewDate);
+
+// Local midnight of the first day on the page showing viewDate
+time_t pageStart(ViewMode view, const struct tm& viewDate);
+
+// `viewDate` moved by `pages` pages, as the header arrows and swipes do
+struct tm pageShift(ViewMode view, const struct tm& viewDate, int pages);
+
+// Days on one page: the day, Monday to Sunday, or the 6x7 month grid
+inline int pageDayCount(ViewMode view) {
+  return view == VIEW_DAY ? 1 : view == VIEW_WEEK ? 7 : 42;
+}
+
+// Server-side layout (/api/calendar?layout=...): one page of one view,
+// events already bucketed per day, placed and clipped by the API, so
+// drawing it needs no date math, sorting or overlap checks
+struct PlacedEvent {
+  String title;      // Clipped to its box; empty when there's no room
+  String label;      // Day view: "HH:MM-HH:MM"
+  int16_t startMin;  // Week, day: minutes after midnight, within the visible hours
+  int16_t endMin;
+  uint8_t col;       // Week, day: column, and columns sharing the width
+  uint8_t cols;
+  uint8_t cal;       // Index into calendars
+};
+
+struct PageLayout {
+  ViewMode view;
+  time_t start;                    // Local midnight of the first day
+  std::vector<uint16_t> dayFirst;  // Day d is events[dayFirst[d] .. dayFirst[d + 1])
+  std::vector<PlacedEvent> events;
+  std::vector<CalInfo> calendars;
+};
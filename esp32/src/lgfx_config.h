@@ -3,6 +3,11 @@
 // LovyanGFX configuration for Makerfabs MaTouch ESP32-S3 7" (1024x600)
 // Adjust pins if needed for your specific board revision
 
+#ifndef ARDUINO
+// Replay build: draws into a host framebuffer instead
+#include "host/replay/lgfx_host.h"
+#else
+
 #define LGFX_USE_V1
 #include <LovyanGFX.hpp>
 
@@ -100,3 +105,5 @@ public:
     setPanel(&_panel_instance);
   }
 };
+
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+
+// Every binlog message: id, level, printf format. Records store only the
+// id and the raw arguments, so formats live here, once, and the host
+// decoder (host/logdecode/) reads the same table. Append new messages at
+// the end; reordering changes the ids and the table hash in every dump.
+//
+// Length modifiers in the formats are ignored; each argument is printed
+// with the width it was recorded with.
+
+#define LOG_MESSAGES(X) \
+  X(LOG_BOOT_MARK,        LOG_INFO,  "[boot] +%lu ms %s") \
+  X(LOG_NET_RETRY,        LOG_INFO,  "[net] retry in %lu ms") \
+  X(LOG_NET_BAD_URL,      LOG_ERROR, "[net] bad API_URL: %s") \
+  X(LOG_NET_DNS_FAILED,   LOG_WARN,  "[net] DNS failed: %s") \
+  X(LOG_NET_CONNECT_FAILED, LOG_WARN, "[net] connect failed: %s:%u") \
+  X(LOG_NET_GET_FAILED,   LOG_WARN,  "[net] GET failed: %d") \
+  X(LOG_NET_JSON_ERROR,   LOG_WARN,  "[net] JSON error: %s") \
+  X(LOG_NET_REFRESH,      LOG_DEBUG, "[net] refresh %s: status %d, %lu us, %lu bytes, %lu events") \
+  X(LOG_ALLOC_OVER_BUDGET, LOG_WARN, "[alloc] %s over budget") \
+  X(LOG_REC_FULL,         LOG_WARN,  "[rec] full, stopped") \
+  X(LOG_HUD_NO_MEMORY,    LOG_WARN,  "[hud] no memory for overlay") \
+  X(LOG_UI_FRAME,         LOG_DEBUG, "[ui] frame view=%d layout=%d steps=%d render=%lu us present=%lu us") \
+  X(LOG_UI_GESTURE,       LOG_DEBUG, "[ui] gesture %d at %d,%d dx=%d dy=%d") \
+  X(LOG_UI_EVENTS,        LOG_DEBUG, "[ui] took %u events from %u calendars") \
+  X(LOG_NET_PAGE,         LOG_DEBUG, "[net] page %s: status %d, %lu us, %lu bytes, %lu events") \
+  X(LOG_NET_TILES,        LOG_DEBUG, "[net] tiles %s: status %d, %lu us, %lu bytes, %u fetched, %u not modified, %u reused") \
+  X(LOG_NET_WATCH_OPEN,   LOG_DEBUG, "[net] watching %s for changes") \
+  X(LOG_NET_WATCH_CHANGE, LOG_DEBUG, "[net] data version %s, refreshing") \
+  X(LOG_NET_WATCH_CLOSED, LOG_INFO,  "[net] change stream %s (status %d), reopening in %lu ms") \
+  X(LOG_NET_ICS_FEED,     LOG_DEBUG, "[net] feed %s: %lu bytes, %lu VEVENTs, %lu in the window") \
+  X(LOG_NET_ICS_RRULE,    LOG_WARN,  "[net] feed %s: %lu series with rules shown once (BYSETPOS, ...)") \
+  X(LOG_UI_SERIES,        LOG_DEBUG, "[ui] took %u recurring series in %u time zones") \
+  X(LOG_NET_ICS_SILENT,   LOG_WARN,  "[net] feed %s sent nothing for %u s") \
+  X(LOG_NET_ICS_DONE,     LOG_INFO,  "[net] %u feeds in %lu ms, slowest %s %lu ms") \
+  X(LOG_NET_ICS_CHANGES,  LOG_DEBUG, "[net] feed %s: %u added, %u changed, %u removed, %lu reused%s")
+
+#define LOG_MSG_ENUM(id, level, fmt) id,
+enum LogMsg { LOG_MESSAGES(LOG_MSG_ENUM) LOG_MSG_COUNT };
+#undef LOG_MSG_ENUM
@@ -10,12 +10,24 @@
  */
 
 #include <Arduino.h>
-#include <WiFi.h>
-#include <HTTPClient.h>
-#include <ArduinoJson.h>
 #include <time.h>
 #include "lgfx_config.h"
 #include "secrets.h"
+#include "calendar.h"
+#include "layout.h"
+#include "series.h"
+#include "tiles.h"
+#include "net.h"
+#include "timer_wheel.h"
+#include "profiler.h"
+#include "metrics.h"
+#include "alloc_track.h"
+#include "trace.h"
+#include "recorder.h"
+#include "refresh_log.h"
+#include "hud.h"
+#include "binlog.h"
+#include <algorithm>
 
 // Display
 static LGFX tft;
@@ -38,156 +50,101 @@ static LGFX tft;
 #define COLOR_ACCENT    0x634F 
 #define COLOR_DIM_TEXT  0x39E7
 
-enum ViewMode { VIEW_DAY, VIEW_WEEK, VIEW_MONTH };
-
-struct CalEvent {
-  String title;
-  time_t start;
-  time_t end;
-  uint16_t color;
-  String location;
-  bool allDay;
-};
-
-struct CalInfo {
-  String name;
-  uint16_t color;
-  String id;
-};
-
 // Globals
 ViewMode currentView = VIEW_WEEK;
 struct tm viewDate;
-unsigned long lastRefresh = 0;
+bool timeValid = false;
 
 std::vector<CalEvent> events;
 std::vector<CalInfo> calendars;
+SeriesSet series;             // Recurring events, expanded per day as drawn (series.h)
+SeriesDays seriesDays;
+std::vector<CalEvent> reminderInstances;   // Series instances the reminder timers point into
+
+// Draw from pages laid out by the API (layout.h) instead of laying events
+// out here; 'm' on serial switches. Raw events are still fetched, and used
+// whenever the page for the current view hasn't arrived yet.
+#ifdef SERVER_LAYOUT
+bool serverLayout = true;
+#else
+bool serverLayout = false;
+#endif
+PageLayout page;
+bool pageValid = false;
+ViewMode requestedView = VIEW_WEEK;
+time_t requestedStart = 0;   // Page last asked for, 0 = none
+
+// Thin client (tiles.h): blit whole pages rendered by the tile server at
+// TILE_URL; 'g' on serial switches. Until the current page has been synced
+// it is drawn as above. panelTiles remembers which tile is on the panel at
+// each position, so only tiles that changed are drawn again.
+#ifdef TILE_URL
+bool thinClient = true;
+#else
+bool thinClient = false;
+#endif
+#define TILE_SLOTS (((SCREEN_WIDTH + TILE_W - 1) / TILE_W) * ((SCREEN_HEIGHT + TILE_H - 1) / TILE_H))
+#define TILE_PAGES 3   // The page shown and the ones either side
+std::shared_ptr<const TilePage> tilePages[TILE_PAGES];   // Newest first
+uint32_t panelTiles[TILE_SLOTS];                          // Tile hash, 0 = drawn some other way
+ViewMode requestedTileView = VIEW_WEEK;
+time_t requestedTileStart = 0;
 
 const char* monthNames[] = {"Januar", "Februar", "Maerz", "April", "Mai", "Juni", "Juli", "August", "September", "Oktober", "November", "Dezember"};
 const char* dayNamesShort[] = {"So", "Mo", "Di", "Mi", "Do", "Fr", "Sa"};
 const char* dayNamesLong[] = {"Sonntag", "Montag", "Dienstag", "Mittwoch", "Donnerstag", "Freitag", "Samstag"};
 
 // Touch state
+enum Gesture { GESTURE_TAP, GESTURE_SWIPE_LEFT, GESTURE_SWIPE_RIGHT };
 int touchX = -1, touchY = -1;
 int touchStartX = -1, touchStartY = -1;
 bool touched = false;
 unsigned long lastTouch = 0;
+int touchPoints = 0;        // Most fingers seen during the current touch
+bool longPressDone = false; // Header long-press already handled for this touch
+uint32_t inputUs = 0;       // micros() of the release being handled, 0 outside handleTouch()
+
+#define LONG_PRESS_MS 800
+
+// Time-driven work, all owned by the timer wheel
+#define MAX_REMINDERS 32
+#define REMINDER_HORIZON (24 * 3600)   // Arm reminders this far ahead
+#define REMINDER_SHOW_SECS (5 * 60)    // How long the header banner stays up
+
+WheelTimer minuteTimer;
+WheelTimer dayTimer;
+WheelTimer refreshTimer;
+WheelTimer reminderTimers[MAX_REMINDERS];
+WheelTimer reminderClearTimer;
+char reminderText[34] = "";
+int remindersArmed = 0;          // Armed reminder timers yet to fire
+bool remindersWaiting = false;   // More were due than MAX_REMINDERS
 
 // Forward declarations
 void draw();
-void fetchEvents();
-
-// Helpers
-uint16_t hexToRGB(String hex) {
-  if (hex.startsWith("#")) hex = hex.substring(1);
-  long number = strtol(hex.c_str(), NULL, 16);
-  uint8_t r = (number >> 16) & 0xFF;
-  uint8_t g = (number >> 8) & 0xFF;
-  uint8_t b = number & 0xFF;
-  return tft.color565(r, g, b);
-}
-
-time_t parseISO(String iso) {
-  struct tm t = {0};
-  strptime(iso.c_str(), "%Y-%m-%dT%H:%M:%S", &t);
-  return mktime(&t); // Assumes local time or needs adjustment if UTC
-}
+void scheduleReminders();
 
-bool connectWiFi() {
-  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-  int tries = 0;
-  while (WiFi.status() != WL_CONNECTED && tries < 20) {
-    delay(500);
-    tries++;
-  }
-  return WiFi.status() == WL_CONNECTED;
+int getEventsForDay(time_t dayStart, CalEvent** outEvents, int maxEvents) {
+  int count = eventsForDay(events, dayStart, outEvents, maxEvents);
+  int all = seriesForDay(series, seriesDays, dayStart, outEvents, count, maxEvents);
+  // Keep the API's start order with series instances mixed in
+  if (all > count) sortEvents(outEvents, all);
+  return all;
 }
 
-void syncTime() {
-  configTime(GMT_OFFSET * 3600, DST_OFFSET * 3600, NTP_SERVER);
-  struct tm timeinfo;
-  if(!getLocalTime(&timeinfo)){
+// Print text, cut to `keep` chars plus `suffix` when longer than `limit`.
+// Render steps must not allocate, so no String temporaries here.
+void printClipped(const String& text, unsigned limit, unsigned keep, const char* suffix) {
+  if (text.length() <= limit) {
+    tft.print(text.c_str());
     return;
   }
-  viewDate = timeinfo;
-}
-
-int getEventsForDay(time_t dayStart, CalEvent** outEvents, int maxEvents) {
-  struct tm dayTm;
-  localtime_r(&dayStart, &dayTm);
-  dayTm.tm_hour = 0; dayTm.tm_min = 0; dayTm.tm_sec = 0;
-  time_t dayMin = mktime(&dayTm);
-  dayTm.tm_hour = 23; dayTm.tm_min = 59; dayTm.tm_sec = 59;
-  time_t dayMax = mktime(&dayTm);
-
-  int count = 0;
-  for (auto& e : events) {
-    if (e.start < dayMax && e.end > dayMin) {
-      if (count < maxEvents) {
-        outEvents[count++] = &e;
-      }
-    }
-  }
-  return count;
-}
-
-bool fetchEvents() {
-    if(WiFi.status() != WL_CONNECTED) return false;
-    
-    HTTPClient http;
-    // Construct URL with range
-    // Simplify: just fetch -1 month to +2 months from now
-    time_t now; time(&now);
-    struct tm startTm; localtime_r(&now, &startTm);
-    startTm.tm_mon -= 1; mktime(&startTm);
-    struct tm endTm; localtime_r(&now, &endTm);
-    endTm.tm_mon += 2; mktime(&endTm);
-    
-    char url[256];
-    char startIso[30], endIso[30];
-    strftime(startIso, sizeof(startIso), "%Y-%m-%dT%H:%M:%SZ", &startTm);
-    strftime(endIso, sizeof(endIso), "%Y-%m-%dT%H:%M:%SZ", &endTm);
-    
-    snprintf(url, sizeof(url), "%s?from=%s&to=%s", API_URL, startIso, endIso);
-    
-    http.begin(url);
-    http.addHeader("x-api-key", API_SECRET);
-    
-    int code = http.GET();
-    if(code == HTTP_CODE_OK) {
-        String payload = http.getString();
-        DynamicJsonDocument doc(32768); // ~32KB buffer
-        DeserializationError error = deserializeJson(doc, payload);
-        
-        if(!error) {
-            events.clear();
-            JsonArray evts = doc["events"];
-            for(JsonVariant v : evts) {
-                CalEvent e;
-                e.title = v["title"].as<String>();
-                e.start = parseISO(v["start"].as<String>());
-                e.end = parseISO(v["end"].as<String>());
-                e.color = hexToRGB(v["color"].as<String>());
-                e.location = v["location"] | "";
-                e.allDay = v["allDay"];
-                events.push_back(e);
-            }
-            
-            calendars.clear();
-            JsonArray cals = doc["calendars"];
-            for(JsonVariant c : cals) {
-               CalInfo ci;
-               ci.name = c["name"].as<String>();
-               ci.color = hexToRGB(c["color"].as<String>());
-               calendars.push_back(ci);
-            }
-            lastRefresh = millis();
-            http.end();
-            return true;
-        }
-    }
-    http.end();
-    return false;
+  char buf[96];
+  if (keep >= sizeof(buf)) keep = sizeof(buf) - 1;
+  memcpy(buf, text.c_str(), keep);
+  buf[keep] = 0;
+  tft.print(buf);
+  tft.print(suffix);
 }
 
 void drawLegend() {
@@ -226,6 +183,15 @@ void drawHeader() {
   tft.setCursor(80, 12);
   tft.print(title);
 
+  // Reminder banner for an event that just started
+  if (reminderText[0]) {
+    tft.fillRoundRect(350, 8, 400, 34, 4, COLOR_NOW);
+    tft.setTextColor(COLOR_TEXT);
+    tft.setTextSize(2);
+    tft.setCursor(360, 18);
+    tft.print(reminderText);
+  }
+
   // Right arrow
   tft.fillTriangle(SCREEN_WIDTH - 20, 25, SCREEN_WIDTH - 40, 10, SCREEN_WIDTH - 40, 40, COLOR_TEXT);
 
@@ -249,132 +215,171 @@ void drawHeader() {
   }
 }
 
-// Draw month view
-void drawMonthView() {
-  tft.fillScreen(COLOR_BG);
-  drawHeader();
-
-  struct tm firstOfMonth = viewDate;
-  firstOfMonth.tm_mday = 1;
-  mktime(&firstOfMonth);
+// Rendering is split into small resumable steps so touch input can be
+// polled between them. draw() (re)starts a frame; renderSlice() advances it
+// until the time budget is used up. Starting a new frame abandons the old one.
+#define RENDER_SLICE_MS 8
+#define MAX_DAY_EVENTS 30
+
+struct RenderJob {
+  bool active;
+  ViewMode view;
+  int step;
+  struct tm today;
+  struct tm gridStart;   // Month: first cell, Week: Monday
+  // Day view layout, computed once per frame
+  CalEvent* dayEvents[MAX_DAY_EVENTS];
+  LayoutInfo layouts[MAX_DAY_EVENTS];
+  int numEvents;
+  const PageLayout* page; // Server-side layout for this frame, NULL to lay out here
+  std::shared_ptr<const TilePage> tiles;   // Thin client: page to blit, NULL to draw here
+  uint32_t frameStart;   // profCycles() when draw() was called
+  uint32_t startUs;      // micros() when draw() was called
+  uint32_t inputUs;      // Release that caused this frame, 0 if none
+  uint32_t renderUs;     // Time spent in steps, excluding yields
+  // Series day buckets (series.h) made one per step ahead of the view's
+  // steps, which then only read them
+  struct tm fillStart;   // First day of the page
+  int fillNext;
+  int fillDays;          // 0 when the frame draws no events of its own
+};
 
-  // Mon=0, Sun=6 adjustment
-  int startDayOfWeek = firstOfMonth.tm_wday - 1;
-  if (startDayOfWeek < 0) startDayOfWeek = 6;
+RenderJob job;
 
-  struct tm gridStart = firstOfMonth;
-  gridStart.tm_mday -= startDayOfWeek;
-  mktime(&gridStart);
+uint16_t pageColor(const PlacedEvent& e) {
+  return e.cal < job.page->calendars.size() ? job.page->calendars[e.cal].color : COLOR_ACCENT;
+}
 
-  time_t now; time(&now);
-  struct tm today; localtime_r(&now, &today);
+// Month view
+void drawPlacedMonthEvents(int cell, int x, int y, int cellW, bool isCurrentMonth) {
+  const PageLayout& p = *job.page;
+  int evtY = y + 28;
+  for (int i = p.dayFirst[cell]; i < p.dayFirst[cell + 1]; i++) {
+    uint16_t color = pageColor(p.events[i]);
+    if (!isCurrentMonth) color = (color >> 1) & 0x7BEF;
+    tft.fillRoundRect(x + 3, evtY, cellW - 6, 14, 2, color);
+    tft.setTextColor(COLOR_TEXT);
+    tft.setTextSize(1);
+    tft.setCursor(x + 5, evtY + 3);
+    tft.print(p.events[i].title.c_str());
+    evtY += 16;
+  }
+}
 
-  // Metrics
+void drawMonthCell(int i) {
   int startY = 80; // Below header + weekdays
   int cellW = SCREEN_WIDTH / 7;
   int cellH = (SCREEN_HEIGHT - startY) / 6;
 
-  const char* weekDaysDe[] = {"Mo", "Di", "Mi", "Do", "Fr", "Sa", "So"};
-  tft.setTextColor(COLOR_TEXT_DIM);
+  struct tm currentDay = job.gridStart;
+  currentDay.tm_mday += i;
+  time_t currentDayTime = mktime(&currentDay);
+
+  int col = i % 7;
+  int row = i / 7;
+  int x = col * cellW;
+  int y = startY + row * cellH;
+
+  bool isCurrentMonth = (currentDay.tm_mon == viewDate.tm_mon);
+  bool isToday = (currentDay.tm_mday == job.today.tm_mday &&
+                  currentDay.tm_mon == job.today.tm_mon &&
+                  currentDay.tm_year == job.today.tm_year);
+
+  if (isToday) {
+    tft.fillRect(x, y, cellW, cellH, COLOR_TODAY);
+  } 
+
+  tft.drawRect(x, y, cellW, cellH, COLOR_GRID);
+
   tft.setTextSize(2);
-  for (int i = 0; i < 7; i++) {
-    tft.setCursor(i * cellW + 10, HEADER_HEIGHT + 5); 
-    tft.print(weekDaysDe[i]);
-  }
+  tft.setCursor(x + 5, y + 5);
   
-  // 42 cells
-  for (int i = 0; i < 42; i++) {
-    struct tm currentDay = gridStart;
-    currentDay.tm_mday += i;
-    time_t currentDayTime = mktime(&currentDay);
+  if (isToday) tft.setTextColor(0xFFFF); 
+  else if (isCurrentMonth) tft.setTextColor(COLOR_TEXT_DIM);
+  else tft.setTextColor(COLOR_DIM_TEXT); 
 
-    int col = i % 7;
-    int row = i / 7;
-    int x = col * cellW;
-    int y = startY + row * cellH;
+  tft.print(currentDay.tm_mday);
 
-    bool isCurrentMonth = (currentDay.tm_mon == viewDate.tm_mon);
-    bool isToday = (currentDay.tm_mday == today.tm_mday &&
-                    currentDay.tm_mon == today.tm_mon &&
-                    currentDay.tm_year == today.tm_year);
-
-    if (isToday) {
-      tft.fillRect(x, y, cellW, cellH, COLOR_TODAY);
-    } 
+  if (job.page) {
+    drawPlacedMonthEvents(i, x, y, cellW, isCurrentMonth);
+    return;
+  }
 
-    tft.drawRect(x, y, cellW, cellH, COLOR_GRID);
+  CalEvent* dayEvents[5];
+  int numEvents = getEventsForDay(currentDayTime, dayEvents, 5);
 
-    tft.setTextSize(2);
-    tft.setCursor(x + 5, y + 5);
+  int evtY = y + 28;
+  for (int e = 0; e < numEvents && evtY < y + cellH - 10; e++) {
+    uint16_t color = dayEvents[e]->color;
+    if (!isCurrentMonth) {
+       color = (color >> 1) & 0x7BEF; 
+    }
+    
+    tft.fillRoundRect(x + 3, evtY, cellW - 6, 14, 2, color);
+    tft.setTextColor(COLOR_TEXT);
+    tft.setTextSize(1);
+    tft.setCursor(x + 5, evtY + 3);
     
-    if (isToday) tft.setTextColor(0xFFFF); 
-    else if (isCurrentMonth) tft.setTextColor(COLOR_TEXT_DIM);
-    else tft.setTextColor(COLOR_DIM_TEXT); 
+    printClipped(dayEvents[e]->title, 12, 11, "..");
+    evtY += 16;
+  }
+}
 
-    tft.print(currentDay.tm_mday);
+// Steps: 0 background + header, 1 weekday labels, 2..43 cells, 44 legend
+bool drawMonthStep(int step) {
+  if (step == 0) {
+    tft.fillScreen(COLOR_BG);
+    drawHeader();
 
-    CalEvent* dayEvents[5];
-    int numEvents = getEventsForDay(currentDayTime, dayEvents, 5);
+    job.gridStart = monthGridStart(viewDate);
+    return false;
+  }
 
-    int evtY = y + 28;
-    for (int e = 0; e < numEvents && evtY < y + cellH - 10; e++) {
-      uint16_t color = dayEvents[e]->color;
-      if (!isCurrentMonth) {
-         color = (color >> 1) & 0x7BEF; 
-      }
-      
-      tft.fillRoundRect(x + 3, evtY, cellW - 6, 14, 2, color);
-      tft.setTextColor(COLOR_TEXT);
-      tft.setTextSize(1);
-      tft.setCursor(x + 5, evtY + 3);
-      
-      String title = dayEvents[e]->title;
-      if (title.length() > 12) title = title.substring(0, 11) + "..";
-      tft.print(title);
-      evtY += 16;
+  if (step == 1) {
+    int cellW = SCREEN_WIDTH / 7;
+    const char* weekDaysDe[] = {"Mo", "Di", "Mi", "Do", "Fr", "Sa", "So"};
+    tft.setTextColor(COLOR_TEXT_DIM);
+    tft.setTextSize(2);
+    for (int i = 0; i < 7; i++) {
+      tft.setCursor(i * cellW + 10, HEADER_HEIGHT + 5); 
+      tft.print(weekDaysDe[i]);
     }
+    return false;
+  }
+
+  // 42 cells
+  int cell = step - 2;
+  if (cell < 42) {
+    drawMonthCell(cell);
+    return false;
   }
 
   drawLegend();
+  return true;
 }
 
-void drawWeekView() {
-  tft.fillScreen(COLOR_BG);
-  drawHeader();
-
-  int startHour = 7;
-  int endHour = 18; 
-  int hourH = HOUR_HEIGHT_WEEK;
-
-  struct tm weekStart = viewDate;
-  int currentWday = weekStart.tm_wday; 
-  int daysSinceMon = currentWday - 1;
-  if (daysSinceMon < 0) daysSinceMon = 6;
-  
-  weekStart.tm_mday -= daysSinceMon;
-  weekStart.tm_hour = 0; weekStart.tm_min = 0; weekStart.tm_sec = 0;
-  mktime(&weekStart);
+// Week view
+#define WEEK_START_HOUR 7
+#define WEEK_END_HOUR 18
+#define WEEK_HOUR_W 50
+#define WEEK_DAY_HEADER_H 45
 
-  time_t now; time(&now);
-  struct tm today; localtime_r(&now, &today);
-
-  // Headers
-  int hourW = 50;
-  int cellW = (SCREEN_WIDTH - hourW) / 7;
+void drawWeekDayHeaders() {
+  int cellW = (SCREEN_WIDTH - WEEK_HOUR_W) / 7;
   int headerY = HEADER_HEIGHT;
-  int headerH = 45; 
+  int headerH = WEEK_DAY_HEADER_H;
   const char* weekDaysDe[] = {"So", "Mo", "Di", "Mi", "Do", "Fr", "Sa"};
 
   for (int d = 0; d < 7; d++) {
-    struct tm day = weekStart;
+    struct tm day = job.gridStart;
     day.tm_mday += d;
     mktime(&day);
 
-    bool isToday = (day.tm_mday == today.tm_mday &&
-                    day.tm_mon == today.tm_mon &&
-                    day.tm_year == today.tm_year);
+    bool isToday = (day.tm_mday == job.today.tm_mday &&
+                    day.tm_mon == job.today.tm_mon &&
+                    day.tm_year == job.today.tm_year);
 
-    int x = hourW + d * cellW;
+    int x = WEEK_HOUR_W + d * cellW;
     tft.fillRect(x, headerY, cellW, headerH, isToday ? COLOR_TODAY : COLOR_BG);
     tft.drawRect(x, headerY, cellW, headerH, COLOR_GRID);
 
@@ -386,11 +391,15 @@ void drawWeekView() {
     tft.setCursor(x + 10, headerY + 20);
     tft.print(day.tm_mday);
   }
+}
+
+void drawWeekGrid() {
+  int cellW = (SCREEN_WIDTH - WEEK_HOUR_W) / 7;
+  int gridY = HEADER_HEIGHT + WEEK_DAY_HEADER_H;
+  int hourH = HOUR_HEIGHT_WEEK;
 
-  // Grid
-  int gridY = headerY + headerH;
-  for (int h = startHour; h <= endHour; h++) {
-    int y = gridY + (h - startHour) * hourH;
+  for (int h = WEEK_START_HOUR; h <= WEEK_END_HOUR; h++) {
+    int y = gridY + (h - WEEK_START_HOUR) * hourH;
     tft.setTextColor(COLOR_TEXT_DIM);
     tft.setTextSize(1);
     tft.setCursor(5, y + 2);
@@ -399,117 +408,147 @@ void drawWeekView() {
   }
   
   for (int d = 0; d <= 7; d++) {
-     tft.drawLine(hourW + d * cellW, gridY, hourW + d * cellW, SCREEN_HEIGHT, COLOR_GRID);
+     tft.drawLine(WEEK_HOUR_W + d * cellW, gridY, WEEK_HOUR_W + d * cellW, SCREEN_HEIGHT, COLOR_GRID);
   }
+}
 
-  // Events - smart layout: side-by-side ONLY when overlapping
-  for (int d = 0; d < 7; d++) {
-    struct tm day = weekStart;
-    day.tm_mday += d;
-    time_t dayStart = mktime(&day);
-    CalEvent* dayEvents[20];
-    int numEvents = getEventsForDay(dayStart, dayEvents, 20);
-
-    int dayColX = hourW + d * cellW;
-    int colPadding = 2;
-
-    // Pre-calculate start/end hours for all events
-    float evtStartH[20], evtEndH[20];
-    for (int i = 0; i < numEvents; i++) {
-       struct tm st, et;
-       localtime_r(&dayEvents[i]->start, &st);
-       localtime_r(&dayEvents[i]->end, &et);
-       evtStartH[i] = st.tm_hour + st.tm_min / 60.0;
-       evtEndH[i] = et.tm_hour + et.tm_min / 60.0;
+// Server-side layout: minutes and columns as placed by the API
+void drawPlacedWeekDay(int d) {
+  const PageLayout& p = *job.page;
+  int cellW = (SCREEN_WIDTH - WEEK_HOUR_W) / 7;
+  int gridY = HEADER_HEIGHT + WEEK_DAY_HEADER_H;
+  int dayColX = WEEK_HOUR_W + d * cellW;
+  int colPadding = 2;
+
+  for (int i = p.dayFirst[d]; i < p.dayFirst[d + 1]; i++) {
+    const PlacedEvent& e = p.events[i];
+    int evtX, evtWidth;
+    if (e.cols <= 1) {
+      evtX = dayColX + colPadding;
+      evtWidth = cellW - (colPadding * 2);
+    } else {
+      int slotWidth = (cellW - (colPadding * 2)) / e.cols;
+      evtX = dayColX + colPadding + e.col * slotWidth;
+      evtWidth = slotWidth - colPadding;
+      if (evtWidth < 10) evtWidth = 10;
     }
+    int top = gridY + (e.startMin - WEEK_START_HOUR * 60) * HOUR_HEIGHT_WEEK / 60;
+    int height = (e.endMin - e.startMin) * HOUR_HEIGHT_WEEK / 60;
 
-    for (int i = 0; i < numEvents; i++) {
-       float s = evtStartH[i];
-       float e = evtEndH[i];
-       
-       // Clamp to view
-       if (s < startHour) s = startHour;
-       if (e > endHour) e = endHour;
-       if (e <= s) continue;
-
-       // Check for overlaps with OTHER events
-       int overlapCount = 0;
-       int myColumn = 0;
-       for (int j = 0; j < numEvents; j++) {
-          if (i == j) continue;
-          // Check time overlap
-          if (max(evtStartH[i], evtStartH[j]) < min(evtEndH[i], evtEndH[j])) {
-             overlapCount++;
-             // Determine column order by start time, then by index
-             if (evtStartH[j] < evtStartH[i] || 
-                 (evtStartH[j] == evtStartH[i] && j < i)) {
-                myColumn++;
-             }
-          }
-       }
-
-       int evtX, evtWidth;
-       if (overlapCount == 0) {
-          // No overlaps - full width
-          evtX = dayColX + colPadding;
-          evtWidth = cellW - (colPadding * 2);
-       } else {
-          // Has overlaps - split into columns
-          int totalCols = overlapCount + 1;
-          int slotWidth = (cellW - (colPadding * 2)) / totalCols;
-          evtX = dayColX + colPadding + myColumn * slotWidth;
-          evtWidth = slotWidth - colPadding;
-          if (evtWidth < 10) evtWidth = 10;
-       }
-
-       int top = gridY + (int)((s - startHour) * hourH);
-       int height = (int)((e - s) * hourH);
-       
-       tft.fillRoundRect(evtX, top + 1, evtWidth, height - 2, 4, dayEvents[i]->color);
-       
-       if (evtWidth > 20 && height > 12) {
-           tft.setTextColor(0xFFFF);
-           tft.setTextSize(1);
-           tft.setCursor(evtX + 3, top + 3);
-           int maxChars = evtWidth / 7;
-           if (maxChars > 10) maxChars = 10;
-           tft.print(dayEvents[i]->title.substring(0, maxChars));
-       }
+    tft.fillRoundRect(evtX, top + 1, evtWidth, height - 2, 4, pageColor(e));
+    if (e.title.length()) {
+      tft.setTextColor(0xFFFF);
+      tft.setTextSize(1);
+      tft.setCursor(evtX + 3, top + 3);
+      tft.print(e.title.c_str());
     }
   }
-  
-  drawLegend(); 
 }
 
-void sortEvents(CalEvent** events, int count) {
-  for (int i = 1; i < count; i++) {
-    CalEvent* key = events[i];
-    int j = i - 1;
-    while (j >= 0 && events[j]->start > key->start) {
-      events[j + 1] = events[j];
-      j--;
-    }
-    events[j + 1] = key;
+// Events - smart layout: side-by-side ONLY when overlapping
+void drawWeekDayEvents(int d) {
+  if (job.page) {
+    drawPlacedWeekDay(d);
+    return;
+  }
+  int startHour = WEEK_START_HOUR;
+  int endHour = WEEK_END_HOUR;
+  int hourH = HOUR_HEIGHT_WEEK;
+  int cellW = (SCREEN_WIDTH - WEEK_HOUR_W) / 7;
+  int gridY = HEADER_HEIGHT + WEEK_DAY_HEADER_H;
+
+  struct tm day = job.gridStart;
+  day.tm_mday += d;
+  time_t dayStart = mktime(&day);
+  CalEvent* dayEvents[20];
+  int numEvents = getEventsForDay(dayStart, dayEvents, 20);
+
+  int dayColX = WEEK_HOUR_W + d * cellW;
+  int colPadding = 2;
+
+  WeekSlot slots[20];
+  layoutWeekDay(dayEvents, numEvents, slots);
+
+  for (int i = 0; i < numEvents; i++) {
+     float s = slots[i].startH;
+     float e = slots[i].endH;
+     
+     // Clamp to view
+     if (s < startHour) s = startHour;
+     if (e > endHour) e = endHour;
+     if (e <= s) continue;
+
+     int evtX, evtWidth;
+     if (slots[i].cols == 1) {
+        // No overlaps - full width
+        evtX = dayColX + colPadding;
+        evtWidth = cellW - (colPadding * 2);
+     } else {
+        // Has overlaps - split into columns
+        int slotWidth = (cellW - (colPadding * 2)) / slots[i].cols;
+        evtX = dayColX + colPadding + slots[i].col * slotWidth;
+        evtWidth = slotWidth - colPadding;
+        if (evtWidth < 10) evtWidth = 10;
+     }
+
+     int top = gridY + (int)((s - startHour) * hourH);
+     int height = (int)((e - s) * hourH);
+     
+     tft.fillRoundRect(evtX, top + 1, evtWidth, height - 2, 4, dayEvents[i]->color);
+     
+     if (evtWidth > 20 && height > 12) {
+         tft.setTextColor(0xFFFF);
+         tft.setTextSize(1);
+         tft.setCursor(evtX + 3, top + 3);
+         int maxChars = evtWidth / 7;
+         if (maxChars > 10) maxChars = 10;
+         printClipped(dayEvents[i]->title, maxChars, maxChars, "");
+     }
   }
 }
 
-void drawDayView() {
-  tft.fillScreen(COLOR_BG);
-  drawHeader();
+// Steps: 0 background + header, 1 day headers, 2 grid, 3..9 day columns, 10 legend
+bool drawWeekStep(int step) {
+  if (step == 0) {
+    tft.fillScreen(COLOR_BG);
+    drawHeader();
+
+    job.gridStart = viewDate;
+    int daysSinceMon = job.gridStart.tm_wday - 1;
+    if (daysSinceMon < 0) daysSinceMon = 6;
+    job.gridStart.tm_mday -= daysSinceMon;
+    job.gridStart.tm_hour = 0; job.gridStart.tm_min = 0; job.gridStart.tm_sec = 0;
+    mktime(&job.gridStart);
+    return false;
+  }
+  if (step == 1) { drawWeekDayHeaders(); return false; }
+  if (step == 2) { drawWeekGrid(); return false; }
 
-  time_t now; time(&now);
-  struct tm today; localtime_r(&now, &today);
-  bool isToday = (viewDate.tm_mday == today.tm_mday &&
-                  viewDate.tm_mon == today.tm_mon &&
-                  viewDate.tm_year == today.tm_year);
+  int d = step - 3;
+  if (d < 7) {
+    drawWeekDayEvents(d);
+    return false;
+  }
 
-  int startHour = 7;
-  int endHour = 18; 
-  int hourH = HOUR_HEIGHT_DAY;
+  drawLegend();
+  return true;
+}
+
+// Day view
+#define DAY_START_HOUR 7
+#define DAY_END_HOUR 18
+#define DAY_HOUR_W 60
+#define DAY_GRID_Y (HEADER_HEIGHT + 40)
+
+void drawDayGrid() {
+  bool isToday = (viewDate.tm_mday == job.today.tm_mday &&
+                  viewDate.tm_mon == job.today.tm_mon &&
+                  viewDate.tm_year == job.today.tm_year);
 
+  int hourH = HOUR_HEIGHT_DAY;
   int headerY = HEADER_HEIGHT;
   // Sub-header for date
-  int gridY = headerY + 40; 
+  int gridY = DAY_GRID_Y;
 
   char dateStr[64];
   snprintf(dateStr, sizeof(dateStr), "%s, %d. %s %d", dayNamesLong[viewDate.tm_wday], viewDate.tm_mday, monthNames[viewDate.tm_mon], viewDate.tm_year + 1900);
@@ -523,104 +562,173 @@ void drawDayView() {
      tft.print(" HEUTE");
   }
 
-  int hourW = 60;
-  for (int h = startHour; h <= endHour; h++) {
-     int y = gridY + (h - startHour) * hourH;
+  for (int h = DAY_START_HOUR; h <= DAY_END_HOUR; h++) {
+     int y = gridY + (h - DAY_START_HOUR) * hourH;
      tft.setTextColor(COLOR_TEXT_DIM);
      tft.setTextSize(2);
      tft.setCursor(5, y - 6);
      tft.printf("%2d:00", h);
-     tft.drawLine(hourW, y, SCREEN_WIDTH, y, COLOR_GRID); 
+     tft.drawLine(DAY_HOUR_W, y, SCREEN_WIDTH, y, COLOR_GRID); 
   }
+}
 
+void layoutDayEvents() {
   struct tm dayTm = viewDate;
   dayTm.tm_hour = 0; dayTm.tm_min = 0; dayTm.tm_sec = 0;
   time_t dayStart = mktime(&dayTm);
-  CalEvent* dayEvents[30];
-  int numEvents = getEventsForDay(dayStart, dayEvents, 30);
+  int numEvents = getEventsForDay(dayStart, job.dayEvents, MAX_DAY_EVENTS);
+  layoutDay(job.dayEvents, numEvents, job.layouts);
+  job.numEvents = numEvents;
+}
+
+void drawPlacedDayEvent(int i) {
+  const PlacedEvent& e = job.page->events[job.page->dayFirst[0] + i];
+  int width = (SCREEN_WIDTH - DAY_HOUR_W - 20) / (e.cols ? e.cols : 1);
+  int left = DAY_HOUR_W + 10 + e.col * width;
+  int top = DAY_GRID_Y + (e.startMin - DAY_START_HOUR * 60) * HOUR_HEIGHT_DAY / 60;
+  int h = (e.endMin - e.startMin) * HOUR_HEIGHT_DAY / 60;
+
+  tft.fillRoundRect(left, top, width - 4, h - 2, 6, pageColor(e));
+  tft.setTextColor(0xFFFF);
+  tft.setTextSize(width < 80 ? 1 : 2);
+  tft.setCursor(left + 5, top + 5);
+  tft.print(e.title.c_str());
+  tft.setCursor(left + 5, top + 25);
+  tft.setTextSize(1);
+  tft.print(e.label.c_str());
+}
+
+void drawDayEvent(int i) {
+  if (job.page) {
+    drawPlacedDayEvent(i);
+    return;
+  }
+  int startHour = DAY_START_HOUR;
+  int endHour = DAY_END_HOUR;
+  int hourH = HOUR_HEIGHT_DAY;
+  int gridY = DAY_GRID_Y;
+  int hourW = DAY_HOUR_W;
+  int totalW = SCREEN_WIDTH - hourW - 20; 
+  int numEvents = job.numEvents;
+  CalEvent** dayEvents = job.dayEvents;
+  LayoutInfo* layouts = job.layouts;
+
+  int maxColInGroup = 0;
+  for (int j = 0; j < numEvents; j++) {
+     if (i == j) continue;
+     if (max(layouts[i].startH, layouts[j].startH) < min(layouts[i].endH, layouts[j].endH)) {
+         if (layouts[j].col > maxColInGroup) maxColInGroup = layouts[j].col;
+     }
+  }
+  if (layouts[i].col > maxColInGroup) maxColInGroup = layouts[i].col;
   
-  sortEvents(dayEvents, numEvents);
+  int colCount = maxColInGroup + 1;
+  int width = totalW / colCount;
+  int left = hourW + 10 + layouts[i].col * width;
   
-  struct LayoutInfo {
-     int col;
-     float startH;
-     float endH;
-  };
-  LayoutInfo layouts[30];
+  float s = layouts[i].startH;
+  float e = layouts[i].endH;
+  if (s < startHour) s = startHour;
+  if (e > endHour) e = endHour;
+  if (e <= s) return;
   
-  float colEndTimes[10]; 
-  for(int k=0; k<10; k++) colEndTimes[k] = -1.0;
+  int top = gridY + (int)((s - startHour) * hourH);
+  int h = (int)((e - s) * hourH);
   
-  for (int i = 0; i < numEvents; i++) {
-     struct tm st, et;
-     localtime_r(&dayEvents[i]->start, &st);
-     localtime_r(&dayEvents[i]->end, &et);
-     float startH = st.tm_hour + st.tm_min / 60.0;
-     float endH = et.tm_hour + et.tm_min / 60.0;
-     layouts[i].startH = startH;
-     layouts[i].endH = endH;
-     
-     int placedCol = 0;
-     for (int c = 0; c < 10; c++) {
-        if (startH >= colEndTimes[c]) {
-           placedCol = c;
-           colEndTimes[c] = endH;
-           break;
-        }
-     }
-     layouts[i].col = placedCol;
-  }
+  tft.fillRoundRect(left, top, width - 4, h - 2, 6, dayEvents[i]->color);
   
-  int totalW = SCREEN_WIDTH - hourW - 20; 
+  tft.setTextColor(0xFFFF);
+  tft.setTextSize(2);
+  tft.setCursor(left + 5, top + 5);
+  if (width < 80) tft.setTextSize(1);
   
-  for (int i = 0; i < numEvents; i++) {
-     int maxColInGroup = 0;
-     for (int j = 0; j < numEvents; j++) {
-        if (i == j) continue;
-        if (max(layouts[i].startH, layouts[j].startH) < min(layouts[i].endH, layouts[j].endH)) {
-            if (layouts[j].col > maxColInGroup) maxColInGroup = layouts[j].col;
-        }
-     }
-     if (layouts[i].col > maxColInGroup) maxColInGroup = layouts[i].col;
-     
-     int colCount = maxColInGroup + 1;
-     int width = totalW / colCount;
-     int left = hourW + 10 + layouts[i].col * width;
-     
-     float s = layouts[i].startH;
-     float e = layouts[i].endH;
-     if (s < startHour) s = startHour;
-     if (e > endHour) e = endHour;
-     if (e <= s) continue;
-     
-     int top = gridY + (int)((s - startHour) * hourH);
-     int h = (int)((e - s) * hourH);
-     
-     tft.fillRoundRect(left, top, width - 4, h - 2, 6, dayEvents[i]->color);
-     
-     tft.setTextColor(0xFFFF);
-     tft.setTextSize(2);
-     tft.setCursor(left + 5, top + 5);
-     if (width < 80) tft.setTextSize(1);
-     
-     String title = dayEvents[i]->title;
-     int maxChars = width / 12; 
-     if (title.length() > maxChars) title = title.substring(0, maxChars) + ".";
-     tft.print(title);
-     
-     tft.setCursor(left + 5, top + 25);
-     tft.setTextSize(1);
-     struct tm st; localtime_r(&dayEvents[i]->start, &st);
-     struct tm et; localtime_r(&dayEvents[i]->end, &et);
-     tft.printf("%02d:%02d-%02d:%02d", st.tm_hour, st.tm_min, et.tm_hour, et.tm_min);
-  }
+  int maxChars = width / 12; 
+  printClipped(dayEvents[i]->title, maxChars, maxChars, ".");
   
+  tft.setCursor(left + 5, top + 25);
+  tft.setTextSize(1);
+  struct tm st; localtime_r(&dayEvents[i]->start, &st);
+  struct tm et; localtime_r(&dayEvents[i]->end, &et);
+  tft.printf("%02d:%02d-%02d:%02d", st.tm_hour, st.tm_min, et.tm_hour, et.tm_min);
+}
+
+// Steps: 0 background + header, 1 date + hour grid, 2 layout, 3.. one per event, then legend
+bool drawDayStep(int step) {
+  if (step == 0) {
+    tft.fillScreen(COLOR_BG);
+    drawHeader();
+    return false;
+  }
+  if (step == 1) { drawDayGrid(); return false; }
+  if (step == 2) {
+    if (job.page) job.numEvents = job.page->dayFirst[1] - job.page->dayFirst[0];
+    else layoutDayEvents();
+    return false;
+  }
+
+  int i = step - 3;
+  if (i < job.numEvents) {
+    drawDayEvent(i);
+    return false;
+  }
+
   drawLegend();
+  return true;
+}
+
+// Thin client
+struct TileOrigin {
+  int x, y;
+};
+
+void blitSpan(void* ctx, int x, int y, int count, const uint16_t* pixels, uint16_t color) {
+  const TileOrigin* at = (const TileOrigin*)ctx;
+  if (pixels) tft.pushImage(at->x + x, at->y + y, count, 1, pixels);
+  else tft.fillRect(at->x + x, at->y + y, count, 1, color);
+}
+
+// Steps: one per tile, skipping tiles the panel already shows
+bool drawTileStep(int step) {
+  const TilePage& p = *job.tiles;
+  if (step >= (int)p.hashes.size() || step >= TILE_SLOTS) return true;
+  if (panelTiles[step] == p.hashes[step]) return false;
+
+  TileOrigin at = {(step % p.cols) * TILE_W, (step / p.cols) * TILE_H};
+  int w = min(TILE_W, SCREEN_WIDTH - at.x);
+  int h = min(TILE_H, SCREEN_HEIGHT - at.y);
+  const TileData& data = *p.tiles[step];
+  panelTiles[step] = tileDecode(data.data(), data.size(), w, h, blitSpan, &at) ? p.hashes[step] : 0;
+  return false;
+}
+
+// Newest first; a page synced again replaces its older copy
+void storeTilePage(const std::shared_ptr<const TilePage>& synced) {
+  int slot = TILE_PAGES - 1;
+  for (int i = 0; i < TILE_PAGES; i++) {
+    if (tilePages[i] && tilePages[i]->view == synced->view && tilePages[i]->start == synced->start) {
+      slot = i;
+      break;
+    }
+  }
+  for (int i = slot; i > 0; i--) tilePages[i] = tilePages[i - 1];
+  tilePages[0] = synced;
+}
+
+void toggleHud() {
+  hudToggle();
+  Serial.printf("[hud] %s\n", hudVisible() ? "on" : "off");
+  // Repaint underneath when it goes away
+  memset(panelTiles, 0, sizeof(panelTiles));
+  if (!hudVisible()) draw();
 }
 
 void handleTouch() {
-  uint16_t x, y;
-  bool isTouching = tft.getTouch(&x, &y);
+  lgfx::touch_point_t tp[HUD_TOUCH_POINTS];
+  int points = tft.getTouch(tp, HUD_TOUCH_POINTS);
+  bool isTouching = points > 0;
+  uint16_t x = isTouching ? tp[0].x : 0;
+  uint16_t y = isTouching ? tp[0].y : 0;
+  recTouch(isTouching, x, y);
 
   if (isTouching) {
     if (!touched) {
@@ -628,45 +736,51 @@ void handleTouch() {
       touchStartX = x;
       touchStartY = y;
       lastTouch = millis();
+      touchPoints = 0;
+      longPressDone = false;
     }
     touchX = x;
     touchY = y;
+    if (points > touchPoints) touchPoints = points;
+
+    // Long-press on the header toggles the HUD without waiting for release
+    if (!longPressDone && touchStartY < HEADER_HEIGHT && millis() - lastTouch > LONG_PRESS_MS &&
+        abs(touchX - touchStartX) < 10 && abs(touchY - touchStartY) < 10) {
+      longPressDone = true;
+      toggleHud();
+    }
   } else {
     if (touched) {
       touched = false;
+      inputUs = micros();
       int dx = touchX - touchStartX;
       int dy = touchY - touchStartY;
+
+      if (longPressDone) return;
+      if (touchPoints >= HUD_TOUCH_POINTS && millis() - lastTouch < 500) {
+        toggleHud();
+        return;
+      }
       
       if (abs(dx) > 50 && abs(dy) < 60) {
-        if (dx > 0) {
-          if (currentView == VIEW_MONTH) viewDate.tm_mon--;
-          else if (currentView == VIEW_WEEK) viewDate.tm_mday -= 7;
-          else viewDate.tm_mday--;
-        } else {
-          if (currentView == VIEW_MONTH) viewDate.tm_mon++;
-          else if (currentView == VIEW_WEEK) viewDate.tm_mday += 7;
-          else viewDate.tm_mday++;
-        }
-        mktime(&viewDate);
-        draw(); 
+        traceInstant(TRACE_TOUCH, dx > 0 ? GESTURE_SWIPE_RIGHT : GESTURE_SWIPE_LEFT);
+        logWrite(LOG_UI_GESTURE, dx > 0 ? GESTURE_SWIPE_RIGHT : GESTURE_SWIPE_LEFT, touchStartX, touchStartY, dx, dy);
+        viewDate = pageShift(currentView, viewDate, dx > 0 ? -1 : 1);
+        draw();
         return;
       }
 
       if (millis() - lastTouch < 500 && abs(dx) < 10 && abs(dy) < 10) {
+         traceInstant(TRACE_TOUCH, GESTURE_TAP);
+         logWrite(LOG_UI_GESTURE, GESTURE_TAP, touchStartX, touchStartY, dx, dy);
          if (touchStartY < 50) {
             if (touchStartX < 80) { 
-               if (currentView == VIEW_MONTH) viewDate.tm_mon--;
-               else if (currentView == VIEW_WEEK) viewDate.tm_mday -= 7;
-               else viewDate.tm_mday--;
-               mktime(&viewDate);
+               viewDate = pageShift(currentView, viewDate, -1);
                draw();
                return;
             }
             if (touchStartX > SCREEN_WIDTH - 80) { 
-               if (currentView == VIEW_MONTH) viewDate.tm_mon++;
-               else if (currentView == VIEW_WEEK) viewDate.tm_mday += 7;
-               else viewDate.tm_mday++;
-               mktime(&viewDate);
+               viewDate = pageShift(currentView, viewDate, 1);
                draw();
                return;
             }
@@ -681,71 +795,361 @@ void handleTouch() {
   }
 }
 
+// Start rendering the current view. Any frame still in progress is abandoned.
 void draw() {
-  switch (currentView) {
-    case VIEW_DAY:   drawDayView(); break;
-    case VIEW_WEEK:  drawWeekView(); break;
-    case VIEW_MONTH: drawMonthView(); break;
+  job.active = true;
+  job.view = currentView;
+  job.step = 0;
+  job.frameStart = profCycles();
+  job.startUs = micros();
+  job.inputUs = inputUs;
+  job.renderUs = 0;
+  job.page = NULL;
+  job.tiles.reset();
+  if (thinClient) {
+    time_t start = pageStart(currentView, viewDate);
+    for (int i = TILE_PAGES - 1; i >= 0; i--) {
+      const std::shared_ptr<const TilePage>& p = tilePages[i];
+      if (p && p->view == currentView && p->start == start && p->width == SCREEN_WIDTH && p->height == SCREEN_HEIGHT) {
+        job.tiles = p;
+      }
+    }
+    // Asked for even when already synced: the network task checks it for
+    // changes and syncs the pages either side of it next
+    if (currentView != requestedTileView || start != requestedTileStart) {
+      requestedTileView = currentView;
+      requestedTileStart = start;
+      netRequestTiles(currentView, viewDate, SCREEN_WIDTH, SCREEN_HEIGHT);
+    }
   }
+  // Anything but a tile frame paints over the tiles on the panel
+  if (!job.tiles) memset(panelTiles, 0, sizeof(panelTiles));
+  if (serverLayout && !job.tiles) {
+    if (pageValid && page.view == currentView && page.start == pageStart(currentView, viewDate) &&
+        (int)page.dayFirst.size() == pageDayCount(currentView) + 1) {
+      job.page = &page;
+    } else if (currentView != requestedView || pageStart(currentView, viewDate) != requestedStart) {
+      // Laid out here until the API's page arrives. Asked for once; the
+      // network task fetches it again after every refresh.
+      requestedView = currentView;
+      requestedStart = pageStart(currentView, viewDate);
+      netRequestPage(currentView, viewDate, SCREEN_WIDTH, SCREEN_HEIGHT);
+    }
+  }
+  time_t first = pageStart(currentView, viewDate);
+  localtime_r(&first, &job.fillStart);
+  job.fillNext = 0;
+  job.fillDays = job.tiles || job.page || series.series.empty() ? 0 : pageDayCount(currentView);
+  allocWindowStart(ALLOC_LAYOUT);
+  allocWindowStart(ALLOC_RENDER);
+  time_t now; time(&now);
+  localtime_r(&now, &job.today);
 }
 
-void setup() {
-  Serial.begin(115200);
+// Advance the current frame by whole steps until the slice budget is spent
+void renderSlice() {
+  if (!job.active) return;
+  unsigned long sliceStart = millis();
+  unsigned long sliceStartUs = micros();
+  ALLOC_SCOPE(ALLOC_RENDER);
+  TRACE_SCOPE(TRACE_SLICE);
+  do {
+    if (job.fillNext < job.fillDays) {
+      struct tm day = job.fillStart;
+      day.tm_mday += job.fillNext++;
+      day.tm_isdst = -1;
+      seriesFillDay(series, seriesDays, mktime(&day));
+      continue;
+    }
+    bool done = false;
+    {
+      PROF_SCOPE(PROF_RENDER_STEP);
+      if (job.tiles) {
+        done = drawTileStep(job.step);
+      } else {
+        switch (job.view) {
+          case VIEW_DAY:   done = drawDayStep(job.step); break;
+          case VIEW_WEEK:  done = drawWeekStep(job.step); break;
+          case VIEW_MONTH: done = drawMonthStep(job.step); break;
+        }
+      }
+    }
+    job.step++;
+    if (done) {
+      job.active = false;
+      profRecord(PROF_FRAME, profCycles() - job.frameStart);
+      uint32_t doneUs = micros();
+      uint32_t renderUs = job.renderUs + (doneUs - sliceStartUs);
+      int source = job.tiles ? FRAME_TILES : job.page ? FRAME_SERVER_LAYOUT : FRAME_DEVICE;
+      metricsFrameDone(job.view, source, renderUs);
+      hudFrameDone(renderUs, doneUs - job.startUs, job.inputUs ? doneUs - job.inputUs : 0);
+      logWrite(LOG_UI_FRAME, job.view, source, job.step, renderUs, doneUs - job.startUs);
+      if (!allocWindowEnd(ALLOC_LAYOUT)) logWrite(LOG_ALLOC_OVER_BUDGET, "layout");
+      if (!allocWindowEnd(ALLOC_RENDER)) logWrite(LOG_ALLOC_OVER_BUDGET, "render");
+    }
+  } while (job.active && millis() - sliceStart < RENDER_SLICE_MS);
+  if (job.active) job.renderUs += micros() - sliceStartUs;
+}
 
-  tft.init();
-  tft.setRotation(0);
-  tft.fillScreen(COLOR_BG);
-  tft.setTextColor(COLOR_TEXT);
+// Monotonic seconds for the timer wheel (millis() alone wraps after ~49 days)
+uint32_t uptimeSeconds() {
+  static unsigned long lastMs = 0;
+  static uint32_t msAcc = 0, secs = 0;
+  unsigned long ms = millis();
+  msAcc += ms - lastMs;
+  lastMs = ms;
+  secs += msAcc / 1000;
+  msAcc %= 1000;
+  return secs;
+}
 
-  if (!connectWiFi()) {
-    tft.println("WiFi failed. Restarting...");
-    delay(3000);
-    ESP.restart();
+// Seconds until the next wall-clock minute / local midnight
+uint32_t secondsToNextMinute() {
+  time_t now; time(&now);
+  return 60 - (now % 60);
+}
+
+uint32_t secondsToMidnight() {
+  time_t now; time(&now);
+  struct tm t; localtime_r(&now, &t);
+  t.tm_mday += 1;
+  t.tm_hour = 0; t.tm_min = 0; t.tm_sec = 0;
+  return mktime(&t) - now;
+}
+
+void onReminderClear(void*) {
+  reminderText[0] = 0;
+  draw();
+}
+
+void onReminder(void* arg) {
+  CalEvent* e = (CalEvent*)arg;
+  snprintf(reminderText, sizeof(reminderText), "Jetzt: %s", e->title.c_str());
+  timerSchedule(&reminderClearTimer, REMINDER_SHOW_SECS, onReminderClear, NULL);
+  // The last armed one fired: arm the next ones. Snapshots that don't
+  // change anything aren't published, so nothing else would.
+  if (--remindersArmed == 0 && remindersWaiting) scheduleReminders();
+  draw();
+}
+
+// A new snapshot's series: day buckets of the old one are stale
+void takeSeries() {
+  seriesDaysClear(seriesDays);
+  seriesDaysReserve(series, seriesDays);
+  if (!series.series.empty()) logWrite(LOG_UI_SERIES, series.series.size(), series.zones.size());
+}
+
+// Re-arm reminder alarms at event start, the MAX_REMINDERS soonest. Runs
+// when the event list or the day changes, and when the last armed one
+// fired while more were due; never from the loop.
+void scheduleReminders() {
+  for (int i = 0; i < MAX_REMINDERS; i++) timerCancel(&reminderTimers[i]);
+
+  time_t now; time(&now);
+  reminderInstances.clear();
+  seriesExpand(series, now, now + REMINDER_HORIZON, reminderInstances);
+  // Events and series instances together, soonest first
+  std::vector<CalEvent*> due;
+  for (std::vector<CalEvent>* list : {&events, &reminderInstances}) {
+    for (auto& e : *list) {
+      if (e.allDay || e.start <= now || e.start - now > REMINDER_HORIZON) continue;
+      due.push_back(&e);
+    }
+  }
+  std::stable_sort(due.begin(), due.end(), [](const CalEvent* a, const CalEvent* b) { return a->start < b->start; });
+  remindersArmed = std::min((int)due.size(), MAX_REMINDERS);
+  remindersWaiting = (int)due.size() > MAX_REMINDERS;
+  for (int i = 0; i < remindersArmed; i++) {
+    timerSchedule(&reminderTimers[i], due[i]->start - now, onReminder, due[i]);
   }
+}
 
-  syncTime();
+void onMinuteTick(void*) {
+  heapSample(uptimeSeconds());
+  if (currentView != VIEW_MONTH) {
+    draw();
+  }
+  timerSchedule(&minuteTimer, secondsToNextMinute(), onMinuteTick, NULL);
+}
 
-  tft.fillScreen(COLOR_BG);
-  tft.setCursor(20, SCREEN_HEIGHT / 2);
-  tft.setTextSize(2);
-  tft.print("Loading calendars...");
+void onDayRollover(void*) {
+  time_t now; time(&now);
+  localtime_r(&now, &viewDate);
+  scheduleReminders();
+  draw();
+  timerSchedule(&dayTimer, secondsToMidnight(), onDayRollover, NULL);
+}
+
+void onRefreshDue(void*) {
+  netRequestRefresh();
+  timerSchedule(&refreshTimer, REFRESH_INTERVAL / 1000, onRefreshDue, NULL);
+}
+
+void startTimers() {
+  timerInit(uptimeSeconds());
+  timerSchedule(&minuteTimer, secondsToNextMinute(), onMinuteTick, NULL);
+  timerSchedule(&dayTimer, secondsToMidnight(), onDayRollover, NULL);
+  timerSchedule(&refreshTimer, REFRESH_INTERVAL / 1000, onRefreshDue, NULL);
+}
+
+void serialEmit(const char* line) {
+  Serial.print(line);
+}
 
-  if (fetchEvents()) {
-    tft.println(" OK");
+// Live log on serial, formatted from the idle loop
+#define LOG_TAIL_BATCH 16   // Records per loop pass, keeps touch polling responsive
+LogLevel logTailLevel = LOG_INFO;
+
+void toggleRecording() {
+  if (recActive()) {
+    recStop();
+    Serial.println("[rec] stopped");
+  } else if (recStart()) {
+    recView(currentView, viewDate);
+    // Capture a payload right away so the replay has data from the start
+    netRequestRefresh();
+    Serial.println("[rec] recording to " REC_PATH);
   } else {
-    tft.println(" Failed");
+    Serial.println("[rec] filesystem unavailable");
   }
-  delay(500);
+}
 
-  draw();
+// Single-key serial commands: 'p' prints the phase profile, 'r' resets it,
+// 'a' prints allocation accounting and heap fragmentation history,
+// 't' dumps the trace ring as Chrome trace JSON, 'c' starts/stops a
+// field recording (payloads + touches), 'd' dumps it, 'n' prints the
+// network timing of the last refreshes, 'h' toggles the performance HUD,
+// 'l' prints the log ring, 'x' dumps it as hex for host/logdecode/,
+// 'v' switches the live log between info and debug, 'm' switches between
+// laying out here and drawing the API's pages, 'g' switches the thin
+// client (tile server) on and off
+void handleSerial() {
+  while (Serial.available()) {
+    switch (Serial.read()) {
+      case 'p': profReport(serialEmit); break;
+      case 'r': profReset(); Serial.println("profile reset"); break;
+      case 'a': allocReport(serialEmit); break;
+      case 't': traceExport(serialEmit); break;
+      case 'c': toggleRecording(); break;
+      case 'd': recExport(serialEmit); break;
+      case 'n': refreshLogReport(serialEmit); break;
+      case 'h': toggleHud(); break;
+      case 'l': logDump(serialEmit, LOG_DEBUG); break;
+      case 'x': logExportHex(serialEmit); break;
+      case 'v':
+        logTailLevel = logTailLevel == LOG_DEBUG ? LOG_INFO : LOG_DEBUG;
+        Serial.printf("live log: %s\n", logTailLevel == LOG_DEBUG ? "debug" : "info");
+        break;
+      case 'm':
+        serverLayout = !serverLayout;
+        Serial.printf("layout: %s\n", serverLayout ? "server" : "device");
+        draw();
+        break;
+      case 'g':
+#ifdef TILE_URL
+        thinClient = !thinClient;
+        Serial.printf("tiles: %s\n", thinClient ? "on" : "off");
+        draw();
+#else
+        Serial.println("tiles: no TILE_URL in secrets.h");
+#endif
+        break;
+    }
+  }
+}
+
+void drawBootScreen() {
+  tft.fillScreen(COLOR_BG);
+  tft.setTextColor(COLOR_TEXT);
+  tft.setTextSize(2);
+  tft.setCursor(20, SCREEN_HEIGHT / 2);
+  tft.print(netPhaseName());
+}
+
+void setup() {
+  Serial.begin(115200);
+  logInit();
+  bootMark("setup");
+
+  // Steady-state frames must not touch the heap
+  allocSetBudget(ALLOC_LAYOUT, 0);
+  allocSetBudget(ALLOC_RENDER, 0);
+  traceInit();
+
+  tft.init();
+  tft.setRotation(0);
+  drawBootScreen();
+  bootMark("first_frame");
+
+  // WiFi, NTP and the first fetch run in the background from here on
+  netBegin();
 }
 
 void loop() {
-  handleTouch();
+  // Until NTP has set the clock there is no "today" to show
+  if (!timeValid) {
+    static NetPhase shownPhase = netPhase();
+    if (netTimeValid()) {
+      time_t now; time(&now);
+      localtime_r(&now, &viewDate);
+      timeValid = true;
+      netTakeEvents(events, calendars, series);
+      takeSeries();
+      metricsSetEventCount(events.size());
+      logWrite(LOG_UI_EVENTS, events.size(), calendars.size());
+      startTimers();
+      scheduleReminders();
+      draw();
+    } else if (netPhase() != shownPhase) {
+      shownPhase = netPhase();
+      drawBootScreen();
+    }
+    logTail(serialEmit, logTailLevel, LOG_TAIL_BATCH);
+    delay(50);
+    return;
+  }
 
-  if (millis() - lastRefresh > REFRESH_INTERVAL) {
-    fetchEvents();
+  handleTouch();
+  inputUs = 0;
+  handleSerial();
+
+  if (netTakeEvents(events, calendars, series)) {
+    takeSeries();
+    metricsSetEventCount(events.size());
+    logWrite(LOG_UI_EVENTS, events.size(), calendars.size());
+    // Reminder timers point into the old list: re-arm before anything fires
+    scheduleReminders();
     draw();
   }
 
-  static ViewMode lastView = currentView;
-  static struct tm lastDate = viewDate;
+  if (netTakePage(page)) {
+    pageValid = true;
+    if (serverLayout) draw();
+  }
 
-  if (currentView != lastView ||
-      viewDate.tm_mday != lastDate.tm_mday ||
-      viewDate.tm_mon != lastDate.tm_mon ||
-      viewDate.tm_year != lastDate.tm_year) {
-    draw();
-    lastView = currentView;
-    lastDate = viewDate;
+  std::shared_ptr<const TilePage> synced;
+  while (netTakeTiles(synced)) {
+    storeTilePage(synced);
+    if (thinClient && synced->view == currentView && synced->start == pageStart(currentView, viewDate)) draw();
   }
 
-  static unsigned long lastTimeUpdate = 0;
-  if (millis() - lastTimeUpdate > 60000) {
-    lastTimeUpdate = millis();
-    if (currentView != VIEW_MONTH) {
-      draw();
-    }
+  timerAdvance(uptimeSeconds());
+
+  bool wasRendering = job.active;
+  renderSlice();
+  if (wasRendering && !job.active) {
+    static bool firstFrame = true;
+    if (firstFrame) bootMark("calendar_frame");
+    firstFrame = false;
+  }
+
+  // Overlay goes on top of finished frames only; log text is formatted
+  // here too, never while a frame is being drawn
+  if (!job.active) {
+    hudUpdate(tft, events.size());
+    logTail(serialEmit, logTailLevel, LOG_TAIL_BATCH);
   }
-  delay(50);
+
+  // Touch is polled between render slices; only sleep when idle
+  if (!job.active) delay(50);
 }
@@ -0,0 +1,215 @@
+#include "metrics.h"
+#include "profiler.h"
+#include "alloc_track.h"
+#include "refresh_log.h"
+#include <stdio.h>
+
+#define METRIC_VIEWS 3
+
+static const char* viewNames[METRIC_VIEWS] = {"day", "week", "month"};
+static const char* layoutNames[FRAME_SOURCES] = {"device", "server", "tiles"};
+
+static uint32_t refreshOk = 0;
+static uint32_t refreshErrors = 0;
+static uint32_t lastRefreshMs = 0;
+static uint32_t lastRefreshUptime = 0;   // Seconds, 0 = never succeeded
+static uint64_t bytesTotal = 0;
+static uint32_t lastBytes = 0;
+
+static uint32_t frames[FRAME_SOURCES][METRIC_VIEWS];   // [source][view]
+static uint64_t frameRenderUs[FRAME_SOURCES][METRIC_VIEWS];
+static uint32_t eventCount = 0;
+static FrameSample lastFrame;
+
+void metricsRefreshDone(bool ok, uint32_t durationMs, uint32_t bytes, uint32_t uptimeSec) {
+  lastRefreshMs = durationMs;
+  if (ok) {
+    refreshOk++;
+    bytesTotal += bytes;
+    lastBytes = bytes;
+    lastRefreshUptime = uptimeSec ? uptimeSec : 1;
+  } else {
+    refreshErrors++;
+  }
+}
+
+void metricsFrameDone(int view, int source, uint32_t renderUs) {
+  if (view < 0 || view >= METRIC_VIEWS || source < 0 || source >= FRAME_SOURCES) return;
+  frames[source][view]++;
+  frameRenderUs[source][view] += renderUs;
+  lastFrame.view = view;
+  lastFrame.source = source;
+  lastFrame.renderUs = renderUs;
+  lastFrame.seq++;
+}
+
+FrameSample metricsLastFrame() {
+  return lastFrame;
+}
+
+void metricsSetEventCount(uint32_t count) {
+  eventCount = count;
+}
+
+static void header(void (*emit)(const char*), const char* name, const char* type, const char* help) {
+  char buf[160];
+  snprintf(buf, sizeof(buf), "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+  emit(buf);
+}
+
+static void gauge(void (*emit)(const char*), const char* name, const char* help, double value) {
+  char buf[96];
+  header(emit, name, "gauge", help);
+  snprintf(buf, sizeof(buf), "%s %.6g\n", name, value);
+  emit(buf);
+}
+
+#ifndef NO_INSTRUMENTATION
+// Profiler phases as a Prometheus histogram; log2 buckets map onto "le"
+static void phaseHistograms(void (*emit)(const char*)) {
+  char buf[256];
+  header(emit, "calendar_phase_duration_seconds", "histogram", "Firmware phase latency");
+  for (int p = 0; p < PROF_PHASE_COUNT; p++) {
+    const ProfStats* s = profStats((ProfPhase)p);
+    if (!s->count) continue;
+    const char* name = profPhaseName((ProfPhase)p);
+
+    // The full ladder every time: a histogram's set of "le" series must not
+    // change between scrapes
+    uint32_t cumulative = 0;
+    for (int b = 0; b < PROF_BUCKETS; b++) {
+      cumulative += s->buckets[b];
+      snprintf(buf, sizeof(buf), "calendar_phase_duration_seconds_bucket{phase=\"%s\",le=\"%.6g\"} %lu\n",
+               name, (double)(2ULL << b) / 1e6, (unsigned long)cumulative);
+      emit(buf);
+    }
+    snprintf(buf, sizeof(buf),
+             "calendar_phase_duration_seconds_bucket{phase=\"%s\",le=\"+Inf\"} %lu\n"
+             "calendar_phase_duration_seconds_sum{phase=\"%s\"} %.6f\n"
+             "calendar_phase_duration_seconds_count{phase=\"%s\"} %lu\n",
+             name, (unsigned long)s->count, name, (double)s->totalUs / 1e6, name, (unsigned long)s->count);
+    emit(buf);
+  }
+}
+#endif
+
+#ifndef NO_INSTRUMENTATION
+static void allocMetrics(void (*emit)(const char*)) {
+  static const char* regions[ALLOC_REGION_COUNT] = {"internal", "psram"};
+  char buf[160];
+
+  header(emit, "calendar_alloc_total", "counter", "Heap allocations by phase and region");
+  for (int p = 0; p < ALLOC_PHASE_COUNT; p++) {
+    for (int r = 0; r < ALLOC_REGION_COUNT; r++) {
+      snprintf(buf, sizeof(buf), "calendar_alloc_total{phase=\"%s\",region=\"%s\"} %lu\n",
+               allocPhaseName((AllocPhase)p), regions[r], (unsigned long)allocTotals((AllocPhase)p)->region[r].allocs);
+      emit(buf);
+    }
+  }
+
+  header(emit, "calendar_alloc_bytes_total", "counter", "Heap bytes allocated by phase and region");
+  for (int p = 0; p < ALLOC_PHASE_COUNT; p++) {
+    for (int r = 0; r < ALLOC_REGION_COUNT; r++) {
+      snprintf(buf, sizeof(buf), "calendar_alloc_bytes_total{phase=\"%s\",region=\"%s\"} %llu\n",
+               allocPhaseName((AllocPhase)p), regions[r], (unsigned long long)allocTotals((AllocPhase)p)->region[r].bytesAllocated);
+      emit(buf);
+    }
+  }
+
+  header(emit, "calendar_alloc_window_peak_bytes", "gauge", "Peak live bytes during the last refresh/frame");
+  for (int p = ALLOC_INGEST; p < ALLOC_PHASE_COUNT; p++) {
+    for (int r = 0; r < ALLOC_REGION_COUNT; r++) {
+      snprintf(buf, sizeof(buf), "calendar_alloc_window_peak_bytes{phase=\"%s\",region=\"%s\"} %ld\n",
+               allocPhaseName((AllocPhase)p), regions[r], (long)allocLastWindow((AllocPhase)p)->region[r].peak);
+      emit(buf);
+    }
+  }
+
+  header(emit, "calendar_alloc_budget_violations_total", "counter", "Windows that exceeded their allocation budget");
+  for (int p = ALLOC_INGEST; p < ALLOC_PHASE_COUNT; p++) {
+    snprintf(buf, sizeof(buf), "calendar_alloc_budget_violations_total{phase=\"%s\"} %lu\n",
+             allocPhaseName((AllocPhase)p), (unsigned long)allocBudgetViolations((AllocPhase)p));
+    emit(buf);
+  }
+
+  const HeapSample* samples;
+  int n = heapHistory(&samples);
+  if (n) {
+    const HeapSample& s = samples[n - 1];
+    header(emit, "calendar_heap_fragmentation_ratio", "gauge", "1 - largest free block / total free (last sample)");
+    for (int r = 0; r < ALLOC_REGION_COUNT; r++) {
+      double frag = s.freeBytes[r] ? 1.0 - (double)s.largestBlock[r] / s.freeBytes[r] : 0.0;
+      snprintf(buf, sizeof(buf), "calendar_heap_fragmentation_ratio{region=\"%s\"} %.4f\n", regions[r], frag);
+      emit(buf);
+    }
+  }
+}
+#endif
+
+void metricsReport(const SystemGauges& sys, void (*emit)(const char* text)) {
+  char buf[160];
+
+  gauge(emit, "calendar_uptime_seconds", "Seconds since boot", sys.uptimeSec);
+  gauge(emit, "calendar_heap_free_bytes", "Free internal heap", sys.heapFree);
+  gauge(emit, "calendar_heap_largest_free_block_bytes", "Largest allocatable internal block", sys.heapLargestBlock);
+  gauge(emit, "calendar_psram_free_bytes", "Free PSRAM", sys.psramFree);
+  gauge(emit, "calendar_wifi_rssi_dbm", "WiFi signal strength", sys.wifiRssi);
+  gauge(emit, "calendar_events", "Events in the current snapshot", eventCount);
+
+  header(emit, "calendar_refresh_total", "counter", "Calendar refresh attempts");
+  snprintf(buf, sizeof(buf), "calendar_refresh_total{result=\"ok\"} %lu\ncalendar_refresh_total{result=\"error\"} %lu\n",
+           (unsigned long)refreshOk, (unsigned long)refreshErrors);
+  emit(buf);
+
+  gauge(emit, "calendar_refresh_last_duration_seconds", "Duration of the last refresh attempt", lastRefreshMs / 1000.0);
+  gauge(emit, "calendar_refresh_last_success_age_seconds", "Seconds since the last successful refresh (-1 = never)",
+        lastRefreshUptime ? (double)(sys.uptimeSec - lastRefreshUptime) : -1.0);
+
+  RefreshRecord last;
+  if (refreshLogLast(last)) {
+    header(emit, "calendar_refresh_last_step_seconds", "gauge", "Per-step duration of the last refresh attempt");
+    for (int s = 0; s < REFRESH_STEP_COUNT; s++) {
+      snprintf(buf, sizeof(buf), "calendar_refresh_last_step_seconds{step=\"%s\"} %.6f\n",
+               refreshStepName((RefreshStep)s), last.stepUs[s] / 1e6);
+      emit(buf);
+    }
+    header(emit, "calendar_refresh_last_server_seconds", "gauge", "API Server-Timing of the last refresh (steps it reported)");
+    for (int s = 0; s < SERVER_STEP_COUNT; s++) {
+      if (!last.serverUs[s]) continue;
+      snprintf(buf, sizeof(buf), "calendar_refresh_last_server_seconds{step=\"%s\"} %.6f\n",
+               serverStepName((ServerStep)s), last.serverUs[s] / 1e6);
+      emit(buf);
+    }
+  }
+
+  header(emit, "calendar_fetch_bytes_total", "counter", "Response body bytes fetched from the API");
+  snprintf(buf, sizeof(buf), "calendar_fetch_bytes_total %llu\n", (unsigned long long)bytesTotal);
+  emit(buf);
+  gauge(emit, "calendar_fetch_last_bytes", "Body size of the last successful refresh", lastBytes);
+
+  header(emit, "calendar_frames_total", "counter", "Completed frames per view and layout (device, API or tile server)");
+  for (int l = 0; l < FRAME_SOURCES; l++) {
+    for (int v = 0; v < METRIC_VIEWS; v++) {
+      snprintf(buf, sizeof(buf), "calendar_frames_total{view=\"%s\",layout=\"%s\"} %lu\n",
+               viewNames[v], layoutNames[l], (unsigned long)frames[l][v]);
+      emit(buf);
+    }
+  }
+
+  header(emit, "calendar_frame_render_seconds", "summary", "Render time per frame (excluding time yielded to input)");
+  for (int l = 0; l < FRAME_SOURCES; l++) {
+    for (int v = 0; v < METRIC_VIEWS; v++) {
+      snprintf(buf, sizeof(buf),
+               "calendar_frame_render_seconds_sum{view=\"%s\",layout=\"%s\"} %.6f\n"
+               "calendar_frame_render_seconds_count{view=\"%s\",layout=\"%s\"} %lu\n",
+               viewNames[v], layoutNames[l], (double)frameRenderUs[l][v] / 1e6,
+               viewNames[v], layoutNames[l], (unsigned long)frames[l][v]);
+      emit(buf);
+    }
+  }
+
+#ifndef NO_INSTRUMENTATION
+  phaseHistograms(emit);
+  allocMetrics(emit);
+#endif
+}
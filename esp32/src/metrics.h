@@ -0,0 +1,44 @@
+#pragma once
+
+// Device metrics in Prometheus text exposition format.
+//
+// Counters are bumped by whichever task owns the event (network task for
+// refreshes, UI loop for frames); each value has a single writer, scrapes
+// read without locking. System gauges are sampled by the caller at scrape
+// time because they are platform specific.
+
+#include <stdint.h>
+
+#define METRICS_PORT 9100
+
+struct SystemGauges {
+  uint32_t uptimeSec;
+  uint32_t heapFree;
+  uint32_t heapLargestBlock;
+  uint32_t psramFree;
+  int32_t wifiRssi;
+};
+
+// Network task: one call per refresh attempt
+void metricsRefreshDone(bool ok, uint32_t durationMs, uint32_t bytes, uint32_t uptimeSec);
+
+// What a frame was drawn from: events laid out here, a page laid out by
+// the API (layout.h), or tiles rendered by the tile server (tiles.h)
+enum FrameSource { FRAME_DEVICE, FRAME_SERVER_LAYOUT, FRAME_TILES };
+#define FRAME_SOURCES 3
+
+// UI loop: one call per completed frame; view is a ViewMode value
+void metricsFrameDone(int view, int source, uint32_t renderUs);
+void metricsSetEventCount(uint32_t count);
+
+// Most recent completed frame; seq counts frames since boot (0 = none yet)
+struct FrameSample {
+  uint32_t seq;
+  int view;
+  int source;           // FrameSource
+  uint32_t renderUs;
+};
+FrameSample metricsLastFrame();
+
+// Emit the full exposition, a line (or a few) per call
+void metricsReport(const SystemGauges& sys, void (*emit)(const char* text));
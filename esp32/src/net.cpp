@@ -0,0 +1,1190 @@
+#include "net.h"
+#include <WiFi.h>
+#include <HTTPClient.h>
+#include <WiFiClientSecure.h>
+#include <esp_timer.h>
+#include <Preferences.h>
+#include "secrets.h"
+#include "ingest.h"
+#include "profiler.h"
+#include "metrics.h"
+#include "alloc_track.h"
+#include "trace.h"
+#include "diag.h"
+#include "recorder.h"
+#include "refresh_log.h"
+#include "binlog.h"
+#include "watch.h"
+#include "ics.h"
+#include "transfer.h"
+#include <algorithm>
+#include <memory>
+
+// No API, so no change stream either
+#if defined(ICS_FEEDS) && !defined(NO_WATCH)
+#define NO_WATCH
+#endif
+
+#define NET_TASK_STACK      12288
+#define WIFI_FAST_TIMEOUT   1500    // Give up on the cached AP after this
+#define WIFI_SCAN_TIMEOUT   15000
+#define BACKOFF_MIN         2000
+#define BACKOFF_MAX         120000
+#define TIME_VALID_AFTER    1609459200  // 2021-01-01, anything earlier is "not synced"
+#define WATCH_RETRY_MIN     5000    // Reopen a change stream that ended normally after this
+#define WATCH_RETRY_MAX     600000  // Growing up to this while the API refuses to stream
+#define WATCH_SILENT_MS     (3 * WATCH_PING_SECS * 1000)   // No pings for this long: dead
+#ifndef ICS_PARALLEL
+#define ICS_PARALLEL        3       // Feeds downloaded at once; a TLS session holds tens of KB while open
+#endif
+#define ICS_READ_CHUNK      1436    // Bytes read from one feed's socket before the next gets a turn
+#define ICS_SILENT_MS       20000   // A feed that sends nothing for this long fails the refresh
+#define ICS_REDIRECTS       3
+
+// Cached AP so reconnects can skip the channel scan
+struct WifiCache {
+  uint8_t bssid[6];
+  int32_t channel;
+};
+
+static TaskHandle_t netTask = NULL;
+static SemaphoreHandle_t dataMutex = NULL;
+
+static volatile NetPhase phase = NET_WIFI_FAST;
+static volatile bool timeValid = false;
+static unsigned long phaseStart = 0;
+
+// Retry target after NET_BACKOFF
+static NetPhase retryPhase = NET_FETCH;
+static unsigned long backoffDelay = BACKOFF_MIN;
+static volatile bool refreshRequested = false;
+static bool ntpStarted = false;
+
+static WiFiServer diagServer(METRICS_PORT);
+static bool diagStarted = false;
+static WiFiClient* diagClient = NULL;
+
+static Preferences prefs;
+static WifiCache wifiCache;
+static bool wifiCacheValid = false;
+
+// Snapshot handed over to the UI loop
+static std::vector<CalEvent> pendingEvents;
+static std::vector<CalInfo> pendingCals;
+static SeriesSet pendingSeries;
+static volatile bool pendingReady = false;
+
+// Server-side layout: the page the UI wants (guarded by dataMutex) and
+// the newest one fetched
+static volatile bool pageWanted = false;      // Asked for at least once
+static volatile bool pageRequested = false;   // Fetch when idle
+static ViewMode pageView = VIEW_WEEK;
+static struct tm pageDate;
+static int pageWidth = 0, pageHeight = 0;
+static PageLayout pendingPage;
+static volatile bool pageReady = false;
+
+// ETag of the snapshot last published, sent back so unchanged data costs
+// a 304 (watch.h)
+static char eventsEtag[48];
+
+// Change stream (watch.h), read between other work on the network task
+static WiFiClient watchPlain;
+static WiFiClientSecure watchSecure;
+static WiFiClient* watchClient = NULL;       // Open stream, NULL if none
+static WatchParser watchParser;
+static bool watchStreaming = false;          // Got as far as the event stream
+static unsigned long watchLastByte = 0;
+static unsigned long watchRetryAt = 0;
+static unsigned long watchRetryDelay = WATCH_RETRY_MIN;
+
+// Thin client: the page the UI shows (guarded by dataMutex), the pages
+// synced around it, and synced pages waiting for the UI
+#define TILE_PAGES 3                           // The page shown and one either side
+#define TILE_TIMEOUT_MS 3000
+static volatile bool tilesWanted = false;
+static volatile bool tilesRequested = false;
+static ViewMode tilesView = VIEW_WEEK;
+static struct tm tilesDate;
+static int tilesWidth = 0, tilesHeight = 0;
+static std::shared_ptr<const TilePage> tileCache[TILE_PAGES];   // Network task only
+static std::vector<std::shared_ptr<const TilePage>> pendingTiles;
+static volatile bool tilesReady = false;
+
+static const char* phaseLabels[] = {"wifi_fast", "wifi_scan", "fetch", "idle", "backoff"};
+
+void bootMark(const char* label) {
+  logWrite(LOG_BOOT_MARK, millis(), label);
+}
+
+static void setPhase(NetPhase p) {
+  phase = p;
+  phaseStart = millis();
+  bootMark(phaseLabels[p]);
+  traceInstant(TRACE_NET_PHASE, p);
+}
+
+static void loadWifiCache() {
+  prefs.begin("wifi", true);
+  wifiCacheValid = prefs.getBytes("ap", &wifiCache, sizeof(wifiCache)) == sizeof(wifiCache);
+  prefs.end();
+}
+
+static void saveWifiCache() {
+  WifiCache c;
+  memset(&c, 0, sizeof(c));
+  memcpy(c.bssid, WiFi.BSSID(), sizeof(c.bssid));
+  c.channel = WiFi.channel();
+
+  // Only touch flash when the AP actually changed
+  if (wifiCacheValid && memcmp(&c, &wifiCache, sizeof(c)) == 0) return;
+
+  prefs.begin("wifi", false);
+  prefs.putBytes("ap", &c, sizeof(c));
+  prefs.end();
+  wifiCache = c;
+  wifiCacheValid = true;
+}
+
+static void startWiFi(bool fast) {
+  WiFi.disconnect();
+#ifdef STATIC_IP
+  IPAddress ip, gateway, subnet, dns;
+  ip.fromString(STATIC_IP);
+  gateway.fromString(STATIC_GATEWAY);
+  subnet.fromString(STATIC_SUBNET);
+  dns.fromString(STATIC_DNS);
+  WiFi.config(ip, gateway, subnet, dns);
+#endif
+  if (fast) {
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD, wifiCache.channel, wifiCache.bssid);
+    setPhase(NET_WIFI_FAST);
+  } else {
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+    setPhase(NET_WIFI_SCAN);
+  }
+}
+
+static void enterBackoff(NetPhase retry) {
+  retryPhase = retry;
+  setPhase(NET_BACKOFF);
+  logWrite(LOG_NET_RETRY, backoffDelay);
+}
+
+static void growBackoff() {
+  // Exponential with a little jitter so several displays don't retry in lockstep
+  backoffDelay = backoffDelay * 2 + random(0, backoffDelay / 4 + 1);
+  if (backoffDelay > BACKOFF_MAX) backoffDelay = BACKOFF_MAX;
+}
+
+static void checkTime() {
+  if (timeValid || !ntpStarted) return;
+  if (time(NULL) > TIME_VALID_AFTER) {
+    timeValid = true;
+    bootMark("ntp_synced");
+  }
+}
+
+static void publish(std::vector<CalEvent>& newEvents, std::vector<CalInfo>& newCals, SeriesSet& newSeries) {
+  xSemaphoreTake(dataMutex, portMAX_DELAY);
+  pendingEvents.swap(newEvents);
+  pendingCals.swap(newCals);
+  std::swap(pendingSeries, newSeries);
+  pendingReady = true;
+  xSemaphoreGive(dataMutex);
+}
+
+// "http[s]://host[:port]/..."
+static bool splitUrl(const char* url, char* host, size_t hostSize, uint16_t& port, bool& tls) {
+  tls = !strncmp(url, "https://", 8);
+  if (!tls && strncmp(url, "http://", 7)) return false;
+  const char* h = url + (tls ? 8 : 7);
+  size_t len = strcspn(h, ":/");
+  if (!len || len >= hostSize) return false;
+  memcpy(host, h, len);
+  host[len] = 0;
+  port = h[len] == ':' ? atoi(h + len + 1) : (tls ? 443 : 80);
+  return true;
+}
+
+// Separate TCP and TLS timing needs STARTTLS support in WiFiClientSecure
+// (arduino-esp32 2.0.10+); on older cores the handshake is counted as connect.
+template <typename T>
+static auto connectSplit(T& client, const char* host, uint16_t port, RefreshRecord& rec, int)
+    -> decltype(client.setPlainStart(), client.startTLS(), bool()) {
+  client.setPlainStart();
+  uint32_t t = micros();
+  if (!client.connect(host, port)) return false;
+  rec.stepUs[REFRESH_CONNECT] = micros() - t;
+  t = micros();
+  bool ok = client.startTLS() > 0;
+  rec.stepUs[REFRESH_TLS] = micros() - t;
+  return ok;
+}
+
+template <typename T>
+static bool connectSplit(T& client, const char* host, uint16_t port, RefreshRecord& rec, long) {
+  uint32_t t = micros();
+  bool ok = client.connect(host, port);
+  rec.stepUs[REFRESH_CONNECT] = micros() - t;
+  return ok;
+}
+
+// GET `url` with every step timed into `rec`. False (with rec.status set)
+// unless the body arrived with a 200, or `ifNoneMatch` was given and the
+// server answered 304 (payload left empty). The response's ETag goes to
+// `etag` when given.
+static bool httpFetch(const char* url, RefreshRecord& rec, String& payload, const char* ifNoneMatch = NULL,
+                      String* etag = NULL) {
+  HTTPClient http;
+  char host[128];
+  uint16_t port;
+  bool tls;
+  if (!splitUrl(url, host, sizeof(host), port, tls)) {
+    logWrite(LOG_NET_BAD_URL, API_URL);
+    return false;
+  }
+
+  // Resolve and connect ourselves so each step can be timed; HTTPClient
+  // reuses a client that is already connected. The resolved name stays
+  // in lwIP's DNS cache, so connect() doesn't look it up again.
+  IPAddress ip;
+  uint32_t t = micros();
+  bool resolved = WiFi.hostByName(host, ip) == 1;
+  rec.stepUs[REFRESH_DNS] = micros() - t;
+  if (!resolved) {
+    logWrite(LOG_NET_DNS_FAILED, host);
+    rec.status = HTTPC_ERROR_CONNECTION_REFUSED;
+    return false;
+  }
+
+  WiFiClient plain;
+  WiFiClientSecure secure;
+  bool connected;
+  if (tls) {
+    secure.setInsecure();   // Same as HTTPClient without a CA certificate
+    connected = connectSplit(secure, host, port, rec, 0);
+  } else {
+    connected = connectSplit(plain, host, port, rec, 0);
+  }
+  if (!connected) {
+    logWrite(LOG_NET_CONNECT_FAILED, host, port);
+    rec.status = HTTPC_ERROR_CONNECTION_REFUSED;
+    return false;
+  }
+
+  http.begin(tls ? (WiFiClient&)secure : plain, url);
+  http.setReuse(false);
+  http.addHeader("x-api-key", API_SECRET);
+  if (ifNoneMatch) http.addHeader("If-None-Match", ifNoneMatch);
+  static const char* collect[] = {"Server-Timing", "ETag"};
+  http.collectHeaders(collect, 2);
+
+  int code;
+  t = micros();
+  {
+    PROF_SCOPE(PROF_NET_GET);
+    code = http.GET();
+  }
+  rec.stepUs[REFRESH_TTFB] = micros() - t;
+  rec.status = code;
+  if (code == HTTP_CODE_NOT_MODIFIED && ifNoneMatch) {
+    refreshParseServerTiming(http.header("Server-Timing").c_str(), rec);
+    http.end();
+    return true;
+  }
+  if (code != HTTP_CODE_OK) {
+    logWrite(LOG_NET_GET_FAILED, code);
+    http.end();
+    return false;
+  }
+  refreshParseServerTiming(http.header("Server-Timing").c_str(), rec);
+  if (etag) *etag = http.header("ETag");
+
+  t = micros();
+  {
+    PROF_SCOPE(PROF_NET_BODY);
+    payload = http.getString();
+  }
+  rec.stepUs[REFRESH_TRANSFER] = micros() - t;
+  http.end();
+  rec.bodyBytes = payload.length();
+  return true;
+}
+
+// -1 month to +2 months from today, whole days so the URL (and with it
+// the ETag) stays the same until midnight
+static void fetchWindow(struct tm& startTm, struct tm& endTm) {
+  time_t now; time(&now);
+  localtime_r(&now, &startTm);
+  startTm.tm_hour = startTm.tm_min = startTm.tm_sec = 0;
+  endTm = startTm;
+  startTm.tm_mon -= 1; mktime(&startTm);
+  endTm.tm_mon += 2; mktime(&endTm);
+}
+
+#ifndef ICS_FEEDS
+// `changed` is false when the API answered 304 to the ETag we hold
+static bool fetchEvents(RefreshRecord& rec, bool& changed) {
+  TRACE_SCOPE(TRACE_REFRESH);
+  char url[256];
+  changed = false;
+
+  // Only what the display reads (?profile=device, ingest.h), recurring
+  // events as compact series (series.h)
+  if (timeValid) {
+    struct tm startTm, endTm;
+    fetchWindow(startTm, endTm);
+    char startIso[30], endIso[30];
+    strftime(startIso, sizeof(startIso), "%Y-%m-%dT%H:%M:%SZ", &startTm);
+    strftime(endIso, sizeof(endIso), "%Y-%m-%dT%H:%M:%SZ", &endTm);
+    snprintf(url, sizeof(url), "%s?from=%s&to=%s&profile=device&series=1", API_URL, startIso, endIso);
+  } else {
+    // NTP still running in the background: let the API pick its default range
+    snprintf(url, sizeof(url), "%s?profile=device&series=1", API_URL);
+  }
+
+  String payload, etag;
+  if (!httpFetch(url, rec, payload, eventsEtag[0] ? eventsEtag : NULL, &etag)) return false;
+  if (rec.status == HTTP_CODE_NOT_MODIFIED) return true;
+  recPayload(payload.c_str(), payload.length());
+
+  std::vector<CalEvent> newEvents;
+  std::vector<CalInfo> newCals;
+  SeriesSet newSeries;
+  const char* error;
+  uint32_t t = micros();
+  bool parsed = ingestCalendarJson(payload.c_str(), payload.length(), newEvents, newCals, &error, &newSeries);
+  rec.stepUs[REFRESH_DECODE] = micros() - t;
+  if (!parsed) {
+    logWrite(LOG_NET_JSON_ERROR, error);
+    return false;
+  }
+  rec.events = newEvents.size() + newSeries.series.size();
+
+  t = micros();
+  publish(newEvents, newCals, newSeries);
+  rec.stepUs[REFRESH_APPLY] = micros() - t;
+  snprintf(eventsEtag, sizeof(eventsEtag), "%s", etag.length() < sizeof(eventsEtag) ? etag.c_str() : "");
+  changed = true;
+  return true;
+}
+#endif
+
+#ifdef ICS_FEEDS
+// Calendars read straight from their ICS (ics.h) instead of the API
+struct IcsFeed {
+  const char* name;
+  const char* color;
+  const char* url;
+};
+static const IcsFeed icsFeeds[] = {ICS_FEEDS};
+#define ICS_FEED_COUNT (sizeof(icsFeeds) / sizeof(icsFeeds[0]))
+
+// Each feed's VEVENTs as of its last download (ics.h), so a download only
+// expands what changed. Network task only.
+static IcsIndex icsIndexes[ICS_FEED_COUNT];
+// A feed's index moved past the snapshot last published (another feed
+// failed after it finished), or nothing was published yet
+static bool icsUnpublished = true;
+
+// One feed being downloaded: its connection, the HTTP framing around the
+// body (transfer.h) and the parser the body goes into. About 3 KB plus
+// the TLS session while connected, on the heap.
+struct IcsTransfer {
+  size_t feed;            // Index into icsFeeds
+  String url;             // Where redirects led
+  uint8_t redirects;
+  WiFiClient plain;
+  WiFiClientSecure secure;
+  WiFiClient* client;
+  TransferParser http;
+  IcsParser parser;
+  IcsCollector collector;   // Into the feed's IcsIndex
+  uint32_t startMs;
+  uint32_t sentUs;        // Request sent, for the wait until its headers
+  uint32_t lastByteMs;
+  uint32_t parseUs;
+};
+
+enum IcsStep {
+  ICS_IDLE,               // Nothing arrived
+  ICS_PROGRESS,
+  ICS_FINISHED,           // Events complete in the feed's index
+  ICS_FAILED              // Logged, rec.status set
+};
+
+static void icsBody(void* ctx, const char* bytes, size_t len) {
+  IcsTransfer& x = *(IcsTransfer*)ctx;
+  uint32_t t = micros();
+  icsFeed(x.parser, bytes, len, icsCollect, &x.collector);
+  x.parseUs += micros() - t;
+}
+
+// Connect to x.url and send the request; the response is read by icsPump().
+// DNS, TCP connect and the TLS handshake block (WiFiClientSecure has no
+// non-blocking handshake), so slots connect one after another; only the
+// downloads overlap. The rest doesn't block.
+static bool icsOpen(IcsTransfer& x, time_t from, time_t to, RefreshRecord& rec) {
+  char host[128];
+  uint16_t port;
+  bool tls;
+  if (!splitUrl(x.url.c_str(), host, sizeof(host), port, tls)) {
+    logWrite(LOG_NET_BAD_URL, x.url.c_str());
+    return false;
+  }
+  IPAddress ip;
+  uint32_t t = micros();
+  bool resolved = WiFi.hostByName(host, ip) == 1;
+  rec.stepUs[REFRESH_DNS] += micros() - t;
+  if (!resolved) {
+    logWrite(LOG_NET_DNS_FAILED, host);
+    rec.status = HTTPC_ERROR_CONNECTION_REFUSED;
+    return false;
+  }
+
+  // connectSplit() sets the steps; feeds add theirs up
+  RefreshRecord steps = {};
+  bool connected;
+  x.plain.stop();
+  x.secure.stop();
+  if (tls) {
+    x.secure.setInsecure();   // Same as HTTPClient without a CA certificate
+    x.client = &x.secure;
+    connected = connectSplit(x.secure, host, port, steps, 0);
+  } else {
+    x.client = &x.plain;
+    connected = connectSplit(x.plain, host, port, steps, 0);
+  }
+  rec.stepUs[REFRESH_CONNECT] += steps.stepUs[REFRESH_CONNECT];
+  rec.stepUs[REFRESH_TLS] += steps.stepUs[REFRESH_TLS];
+  if (!connected) {
+    logWrite(LOG_NET_CONNECT_FAILED, host, port);
+    rec.status = HTTPC_ERROR_CONNECTION_REFUSED;
+    return false;
+  }
+
+  const char* path = strchr(x.url.c_str() + (tls ? 8 : 7), '/');
+  char hostHeader[136];
+  if (port == (tls ? 443 : 80)) snprintf(hostHeader, sizeof(hostHeader), "%s", host);
+  else snprintf(hostHeader, sizeof(hostHeader), "%s:%u", host, port);
+  x.client->printf("GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: ESP32HTTPClient\r\nConnection: close\r\n\r\n",
+                   path ? path : "/", hostHeader);
+  transferReset(x.http);
+  icsBegin(x.parser, from, to);
+  icsCollectBegin(x.collector, x.parser, hexToRGB(icsFeeds[x.feed].color), icsIndexes[x.feed]);
+  x.sentUs = micros();
+  x.lastByteMs = millis();
+  return true;
+}
+
+// Read what arrived for `x`, at most ICS_READ_CHUNK bytes so the other
+// transfers get their turn
+static IcsStep icsPump(IcsTransfer& x, time_t from, time_t to, RefreshRecord& rec, uint32_t& waitUs) {
+  static char buf[ICS_READ_CHUNK];   // Network task only
+  int n = x.client->available();
+  if (n > 0) n = x.client->read((uint8_t*)buf, n < ICS_READ_CHUNK ? n : ICS_READ_CHUNK);
+  if (n > 0) {
+    bool headers = x.http.state >= TRANSFER_CHUNK_SIZE;
+    x.lastByteMs = millis();
+    if (!transferFeed(x.http, buf, n, icsBody, &x)) {
+      logWrite(LOG_NET_GET_FAILED, x.http.status);
+      rec.status = HTTPC_ERROR_CONNECTION_LOST;
+      return ICS_FAILED;
+    }
+    // The longest wait for headers is what the refresh waited for
+    if (!headers && x.http.state >= TRANSFER_CHUNK_SIZE) waitUs = std::max(waitUs, (uint32_t)(micros() - x.sentUs));
+    if (x.http.state != TRANSFER_DONE) return ICS_PROGRESS;
+  } else if (x.client->connected()) {
+    if (millis() - x.lastByteMs < ICS_SILENT_MS) return ICS_IDLE;
+    logWrite(LOG_NET_ICS_SILENT, icsFeeds[x.feed].name, ICS_SILENT_MS / 1000);
+    rec.status = HTTPC_ERROR_READ_TIMEOUT;
+    return ICS_FAILED;
+  } else if (!transferClosed(x.http)) {
+    logWrite(LOG_NET_GET_FAILED, HTTPC_ERROR_CONNECTION_LOST);
+    rec.status = HTTPC_ERROR_CONNECTION_LOST;
+    return ICS_FAILED;
+  }
+
+  x.client->stop();
+  int status = x.http.status;
+  bool redirect = status == 301 || status == 302 || status == 303 || status == 307 || status == 308;
+  if (redirect && x.http.location[0] && x.redirects < ICS_REDIRECTS) {
+    // Relative Locations keep scheme and host
+    char url[TRANSFER_LINE_MAX + 128];
+    if (x.http.location[0] == '/') {
+      const char* old = x.url.c_str();
+      const char* hostEnd = strchr(old + (strncmp(old, "https://", 8) ? 7 : 8), '/');
+      int len = hostEnd ? hostEnd - old : strlen(old);
+      snprintf(url, sizeof(url), "%.*s%s", len, old, x.http.location);
+    } else {
+      snprintf(url, sizeof(url), "%s", x.http.location);
+    }
+    x.url = url;
+    x.redirects++;
+    return icsOpen(x, from, to, rec) ? ICS_PROGRESS : ICS_FAILED;
+  }
+  rec.status = status;
+  if (status != HTTP_CODE_OK) {
+    logWrite(LOG_NET_GET_FAILED, status);
+    return ICS_FAILED;
+  }
+
+  uint32_t t = micros();
+  icsEnd(x.parser, icsCollect, &x.collector);
+  icsCollectEnd(x.collector);
+  x.parseUs += micros() - t;
+  const IcsFeed& feed = icsFeeds[x.feed];
+  logWrite(LOG_NET_ICS_FEED, feed.name, x.parser.bytes, x.parser.vevents, x.parser.emitted);
+  if (x.collector.unsupported) logWrite(LOG_NET_ICS_RRULE, feed.name, x.collector.unsupported);
+  unsigned counts[3] = {0, 0, 0};
+  for (const IcsChange& change : x.collector.changes) counts[change.kind]++;
+  logWrite(LOG_NET_ICS_CHANGES, feed.name, counts[ICS_ADDED], counts[ICS_CHANGED], counts[ICS_REMOVED],
+           x.collector.reused, x.collector.rebuilt ? " (rebuilt)" : "");
+  return ICS_FINISHED;
+}
+
+// Every ICS_FEEDS calendar, parsed while it downloads. Up to ICS_PARALLEL
+// feeds download at once on this task, each socket read in turn, so a
+// refresh takes about as long as its slowest feed rather than all of them
+// together, plus every feed's connection setup, which doesn't overlap
+// (icsOpen()); the others start as slots free up. A feed that fails fails
+// the refresh, so a snapshot never lacks a calendar, and all of them are
+// published as one snapshot. When no feed changed since the snapshot last
+// published (IcsCollector::changes), nothing is published and the UI keeps
+// its events, reminders and frame, like after a 304 from the API.
+static bool fetchFeeds(RefreshRecord& rec, bool& changed) {
+  TRACE_SCOPE(TRACE_REFRESH);
+  changed = false;
+  struct tm startTm, endTm;
+  fetchWindow(startTm, endTm);
+  time_t from = mktime(&startTm);
+  time_t to = mktime(&endTm);
+
+  std::vector<CalInfo> newCals;
+  for (const IcsFeed& feed : icsFeeds) {
+    CalInfo ci;
+    ci.name = feed.name;
+    ci.color = hexToRGB(feed.color);
+    newCals.push_back(ci);
+  }
+
+  std::unique_ptr<IcsTransfer> slots[ICS_PARALLEL];
+  size_t next = 0, finished = 0;
+  uint32_t parseUs = 0, waitUs = 0, slowestMs = 0;
+  size_t slowest = 0;
+  uint32_t start = micros();
+  bool ok = true;
+  bool anyChange = false;
+  while (ok && finished < ICS_FEED_COUNT) {
+    // Connect every free slot before reading any. Connecting blocks
+    // (icsOpen()), and the servers of requests already sent work meanwhile
+    for (std::unique_ptr<IcsTransfer>& slot : slots) {
+      if (slot || next >= ICS_FEED_COUNT) continue;
+      slot.reset(new IcsTransfer());
+      slot->feed = next++;
+      slot->url = icsFeeds[slot->feed].url;
+      slot->redirects = 0;
+      slot->parseUs = 0;
+      slot->startMs = millis();
+      if (!icsOpen(*slot, from, to, rec)) {
+        ok = false;
+        break;
+      }
+    }
+    if (!ok) break;
+
+    bool progress = false;
+    for (std::unique_ptr<IcsTransfer>& slot : slots) {
+      if (!slot) continue;
+
+      IcsStep step;
+      {
+        PROF_SCOPE(PROF_NET_BODY);
+        step = icsPump(*slot, from, to, rec, waitUs);
+      }
+      if (step == ICS_FAILED) {
+        ok = false;
+        break;
+      }
+      if (step == ICS_IDLE) continue;
+      progress = true;
+      if (step == ICS_FINISHED) {
+        uint32_t ms = millis() - slot->startMs;
+        if (ms >= slowestMs) {
+          slowestMs = ms;
+          slowest = slot->feed;
+        }
+        parseUs += slot->parseUs;
+        rec.bodyBytes += slot->parser.bytes;
+        if (!slot->collector.changes.empty()) anyChange = true;
+        slot.reset();
+        finished++;
+      }
+    }
+    if (!progress) delay(1);   // Every socket is waiting on the network
+  }
+  // Slots still open on failure close with their clients here
+  for (std::unique_ptr<IcsTransfer>& slot : slots) slot.reset();
+  if (!ok) {
+    icsUnpublished = true;
+    return false;
+  }
+
+  // Steps as wall time: connecting, the longest wait for headers, parsing
+  // (inside the transfers) and the rest of the downloads
+  uint32_t elapsed = micros() - start;
+  uint32_t known = rec.stepUs[REFRESH_DNS] + rec.stepUs[REFRESH_CONNECT] + rec.stepUs[REFRESH_TLS] + waitUs + parseUs;
+  rec.stepUs[REFRESH_TTFB] = waitUs;
+  rec.stepUs[REFRESH_TRANSFER] = elapsed > known ? elapsed - known : 0;
+  rec.stepUs[REFRESH_DECODE] = parseUs;
+  logWrite(LOG_NET_ICS_DONE, (unsigned)ICS_FEED_COUNT, elapsed / 1000, icsFeeds[slowest].name, slowestMs);
+  if (!anyChange && !icsUnpublished) return true;
+
+  // Copied out of the indexes in feed order, so which one finished first
+  // doesn't change the snapshot, then merged in start order, as the API
+  // sends them
+  uint32_t t = micros();
+  std::vector<CalEvent> newEvents;
+  size_t total = 0;
+  for (const IcsIndex& index : icsIndexes) total += index.events.size();
+  newEvents.reserve(total);
+  for (const IcsIndex& index : icsIndexes) icsIndexEvents(index, newEvents);
+  std::stable_sort(newEvents.begin(), newEvents.end(),
+                   [](const CalEvent& a, const CalEvent& b) { return a.start < b.start; });
+  rec.stepUs[REFRESH_DECODE] += micros() - t;
+  rec.events = newEvents.size();
+
+  t = micros();
+  SeriesSet noSeries;   // Feeds come expanded (ics.h)
+  publish(newEvents, newCals, noSeries);
+  rec.stepUs[REFRESH_APPLY] = micros() - t;
+  icsUnpublished = false;
+  changed = true;
+  return true;
+}
+#endif
+
+// Minutes east of UTC at `t` (newlib's struct tm has no tm_gmtoff)
+static long utcOffsetMinutes(time_t t) {
+  struct tm local, utc;
+  localtime_r(&t, &local);
+  gmtime_r(&t, &utc);
+  utc.tm_isdst = local.tm_isdst;
+  return (long)(t - mktime(&utc)) / 60;
+}
+
+// The layout's `tz`: minutes east of UTC at `from`, then every change
+// before `to` as ",<UTC seconds>:<minutes>", so the API puts each day of
+// a page that spans a DST switch on this clock. Looked for a day at a
+// time, then narrowed to the second.
+static void tzParam(char* buf, size_t len, time_t from, time_t to) {
+  long offset = utcOffsetMinutes(from);
+  int n = snprintf(buf, len, "%ld", offset);
+  time_t lo = from;
+  while (lo < to && n < (int)len) {
+    time_t hi = std::min(lo + 86400, to);
+    if (utcOffsetMinutes(hi) != offset) {
+      while (hi - lo > 1) {
+        time_t mid = lo + (hi - lo) / 2;
+        if (utcOffsetMinutes(mid) == offset) lo = mid;
+        else hi = mid;
+      }
+      offset = utcOffsetMinutes(hi);
+      n += snprintf(buf + n, len - n, ",%ld:%ld", (long)hi, offset);
+    }
+    lo = hi;
+  }
+}
+
+static const char* pageViewNames[] = {"day", "week", "month"};
+
+// The page last asked for by netRequestPage(), laid out by the API
+static bool fetchPage(RefreshRecord& rec) {
+  TRACE_SCOPE(TRACE_REFRESH);
+  xSemaphoreTake(dataMutex, portMAX_DELAY);
+  ViewMode view = pageView;
+  struct tm date = pageDate;
+  int width = pageWidth, height = pageHeight;
+  xSemaphoreGive(dataMutex);
+
+  // Any page `date` is on, with a day to spare: a month grid starts up to
+  // 36 days before it and shows 42
+  struct tm midnight = date;
+  midnight.tm_hour = midnight.tm_min = midnight.tm_sec = 0;
+  midnight.tm_isdst = -1;
+  time_t anchor = mktime(&midnight);
+  char tz[64];
+  tzParam(tz, sizeof(tz), anchor - 38 * 86400, anchor + 43 * 86400);
+
+  char url[256];
+  snprintf(url, sizeof(url), "%s?layout=%s&w=%d&h=%d&date=%04d-%02d-%02d&tz=%s", API_URL,
+           pageViewNames[view], width, height, date.tm_year + 1900, date.tm_mon + 1, date.tm_mday, tz);
+
+  String payload;
+  if (!httpFetch(url, rec, payload)) return false;
+  recPage(payload.c_str(), payload.length());
+
+  PageLayout newPage;
+  const char* error;
+  uint32_t t = micros();
+  bool parsed = ingestLayoutJson(payload.c_str(), payload.length(), newPage, &error);
+  rec.stepUs[REFRESH_DECODE] = micros() - t;
+  if (!parsed) {
+    logWrite(LOG_NET_JSON_ERROR, error);
+    return false;
+  }
+  rec.events = newPage.events.size();
+
+  t = micros();
+  xSemaphoreTake(dataMutex, portMAX_DELAY);
+  std::swap(pendingPage, newPage);
+  pageReady = true;
+  xSemaphoreGive(dataMutex);
+  rec.stepUs[REFRESH_APPLY] = micros() - t;
+  return true;
+}
+
+#ifdef TILE_URL
+struct TileClient {
+  WiFiClient client;
+  HTTPClient http;
+};
+
+// TileGet for tileSync(): reads exactly Content-Length bytes into `body`
+static int tileGet(void* ctx, const char* url, const char* ifNoneMatch, TileData& body) {
+  HTTPClient& http = ((TileClient*)ctx)->http;
+  if (!http.begin(((TileClient*)ctx)->client, url)) return HTTPC_ERROR_CONNECTION_REFUSED;
+  http.setReuse(true);
+  http.setTimeout(TILE_TIMEOUT_MS);
+  http.addHeader("x-api-key", API_SECRET);
+  if (ifNoneMatch) {
+    char etag[16];
+    snprintf(etag, sizeof(etag), "\"%s\"", ifNoneMatch);
+    http.addHeader("If-None-Match", etag);
+  }
+
+  int code;
+  {
+    PROF_SCOPE(PROF_NET_GET);
+    code = http.GET();
+  }
+  if (code == HTTP_CODE_OK) {
+    PROF_SCOPE(PROF_NET_BODY);
+    int len = http.getSize();
+    if (len < 0 || len > TILE_MAX_BYTES) {
+      code = HTTPC_ERROR_TOO_LESS_RAM;
+    } else {
+      body.resize(len);
+      WiFiClient* stream = http.getStreamPtr();
+      size_t got = 0;
+      while (got < (size_t)len) {
+        size_t n = stream->readBytes(body.data() + got, len - got);
+        if (!n) break;
+        got += n;
+      }
+      if (got != (size_t)len) code = HTTPC_ERROR_CONNECTION_LOST;
+    }
+  }
+  http.end();
+  return code;
+}
+#endif
+
+// The page last asked for by netRequestTiles(), then its neighbours. Each
+// synced page is handed to the UI as soon as it is complete.
+static bool fetchTiles(RefreshRecord& rec, TileSyncStats& stats) {
+#ifdef TILE_URL
+  TRACE_SCOPE(TRACE_REFRESH);
+  xSemaphoreTake(dataMutex, portMAX_DELAY);
+  ViewMode view = tilesView;
+  struct tm date = tilesDate;
+  int width = tilesWidth, height = tilesHeight;
+  xSemaphoreGive(dataMutex);
+
+  // Tiles may come from any page held before or synced in this pass
+  std::shared_ptr<const TilePage> known[2 * TILE_PAGES];
+  for (int i = 0; i < TILE_PAGES; i++) known[i] = tileCache[i];
+
+  static const int order[TILE_PAGES] = {0, 1, -1};
+  TileClient client;
+  for (int i = 0; i < TILE_PAGES; i++) {
+    struct tm pageDate = pageShift(view, date, order[i]);
+    std::shared_ptr<const TilePage> page =
+        tileSync(tileGet, &client, TILE_URL, view, pageDate, width, height, known, 2 * TILE_PAGES, stats);
+    rec.status = stats.status;
+    if (!page) {
+      logWrite(LOG_NET_GET_FAILED, stats.status);
+      break;
+    }
+    known[TILE_PAGES + i] = page;
+
+    xSemaphoreTake(dataMutex, portMAX_DELAY);
+    pendingTiles.push_back(page);
+    tilesReady = true;
+    xSemaphoreGive(dataMutex);
+
+    // Moved on meanwhile: the neighbours of this page can wait
+    if (tilesRequested) break;
+  }
+
+  // Keep what this pass synced; anything it didn't get to stays
+  for (int i = 0; i < TILE_PAGES; i++) {
+    if (known[TILE_PAGES + i]) tileCache[i] = known[TILE_PAGES + i];
+  }
+  rec.bodyBytes = stats.bytes;
+  rec.events = stats.fetched;
+  return (bool)known[TILE_PAGES];
+#else
+  return false;
+#endif
+}
+
+#ifndef NO_WATCH
+// A version the API announced: refresh unless it is the one our ETag
+// ("<version>.<window>") already came with
+static void onWatchEvent(void*, const char* event, const char* data) {
+  if (strcmp(event, "version")) return;
+  const char* held = eventsEtag;
+  if (!strncmp(held, "W/", 2)) held += 2;
+  if (*held == '"') held++;
+  size_t len = strlen(data);
+  if (!strncmp(held, data, len) && held[len] == '.') return;
+  logWrite(LOG_NET_WATCH_CHANGE, data);
+  refreshRequested = true;
+}
+
+static void watchClose(const char* why) {
+  watchClient->stop();
+  watchClient = NULL;
+  // Streams end normally (server time limits, proxies); reopen soon. An
+  // API that won't stream at all is asked again less and less often.
+  if (watchStreaming) watchRetryDelay = WATCH_RETRY_MIN;
+  else if ((watchRetryDelay *= 2) > WATCH_RETRY_MAX) watchRetryDelay = WATCH_RETRY_MAX;
+  watchRetryAt = millis() + watchRetryDelay;
+  logWrite(LOG_NET_WATCH_CLOSED, why, watchParser.http.status, watchRetryDelay);
+}
+
+static void watchOpen() {
+  char host[128];
+  uint16_t port;
+  bool tls;
+  if (!splitUrl(API_URL, host, sizeof(host), port, tls)) return;   // Logged by httpFetch
+
+  WiFiClient& client = tls ? (WiFiClient&)watchSecure : watchPlain;
+  if (tls) watchSecure.setInsecure();
+  watchReset(watchParser);
+  watchStreaming = false;
+  watchClient = &client;
+  if (!client.connect(host, port)) {
+    watchClose("connect failed");
+    return;
+  }
+  const char* path = strchr(API_URL + (tls ? 8 : 7), '/');
+  client.printf("GET %s?watch=1 HTTP/1.1\r\nHost: %s\r\nx-api-key: %s\r\nAccept: text/event-stream\r\n\r\n",
+                path ? path : "/", host, API_SECRET);
+  watchLastByte = millis();
+  logWrite(LOG_NET_WATCH_OPEN, host);
+}
+
+#endif
+
+// Change stream upkeep: open it when due, parse whatever arrived, notice
+// when it died. Never blocks except while connecting.
+static void watchTick() {
+#ifndef NO_WATCH
+  if (!watchClient) {
+    if ((long)(millis() - watchRetryAt) >= 0) watchOpen();
+    return;
+  }
+
+  char buf[256];
+  int n;
+  while ((n = watchClient->available()) > 0) {
+    n = watchClient->read((uint8_t*)buf, n < (int)sizeof(buf) ? n : sizeof(buf));
+    if (n <= 0) break;
+    watchLastByte = millis();
+    if (!watchFeed(watchParser, buf, n, onWatchEvent, NULL)) {
+      watchClose(watchParser.http.status == 200 ? "not an event stream" : "refused");
+      return;
+    }
+    if (watchParser.http.state >= TRANSFER_CHUNK_SIZE) watchStreaming = true;
+  }
+  if (!watchClient->connected()) watchClose("ended");
+  else if (millis() - watchLastByte > WATCH_SILENT_MS) watchClose("silent");
+#endif
+}
+
+// From the 64-bit microsecond timer: millis() / 1000 wraps after 49.7 days
+static uint32_t uptimeSec() {
+  return esp_timer_get_time() / 1000000;
+}
+
+static void sampleSystem(SystemGauges& sys) {
+  sys.uptimeSec = uptimeSec();
+  sys.heapFree = ESP.getFreeHeap();
+  sys.heapLargestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  sys.psramFree = ESP.getFreePsram();
+  sys.wifiRssi = WiFi.RSSI();
+}
+
+static void diagEmit(const char* text) {
+  diagClient->print(text);
+}
+
+// Tiny HTTP/1.0 responder for the LAN diagnostics endpoint. Runs on the
+// network task between refreshes, so scrapes never touch the render loop.
+static void serveDiag() {
+  if (!diagStarted) return;
+  WiFiClient client = diagServer.available();
+  if (!client) return;
+
+  client.setTimeout(200);
+  String request = client.readStringUntil('\n');
+  // Drain headers; we don't need any of them
+  for (int i = 0; i < 32 && client.connected(); i++) {
+    String line = client.readStringUntil('\n');
+    if (line.length() <= 1) break;
+  }
+
+  // "GET /path HTTP/1.1"
+  char path[64] = "/";
+  int sp1 = request.indexOf(" ");
+  int sp2 = sp1 >= 0 ? request.indexOf(" ", sp1 + 1) : -1;
+  if (sp2 > sp1 && sp2 - sp1 - 1 < (int)sizeof(path)) {
+    memcpy(path, request.c_str() + sp1 + 1, sp2 - sp1 - 1);
+    path[sp2 - sp1 - 1] = 0;
+  }
+
+  diagClient = &client;
+  diagRespond(path, sampleSystem, diagEmit);
+  diagClient = NULL;
+  client.stop();
+}
+
+static void netLoop(void*) {
+  loadWifiCache();
+  startWiFi(wifiCacheValid);
+
+  for (;;) {
+    checkTime();
+    serveDiag();
+
+    switch (phase) {
+      case NET_WIFI_FAST:
+      case NET_WIFI_SCAN:
+        if (WiFi.status() == WL_CONNECTED) {
+          bootMark("wifi_up");
+          saveWifiCache();
+          if (!diagStarted) {
+            diagServer.begin();
+            diagStarted = true;
+          }
+          if (!ntpStarted) {
+            // SNTP runs in the background; nothing below waits for it
+            configTime(GMT_OFFSET * 3600, DST_OFFSET * 3600, NTP_SERVER);
+            ntpStarted = true;
+          }
+          setPhase(NET_FETCH);
+        } else if (phase == NET_WIFI_FAST && millis() - phaseStart > WIFI_FAST_TIMEOUT) {
+          // AP moved channel or was replaced: fall back to a full scan
+          startWiFi(false);
+        } else if (phase == NET_WIFI_SCAN && millis() - phaseStart > WIFI_SCAN_TIMEOUT) {
+          WiFi.disconnect();
+          enterBackoff(NET_WIFI_SCAN);
+        } else {
+          vTaskDelay(pdMS_TO_TICKS(20));
+        }
+        break;
+
+      case NET_FETCH:
+        if (WiFi.status() != WL_CONNECTED) {
+          startWiFi(wifiCacheValid);
+#ifdef ICS_FEEDS
+        } else if (!timeValid) {
+          // Feeds are cut to the window, which needs the date
+          vTaskDelay(pdMS_TO_TICKS(100));
+#endif
+        } else {
+          uint32_t fetchStart = micros();
+          RefreshRecord rec;
+          memset(&rec, 0, sizeof(rec));
+          bool ok, changed;
+          allocWindowStart(ALLOC_INGEST);
+          {
+            ALLOC_SCOPE(ALLOC_INGEST);
+#ifdef ICS_FEEDS
+            ok = fetchFeeds(rec, changed);
+#else
+            ok = fetchEvents(rec, changed);
+#endif
+          }
+          allocWindowEnd(ALLOC_INGEST);
+          rec.ok = ok;
+          rec.totalUs = micros() - fetchStart;
+          rec.uptimeSec = uptimeSec();
+          refreshLogAdd(rec);
+          logWrite(LOG_NET_REFRESH, !ok ? "failed" : changed ? "ok" : "unchanged", rec.status, rec.totalUs, rec.bodyBytes, rec.events);
+          metricsRefreshDone(ok, rec.totalUs / 1000, rec.bodyBytes, rec.uptimeSec);
+          if (ok) {
+            backoffDelay = BACKOFF_MIN;
+            // New data: the page on screen has to be laid out again
+            if (pageWanted && changed) pageRequested = true;
+            // Tiles are rendered from the tile server's own copy of the
+            // calendars; check them on the same schedule
+            if (tilesWanted) tilesRequested = true;
+            setPhase(NET_IDLE);
+          } else {
+            enterBackoff(NET_FETCH);
+          }
+        }
+        break;
+
+      case NET_IDLE:
+        if (WiFi.status() != WL_CONNECTED) {
+          startWiFi(wifiCacheValid);
+        } else if (refreshRequested) {
+          refreshRequested = false;
+          setPhase(NET_FETCH);
+        } else if (pageRequested) {
+          pageRequested = false;
+          uint32_t fetchStart = micros();
+          RefreshRecord rec;
+          memset(&rec, 0, sizeof(rec));
+          bool ok;
+          {
+            ALLOC_SCOPE(ALLOC_INGEST);
+            ok = fetchPage(rec);
+          }
+          rec.ok = ok;
+          rec.totalUs = micros() - fetchStart;
+          rec.uptimeSec = uptimeSec();
+          refreshLogAdd(rec);
+          logWrite(LOG_NET_PAGE, ok ? "ok" : "failed", rec.status, rec.totalUs, rec.bodyBytes, rec.events);
+        } else if (tilesRequested) {
+          tilesRequested = false;
+          uint32_t fetchStart = micros();
+          RefreshRecord rec;
+          memset(&rec, 0, sizeof(rec));
+          TileSyncStats stats;
+          memset(&stats, 0, sizeof(stats));
+          bool ok;
+          {
+            ALLOC_SCOPE(ALLOC_INGEST);
+            ok = fetchTiles(rec, stats);
+          }
+          rec.totalUs = micros() - fetchStart;
+          logWrite(LOG_NET_TILES, ok ? "ok" : "failed", rec.status, rec.totalUs, rec.bodyBytes,
+                   stats.fetched, stats.notModified, stats.reused);
+        } else {
+          // Refreshes come from the change stream, or as a fallback from
+          // deadlines in the UI's timer wheel, which wakes us up early.
+          // Short wait so metrics scrapes and notifications are handled promptly.
+          watchTick();
+          ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+        }
+        break;
+
+      case NET_BACKOFF:
+        if (millis() - phaseStart >= backoffDelay) {
+          growBackoff();
+          if (retryPhase == NET_FETCH && WiFi.status() == WL_CONNECTED) setPhase(NET_FETCH);
+          else startWiFi(wifiCacheValid);
+        } else {
+          vTaskDelay(pdMS_TO_TICKS(100));
+        }
+        break;
+    }
+  }
+}
+
+void netBegin() {
+  dataMutex = xSemaphoreCreateMutex();
+  WiFi.persistent(false);   // We keep our own AP cache, don't write WiFi config to flash
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(false);
+  xTaskCreatePinnedToCore(netLoop, "net", NET_TASK_STACK, NULL, 1, &netTask, 0);
+}
+
+NetPhase netPhase() {
+  return phase;
+}
+
+const char* netPhaseName() {
+  // Connected before NTP has set the clock: what the boot screen waits for
+  if (phase == NET_IDLE && !timeValid) return "Waiting for time sync...";
+  switch (phase) {
+    case NET_WIFI_FAST: return "Connecting WiFi...";
+    case NET_WIFI_SCAN: return "Searching WiFi...";
+    case NET_FETCH:     return "Loading calendars...";
+    case NET_IDLE:      return "Connected";
+    case NET_BACKOFF:   return "Offline, retrying...";
+  }
+  return "";
+}
+
+void netRequestRefresh() {
+  refreshRequested = true;
+  if (netTask) xTaskNotifyGive(netTask);
+}
+
+bool netTimeValid() {
+  return timeValid;
+}
+
+bool netTakeEvents(std::vector<CalEvent>& outEvents, std::vector<CalInfo>& outCals, SeriesSet& outSeries) {
+  if (!pendingReady) return false;
+  xSemaphoreTake(dataMutex, portMAX_DELAY);
+  outEvents.swap(pendingEvents);
+  outCals.swap(pendingCals);
+  std::swap(outSeries, pendingSeries);
+  pendingEvents.clear();
+  pendingCals.clear();
+  pendingSeries = SeriesSet();
+  pendingReady = false;
+  xSemaphoreGive(dataMutex);
+  return true;
+}
+
+void netRequestPage(ViewMode view, const struct tm& date, int width, int height) {
+  xSemaphoreTake(dataMutex, portMAX_DELAY);
+  pageView = view;
+  pageDate = date;
+  pageWidth = width;
+  pageHeight = height;
+  xSemaphoreGive(dataMutex);
+  pageWanted = true;
+  pageRequested = true;
+  if (netTask) xTaskNotifyGive(netTask);
+}
+
+bool netTakePage(PageLayout& out) {
+  if (!pageReady) return false;
+  xSemaphoreTake(dataMutex, portMAX_DELAY);
+  std::swap(out, pendingPage);
+  pageReady = false;
+  xSemaphoreGive(dataMutex);
+  return true;
+}
+
+void netRequestTiles(ViewMode view, const struct tm& date, int width, int height) {
+  xSemaphoreTake(dataMutex, portMAX_DELAY);
+  tilesView = view;
+  tilesDate = date;
+  tilesWidth = width;
+  tilesHeight = height;
+  xSemaphoreGive(dataMutex);
+  tilesWanted = true;
+  tilesRequested = true;
+  if (netTask) xTaskNotifyGive(netTask);
+}
+
+bool netTakeTiles(std::shared_ptr<const TilePage>& out) {
+  if (!tilesReady) return false;
+  xSemaphoreTake(dataMutex, portMAX_DELAY);
+  out = pendingTiles.front();
+  pendingTiles.erase(pendingTiles.begin());
+  tilesReady = !pendingTiles.empty();
+  xSemaphoreGive(dataMutex);
+  return true;
+}
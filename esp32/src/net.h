@@ -0,0 +1,55 @@
+#pragma once
+
+// Network task: Wi-Fi bring-up, NTP and calendar refreshes run on core 0
+// so the UI loop can draw from the first millisecond.
+
+#include "calendar.h"
+#include "layout.h"
+#include "series.h"
+#include "tiles.h"
+
+enum NetPhase {
+  NET_WIFI_FAST,   // Joining with cached BSSID/channel (no scan)
+  NET_WIFI_SCAN,   // Full scan + join
+  NET_FETCH,       // Requesting events from the API
+  NET_IDLE,        // Connected, waiting for a refresh request
+  NET_BACKOFF      // Something failed, waiting before retrying
+};
+
+// Start the network task. Call once from setup().
+void netBegin();
+
+NetPhase netPhase();
+const char* netPhaseName();
+
+// Ask the network task to refresh; picked up as soon as it is idle
+void netRequestRefresh();
+
+// True once the system clock has been set by NTP
+bool netTimeValid();
+
+// Swap in the newest snapshot published by the network task: events,
+// calendars and the recurring series kept compact (series.h).
+// Returns false if nothing new arrived since the last call.
+bool netTakeEvents(std::vector<CalEvent>& outEvents, std::vector<CalInfo>& outCals, SeriesSet& outSeries);
+
+// Server-side layout (layout.h): fetch the page of `view` showing `date`
+// for a width x height panel once the network task is idle, and again
+// after every refresh until another page is asked for
+void netRequestPage(ViewMode view, const struct tm& date, int width, int height);
+
+// Swap in the newest page. Returns false if none arrived since the last call.
+bool netTakePage(PageLayout& out);
+
+// Thin client (tiles.h, TILE_URL): sync the tiles of the page of `view`
+// showing `date` once the network task is idle, then the pages either
+// side so swipes find them ready; again after every refresh until another
+// page is asked for
+void netRequestTiles(ViewMode view, const struct tm& date, int width, int height);
+
+// Next synced page, in the order they were synced. Returns false if none
+// is waiting.
+bool netTakeTiles(std::shared_ptr<const TilePage>& out);
+
+// Boot timeline: logs "[boot] +<ms> <label>" over serial
+void bootMark(const char* label);
@@ -0,0 +1,102 @@
+#include "profiler.h"
+#include "trace.h"
+
+#ifndef NO_INSTRUMENTATION
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <time.h>
+#endif
+
+static ProfStats stats[PROF_PHASE_COUNT];
+
+// Phases that also go to the trace ring; the per-call ones would flood it
+static const bool traced[PROF_PHASE_COUNT] = {
+  true, true, true, false, true, false, true, true, true
+};
+
+static const char* phaseNames[PROF_PHASE_COUNT] = {
+  "net_get", "net_body", "json_parse", "parse_iso", "ingest",
+  "day_query", "layout", "render_step", "frame"
+};
+
+#ifdef ARDUINO
+// 32-bit CCOUNT wraps after ~17 s at 240 MHz, longer phases are misreported
+uint32_t profCycles() {
+  return ESP.getCycleCount();
+}
+
+static uint32_t cyclesPerUs() {
+  static uint32_t mhz = 0;
+  if (!mhz) mhz = ESP.getCpuFreqMHz();
+  return mhz;
+}
+#else
+// Host builds count nanoseconds instead of cycles
+uint32_t profCycles() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+static uint32_t cyclesPerUs() {
+  return 1000;
+}
+#endif
+
+void profRecord(ProfPhase phase, uint32_t cycles) {
+  uint32_t us = cycles / cyclesPerUs();
+  ProfStats& s = stats[phase];
+  s.count++;
+  s.totalUs += us;
+  if (us > s.maxUs) s.maxUs = us;
+  int bucket = us ? 31 - __builtin_clz(us) : 0;
+  s.buckets[bucket]++;
+
+  if (traced[phase]) traceComplete(phase, traceNow() - us);
+}
+
+const ProfStats* profStats(ProfPhase phase) {
+  return &stats[phase];
+}
+
+const char* profPhaseName(ProfPhase phase) {
+  return phaseNames[phase];
+}
+
+uint32_t profPercentile(ProfPhase phase, int pct) {
+  const ProfStats& s = stats[phase];
+  if (!s.count) return 0;
+  uint32_t target = (uint32_t)(((uint64_t)s.count * pct + 99) / 100);
+  uint32_t seen = 0;
+  for (int i = 0; i < PROF_BUCKETS; i++) {
+    seen += s.buckets[i];
+    if (seen >= target) return i >= 31 ? 0xFFFFFFFF : (2u << i);
+  }
+  return s.maxUs;
+}
+
+void profReport(void (*emit)(const char* line)) {
+  char line[96];
+  emit("phase           count     avg_us     p50     p90     p99     max\n");
+  for (int p = 0; p < PROF_PHASE_COUNT; p++) {
+    const ProfStats& s = stats[p];
+    if (!s.count) continue;
+    ProfPhase phase = (ProfPhase)p;
+    snprintf(line, sizeof(line), "%-12s %8lu %10lu %7lu %7lu %7lu %7lu\n",
+             phaseNames[p], (unsigned long)s.count, (unsigned long)(s.totalUs / s.count),
+             (unsigned long)profPercentile(phase, 50), (unsigned long)profPercentile(phase, 90),
+             (unsigned long)profPercentile(phase, 99), (unsigned long)s.maxUs);
+    emit(line);
+  }
+}
+
+void profReset() {
+  memset(stats, 0, sizeof(stats));
+}
+
+#endif
@@ -0,0 +1,71 @@
+#pragma once
+
+// Phase profiler: scoped timers on the CPU cycle counter feeding one
+// log2-bucketed latency histogram per phase.
+//
+// Scopes may nest (ingest contains parse_iso); every histogram is inclusive.
+// Recording is a couple of counter reads and increments, so it stays on in
+// production builds. Build with -DNO_INSTRUMENTATION to compile it out.
+// Most phases are also recorded on the trace timeline (trace.h).
+// Each phase is recorded from a single task; reports may race with
+// recording and are only approximately consistent.
+
+#include <stdint.h>
+
+enum ProfPhase {
+  PROF_NET_GET,       // http.GET(): connect, TLS, request, response headers
+  PROF_NET_BODY,      // Reading the response body
+  PROF_JSON_PARSE,    // deserializeJson
+  PROF_PARSE_ISO,     // One parseISO() call
+  PROF_INGEST,        // JSON document -> CalEvent list
+  PROF_DAY_QUERY,     // One getEventsForDay() call
+  PROF_LAYOUT,        // Overlap/column layout for one day
+  PROF_RENDER_STEP,   // One resumable render step (layout + pixels)
+  PROF_FRAME,         // draw() to last step, including time yielded to input
+  PROF_PHASE_COUNT
+};
+
+#define PROF_BUCKETS 32   // Bucket i holds samples in [2^i, 2^(i+1)) us
+
+struct ProfStats {
+  uint32_t count;
+  uint64_t totalUs;
+  uint32_t maxUs;
+  uint32_t buckets[PROF_BUCKETS];
+};
+
+#ifndef NO_INSTRUMENTATION
+
+uint32_t profCycles();
+void profRecord(ProfPhase phase, uint32_t cycles);
+const ProfStats* profStats(ProfPhase phase);
+const char* profPhaseName(ProfPhase phase);
+
+// Upper bound (us) of the bucket containing the given percentile (0..100)
+uint32_t profPercentile(ProfPhase phase, int pct);
+
+// Emit a human-readable table, one line per call
+void profReport(void (*emit)(const char* line));
+void profReset();
+
+struct ProfScope {
+  ProfPhase phase;
+  uint32_t start;
+  explicit ProfScope(ProfPhase p) : phase(p), start(profCycles()) {}
+  ~ProfScope() { profRecord(phase, profCycles() - start); }
+};
+
+#define PROF_CONCAT_(a, b) a##b
+#define PROF_CONCAT(a, b) PROF_CONCAT_(a, b)
+#define PROF_SCOPE(phase) ProfScope PROF_CONCAT(_profScope, __LINE__)(phase)
+
+#else
+
+inline uint32_t profCycles() { return 0; }
+inline void profRecord(ProfPhase, uint32_t) {}
+inline void profReport(void (*)(const char*)) {}
+inline void profReset() {}
+
+#define PROF_SCOPE(phase) do {} while (0)
+
+#endif
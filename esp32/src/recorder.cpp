@@ -0,0 +1,122 @@
+#include "recorder.h"
+
+#ifdef ARDUINO
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "binlog.h"
+
+static SemaphoreHandle_t recMutex = NULL;
+static File recFile;
+static volatile bool active = false;
+static uint32_t written = 0;
+
+// Last touch sample, so a held finger isn't written 20 times a second
+static bool lastDown = false;
+static uint16_t lastX = 0, lastY = 0;
+
+// Caller holds recMutex
+static void writeRecord(const char* head, const char* body, size_t len) {
+  size_t headLen = strlen(head);
+  if (written + headLen + len + 1 > REC_MAX_BYTES) {
+    active = false;
+    recFile.close();
+    logWrite(LOG_REC_FULL);
+    return;
+  }
+  recFile.write((const uint8_t*)head, headLen);
+  if (body) {
+    recFile.write((const uint8_t*)body, len);
+    recFile.write((const uint8_t*)"\n", 1);
+    len++;
+  }
+  written += headLen + len;
+}
+
+bool recStart() {
+  if (!recMutex) recMutex = xSemaphoreCreateMutex();
+  if (!LittleFS.begin(true)) return false;
+
+  xSemaphoreTake(recMutex, portMAX_DELAY);
+  if (active) recFile.close();
+  recFile = LittleFS.open(REC_PATH, "w");
+  active = (bool)recFile;
+  written = 0;
+  lastDown = false;
+  if (active) {
+    const char* tz = getenv("TZ");
+    char line[96];
+    writeRecord("# calendar recording v1\n", NULL, 0);
+    snprintf(line, sizeof(line), "C %lu %lld %s\n", millis(), (long long)time(NULL), tz && *tz ? tz : "UTC0");
+    writeRecord(line, NULL, 0);
+  }
+  xSemaphoreGive(recMutex);
+  return active;
+}
+
+void recStop() {
+  if (!recMutex) return;
+  xSemaphoreTake(recMutex, portMAX_DELAY);
+  if (active) recFile.close();
+  active = false;
+  xSemaphoreGive(recMutex);
+}
+
+bool recActive() {
+  return active;
+}
+
+static void recBody(char type, const char* body, size_t len) {
+  if (!active) return;
+  char head[32];
+  snprintf(head, sizeof(head), "%c %lu %u\n", type, millis(), (unsigned)len);
+  xSemaphoreTake(recMutex, portMAX_DELAY);
+  if (active) writeRecord(head, body, len);
+  xSemaphoreGive(recMutex);
+}
+
+void recPayload(const char* body, size_t len) {
+  recBody('P', body, len);
+}
+
+void recPage(const char* body, size_t len) {
+  recBody('L', body, len);
+}
+
+void recTouch(bool down, uint16_t x, uint16_t y) {
+  if (!active) return;
+  if (down == lastDown && (!down || (x == lastX && y == lastY))) return;
+  lastDown = down;
+  lastX = x;
+  lastY = y;
+  char line[40];
+  snprintf(line, sizeof(line), "T %lu %d %u %u\n", millis(), down ? 1 : 0, x, y);
+  xSemaphoreTake(recMutex, portMAX_DELAY);
+  if (active) writeRecord(line, NULL, 0);
+  xSemaphoreGive(recMutex);
+}
+
+void recView(int view, const struct tm& date) {
+  if (!active) return;
+  char line[48];
+  snprintf(line, sizeof(line), "V %lu %d %d %d %d\n", millis(), view, date.tm_year + 1900, date.tm_mon + 1, date.tm_mday);
+  xSemaphoreTake(recMutex, portMAX_DELAY);
+  if (active) writeRecord(line, NULL, 0);
+  xSemaphoreGive(recMutex);
+}
+
+void recExport(void (*emit)(const char* text)) {
+  recStop();
+  if (!LittleFS.begin(true)) return;
+  File f = LittleFS.open(REC_PATH, "r");
+  if (!f) return;
+  char buf[513];
+  int n;
+  while ((n = f.read((uint8_t*)buf, sizeof(buf) - 1)) > 0) {
+    buf[n] = 0;
+    emit(buf);
+  }
+  f.close();
+}
+
+#endif
@@ -0,0 +1,50 @@
+#pragma once
+
+// Field recordings: the raw API payloads and the touch stream, written to
+// flash so an incident can be replayed on a PC (host/replay/).
+//
+// The file is text, one record per line, times in millis():
+//   # calendar recording v1
+//   C <ms> <epoch> <TZ>            wall clock and time zone at <ms>
+//   V <ms> <view> <year> <mon> <mday>   view shown when recording started
+//   T <ms> <down> <x> <y>          touch sample (only when it changes)
+//   P <ms> <len>                   API response body, followed by <len>
+//   <body>                         bytes and a newline
+//   L <ms> <len>                   Same for a ?layout= page (layout.h)
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define REC_PATH "/recording.txt"
+#define REC_MAX_BYTES (2 * 1024 * 1024)   // Recording stops here
+
+#ifdef ARDUINO
+
+// Truncates any previous recording. Returns false if the filesystem fails.
+bool recStart();
+void recStop();
+bool recActive();
+
+// Safe from any task
+void recPayload(const char* body, size_t len);
+void recPage(const char* body, size_t len);
+void recTouch(bool down, uint16_t x, uint16_t y);
+void recView(int view, const struct tm& date);
+
+// Stream the recording file (stops recording first)
+void recExport(void (*emit)(const char* text));
+
+#else
+
+// Host builds read recordings, they don't make them
+inline bool recStart() { return false; }
+inline void recStop() {}
+inline bool recActive() { return false; }
+inline void recPayload(const char*, size_t) {}
+inline void recPage(const char*, size_t) {}
+inline void recTouch(bool, uint16_t, uint16_t) {}
+inline void recView(int, const struct tm&) {}
+inline void recExport(void (*)(const char*)) {}
+
+#endif
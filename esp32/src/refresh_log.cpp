@@ -0,0 +1,98 @@
+#include "refresh_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static RefreshRecord ring[REFRESH_LOG_SIZE];
+static volatile uint32_t lastSeq = 0;
+
+static const char* stepNames[REFRESH_STEP_COUNT] = {
+  "dns", "connect", "tls", "ttfb", "transfer", "decode", "apply"
+};
+
+static const char* serverNames[SERVER_STEP_COUNT] = {
+  "upstream", "parse", "expand", "total"
+};
+
+const char* refreshStepName(RefreshStep step) {
+  return stepNames[step];
+}
+
+const char* serverStepName(ServerStep step) {
+  return serverNames[step];
+}
+
+void refreshParseServerTiming(const char* header, RefreshRecord& rec) {
+  const char* p = header;
+  while (p && *p) {
+    while (*p == ' ' || *p == ',') p++;
+    const char* name = p;
+    while (*p && *p != ';' && *p != ',' && *p != ' ') p++;
+    size_t nameLen = p - name;
+
+    // Parameters up to the next entry; only dur (ms) matters
+    double durMs = -1;
+    while (*p && *p != ',') {
+      if (!strncmp(p, ";dur=", 5)) durMs = strtod(p + 5, NULL);
+      p++;
+    }
+    if (durMs < 0) continue;
+    for (int s = 0; s < SERVER_STEP_COUNT; s++) {
+      if (strlen(serverNames[s]) == nameLen && !strncmp(name, serverNames[s], nameLen)) {
+        rec.serverUs[s] = (uint32_t)(durMs * 1000);
+      }
+    }
+  }
+}
+
+void refreshLogAdd(const RefreshRecord& rec) {
+  uint32_t seq = lastSeq + 1;
+  RefreshRecord& slot = ring[seq % REFRESH_LOG_SIZE];
+  slot = rec;
+  slot.seq = seq;
+  lastSeq = seq;
+}
+
+bool refreshLogLast(RefreshRecord& out) {
+  uint32_t seq = lastSeq;
+  if (!seq) return false;
+  out = ring[seq % REFRESH_LOG_SIZE];
+  return true;
+}
+
+static void ms(char* buf, size_t size, uint32_t us) {
+  snprintf(buf, size, "%8.1f", us / 1000.0);
+}
+
+void refreshLogReport(void (*emit)(const char* text)) {
+  char line[256];
+  int n = snprintf(line, sizeof(line), "  seq   uptime status   bytes events");
+  for (int s = 0; s < REFRESH_STEP_COUNT; s++) n += snprintf(line + n, sizeof(line) - n, " %8s", stepNames[s]);
+  n += snprintf(line + n, sizeof(line) - n, "    total |");
+  for (int s = 0; s < SERVER_STEP_COUNT; s++) n += snprintf(line + n, sizeof(line) - n, " %8s", serverNames[s]);
+  snprintf(line + n, sizeof(line) - n, "\n");
+  emit(line);
+
+  uint32_t last = lastSeq;
+  uint32_t first = last >= REFRESH_LOG_SIZE ? last - REFRESH_LOG_SIZE + 1 : 1;
+  for (uint32_t seq = first; seq <= last && seq; seq++) {
+    RefreshRecord r = ring[seq % REFRESH_LOG_SIZE];
+    if (r.seq != seq) continue;   // Overwritten while we were printing
+    char cell[16];
+    n = snprintf(line, sizeof(line), "%5lu %8lu %6ld %7lu %6lu", (unsigned long)r.seq, (unsigned long)r.uptimeSec,
+                 (long)r.status, (unsigned long)r.bodyBytes, (unsigned long)r.events);
+    for (int s = 0; s < REFRESH_STEP_COUNT; s++) {
+      ms(cell, sizeof(cell), r.stepUs[s]);
+      n += snprintf(line + n, sizeof(line) - n, " %s", cell);
+    }
+    ms(cell, sizeof(cell), r.totalUs);
+    n += snprintf(line + n, sizeof(line) - n, " %s |", cell);
+    for (int s = 0; s < SERVER_STEP_COUNT; s++) {
+      if (r.serverUs[s]) ms(cell, sizeof(cell), r.serverUs[s]);
+      else snprintf(cell, sizeof(cell), "%8s", "-");
+      n += snprintf(line + n, sizeof(line) - n, " %s", cell);
+    }
+    snprintf(line + n, sizeof(line) - n, "%s\n", r.ok ? "" : "  FAILED");
+    emit(line);
+  }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+// Where each calendar refresh spent its time: DNS, TCP connect, TLS,
+// time to first byte, body transfer, JSON decode and handing the snapshot
+// to the UI, plus the API's own breakdown from its Server-Timing header.
+//
+// The network task writes one record per refresh attempt into a small
+// ring; readers (serial, /refreshes, /metrics) copy without locking, like
+// the metrics counters.
+
+#include <stdint.h>
+
+#define REFRESH_LOG_SIZE 32
+
+enum RefreshStep {
+  REFRESH_DNS,
+  REFRESH_CONNECT,    // TCP handshake
+  REFRESH_TLS,        // 0 for plain http
+  REFRESH_TTFB,       // Request sent until the response headers are in
+  REFRESH_TRANSFER,   // Body
+  REFRESH_DECODE,     // JSON ingest
+  REFRESH_APPLY,      // Publishing the snapshot to the UI
+  REFRESH_STEP_COUNT
+};
+
+// Server-Timing entries the API reports (route.ts)
+enum ServerStep {
+  SERVER_UPSTREAM,    // Fetching the ICS feeds (slowest feed)
+  SERVER_PARSE,       // ICS parsing, all feeds
+  SERVER_EXPAND,      // Recurrence expansion, all feeds
+  SERVER_TOTAL,       // Whole request on the server
+  SERVER_STEP_COUNT
+};
+
+struct RefreshRecord {
+  uint32_t seq;           // 1-based, 0 = empty slot
+  uint32_t uptimeSec;
+  int32_t status;         // HTTP status, negative HTTPClient error, 0 = failed before the request
+  bool ok;
+  uint32_t stepUs[REFRESH_STEP_COUNT];
+  uint32_t serverUs[SERVER_STEP_COUNT];   // 0 = not reported
+  uint32_t totalUs;
+  uint32_t bodyBytes;
+  uint32_t events;
+};
+
+// Fill serverUs from a Server-Timing value ("name;dur=12.5, ...").
+// Unknown names are ignored.
+void refreshParseServerTiming(const char* header, RefreshRecord& rec);
+
+// Network task: append a finished record (seq is assigned here)
+void refreshLogAdd(const RefreshRecord& rec);
+
+// Most recent record, false if there is none yet
+bool refreshLogLast(RefreshRecord& out);
+
+const char* refreshStepName(RefreshStep step);
+const char* serverStepName(ServerStep step);
+
+// Table of the ring, oldest first, times in ms
+void refreshLogReport(void (*emit)(const char* text));
@@ -0,0 +1,252 @@
+#include "rrule.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int32_t daysFromCivil(int y, int m, int d) {
+  y -= m <= 2;
+  int era = (y >= 0 ? y : y - 399) / 400;
+  int yoe = y - era * 400;
+  int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+void civilFromDays(int32_t day, int& y, int& m, int& d) {
+  int32_t z = day + 719468;
+  int era = (z >= 0 ? z : z - 146096) / 146097;
+  int doe = z - era * 146097;
+  int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  int mp = (5 * doy + 2) / 153;
+  d = doy - (153 * mp + 2) / 5 + 1;
+  m = mp < 10 ? mp + 3 : mp - 9;
+  y = yoe + era * 400 + (m <= 2);
+}
+
+int weekdayOf(int32_t day) {
+  return (int)(((int64_t)day % 7 + 11) % 7);
+}
+
+static int daysInMonth(int y, int m) {
+  return daysFromCivil(y + (m == 12), m % 12 + 1, 1) - daysFromCivil(y, m, 1);
+}
+
+static int weekdayCode(const char* s) {
+  static const char* codes[] = {"SU", "MO", "TU", "WE", "TH", "FR", "SA"};
+  for (int i = 0; i < 7; i++) {
+    if (!strncmp(s, codes[i], 2)) return i;
+  }
+  return -1;
+}
+
+bool rruleParse(const char* text, RRule& out) {
+  memset(&out, 0, sizeof(out));
+  out.wkst = 1;
+  out.interval = 1;
+  char buf[160];
+  snprintf(buf, sizeof(buf), "%s", text);
+  char* save;
+  for (char* part = strtok_r(buf, ";", &save); part; part = strtok_r(NULL, ";", &save)) {
+    char* value = strchr(part, '=');
+    if (!value) return false;
+    *value++ = 0;
+    char* itemSave;
+    if (!strcmp(part, "FREQ")) {
+      if (!strcmp(value, "DAILY")) out.freq = RRULE_DAILY;
+      else if (!strcmp(value, "WEEKLY")) out.freq = RRULE_WEEKLY;
+      else if (!strcmp(value, "MONTHLY")) out.freq = RRULE_MONTHLY;
+      else if (!strcmp(value, "YEARLY")) out.freq = RRULE_YEARLY;
+      else return false;   // SECONDLY .. HOURLY
+    } else if (!strcmp(part, "INTERVAL")) {
+      int n = atoi(value);
+      if (n < 1 || n > 1000) return false;
+      out.interval = n;
+    } else if (!strcmp(part, "COUNT")) {
+      long n = atol(value);
+      if (n < 1) return false;
+      out.count = n;
+    } else if (!strcmp(part, "UNTIL")) {
+      int y, m, d, hh = 0, mm = 0, ss = 0;
+      if (sscanf(value, "%4d%2d%2d", &y, &m, &d) != 3) return false;
+      out.untilDate = value[8] != 'T';
+      if (!out.untilDate && sscanf(value + 9, "%2d%2d%2d", &hh, &mm, &ss) != 3) return false;
+      out.hasUntil = true;
+      out.untilDay = daysFromCivil(y, m, d);
+      out.untilSecs = hh * 3600 + mm * 60 + ss;
+    } else if (!strcmp(part, "WKST")) {
+      int wd = weekdayCode(value);
+      if (wd < 0) return false;
+      out.wkst = wd;
+    } else if (!strcmp(part, "BYDAY")) {
+      for (char* item = strtok_r(value, ",", &itemSave); item; item = strtok_r(NULL, ",", &itemSave)) {
+        char* code;
+        long pos = strtol(item, &code, 10);
+        int wd = weekdayCode(code);
+        if (wd < 0 || pos < -53 || pos > 53 || out.byDayCount == RRULE_BYDAY_MAX) return false;
+        out.byDayPos[out.byDayCount] = pos;
+        out.byDayWeekday[out.byDayCount++] = wd;
+      }
+    } else if (!strcmp(part, "BYMONTHDAY")) {
+      for (char* item = strtok_r(value, ",", &itemSave); item; item = strtok_r(NULL, ",", &itemSave)) {
+        int md = atoi(item);
+        if (!md || md < -31 || md > 31 || out.byMonthDayCount == RRULE_BYMONTHDAY_MAX) return false;
+        out.byMonthDay[out.byMonthDayCount++] = md;
+      }
+    } else if (!strcmp(part, "BYMONTH")) {
+      for (char* item = strtok_r(value, ",", &itemSave); item; item = strtok_r(NULL, ",", &itemSave)) {
+        int m = atoi(item);
+        if (m < 1 || m > 12) return false;
+        out.byMonth |= 1 << m;
+      }
+    } else {
+      return false;
+    }
+  }
+  return out.freq != RRULE_NONE;
+}
+
+// First day and length of period `k`
+static void periodAt(const RRuleIter& it, int32_t k, int32_t& first, int32_t& length) {
+  const RRule& r = *it.rule;
+  int y, m, d;
+  civilFromDays(it.start, y, m, d);
+  switch (r.freq) {
+    case RRULE_DAILY:
+      first = it.start + k * r.interval;
+      length = 1;
+      break;
+    case RRULE_WEEKLY:
+      first = it.start - (it.startWeekday - r.wkst + 7) % 7 + k * 7 * r.interval;
+      length = 7;
+      break;
+    case RRULE_MONTHLY: {
+      int32_t month = y * 12 + m - 1 + k * r.interval;
+      first = daysFromCivil(month / 12, month % 12 + 1, 1);
+      length = daysInMonth(month / 12, month % 12 + 1);
+      break;
+    }
+    default: {
+      int year = y + k * r.interval;
+      first = daysFromCivil(year, 1, 1);
+      length = daysFromCivil(year + 1, 1, 1) - first;
+      break;
+    }
+  }
+}
+
+// Index of the period containing `day`
+static int32_t periodOf(const RRuleIter& it, int32_t day) {
+  const RRule& r = *it.rule;
+  int y, m, d, fy, fm, fd;
+  civilFromDays(it.start, y, m, d);
+  civilFromDays(day, fy, fm, fd);
+  switch (r.freq) {
+    case RRULE_DAILY: return (day - it.start) / r.interval;
+    case RRULE_WEEKLY: return (day - (it.start - (it.startWeekday - r.wkst + 7) % 7)) / (7 * r.interval);
+    case RRULE_MONTHLY: return ((fy * 12 + fm) - (y * 12 + m)) / r.interval;
+    default: return (fy - y) / r.interval;
+  }
+}
+
+static bool matches(const RRuleIter& it, int32_t day) {
+  const RRule& r = *it.rule;
+  int y, m, d;
+  civilFromDays(day, y, m, d);
+  int wd = weekdayOf(day);
+  if (r.byMonth && !(r.byMonth & (1 << m))) return false;
+
+  // Without BY parts a rule repeats DTSTART's weekday, day or date
+  bool byDay = r.byDayCount > 0, byMonthDay = r.byMonthDayCount > 0;
+  if (r.freq == RRULE_WEEKLY && !byDay && wd != it.startWeekday) return false;
+  if ((r.freq == RRULE_MONTHLY || (r.freq == RRULE_YEARLY && r.byMonth)) && !byDay && !byMonthDay &&
+      d != it.startMonthDay) return false;
+  if (r.freq == RRULE_YEARLY && !r.byMonth && !byDay && !byMonthDay &&
+      (m != it.startMonth || d != it.startMonthDay)) return false;
+
+  if (byMonthDay) {
+    int dim = daysInMonth(y, m);
+    bool any = false;
+    for (int i = 0; i < r.byMonthDayCount && !any; i++) {
+      int md = r.byMonthDay[i];
+      any = md > 0 ? d == md : d == dim + md + 1;
+    }
+    if (!any) return false;
+  }
+
+  if (byDay) {
+    // Positions count within the month, or the year for YEARLY without
+    // BYMONTH; DAILY and WEEKLY have none
+    bool inMonth = r.freq == RRULE_MONTHLY || (r.freq == RRULE_YEARLY && r.byMonth);
+    int index, length;
+    if (inMonth) {
+      index = d - 1;
+      length = daysInMonth(y, m);
+    } else {
+      int32_t jan1 = daysFromCivil(y, 1, 1);
+      index = day - jan1;
+      length = daysFromCivil(y + 1, 1, 1) - jan1;
+    }
+    bool any = false;
+    for (int i = 0; i < r.byDayCount && !any; i++) {
+      if (r.byDayWeekday[i] != wd) continue;
+      int pos = r.byDayPos[i];
+      if (!pos || r.freq == RRULE_DAILY || r.freq == RRULE_WEEKLY) any = true;
+      else if (pos > 0) any = index / 7 + 1 == pos;
+      else any = -((length - 1 - index) / 7 + 1) == pos;
+    }
+    if (!any) return false;
+  }
+  return true;
+}
+
+void rruleBegin(RRuleIter& it, const RRule& rule, int32_t startDay, int32_t fromDay, int32_t toDay) {
+  it.rule = &rule;
+  it.start = startDay;
+  int y;
+  civilFromDays(startDay, y, it.startMonth, it.startMonthDay);
+  it.startWeekday = weekdayOf(startDay);
+  it.period = 0;
+  it.produced = 0;
+  it.idleDays = 0;
+  it.toDay = toDay;
+  it.pendingStart = true;
+  bool skip = !rule.count && fromDay > startDay;
+  if (skip) {
+    it.period = periodOf(it, fromDay);
+    it.pendingStart = false;
+  }
+  int32_t length;
+  periodAt(it, it.period, it.day, length);
+  it.periodEnd = it.day + length;
+  if (skip && it.day < fromDay) it.day = fromDay;
+}
+
+bool rruleNext(RRuleIter& it, int32_t& day) {
+  if (it.pendingStart) {
+    if (it.start > it.toDay) return false;
+    it.pendingStart = false;
+    it.produced = 1;
+    day = it.start;
+    return true;
+  }
+  const RRule& r = *it.rule;
+  for (;;) {
+    if (r.count && it.produced >= r.count) return false;
+    if (it.day >= it.periodEnd) {
+      int32_t length;
+      periodAt(it, ++it.period, it.day, length);
+      it.periodEnd = it.day + length;
+    }
+    if (it.day > it.toDay) return false;
+    int32_t d = it.day++;
+    if (d <= it.start) continue;
+    if (matches(it, d)) {
+      it.produced++;
+      it.idleDays = 0;
+      day = d;
+      return true;
+    }
+    if (++it.idleDays > RRULE_IDLE_DAYS) return false;
+  }
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+// Recurrence rules (RFC 5545 3.3.10) of series read from ICS feeds
+// (ics.h), covering what route.ts meets in practice and expanding it the
+// way ical.js does:
+//
+//   FREQ        DAILY, WEEKLY, MONTHLY, YEARLY
+//   INTERVAL    every n-th period
+//   BYDAY       MO,WE or 2TU / -1FR (position in the month, or in the year
+//               for YEARLY without BYMONTH)
+//   BYMONTHDAY  1..31, -1..-31
+//   BYMONTH     1..12
+//   COUNT, UNTIL, WKST
+//
+// Other parts (BYSETPOS, BYYEARDAY, BYWEEKNO, BYHOUR, ...) make a rule
+// unsupported; the caller then keeps only DTSTART.
+//
+// Rules work on local calendar days. Time of day and time zone stay with
+// the series. DTSTART is always the first occurrence (RFC 5545 3.8.5.3).
+// Every later one is a day of a period (day, week, month, year) that
+// matches all BY parts. Whether a day matches depends on nothing else, so
+// without COUNT the iterator starts right at the first day asked for,
+// however old the series is, and looking at a few days costs a few days.
+
+#include <stdint.h>
+
+#define RRULE_BYDAY_MAX 7
+#define RRULE_BYMONTHDAY_MAX 8
+#define RRULE_IDLE_DAYS (8 * 366)   // Give up after this long without a match (Feb 30, ...)
+
+enum RRuleFreq : uint8_t { RRULE_NONE, RRULE_DAILY, RRULE_WEEKLY, RRULE_MONTHLY, RRULE_YEARLY };
+
+struct RRule {
+  RRuleFreq freq;
+  uint8_t wkst;               // 0 = Sunday; default Monday
+  uint16_t interval;
+  uint32_t count;             // 0 = no COUNT
+  bool hasUntil;
+  bool untilDate;             // UNTIL=YYYYMMDD
+  int32_t untilDay;           // Days since 1970-01-01
+  int32_t untilSecs;
+  uint8_t byDayCount;
+  int8_t byDayPos[RRULE_BYDAY_MAX];     // 0 = every such weekday
+  uint8_t byDayWeekday[RRULE_BYDAY_MAX];
+  uint8_t byMonthDayCount;
+  int8_t byMonthDay[RRULE_BYMONTHDAY_MAX];
+  uint16_t byMonth;           // Bit m set for month m, 0 = any
+};
+
+struct RRuleIter {
+  const RRule* rule;
+  int32_t start;              // DTSTART's day
+  int startMonth, startMonthDay, startWeekday;
+  int32_t period;             // Index of the current period
+  int32_t day;                // Next day to look at
+  int32_t periodEnd;          // First day after the current period
+  int32_t idleDays;           // Looked at since the last match
+  int32_t toDay;              // Last day asked for
+  uint32_t produced;          // Occurrences so far, DTSTART included
+  bool pendingStart;          // DTSTART not yielded yet
+};
+
+// "FREQ=WEEKLY;BYDAY=MO,WE;UNTIL=20260630T215959Z". False if it is invalid
+// or uses a part this engine doesn't handle.
+bool rruleParse(const char* text, RRule& out);
+
+// Occurrences of `rule` for a series starting on `startDay`, up to
+// `toDay`. `fromDay` is the first day the caller cares about; earlier days
+// are skipped where COUNT allows, so occurrences before it may or may not
+// come out.
+void rruleBegin(RRuleIter& it, const RRule& rule, int32_t startDay, int32_t fromDay, int32_t toDay);
+
+// Next occurrence's day, in order. False past `toDay` or once the rule is
+// exhausted (COUNT, or nothing matched for RRULE_IDLE_DAYS); UNTIL is left
+// to the caller, which compares it with resolved times.
+bool rruleNext(RRuleIter& it, int32_t& day);
+
+// Proleptic Gregorian calendar <-> days since 1970-01-01
+int32_t daysFromCivil(int y, int m, int d);
+void civilFromDays(int32_t day, int& y, int& m, int& d);
+int weekdayOf(int32_t day);   // 0 = Sunday
@@ -0,0 +1,182 @@
+#include "series.h"
+#include "profiler.h"
+#include "alloc_track.h"
+#include <algorithm>
+
+static int32_t floorDiv(int64_t a, int64_t b) {
+  return (int32_t)(a >= 0 ? a / b : -((-a + b - 1) / b));
+}
+
+static int32_t zoneOffset(const SeriesZone& zone, int64_t wall) {
+  if (zone.shifts.empty()) return 0;
+  int32_t offset = zone.shifts[0].offset;
+  for (const SeriesShift& shift : zone.shifts) {
+    if (shift.since > wall) break;
+    offset = shift.offset;
+  }
+  return offset;
+}
+
+// The instance on wall day `day`
+static time_t instanceStart(const SeriesSet& set, const CalSeries& s, int32_t day) {
+  if (s.allDay) return deviceTime((int64_t)day * 86400);
+  int64_t wall = (int64_t)day * 86400 + s.startSecs;
+  if (s.zone >= 0 && s.zone < (int)set.zones.size()) wall -= zoneOffset(set.zones[s.zone], wall);
+  return deviceTime(wall);
+}
+
+void seriesPrepare(SeriesSet& set, size_t first) {
+  for (size_t i = first; i < set.series.size(); i++) {
+    CalSeries& s = set.series[i];
+    std::sort(s.skip.begin(), s.skip.end());
+    s.until = s.rule.hasUntil ? deviceTime((int64_t)s.rule.untilDay * 86400 + (s.rule.untilDate ? 0 : s.rule.untilSecs)) : 0;
+    s.lastDay = INT32_MAX;
+    if (!s.rule.count) continue;
+    RRuleIter it;
+    rruleBegin(it, s.rule, s.startDay, s.startDay, INT32_MAX);
+    int32_t day;
+    while (rruleNext(it, day)) s.lastDay = day;
+    s.rule.count = 0;
+  }
+}
+
+// Instances of `s` with start <= to and end >= from
+template <typename Fn>
+static void instances(const SeriesSet& set, const CalSeries& s, time_t from, time_t to, Fn fn) {
+  // Wall days run up to 14 hours off CalEvent days; look a little wider
+  int32_t fromDay = floorDiv((int64_t)from - s.duration, 86400) - 2;
+  int32_t toDay = std::min(floorDiv(to, 86400) + 2, s.lastDay);
+  RRuleIter it;
+  rruleBegin(it, s.rule, s.startDay, fromDay, toDay);
+  int32_t day;
+  while (rruleNext(it, day)) {
+    time_t start = instanceStart(set, s, day);
+    if (start > to || (s.until && start > s.until)) break;
+    if (start + s.duration < from) continue;
+    if (std::binary_search(s.skip.begin(), s.skip.end(), start)) continue;
+    fn(start);
+  }
+}
+
+static void addInstance(std::vector<CalEvent>& out, const CalSeries& s, time_t start) {
+  CalEvent e;
+  e.title = s.title;
+  e.start = start;
+  e.end = start + s.duration;
+  e.color = s.color;
+  e.location = s.location;
+  e.allDay = s.allDay;
+  out.push_back(e);
+}
+
+void seriesExpand(const SeriesSet& set, time_t from, time_t to, std::vector<CalEvent>& out) {
+  for (const CalSeries& s : set.series) {
+    instances(set, s, from, to, [&](time_t start) { addInstance(out, s, start); });
+  }
+}
+
+static time_t localMidnight(time_t t) {
+  struct tm dayTm;
+  localtime_r(&t, &dayTm);
+  dayTm.tm_hour = 0; dayTm.tm_min = 0; dayTm.tm_sec = 0;
+  return mktime(&dayTm);
+}
+
+// Instances on the day starting at local midnight `dayMin`, in series order
+template <typename Fn>
+static void dayInstances(const SeriesSet& set, time_t dayMin, Fn fn) {
+  struct tm dayTm;
+  localtime_r(&dayMin, &dayTm);
+  dayTm.tm_hour = 23; dayTm.tm_min = 59; dayTm.tm_sec = 59;
+  time_t dayMax = mktime(&dayTm);
+  for (const CalSeries& s : set.series) {
+    instances(set, s, dayMin, dayMax, [&](time_t start) {
+      // Same test as eventsForDay()
+      if (start < dayMax && start + s.duration > dayMin) fn(s, start);
+    });
+  }
+}
+
+void seriesMeasure(SeriesSet& set, time_t from, time_t to) {
+  set.dayMost = 0;
+  if (set.series.empty() || !from || to < from) return;
+  struct tm dayTm;
+  localtime_r(&from, &dayTm);
+  for (int i = 0; ; i++) {
+    struct tm d = dayTm;
+    d.tm_mday += i;
+    d.tm_hour = 0; d.tm_min = 0; d.tm_sec = 0;
+    d.tm_isdst = -1;
+    time_t dayMin = mktime(&d);
+    if (dayMin > to) break;
+    int n = 0;
+    dayInstances(set, dayMin, [&](const CalSeries&, time_t) { n++; });
+    if (n > set.dayMost) set.dayMost = std::min(n, SERIES_DAY_MAX);
+  }
+}
+
+void seriesDaysClear(SeriesDays& cache) {
+  for (SeriesDay& d : cache.days) {
+    d.day = 0;
+    d.count = 0;
+  }
+  cache.next = 0;
+}
+
+void seriesDaysReserve(const SeriesSet& set, SeriesDays& cache) {
+  unsigned title = 0, location = 0;
+  for (const CalSeries& s : set.series) {
+    title = std::max(title, s.title.length());
+    location = std::max(location, s.location.length());
+  }
+  for (SeriesDay& d : cache.days) {
+    d.events.resize(set.dayMost);
+    if (!set.dayMost) d.events.shrink_to_fit();
+    for (CalEvent& e : d.events) {
+      e.title.reserve(title);
+      e.location.reserve(location);
+    }
+  }
+}
+
+// Into the next free slot: String assignment reuses the slot's buffer
+static void fillInstance(SeriesDay& bucket, const CalSeries& s, time_t start) {
+  if (bucket.count == SERIES_DAY_MAX) return;
+  if (bucket.count == bucket.events.size()) bucket.events.emplace_back();   // Busier than reserved: allocates
+  CalEvent& e = bucket.events[bucket.count++];
+  e.title = s.title;
+  e.start = start;
+  e.end = start + s.duration;
+  e.color = s.color;
+  e.location = s.location;
+  e.allDay = s.allDay;
+}
+
+// The bucket of the day starting at local midnight `dayMin`, filled on a miss
+static SeriesDay& dayBucket(const SeriesSet& set, SeriesDays& cache, time_t dayMin) {
+  for (SeriesDay& d : cache.days) {
+    if (d.day == dayMin) return d;
+  }
+  ALLOC_SCOPE(ALLOC_LAYOUT);
+  SeriesDay& bucket = cache.days[cache.next];
+  cache.next = (cache.next + 1) % SERIES_DAY_CACHE;
+  bucket.day = dayMin;
+  bucket.count = 0;
+  dayInstances(set, dayMin, [&](const CalSeries& s, time_t start) { fillInstance(bucket, s, start); });
+  return bucket;
+}
+
+void seriesFillDay(const SeriesSet& set, SeriesDays& cache, time_t day) {
+  if (set.series.empty()) return;
+  PROF_SCOPE(PROF_DAY_QUERY);
+  dayBucket(set, cache, localMidnight(day));
+}
+
+int seriesForDay(const SeriesSet& set, SeriesDays& cache, time_t dayStart, CalEvent** out, int count,
+                 int maxEvents) {
+  if (set.series.empty()) return count;
+  PROF_SCOPE(PROF_DAY_QUERY);
+  SeriesDay& bucket = dayBucket(set, cache, localMidnight(dayStart));
+  for (int i = 0; i < bucket.count && count < maxEvents; i++) out[count++] = &bucket.events[i];
+  return count;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+// Recurring series kept the way the API sends them with ?series=1
+// (api/lib/fields.ts): the event once, its rule (rrule.h) and the
+// instances that don't happen, instead of every instance in the window.
+// Instances are made when a day is asked for, into a small cache of day
+// buckets, so memory follows the number of series rather than the number
+// of instances: a timetable of 40 weekly lessons stays 40 entries however
+// many weeks the window holds.
+//
+// Times work like ics.h: a series' DTSTART is wall time in its zone, and
+// each instance is converted with the zone's UTC offset at that wall time
+// into what parseISO() would have made of the API's UTC string for it.
+
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+#include "calendar.h"
+#include "rrule.h"
+
+#define SERIES_DAY_CACHE 64     // Day buckets kept; a month page needs 42
+#define SERIES_DAY_MAX 30       // Instances kept per day; no view shows more (MAX_DAY_EVENTS)
+
+// A zone's UTC offset from a wall time on, until the next shift
+struct SeriesShift {
+  int64_t since;          // Wall time, seconds since 1970-01-01 00:00 on that clock
+  int32_t offset;         // Seconds east of UTC
+};
+
+struct SeriesZone {
+  std::vector<SeriesShift> shifts;   // Ascending; the first also applies before its time
+};
+
+struct CalSeries {
+  String title;
+  String location;
+  uint16_t color;
+  bool allDay;
+  int32_t startDay;       // DTSTART's wall time: days since 1970-01-01 ...
+  int32_t startSecs;      // ... and seconds into that day
+  int32_t duration;       // Seconds, the same for every instance
+  int8_t zone;            // Index into SeriesSet::zones, -1 for UTC (and all-day)
+  RRule rule;
+  std::vector<time_t> skip;   // Instance starts that don't happen (EXDATE, moved, cancelled)
+  // Set by seriesPrepare()
+  int32_t lastDay;        // Last instance's day for COUNT rules, INT32_MAX if none
+  time_t until;           // UNTIL as CalEvent time, 0 = none
+};
+
+struct SeriesSet {
+  std::vector<CalSeries> series;
+  std::vector<SeriesZone> zones;
+  uint16_t dayMost = 0;   // Most instances on one day of the window, set by seriesMeasure()
+};
+
+// Call once series are added, from the first new one: sorts `skip` and
+// turns COUNT into a last day, so instances can be made for any day
+// without walking from DTSTART
+void seriesPrepare(SeriesSet& set, size_t first = 0);
+
+// Sets set.dayMost for the days of [from, to], so the day buckets can be
+// reserved before a frame fills them. Costs an expansion of the window;
+// done where the set is made (the network task), not on the UI task.
+void seriesMeasure(SeriesSet& set, time_t from, time_t to);
+
+// Appends the instances overlapping [from, to] (CalEvent times), in
+// series order, as the API would have sent them
+void seriesExpand(const SeriesSet& set, time_t from, time_t to, std::vector<CalEvent>& out);
+
+struct SeriesDay {
+  time_t day;             // Local midnight, 0 = unused
+  std::vector<CalEvent> events;   // Slots, the first `count` in use; kept when refilled
+  uint8_t count;
+};
+
+// Day buckets, oldest replaced first. Pointers handed out stay valid
+// until SERIES_DAY_CACHE other days have been asked for or the cache is
+// cleared, which must happen whenever the set changes.
+struct SeriesDays {
+  SeriesDay days[SERIES_DAY_CACHE];
+  uint8_t next;
+};
+
+void seriesDaysClear(SeriesDays& cache);
+
+// Sizes every bucket for `set`: set.dayMost slots with room for its
+// longest title and location. Filling then copies into them in place, so
+// a frame that makes buckets doesn't allocate (alloc_track.h) unless a
+// day outside the measured window is busier. Call after seriesDaysClear(),
+// outside any frame.
+void seriesDaysReserve(const SeriesSet& set, SeriesDays& cache);
+
+// Makes the bucket of the day holding `day`, unless it is cached. Meant
+// for one day per render step, before the step that reads the day.
+void seriesFillDay(const SeriesSet& set, SeriesDays& cache, time_t day);
+
+// Like eventsForDay() (layout.h) for the instances of `set`: appended to
+// out[count..maxEvents), returning the new count
+// (filling the day's bucket first if seriesFillDay() didn't)
+int seriesForDay(const SeriesSet& set, SeriesDays& cache, time_t dayStart, CalEvent** out, int count,
+                 int maxEvents);
@@ -0,0 +1,200 @@
+#include "tiles.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* viewNames[] = {"day", "week", "month"};
+
+size_t tileEncode(const uint16_t* fb, int stride, int x, int y, int w, int h, uint8_t* out) {
+  // Runs may continue onto the next row, so work on the tile's pixels in order
+  std::vector<uint16_t> px(w * h);
+  for (int row = 0; row < h; row++) memcpy(&px[row * w], fb + (y + row) * stride + x, w * sizeof(uint16_t));
+
+  size_t n = 0;
+  int total = w * h;
+  int i = 0;
+  while (i < total) {
+    int run = 1;
+    while (i + run < total && run < TILE_RUN_MAX && px[i + run] == px[i]) run++;
+    if (run >= 2) {
+      out[n++] = run - 1;
+      out[n++] = px[i] & 0xFF;
+      out[n++] = px[i] >> 8;
+      i += run;
+      continue;
+    }
+    // Literals until two equal neighbours start the next run
+    int lit = 1;
+    while (i + lit < total && lit < TILE_RUN_MAX &&
+           !(i + lit + 1 < total && px[i + lit] == px[i + lit + 1])) {
+      lit++;
+    }
+    out[n++] = 0x7F + lit;
+    for (int k = 0; k < lit; k++) {
+      out[n++] = px[i + k] & 0xFF;
+      out[n++] = px[i + k] >> 8;
+    }
+    i += lit;
+  }
+  return n;
+}
+
+bool tileDecode(const uint8_t* data, size_t len, int w, int h, TileSpan span, void* ctx) {
+  uint16_t lit[TILE_RUN_MAX];
+  int total = w * h;
+  int pos = 0;
+  size_t i = 0;
+  while (i < len) {
+    uint8_t op = data[i++];
+    bool run = op < 0x80;
+    int count = run ? op + 1 : op - 0x7F;
+    size_t bytes = run ? 2 : 2 * count;
+    if (i + bytes > len || pos + count > total) return false;
+
+    uint16_t color = 0;
+    if (run) {
+      color = data[i] | (data[i + 1] << 8);
+    } else {
+      for (int k = 0; k < count; k++) lit[k] = data[i + 2 * k] | (data[i + 2 * k + 1] << 8);
+    }
+    i += bytes;
+
+    // Split at row ends
+    int done = 0;
+    while (done < count) {
+      int x = pos % w, y = pos / w;
+      int seg = count - done < w - x ? count - done : w - x;
+      span(ctx, x, y, seg, run ? NULL : lit + done, color);
+      pos += seg;
+      done += seg;
+    }
+  }
+  return pos == total;
+}
+
+uint32_t tileHash(const uint8_t* data, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    h ^= data[i];
+    h *= 16777619u;
+  }
+  return h ? h : 1;
+}
+
+bool tileParseManifest(const char* text, TilePage& out) {
+  int version, year, month, day, width, height, tw, th, used = 0;
+  char view[8];
+  if (sscanf(text, "tiles %d %7s %d-%d-%d %d %d %d %d%n", &version, view, &year, &month, &day, &width,
+             &height, &tw, &th, &used) != 9 || version != 1) {
+    return false;
+  }
+  // Tiles have to line up with the ones this build blits
+  if (tw != TILE_W || th != TILE_H || width <= 0 || height <= 0) return false;
+
+  int v = 0;
+  while (v < 3 && strcmp(view, viewNames[v])) v++;
+  if (v == 3) return false;
+
+  struct tm start = {0};
+  start.tm_year = year - 1900;
+  start.tm_mon = month - 1;
+  start.tm_mday = day;
+  start.tm_isdst = -1;
+
+  out.view = (ViewMode)v;
+  out.start = mktime(&start);
+  out.width = width;
+  out.height = height;
+  out.cols = tileCols(width);
+  out.rows = tileRows(height);
+  out.hashes.clear();
+  out.tiles.clear();
+
+  const char* p = text + used;
+  for (int t = 0; t < out.cols * out.rows; t++) {
+    char* end;
+    unsigned long hash = strtoul(p, &end, 16);
+    if (end == p || !hash) return false;
+    out.hashes.push_back((uint32_t)hash);
+    p = end;
+  }
+  return true;
+}
+
+static void discardSpan(void*, int, int, int, const uint16_t*, uint16_t) {}
+
+std::shared_ptr<const TilePage> tileSync(TileGet get, void* ctx, const char* baseUrl, ViewMode view,
+                                         const struct tm& date, int width, int height,
+                                         const std::shared_ptr<const TilePage>* cache, int cacheCount,
+                                         TileSyncStats& stats) {
+  char url[256];
+  snprintf(url, sizeof(url), "%s?view=%s&date=%04d-%02d-%02d&w=%d&h=%d", baseUrl, viewNames[view],
+           date.tm_year + 1900, date.tm_mon + 1, date.tm_mday, width, height);
+
+  TileData body;
+  stats.status = get(ctx, url, NULL, body);
+  if (stats.status != 200) return NULL;
+  stats.bytes += body.size();
+  body.push_back(0);
+
+  std::shared_ptr<TilePage> page(new TilePage);
+  if (!tileParseManifest((const char*)body.data(), *page) || page->view != view || page->width != width ||
+      page->height != height) {
+    return NULL;
+  }
+
+  // An older copy of the same page, for conditional requests
+  const TilePage* previous = NULL;
+  for (int c = 0; c < cacheCount; c++) {
+    if (cache[c] && cache[c]->view == view && cache[c]->start == page->start) previous = cache[c].get();
+  }
+
+  page->tiles.resize(page->hashes.size());
+  for (size_t t = 0; t < page->hashes.size(); t++) {
+    uint32_t hash = page->hashes[t];
+    for (int c = 0; c < cacheCount && !page->tiles[t]; c++) {
+      if (!cache[c]) continue;
+      for (size_t k = 0; k < cache[c]->hashes.size(); k++) {
+        if (cache[c]->hashes[k] == hash && cache[c]->tiles[k]) {
+          page->tiles[t] = cache[c]->tiles[k];
+          break;
+        }
+      }
+    }
+    if (page->tiles[t]) {
+      stats.reused++;
+      continue;
+    }
+
+    char tileUrl[288];
+    snprintf(tileUrl, sizeof(tileUrl), "%s&tile=%u", url, (unsigned)t);
+    char etag[12];
+    const char* ifNoneMatch = NULL;
+    bool held = previous && t < previous->tiles.size() && previous->tiles[t];
+    if (held) {
+      snprintf(etag, sizeof(etag), "%08lx", (unsigned long)previous->hashes[t]);
+      ifNoneMatch = etag;
+    }
+
+    TileData data;
+    stats.status = get(ctx, tileUrl, ifNoneMatch, data);
+    if (stats.status == 304 && held) {
+      // Re-rendered since the manifest, back to what we hold
+      page->hashes[t] = previous->hashes[t];
+      page->tiles[t] = previous->tiles[t];
+      stats.notModified++;
+      continue;
+    }
+    if (stats.status != 200) return NULL;
+
+    int x = (t % page->cols) * TILE_W, y = (t / page->cols) * TILE_H;
+    int w = width - x < TILE_W ? width - x : TILE_W;
+    int h = height - y < TILE_H ? height - y : TILE_H;
+    if (!tileDecode(data.data(), data.size(), w, h, discardSpan, NULL)) return NULL;
+    stats.bytes += data.size();
+    stats.fetched++;
+    page->hashes[t] = tileHash(data.data(), data.size());
+    page->tiles[t] = std::shared_ptr<const TileData>(new TileData(std::move(data)));
+  }
+  return page;
+}
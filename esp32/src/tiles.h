@@ -0,0 +1,85 @@
+#pragma once
+
+// Thin-client tiles: a tile server renders whole views and the display
+// only blits them. The panel is cut into TILE_W x TILE_H tiles, each sent
+// RLE-compressed and named by a hash of its bytes, so after the first page
+// only tiles whose hash changed cross the network or touch the panel.
+//
+// Protocol (host/tiles/tile_server.cpp):
+//   GET <TILE_URL>?view=week&date=YYYY-MM-DD&w=1024&h=600
+//     manifest, text: "tiles 1 <view> <page start YYYY-MM-DD> <w> <h> <tile w> <tile h>\n"
+//     then one 8-digit hex hash per tile, row by row
+//   GET ...&tile=N  with If-None-Match: "<hash>"
+//     the encoded tile with ETag "<hash>", or 304 if it hasn't changed
+//
+// Encoding of one tile, pixels row by row, RGB565 little-endian:
+//   byte n < 0x80:  run of n + 1 pixels, one color follows
+//   byte n >= 0x80: n - 0x7F literal pixels follow
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <memory>
+#include <vector>
+#include "layout.h"
+
+#define TILE_W 128
+#define TILE_H 120
+#define TILE_RUN_MAX 128
+// Worst case: every pixel a literal, one count byte per TILE_RUN_MAX pixels
+#define TILE_MAX_BYTES (TILE_W * TILE_H * 2 + (TILE_W * TILE_H + TILE_RUN_MAX - 1) / TILE_RUN_MAX)
+
+// Tiles across and down a width x height panel (edge tiles may be smaller)
+inline int tileCols(int width) { return (width + TILE_W - 1) / TILE_W; }
+inline int tileRows(int height) { return (height + TILE_H - 1) / TILE_H; }
+
+// Encode the w x h block at (x, y) of a framebuffer `stride` pixels wide.
+// `out` holds at least TILE_MAX_BYTES. Returns the encoded length.
+size_t tileEncode(const uint16_t* fb, int stride, int x, int y, int w, int h, uint8_t* out);
+
+// Decoded pixels, a row segment at a time: `pixels` for literals (valid
+// during the call only), NULL for a run of `color`. x, y are tile-relative.
+typedef void (*TileSpan)(void* ctx, int x, int y, int count, const uint16_t* pixels, uint16_t color);
+
+// False if `data` isn't exactly one w x h tile
+bool tileDecode(const uint8_t* data, size_t len, int w, int h, TileSpan span, void* ctx);
+
+// FNV-1a over the encoded bytes, never 0 (0 means "unknown" to callers)
+uint32_t tileHash(const uint8_t* data, size_t len);
+
+typedef std::vector<uint8_t> TileData;
+
+// One page of one view as tiles. Tiles are immutable and shared between
+// pages holding the same hash.
+struct TilePage {
+  ViewMode view;
+  time_t start;                 // pageStart() of the page
+  uint16_t width, height;
+  uint16_t cols, rows;
+  std::vector<uint32_t> hashes;
+  std::vector<std::shared_ptr<const TileData>> tiles;
+};
+
+// Parse a NUL-terminated manifest into `out` (tiles left empty)
+bool tileParseManifest(const char* text, TilePage& out);
+
+// One GET for tileSync(): fills `body` and returns the HTTP status, or a
+// negative error. `ifNoneMatch` is a bare hash, or NULL.
+typedef int (*TileGet)(void* ctx, const char* url, const char* ifNoneMatch, TileData& body);
+
+struct TileSyncStats {
+  uint16_t fetched;       // 200s
+  uint16_t notModified;   // 304s
+  uint16_t reused;        // Same hash already held, not requested
+  uint32_t bytes;         // Manifest and tile bodies
+  int status;             // Last HTTP status or error
+};
+
+// Bring the page of `view` showing `date` up to date: fetch its manifest,
+// take tiles whose hash is already held by any page in `cache`, and fetch
+// only the rest, conditionally when the cache holds an older tile at that
+// position. Returns NULL on any failure.
+std::shared_ptr<const TilePage> tileSync(TileGet get, void* ctx, const char* baseUrl, ViewMode view,
+                                         const struct tm& date, int width, int height,
+                                         const std::shared_ptr<const TilePage>* cache, int cacheCount,
+                                         TileSyncStats& stats);
@@ -0,0 +1,99 @@
+#include "timer_wheel.h"
+#include <stddef.h>
+
+#define WHEEL_BITS   6
+#define WHEEL_SIZE   (1 << WHEEL_BITS)
+#define WHEEL_MASK   (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4
+#define WHEEL_MAX_DELAY ((1UL << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+
+static WheelTimer* wheel[WHEEL_LEVELS][WHEEL_SIZE];
+static uint32_t wheelNow = 0;
+
+static void link(WheelTimer** head, WheelTimer* t) {
+  t->slot = head;
+  t->prev = NULL;
+  t->next = *head;
+  if (*head) (*head)->prev = t;
+  *head = t;
+}
+
+static void unlink(WheelTimer* t) {
+  if (t->prev) t->prev->next = t->next;
+  else *t->slot = t->next;
+  if (t->next) t->next->prev = t->prev;
+  t->next = t->prev = NULL;
+  t->slot = NULL;
+}
+
+// Put a timer in the lowest level whose span still covers its delay
+static void place(WheelTimer* t) {
+  uint32_t delta = t->expires - wheelNow;
+  if (delta > WHEEL_MAX_DELAY) {
+    delta = WHEEL_MAX_DELAY;
+    t->expires = wheelNow + delta;
+  }
+
+  int level = 0;
+  while (level < WHEEL_LEVELS - 1 && delta >= (1UL << (WHEEL_BITS * (level + 1)))) level++;
+
+  uint32_t idx = (t->expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+  link(&wheel[level][idx], t);
+}
+
+// Re-place every timer in one slot of a higher level; returns that slot's index
+static uint32_t cascade(int level) {
+  uint32_t idx = (wheelNow >> (WHEEL_BITS * level)) & WHEEL_MASK;
+  WheelTimer* t = wheel[level][idx];
+  wheel[level][idx] = NULL;
+  while (t) {
+    WheelTimer* next = t->next;
+    t->slot = NULL;
+    place(t);
+    t = next;
+  }
+  return idx;
+}
+
+void timerInit(uint32_t now) {
+  wheelNow = now;
+}
+
+void timerSchedule(WheelTimer* t, uint32_t delaySec, void (*callback)(void*), void* arg) {
+  if (t->slot) unlink(t);
+  if (delaySec == 0) delaySec = 1;  // The current tick has already been processed
+  t->callback = callback;
+  t->arg = arg;
+  t->expires = wheelNow + delaySec;
+  place(t);
+}
+
+void timerCancel(WheelTimer* t) {
+  if (t->slot) unlink(t);
+}
+
+bool timerPending(const WheelTimer* t) {
+  return t->slot != NULL;
+}
+
+void timerAdvance(uint32_t now) {
+  while ((int32_t)(now - wheelNow) > 0) {
+    wheelNow++;
+
+    // Lower level wrapped: pull the next slot of the level above down
+    if ((wheelNow & WHEEL_MASK) == 0) {
+      for (int level = 1; level < WHEEL_LEVELS; level++) {
+        if (cascade(level) != 0) break;
+      }
+    }
+
+    // Pop one at a time: callbacks may re-arm themselves or cancel others.
+    // Re-armed timers never land in this slot (minimum delay is one tick).
+    WheelTimer** head = &wheel[0][wheelNow & WHEEL_MASK];
+    while (*head) {
+      WheelTimer* t = *head;
+      unlink(t);
+      t->callback(t->arg);
+    }
+  }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// Hierarchical timer wheel with 1 second ticks.
+//
+// Four levels of 64 slots cover 64 s, ~68 min, ~3 days and ~194 days.
+// Scheduling and cancelling are O(1); advancing costs O(1) per tick plus
+// the occasional cascade of one higher-level slot. Timers are owned by the
+// caller (no allocation) and may be re-armed from their own callback.
+
+#include <stdint.h>
+
+struct WheelTimer {
+  WheelTimer* next;
+  WheelTimer* prev;
+  WheelTimer** slot;      // List head we are linked into, NULL when idle
+  uint32_t expires;       // Absolute tick
+  void (*callback)(void* arg);
+  void* arg;
+};
+
+// Set the wheel's notion of "now" (in ticks). Call once before scheduling.
+void timerInit(uint32_t now);
+
+// Arm (or re-arm) a timer to fire delaySec ticks from now (minimum 1)
+void timerSchedule(WheelTimer* t, uint32_t delaySec, void (*callback)(void*), void* arg);
+
+void timerCancel(WheelTimer* t);
+bool timerPending(const WheelTimer* t);
+
+// Fire everything due up to and including `now`
+void timerAdvance(uint32_t now);
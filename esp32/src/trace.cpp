@@ -0,0 +1,116 @@
+#include "trace.h"
+
+#ifndef NO_INSTRUMENTATION
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <esp_timer.h>
+#else
+#include <time.h>
+#endif
+
+static TraceEvent* ring = NULL;
+static uint32_t writeIndex = 0;      // Total events ever claimed
+static volatile bool recording = false;
+
+static const char* extraNames[] = {"slice", "refresh", "touch", "net_phase"};
+static const char* threadNames[] = {"net", "ui"};
+
+#ifndef ARDUINO
+static thread_local uint8_t threadId = 1;
+#endif
+
+void traceInit() {
+  if (ring) return;
+#ifdef ARDUINO
+  ring = (TraceEvent*)ps_malloc(TRACE_CAPACITY * sizeof(TraceEvent));
+#else
+  ring = (TraceEvent*)malloc(TRACE_CAPACITY * sizeof(TraceEvent));
+#endif
+  recording = ring != NULL;
+}
+
+uint64_t traceNow() {
+#ifdef ARDUINO
+  return esp_timer_get_time();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+#endif
+}
+
+void traceSetThread(uint8_t tid) {
+#ifndef ARDUINO
+  threadId = tid;
+#endif
+}
+
+static void record(uint8_t name, uint64_t ts, uint32_t dur, uint8_t ph, uint8_t arg) {
+  if (!recording) return;
+  uint32_t i = __atomic_fetch_add(&writeIndex, 1, __ATOMIC_RELAXED) % TRACE_CAPACITY;
+  TraceEvent& e = ring[i];
+  e.ts = ts;
+  e.dur = dur;
+  e.name = name;
+#ifdef ARDUINO
+  e.tid = xPortGetCoreID();
+#else
+  e.tid = threadId;
+#endif
+  e.ph = ph;
+  e.arg = arg;
+}
+
+void traceComplete(uint8_t name, uint64_t startUs, uint8_t arg) {
+  record(name, startUs, (uint32_t)(traceNow() - startUs), 'X', arg);
+}
+
+void traceInstant(uint8_t name, uint8_t arg) {
+  record(name, traceNow(), 0, 'i', arg);
+}
+
+static const char* nameOf(uint8_t name) {
+  if (name < PROF_PHASE_COUNT) return profPhaseName((ProfPhase)name);
+  if (name < TRACE_NAME_COUNT) return extraNames[name - PROF_PHASE_COUNT];
+  return "?";
+}
+
+void traceExport(void (*emit)(const char* text)) {
+  char buf[160];
+  bool wasRecording = recording;
+  recording = false;
+
+  emit("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  // Metadata rows first, so every event below can lead with a comma
+  for (int t = 0; t < 2; t++) {
+    snprintf(buf, sizeof(buf),
+             "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+             t ? ",\n" : "", t, threadNames[t]);
+    emit(buf);
+  }
+
+  uint32_t end = __atomic_load_n(&writeIndex, __ATOMIC_RELAXED);
+  uint32_t count = end < TRACE_CAPACITY ? end : TRACE_CAPACITY;
+  for (uint32_t n = end - count; ring && n != end; n++) {
+    const TraceEvent& e = ring[n % TRACE_CAPACITY];
+    if (e.ph == 'X') {
+      snprintf(buf, sizeof(buf),
+               ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%lu,\"pid\":1,\"tid\":%d,\"args\":{\"arg\":%d}}",
+               nameOf(e.name), (unsigned long long)e.ts, (unsigned long)e.dur, e.tid, e.arg);
+    } else {
+      snprintf(buf, sizeof(buf),
+               ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%llu,\"pid\":1,\"tid\":%d,\"args\":{\"arg\":%d}}",
+               nameOf(e.name), (unsigned long long)e.ts, e.tid, e.arg);
+    }
+    emit(buf);
+  }
+  emit("\n]}\n");
+
+  recording = wasRecording;
+}
+
+#endif
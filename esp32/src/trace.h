@@ -0,0 +1,70 @@
+#pragma once
+
+// Timeline recorder: complete ("X") and instant ("i") events in a fixed
+// ring buffer (PSRAM on the device), exported as Chrome trace-event JSON
+// that loads in Perfetto or chrome://tracing.
+//
+// Writers from any task claim a slot with one atomic add; a record is a
+// timestamp read plus a 16-byte store. Profiler phases (except the very
+// fine-grained ones) are traced automatically by PROF_SCOPE.
+
+#include <stdint.h>
+#include "profiler.h"
+
+// The first PROF_PHASE_COUNT names mirror ProfPhase
+enum TraceName {
+  TRACE_SLICE = PROF_PHASE_COUNT,   // One renderSlice() call
+  TRACE_REFRESH,                    // Whole refresh on the network task
+  TRACE_TOUCH,                      // Instant: gesture recognised (arg = gesture)
+  TRACE_NET_PHASE,                  // Instant: network state change (arg = NetPhase)
+  TRACE_NAME_COUNT
+};
+
+#define TRACE_CAPACITY 16384   // 256 KB
+
+struct TraceEvent {
+  uint64_t ts;      // us since boot
+  uint32_t dur;     // us, 0 for instants
+  uint8_t name;
+  uint8_t tid;
+  uint8_t ph;       // 'X' or 'i'
+  uint8_t arg;
+};
+
+#ifndef NO_INSTRUMENTATION
+
+// Allocate the ring. Recording is a no-op until this has run.
+void traceInit();
+uint64_t traceNow();
+
+void traceComplete(uint8_t name, uint64_t startUs, uint8_t arg = 0);
+void traceInstant(uint8_t name, uint8_t arg = 0);
+
+// Which timeline row this thread's events go to (host builds; the device
+// uses the core number: 0 = net, 1 = ui)
+void traceSetThread(uint8_t tid);
+
+// Stream the ring as Chrome trace JSON. Recording pauses while exporting.
+void traceExport(void (*emit)(const char* text));
+
+struct TraceScope {
+  uint8_t name;
+  uint64_t start;
+  explicit TraceScope(uint8_t n) : name(n), start(traceNow()) {}
+  ~TraceScope() { traceComplete(name, start); }
+};
+
+#define TRACE_SCOPE(name) TraceScope PROF_CONCAT(_traceScope, __LINE__)(name)
+
+#else
+
+inline void traceInit() {}
+inline uint64_t traceNow() { return 0; }
+inline void traceComplete(uint8_t, uint64_t, uint8_t = 0) {}
+inline void traceInstant(uint8_t, uint8_t = 0) {}
+inline void traceSetThread(uint8_t) {}
+inline void traceExport(void (*)(const char*)) {}
+
+#define TRACE_SCOPE(name) do {} while (0)
+
+#endif
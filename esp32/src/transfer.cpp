@@ -0,0 +1,86 @@
+#include "transfer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+void transferReset(TransferParser& p) {
+  memset(&p, 0, sizeof(p));
+  p.state = TRANSFER_STATUS;
+  p.bodyLeft = -1;
+}
+
+// Status, header or chunk size line complete in p.line
+static void protocolLine(TransferParser& p) {
+  p.line[p.lineLen] = 0;
+  p.lineLen = 0;
+  switch (p.state) {
+    case TRANSFER_STATUS: {
+      // "HTTP/1.1 200 OK"
+      const char* sp = strchr(p.line, ' ');
+      p.status = sp ? atoi(sp + 1) : 0;
+      p.state = strncmp(p.line, "HTTP/", 5) || !p.status ? TRANSFER_FAILED : TRANSFER_HEADERS;
+      break;
+    }
+    case TRANSFER_HEADERS: {
+      const char* value = strchr(p.line, ':');
+      if (value) {
+        value++;
+        while (*value == ' ') value++;
+      }
+      if (!p.line[0]) {
+        if (p.status != 200 || p.bodyLeft == 0) p.state = TRANSFER_DONE;
+        else p.state = p.chunked ? TRANSFER_CHUNK_SIZE : TRANSFER_BODY;
+      } else if (!strncasecmp(p.line, "transfer-encoding:", 18)) {
+        p.chunked = strstr(value, "chunked") != NULL;
+      } else if (!strncasecmp(p.line, "content-length:", 15)) {
+        p.bodyLeft = strtoll(value, NULL, 10);
+      } else if (!strncasecmp(p.line, "location:", 9)) {
+        strcpy(p.location, value);
+      } else if (!strncasecmp(p.line, "content-type:", 13)) {
+        strncpy(p.contentType, value, sizeof(p.contentType) - 1);
+      }
+      break;
+    }
+    case TRANSFER_CHUNK_SIZE: {
+      char* end;
+      p.chunkLeft = strtoul(p.line, &end, 16);
+      if (end == p.line) p.state = TRANSFER_FAILED;
+      else p.state = p.chunkLeft ? TRANSFER_CHUNK_DATA : TRANSFER_DONE;   // Trailers aren't read
+      break;
+    }
+    case TRANSFER_CHUNK_END:
+      p.state = p.line[0] ? TRANSFER_FAILED : TRANSFER_CHUNK_SIZE;
+      break;
+    default:
+      break;
+  }
+}
+
+bool transferFeed(TransferParser& p, const char* bytes, size_t len, TransferBodyFn onBody, void* ctx) {
+  size_t i = 0;
+  while (i < len && p.state != TRANSFER_FAILED && p.state != TRANSFER_DONE) {
+    if (p.state == TRANSFER_BODY) {
+      // Content-Length counts down; without one the body runs to the close
+      size_t n = len - i;
+      if (p.bodyLeft >= 0 && (int64_t)n > p.bodyLeft) n = p.bodyLeft;
+      onBody(ctx, bytes + i, n);
+      i += n;
+      if (p.bodyLeft >= 0 && (p.bodyLeft -= n) == 0) p.state = TRANSFER_DONE;
+    } else if (p.state == TRANSFER_CHUNK_DATA) {
+      size_t n = len - i < p.chunkLeft ? len - i : p.chunkLeft;
+      onBody(ctx, bytes + i, n);
+      i += n;
+      if ((p.chunkLeft -= n) == 0) p.state = TRANSFER_CHUNK_END;
+    } else {
+      char c = bytes[i++];
+      if (c == '\n') protocolLine(p);
+      else if (c != '\r' && p.lineLen < sizeof(p.line) - 1) p.line[p.lineLen++] = c;
+    }
+  }
+  return p.state != TRANSFER_FAILED;
+}
+
+bool transferClosed(TransferParser& p) {
+  if (p.state == TRANSFER_BODY && p.bodyLeft < 0) p.state = TRANSFER_DONE;
+  return p.state == TRANSFER_DONE;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+// A GET response read from a socket that is polled instead of waited on,
+// so one task can keep several downloads going (ICS_FEEDS, net.cpp). The
+// raw bytes go in as they arrive (status line, headers, identity or
+// chunked body) and body bytes come out in the same pieces; nothing is
+// buffered but one header line. The change stream (watch.h) reads its
+// events from the body this parser hands out.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define TRANSFER_LINE_MAX 512   // Longer header lines are cut; a Location must fit
+#define TRANSFER_TYPE_MAX 48    // Longer Content-Types are cut
+
+enum TransferState {
+  TRANSFER_STATUS,        // Status line
+  TRANSFER_HEADERS,
+  TRANSFER_CHUNK_SIZE,    // Chunked body: size line
+  TRANSFER_CHUNK_DATA,
+  TRANSFER_CHUNK_END,     // CRLF after a chunk
+  TRANSFER_BODY,          // Identity body
+  TRANSFER_DONE,          // Body complete, or headers of a response without one we want
+  TRANSFER_FAILED         // Broken status line or chunking
+};
+
+// Body bytes of a 200, in arrival order
+typedef void (*TransferBodyFn)(void* ctx, const char* bytes, size_t len);
+
+struct TransferParser {
+  TransferState state;
+  int status;
+  bool chunked;
+  int64_t bodyLeft;       // Content-Length still to come, -1 = until the server closes
+  uint32_t chunkLeft;
+  char line[TRANSFER_LINE_MAX];
+  uint16_t lineLen;
+  char location[TRANSFER_LINE_MAX];   // Location header, for redirects
+  char contentType[TRANSFER_TYPE_MAX];
+};
+
+void transferReset(TransferParser& p);
+
+// Feed received bytes. Responses other than 200 are done once their
+// headers are in; check p.status and p.location. Returns false once the
+// response is broken.
+bool transferFeed(TransferParser& p, const char* bytes, size_t len, TransferBodyFn onBody, void* ctx);
+
+// The server closed the connection: true if the response was complete
+bool transferClosed(TransferParser& p);
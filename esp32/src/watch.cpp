@@ -0,0 +1,69 @@
+#include "watch.h"
+#include <string.h>
+
+void watchReset(WatchParser& p) {
+  memset(&p, 0, sizeof(p));
+  transferReset(p.http);
+}
+
+// Where transferFeed() hands the body during one watchFeed()
+struct WatchSink {
+  WatchParser* p;
+  WatchEvent onEvent;
+  void* ctx;
+};
+
+static bool eventStream(const TransferParser& http) {
+  return http.status == 200 && strstr(http.contentType, "text/event-stream") != NULL;
+}
+
+static void copyValue(char* dst, size_t size, const char* src) {
+  size_t n = strlen(src);
+  if (n >= size) n = size - 1;
+  memcpy(dst, src, n);
+  dst[n] = 0;
+}
+
+// One event stream line, without its line ending
+static void streamLine(WatchParser& p, WatchEvent onEvent, void* ctx) {
+  p.field[p.fieldLen] = 0;
+  p.fieldLen = 0;
+  if (!p.field[0]) {
+    // Blank line ends the event; ones without data are ignored
+    if (p.data[0]) onEvent(ctx, p.event[0] ? p.event : "message", p.data);
+    p.event[0] = 0;
+    p.data[0] = 0;
+    return;
+  }
+  if (p.field[0] == ':') return;   // Comment, e.g. the server's pings
+
+  char* value = strchr(p.field, ':');
+  if (value) {
+    *value++ = 0;
+    if (*value == ' ') value++;
+  } else {
+    value = p.field + strlen(p.field);
+  }
+  if (!strcmp(p.field, "event")) copyValue(p.event, sizeof(p.event), value);
+  else if (!strcmp(p.field, "data")) copyValue(p.data, sizeof(p.data), value);
+}
+
+static void streamBytes(void* ctx, const char* bytes, size_t len) {
+  WatchSink& sink = *(WatchSink*)ctx;
+  WatchParser& p = *sink.p;
+  if (!eventStream(p.http)) return;   // Refused in watchFeed() below
+  for (size_t i = 0; i < len; i++) {
+    char c = bytes[i];
+    if (c == '\n') streamLine(p, sink.onEvent, sink.ctx);
+    else if (c != '\r' && p.fieldLen < sizeof(p.field) - 1) p.field[p.fieldLen++] = c;
+  }
+}
+
+bool watchFeed(WatchParser& p, const char* bytes, size_t len, WatchEvent onEvent, void* ctx) {
+  WatchSink sink = {&p, onEvent, ctx};
+  if (!transferFeed(p.http, bytes, len, streamBytes, &sink)) return false;
+  // A status other than 200 is refused as soon as the status line is in,
+  // anything but an event stream once the headers are
+  if (p.http.state > TRANSFER_STATUS && p.http.status != 200) return false;
+  return p.http.state <= TRANSFER_HEADERS || eventStream(p.http);
+}
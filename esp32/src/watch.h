@@ -0,0 +1,45 @@
+#pragma once
+
+// Change notifications: instead of only polling every REFRESH_INTERVAL,
+// the network task keeps one request open to GET <API_URL>?watch=1 and the
+// API answers with a Server-Sent Events stream:
+//
+//   event: version
+//   data: <data version>
+//
+// once when the stream opens and again whenever the aggregated calendars
+// change, with ": ping" comments in between so a dead connection is
+// noticed. Event responses carry the same version in their ETag
+// ("<version>.<window>"), so the fetch a notification triggers, and the
+// polls that remain as a fallback, are conditional and cost a 304 when
+// nothing changed.
+//
+// The parser below takes the raw response bytes as they arrive, so it can
+// be fed from a non-blocking socket. The HTTP side (status line, headers,
+// identity or chunked body) is transfer.h's; this only splits the body
+// into events and buffers nothing but one line.
+
+#include <stdint.h>
+#include <stddef.h>
+#include "transfer.h"
+
+#define WATCH_LINE_MAX 96      // Longer lines are cut; versions are 12 hex digits
+#define WATCH_PING_SECS 15     // Server sends a comment at least this often
+
+// Called once per complete event with its name ("message" if none) and data
+typedef void (*WatchEvent)(void* ctx, const char* event, const char* data);
+
+struct WatchParser {
+  TransferParser http;          // Status, headers, chunking; the body comes to us
+  char field[WATCH_LINE_MAX];   // Event stream line, may span chunks
+  uint16_t fieldLen;
+  char event[16];
+  char data[WATCH_LINE_MAX];
+};
+
+void watchReset(WatchParser& p);
+
+// Feed received bytes. Returns false once the response turned out not to
+// be a usable event stream, i.e. not a 200 (p.http.status tells) or not
+// text/event-stream; the connection should then be dropped.
+bool watchFeed(WatchParser& p, const char* bytes, size_t len, WatchEvent onEvent, void* ctx);